@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "app.h"
+#include "app_assets.hpp"
+#include "camera_index.h"
+
+httpd_uri_t g_uri_index = {
+
+		.uri = "/",
+		.method = HTTP_GET,
+		.handler = assets_handler,
+		.user_ctx = NULL,
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL,
+#endif
+
+};
+
+static constexpr uint64_t assets_hash(uint8_t const *p_data, size_t const p_len) {
+	uint64_t hash = 0xCBF29CE484222325ULL;
+
+	for (size_t i = 0; i < p_len; i++) {
+		hash = (hash ^ p_data[i]) * 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+// `constexpr`, so the hashes can't be left for runtime:
+static constexpr assets_entry s_assets[] = {
+
+	{ "/", "text/html", "gzip", index_ov2640_html_gz, index_ov2640_html_gz_len, assets_hash(index_ov2640_html_gz, index_ov2640_html_gz_len) },
+
+};
+
+static assets_stats s_stats = {}; // Only `camera_httpd`'s task writes these.
+
+bool assets_etag_matches(char const *p_if_none_match, char const *p_etag) {
+	size_t const etag_len = strlen(p_etag);
+	char const *at = p_if_none_match;
+
+	while (*at != '\0') {
+		while (*at == ' ' || *at == '\t' || *at == ',') {
+			at++;
+		}
+
+		if (*at == '*') {
+			return true;
+		}
+
+		if (strncmp(at, "W/", 2) == 0) {
+			at += 2;
+		}
+
+		// One `"opaque-tag"`, quotes and all. Commas can't be in it, so it ends at the closing quote:
+		char const *const tag = at;
+		if (*at == '"') {
+			at = strchr(at + 1, '"');
+
+			ifu(at == NULL) {
+				return false;
+			}
+
+			at++;
+		}
+
+		if ((size_t) (at - tag) == etag_len && strncmp(tag, p_etag, etag_len) == 0) {
+			return true;
+		}
+
+		// Whatever's left of this one, malformed or not:
+		while (*at != '\0' && *at != ',') {
+			at++;
+		}
+	}
+
+	return false;
+}
+
+void assets_get(assets_stats *p_out) {
+	*p_out = s_stats;
+}
+
+esp_err_t assets_handler(httpd_req_t *p_request) {
+	size_t const uri_len = strcspn(p_request->uri, "?");
+	assets_entry const *asset = NULL;
+
+	for (assets_entry const &entry : s_assets) {
+		if (strlen(entry.uri) == uri_len && strncmp(entry.uri, p_request->uri, uri_len) == 0) {
+			asset = &entry;
+			break;
+		}
+	}
+
+	ifu(asset == NULL) {
+		return httpd_resp_send_404(p_request);
+	}
+
+	char etag[20];
+	snprintf(etag, sizeof(etag), "\"%016llx\"", (unsigned long long) asset->hash);
+	httpd_resp_set_hdr(p_request, "ETag", etag);
+	httpd_resp_set_hdr(p_request, "Cache-Control", ASSETS_CACHE_CONTROL);
+
+	char if_none_match[ASSETS_IF_NONE_MATCH_MAX];
+	size_t const if_none_match_len = httpd_req_get_hdr_value_len(p_request, "If-None-Match");
+
+	if (if_none_match_len > 0 && if_none_match_len < sizeof(if_none_match)
+		&& httpd_req_get_hdr_value_str(p_request, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK
+		&& assets_etag_matches(if_none_match, etag)) {
+		s_stats.not_modified++;
+		s_stats.bytes_saved += asset->len;
+		httpd_resp_set_status(p_request, "304 Not Modified");
+		return httpd_resp_send(p_request, NULL, 0);
+	}
+
+	s_stats.sent++;
+	httpd_resp_set_type(p_request, asset->type);
+
+	if (asset->encoding != NULL) {
+		httpd_resp_set_hdr(p_request, "Content-Encoding", asset->encoding);
+	}
+
+	return httpd_resp_send(p_request, (char const*) asset->data, asset->len); // Straight out of flash.
+}
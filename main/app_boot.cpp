@@ -0,0 +1,79 @@
+#include <stdint.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+#include "app.h"
+#include "app_boot.hpp"
+
+EventGroupHandle_t g_boot_events = NULL;
+
+static char const *TAG = __FILE__;
+static int64_t volatile s_phase_times[BOOT_PHASE_COUNT]; // Microseconds since reset. `0` means "never happened".
+
+static char const *s_phase_names[BOOT_PHASE_COUNT] = {
+
+	"arduino",
+	"wifi-begin",
+	"server",
+	"camera",
+	"wifi-ip",
+	"first-frame",
+
+};
+
+void boot_init() {
+	ifl(g_boot_events == NULL) {
+		g_boot_events = xEventGroupCreate();
+	}
+}
+
+void boot_mark(boot_phase const p_phase, EventBits_t const p_bits) {
+	// Phases get marked from different tasks, but each phase only ever has one writer. No lock needed.
+	ifl(s_phase_times[p_phase] == 0) {
+		int64_t const time = esp_timer_get_time();
+		s_phase_times[p_phase] = time;
+		ESP_LOGI(TAG, "Boot phase `%s` done at `%lld` ms.", s_phase_names[p_phase], time / 1000);
+
+		// Only on the first mark, so `stream_handler()` can call this every frame for free.
+		ifl(p_bits != 0 && g_boot_events != NULL) {
+			xEventGroupSetBits(g_boot_events, p_bits);
+		}
+	}
+}
+
+bool boot_wait(EventBits_t const p_bits, TickType_t const p_timeout) {
+	ifu(g_boot_events == NULL) {
+		return false;
+	}
+
+	EventBits_t const bits = xEventGroupWaitBits(g_boot_events, p_bits, pdFALSE, pdTRUE, p_timeout);
+	return (bits & p_bits) == p_bits;
+}
+
+bool boot_wait_camera(TickType_t const p_timeout) {
+	ifu(g_boot_events == NULL) {
+		return false;
+	}
+
+	// Wait for *either* bit, then see which one it was:
+	EventBits_t const bits = xEventGroupWaitBits(g_boot_events, BOOT_BITS_CAMERA_DONE, pdFALSE, pdFALSE, p_timeout);
+	return (bits & BOOT_BIT_CAMERA_READY) != 0;
+}
+
+void boot_log_timeline() {
+	// Times are since reset, not since `app_main()`, so the bootloader's share shows up too.
+	for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+		int64_t const time = s_phase_times[i];
+
+		ifu(time == 0) {
+			ESP_LOGW(TAG, "Boot phase `%s` never completed.", s_phase_names[i]);
+			continue;
+		}
+
+		ESP_LOGI(TAG, "Boot timeline: `%-12s` `%6lld` ms.", s_phase_names[i], time / 1000);
+	}
+}
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_camera.h>
+#include <esp_heap_caps.h>
+
+#include <Arduino.h>
+
+#include "app.h"
+#include "app_boot.hpp"
+#include "app_burst.hpp"
+#include "app_timelapse.hpp"
+#include "app_profiles.hpp"
+
+#define BURST_BOUNDARY "burst-5f3a9c1e7d2b4860"
+
+httpd_uri_t g_uri_burst = {
+
+		.uri = "/burst",
+		.method = HTTP_GET,
+		.handler = burst_handler,
+		.user_ctx = NULL,
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL,
+#endif
+
+};
+
+struct burst_frame {
+
+	uint8_t *jpeg; // In PSRAM, ours.
+	size_t len;
+	int64_t timestamp_us;
+
+};
+
+static char const *TAG = __FILE__;
+static bool volatile s_active = false;
+
+bool burst_active() {
+	return s_active;
+}
+
+static int64_t burst_frame_us(camera_fb_t const *p_fb) {
+	return p_fb->timestamp.tv_sec * 1000000LL + p_fb->timestamp.tv_usec;
+}
+
+// Into `p_frames`, as fast as the sensor makes them. How many it got.
+static uint32_t burst_capture(burst_frame *p_frames, uint32_t const p_count, int64_t const p_since_us) {
+	uint32_t got = 0;
+	uint32_t flushed = 0;
+
+	while (got < p_count) {
+		camera_fb_t *fb = esp_camera_fb_get();
+
+		ifu(fb == NULL) {
+			ESP_LOGE(TAG, "Camera capture failed, `%lu` frames in.", (unsigned long) got);
+			break;
+		}
+
+		// Still the old size, or started before it got switched:
+		ifu(burst_frame_us(fb) < p_since_us && flushed < BURST_FLUSH_MAX) {
+			esp_camera_fb_return(fb);
+			flushed++;
+			continue;
+		}
+
+		burst_frame &frame = p_frames[got];
+		frame.jpeg = (uint8_t*) heap_caps_malloc(fb->len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+		ifu(frame.jpeg == NULL) {
+			ESP_LOGW(TAG, "PSRAM's full after `%lu` frames. That's the burst, then.", (unsigned long) got);
+			esp_camera_fb_return(fb);
+			break;
+		}
+
+		memcpy(frame.jpeg, fb->buf, fb->len);
+		frame.len = fb->len;
+		frame.timestamp_us = burst_frame_us(fb);
+		esp_camera_fb_return(fb); // Right away, so the driver's never short of a buffer for the next one.
+		got++;
+	}
+
+	return got;
+}
+
+esp_err_t burst_handler(httpd_req_t *p_request) {
+	char str_query[32];
+	char param_value[4];
+	uint32_t count = BURST_FRAMES_DEFAULT;
+
+	if (httpd_req_get_url_query_str(p_request, str_query, sizeof(str_query)) == ESP_OK
+		&& httpd_query_key_value(str_query, "frames", param_value, sizeof(param_value)) == ESP_OK) {
+		count = strtoul(param_value, NULL, 10);
+	}
+
+	ifu(count == 0 || count > BURST_FRAMES_MAX) {
+		return httpd_resp_send_err(p_request, HTTPD_400_BAD_REQUEST, "`frames` goes from 1 to 10.");
+	}
+
+	// Without PSRAM, `main.cpp` gave the camera SVGA buffers in DRAM: a UXGA frame doesn't fit in those, and there'd be
+	// nowhere to copy frames out to anyway.
+	ifu(!psramFound()) {
+		httpd_resp_set_status(p_request, "503 Service Unavailable");
+		return httpd_resp_send(p_request, "No PSRAM, no bursts.", HTTPD_RESP_USE_STRLEN);
+	}
+
+	sensor_t *sensor = esp_camera_sensor_get();
+	ifu(!boot_wait_camera(pdMS_TO_TICKS(5000)) || sensor == NULL || sensor->pixformat != PIXFORMAT_JPEG) {
+		return httpd_resp_send_500(p_request);
+	}
+
+	// Everyone else off the sensor, and full resolution. With PSRAM, `main.cpp` initialized the camera for UXGA, so its
+	// buffers fit. Nobody else changes the size until it's back to what it was:
+	burst_frame frames[BURST_FRAMES_MAX] = {};
+	profiles_framesize_take(portMAX_DELAY);
+	s_active = true;
+	timelapse_hold();
+
+	framesize_t const framesize = sensor->status.framesize;
+	if (framesize != FRAMESIZE_UXGA) {
+		sensor->set_framesize(sensor, FRAMESIZE_UXGA);
+	}
+
+	int64_t const start = esp_timer_get_time();
+	uint32_t const got = burst_capture(frames, count, start);
+	int64_t const captured = esp_timer_get_time();
+
+	if (framesize != FRAMESIZE_UXGA) {
+		sensor->set_framesize(sensor, framesize);
+	}
+
+	timelapse_release();
+	s_active = false;
+	profiles_framesize_give();
+
+	ifu(got == 0) {
+		return httpd_resp_send_500(p_request);
+	}
+
+	uint32_t bytes = 0;
+	uint32_t gap_min = UINT32_MAX;
+	uint32_t gap_max = 0;
+	for (uint32_t i = 0; i < got; i++) {
+		bytes += frames[i].len;
+
+		if (i > 0) {
+			uint32_t const gap = frames[i].timestamp_us - frames[i - 1].timestamp_us;
+			gap_min = gap < gap_min ? gap : gap_min;
+			gap_max = gap > gap_max ? gap : gap_max;
+		}
+	}
+
+	uint32_t dropped = 0;
+	for (uint32_t i = 1; i < got && gap_min > 0; i++) {
+		dropped += (frames[i].timestamp_us - frames[i - 1].timestamp_us) * 2 / (gap_min * 3);
+	}
+
+	uint32_t const gap_avg = got > 1 ? (frames[got - 1].timestamp_us - frames[0].timestamp_us) / (got - 1) : 0;
+	gap_min = got > 1 ? gap_min : 0;
+
+	char header[64];
+	httpd_resp_set_type(p_request, "multipart/mixed; boundary=" BURST_BOUNDARY);
+	httpd_resp_set_hdr(p_request, "Access-Control-Allow-Origin", "*");
+	snprintf(header, sizeof(header), "%lu/%lu/%lu us, %lu dropped", (unsigned long) gap_min, (unsigned long) gap_avg,
+		(unsigned long) gap_max, (unsigned long) dropped);
+	httpd_resp_set_hdr(p_request, "X-Burst-Gaps", header);
+
+	esp_err_t res = ESP_OK;
+	char part[160];
+	for (uint32_t i = 0; i < got && res == ESP_OK; i++) {
+		int const len = snprintf(part, sizeof(part),
+			"--" BURST_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\nX-Frame: %lu\r\nX-Timestamp: %lld.%06lld\r\n\r\n",
+			(unsigned) frames[i].len, (unsigned long) i, (long long) (frames[i].timestamp_us / 1000000),
+			(long long) (frames[i].timestamp_us % 1000000));
+
+		res = httpd_resp_send_chunk(p_request, part, len);
+		if (res == ESP_OK) {
+			res = httpd_resp_send_chunk(p_request, (char const*) frames[i].jpeg, frames[i].len);
+		}
+
+		if (res == ESP_OK) {
+			res = httpd_resp_send_chunk(p_request, "\r\n", 2);
+		}
+	}
+
+	int64_t const sent = esp_timer_get_time();
+	uint32_t const capture_us = captured - start;
+	uint32_t const send_us = sent - captured;
+
+	// Everything about the burst, last. The send throughput's only known by now:
+	char json[512];
+	int len = snprintf(json, sizeof(json),
+		"--" BURST_BOUNDARY "\r\nContent-Type: application/json\r\n\r\n"
+		"{\"frames\":%lu,\"bytes\":%lu,\"gap_us\":{\"min\":%lu,\"avg\":%lu,\"max\":%lu},\"dropped\":%lu,"
+		"\"capture_ms\":%lu,\"send_ms\":%lu,\"send_kib_s\":%lu,\"timestamps_us\":[",
+		(unsigned long) got, (unsigned long) bytes, (unsigned long) gap_min, (unsigned long) gap_avg, (unsigned long) gap_max,
+		(unsigned long) dropped, (unsigned long) (capture_us / 1000), (unsigned long) (send_us / 1000),
+		(unsigned long) (send_us == 0 ? 0 : (uint64_t) bytes * 1000000 / 1024 / send_us));
+
+	for (uint32_t i = 0; i < got; i++) {
+		len += snprintf(json + len, sizeof(json) - len, i == 0 ? "%lld" : ",%lld", (long long) (frames[i].timestamp_us - frames[0].timestamp_us));
+	}
+
+	len += snprintf(json + len, sizeof(json) - len, "]}\r\n--" BURST_BOUNDARY "--\r\n");
+
+	if (res == ESP_OK) {
+		res = httpd_resp_send_chunk(p_request, json, len);
+	}
+
+	if (res == ESP_OK) {
+		res = httpd_resp_send_chunk(p_request, NULL, 0);
+	}
+
+	for (uint32_t i = 0; i < got; i++) {
+		heap_caps_free(frames[i].jpeg);
+	}
+
+	ESP_LOGI(TAG, "Burst: `%lu` frames, `%lu` bytes. Gaps `%lu`/`%lu`/`%lu` us, `%lu` dropped. Sent in `%lu` ms.",
+		(unsigned long) got, (unsigned long) bytes, (unsigned long) gap_min, (unsigned long) gap_avg, (unsigned long) gap_max,
+		(unsigned long) dropped, (unsigned long) (send_us / 1000));
+	return res;
+}
@@ -0,0 +1,168 @@
+#include <stdint.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <driver/gpio.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "app.h"
+#include "app_capture.hpp"
+
+static char const *TAG = __FILE__;
+static gpio_num_t s_vsync = GPIO_NUM_NC;
+static uint32_t s_period_us = 0; // From the last capture. Only `/capture`'s handler touches it, one request at a time.
+
+struct capture_progress {
+
+	int64_t since_us; // Frames older than this sat in the buffers for who knows how long. Their gaps say nothing.
+	int64_t last_us; // The last frame's timestamp.
+	uint32_t period_us;
+	uint32_t fetched;
+
+};
+
+static int64_t capture_frame_us(camera_fb_t const *p_fb) {
+	return p_fb->timestamp.tv_sec * 1000000LL + p_fb->timestamp.tv_usec;
+}
+
+// Spins until VSYNC falls (the edge `esp32-camera` starts its frames on), or until `p_until_us`. The edge's time, or `0`.
+static int64_t capture_catch_vsync(int64_t const p_until_us) {
+	int last = gpio_get_level(s_vsync);
+	int64_t now;
+
+	while ((now = esp_timer_get_time()) < p_until_us) {
+		int const level = gpio_get_level(s_vsync);
+
+		if (last == 1 && level == 0) {
+			return now;
+		}
+
+		last = level;
+	}
+
+	return 0;
+}
+
+esp_err_t capture_init(camera_config_t const *p_config) {
+	ifu(p_config->pin_vsync < 0) {
+		ESP_LOGW(TAG, "No VSYNC pin? Captures won't be synced to it.");
+		return ESP_ERR_NOT_SUPPORTED;
+	}
+
+	// Already an input, for the camera's DMA and its own interrupt. Reading it is all this does:
+	s_vsync = (gpio_num_t) p_config->pin_vsync;
+	return ESP_OK;
+}
+
+// Pulls the next frame, throwing `p_fb` away first. Keeps track of the frame period meanwhile: the smallest gap between two
+// frames seen, since skipped frames only make gaps bigger.
+static camera_fb_t* capture_next(camera_fb_t *p_fb, capture_progress *p_progress, capture_result *p_out) {
+	if (p_fb != NULL) {
+		esp_camera_fb_return(p_fb);
+		p_out->thrown++;
+	}
+
+	p_fb = esp_camera_fb_get();
+
+	ifl(p_fb != NULL) {
+		int64_t const at = capture_frame_us(p_fb);
+		p_progress->fetched++;
+
+		ifu(at < p_progress->since_us) {
+			return p_fb;
+		}
+
+		if (p_progress->last_us != 0 && at > p_progress->last_us && at - p_progress->last_us < p_progress->period_us) {
+			p_progress->period_us = at - p_progress->last_us;
+		}
+
+		p_progress->last_us = at;
+	}
+
+	return p_fb;
+}
+
+camera_fb_t* capture_lit_frame(void (*p_light)(bool on), capture_result *p_out) {
+	int64_t const start = esp_timer_get_time();
+	capture_progress progress = { .since_us = start, .last_us = 0, .period_us = UINT32_MAX, .fetched = 0 };
+	*p_out = {};
+
+	// Out with whatever was exposed before we got here:
+	camera_fb_t *fb = capture_next(NULL, &progress, p_out);
+	while (fb != NULL && capture_frame_us(fb) < start && progress.fetched < CAPTURE_FRAMES_MAX) {
+		fb = capture_next(fb, &progress, p_out);
+	}
+
+	ifu(fb == NULL || p_light == NULL || s_vsync == GPIO_NUM_NC || progress.fetched >= CAPTURE_FRAMES_MAX) {
+		p_out->period_us = s_period_us;
+		p_out->latency_us = esp_timer_get_time() - start;
+		return fb;
+	}
+
+	// Never measured the period? One more frame, then:
+	if (s_period_us == 0) {
+		fb = capture_next(fb, &progress, p_out);
+
+		ifu(fb == NULL) {
+			return NULL;
+		}
+
+		s_period_us = progress.period_us == UINT32_MAX ? 0 : progress.period_us;
+	}
+
+	// The VSYNC edges are a period apart from this frame's. The next one's usually just after its readout ends, so this rarely
+	// sleeps. Spinning starts a little early, since the timestamps lag the edges by however long `esp32-camera`'s task took:
+	int64_t const reference_us = capture_frame_us(fb);
+	esp_camera_fb_return(fb);
+	p_out->thrown++;
+	fb = NULL;
+
+	int64_t edge_us = 0;
+	if (s_period_us != 0) {
+		int64_t now = esp_timer_get_time();
+		int64_t const predicted = reference_us + ((now - reference_us) / s_period_us + 1) * s_period_us;
+
+		if (predicted - CAPTURE_VSYNC_LEAD_US > now) {
+			vTaskDelay(pdMS_TO_TICKS((predicted - CAPTURE_VSYNC_LEAD_US - now) / 1000));
+			now = esp_timer_get_time();
+		}
+
+		edge_us = capture_catch_vsync(now + CAPTURE_VSYNC_SPIN_US);
+	}
+
+	p_light(true);
+	int64_t const lit_us = edge_us != 0 ? edge_us : esp_timer_get_time();
+	p_out->synced = edge_us != 0;
+
+	// Synced, the frame that started on the edge is half-lit, and the one after it isn't. Otherwise, the first frame to start
+	// after the LED did is half-lit, and the second isn't:
+	uint32_t started = 0;
+	while (true) {
+		fb = capture_next(fb, &progress, p_out);
+
+		ifu(fb == NULL) {
+			p_light(false);
+			return NULL;
+		}
+
+		int64_t const at = capture_frame_us(fb);
+		bool const lit = p_out->synced ? at >= lit_us + s_period_us / 2 : at >= lit_us && ++started == 2;
+
+		if (lit || progress.fetched >= CAPTURE_FRAMES_MAX) {
+			break;
+		}
+	}
+
+	p_light(false);
+
+	if (progress.period_us != UINT32_MAX) {
+		s_period_us = progress.period_us;
+	}
+
+	p_out->period_us = s_period_us;
+	p_out->latency_us = esp_timer_get_time() - start;
+	return fb;
+}
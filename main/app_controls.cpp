@@ -11,7 +11,11 @@
 #include <Arduino.h>
 
 #include "app.h"
+#include "app_drive.hpp"
 #include "app_controls.hpp"
+#include "app_trace.hpp"
+#include "app_events.hpp"
+#include "app_qos.hpp"
 #include "protocol_car_controls.hpp"
 #include "protocol_android_controls.hpp"
 
@@ -32,9 +36,11 @@ httpd_uri_t g_uri_controls = {
 
 int volatile g_carSteerNewValue = 0;
 int volatile g_carSteerPreviousValue = 0;
+char volatile g_carGearValue = ANDROID_GEAR_NEUTRAL;
+int volatile g_carThrottleValue = 0;
+bool volatile g_carModeControls = true;
 
 static char const *TAG = __FILE__;
-static bool s_carModeControls = true;
 
 // HTTP stuff.
 esp_err_t send200(httpd_req_t *p_request) {
@@ -63,6 +69,8 @@ esp_err_t android_controls_handler(httpd_req_t *p_request) {
 	httpd_resp_set_type(p_request, "application/octet-stream");
 
 	int status_code = 200;
+	trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_BEGIN, str_query_len);
+	qos_control_seen();
 
 	ESP_LOGD(TAG, "`/controls` queried!");
 	ESP_LOGD(TAG, "Query length `%zu`!", str_query_len);
@@ -72,6 +80,7 @@ esp_err_t android_controls_handler(httpd_req_t *p_request) {
 	ifu(str_query == NULL) { // Buffer was never allocated.
 		ESP_LOGE(TAG, "URL parsing failed due to `NULL` return from `malloc()`. 500.");
 		send500(p_request);
+		trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_END, 500);
 		// No freeing 👍️!
 		return ESP_OK;
 	}
@@ -80,6 +89,7 @@ esp_err_t android_controls_handler(httpd_req_t *p_request) {
 	ifl((err_httpd_last_call = httpd_req_get_url_query_str(p_request, str_query, str_query_len)) != ESP_OK) {
 		ESP_LOGE(TAG, "URL parsing failed! Reason: \"%s\". 500.", esp_err_to_name(err_httpd_last_call));
 		send500(p_request);
+		trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_END, 500);
 		return ESP_OK;
 	}
 
@@ -88,6 +98,7 @@ esp_err_t android_controls_handler(httpd_req_t *p_request) {
 	char const *str_param_name;
 	char param_value_steer[5]; // Needs only `5`, `-`, possibly a three-digit number, `\0`. That's 5 `char`s.
 	char param_value_gear[2]; // Needs only `2`! A `char` and `\0`!
+	char param_value_throttle[5]; // `-127` and `\0`.
 	char param_value_mode; // Literally empty.
 
 	str_param_name = g_android_controls_http_parameters[ANDROID_CONTROL_STEER];
@@ -142,8 +153,12 @@ esp_err_t android_controls_handler(httpd_req_t *p_request) {
 		}
 
 		// pinMode(PIN_CAR_ARDUINO_STEER, OUTPUT);
-		analogWrite(PIN_CAR_ESP_CAM_STEER, value);
+		drive_set_steer(value); // `app_drive` takes it from here, smoothly.
+		g_carSteerPreviousValue = g_carSteerNewValue;
+		g_carSteerNewValue = value;
+		trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_STEER, value);
 		send200(p_request);
+		trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_END, 200);
 		ESP_LOGI(TAG, "Car should steer towards the *%s* now.", value < 128 ? "left" : "right");
 		return ESP_OK;
 
@@ -165,9 +180,12 @@ esp_err_t android_controls_handler(httpd_req_t *p_request) {
 
 			case ANDROID_GEAR_BACKWARDS: {
 
-				digitalWrite(PIN_CAR_ESP_CAM_1, LOW);
-				digitalWrite(PIN_CAR_ESP_CAM_2, HIGH);
+				g_carGearValue = ANDROID_GEAR_BACKWARDS;
+				trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_GEAR, ANDROID_GEAR_BACKWARDS);
+				g_carThrottleValue = -127;
+				drive_set_throttle(-127);
 				send200(p_request);
+				trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_END, 200);
 				ESP_LOGI(TAG, "Car should move backwards now.");
 				return ESP_OK;
 
@@ -175,9 +193,12 @@ esp_err_t android_controls_handler(httpd_req_t *p_request) {
 
 			case ANDROID_GEAR_FORWARDS: {
 
-				digitalWrite(PIN_CAR_ESP_CAM_1, HIGH);
-				digitalWrite(PIN_CAR_ESP_CAM_2, LOW);
+				g_carGearValue = ANDROID_GEAR_FORWARDS;
+				trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_GEAR, ANDROID_GEAR_FORWARDS);
+				g_carThrottleValue = 127;
+				drive_set_throttle(127);
 				send200(p_request);
+				trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_END, 200);
 				ESP_LOGI(TAG, "Car should move forwards now.");
 				return ESP_OK;
 
@@ -185,9 +206,12 @@ esp_err_t android_controls_handler(httpd_req_t *p_request) {
 
 			case ANDROID_GEAR_NEUTRAL: {
 
-				digitalWrite(PIN_CAR_ESP_CAM_1, HIGH);
-				digitalWrite(PIN_CAR_ESP_CAM_2, HIGH);
+				g_carGearValue = ANDROID_GEAR_NEUTRAL;
+				trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_GEAR, ANDROID_GEAR_NEUTRAL);
+				g_carThrottleValue = 0;
+				drive_set_throttle(0);
 				send200(p_request);
+				trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_END, 200);
 				ESP_LOGI(TAG, "Car should stop now.");
 				return ESP_OK;
 
@@ -205,28 +229,61 @@ esp_err_t android_controls_handler(httpd_req_t *p_request) {
 
 	}
 
+	str_param_name = g_android_controls_http_parameters[ANDROID_CONTROL_THROTTLE];
+	ifl((err_httpd_last_call = httpd_query_key_value(str_query, str_param_name, param_value_throttle, sizeof(param_value_throttle))) != ESP_OK) { // `400` on error.
+
+		ESP_LOGW(TAG, "Parameter `throttle` not parsed. Reason: \"%s\". 400.", esp_err_to_name(err_httpd_last_call));
+		status_code = 400;
+
+	} else do {
+
+		errno = 0;
+		char *strtol_end;
+		long value = strtol(param_value_throttle, &strtol_end, 10);
+
+		ifu(value < -127 || value > 127 || errno == ERANGE || *strtol_end != '\0' || strtol_end == param_value_throttle) {
+
+			ESP_LOGE(TAG, "Parameter `%s` not in range. `400`!", str_param_name);
+			status_code = 400;
+			break;
+
+		}
+
+		// `gear` stays meaningful for whoever still reads it:
+		g_carGearValue = value > 0 ? ANDROID_GEAR_FORWARDS : value < 0 ? ANDROID_GEAR_BACKWARDS : ANDROID_GEAR_NEUTRAL;
+		g_carThrottleValue = value;
+		drive_set_throttle(value);
+		trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_THROTTLE, (uint32_t) value);
+		send200(p_request);
+		trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_END, 200);
+		ESP_LOGI(TAG, "Car should head for throttle `%ld` now.", value);
+		return ESP_OK;
+
+	} while (false);
+
 	str_param_name = g_android_controls_http_parameters[ANDROID_CONTROL_MODE];
 	ifl((err_httpd_last_call = httpd_query_key_value(str_query, str_param_name, &param_value_mode, sizeof(param_value_mode))) == ESP_OK) { // `400` if not found.
 
 		ESP_LOGI(TAG, "Car should be changing modes...");
 
-		if (s_carModeControls) {
+		if (g_carModeControls) {
 
-			digitalWrite(PIN_CAR_ESP_CAM_1, LOW);
-			digitalWrite(PIN_CAR_ESP_CAM_2, LOW);
 			send200(p_request);
+			trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_END, 200);
 
-			s_carModeControls = false;
+			g_carModeControls = false;
+			trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_MODE, 0);
+			events_trigger(EVENTS_CAUSE_OBSTACLE_MODE);
 			ESP_LOGI(TAG, "Car should avoid obstacles now.");
 			return ESP_OK;
 
 		} else {
 
-			digitalWrite(PIN_CAR_ESP_CAM_1, HIGH);
-			digitalWrite(PIN_CAR_ESP_CAM_2, LOW);
 			send200(p_request);
+			trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_END, 200);
 
-			s_carModeControls = true;
+			g_carModeControls = true;
+			trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_MODE, 1);
 			ESP_LOGI(TAG, "Car should listen to controls now.");
 			return ESP_OK;
 
@@ -245,5 +302,7 @@ esp_err_t android_controls_handler(httpd_req_t *p_request) {
 		send400(p_request);
 	}
 
+	trace_emit(TRACE_CHANNEL_CONTROL, TRACE_EVENT_CONTROL_END, status_code);
+
 	return ESP_OK;
 }
@@ -0,0 +1,42 @@
+#include <esp_log.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "app.h"
+#include "app_decode.hpp"
+
+static char const *TAG = __FILE__;
+static SemaphoreHandle_t s_lock = NULL;
+
+esp_err_t decode_init() {
+	s_lock = xSemaphoreCreateMutex();
+
+	ifu(s_lock == NULL) {
+		ESP_LOGE(TAG, "No memory for the decoder lock!");
+		return ESP_ERR_NO_MEM;
+	}
+
+	return ESP_OK;
+}
+
+bool decode_jpg2rgb565(uint8_t const *p_src, size_t const p_src_len, uint8_t *p_out, jpg_scale_t const p_scale) {
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	bool const decoded = jpg2rgb565(p_src, p_src_len, p_out, p_scale);
+	xSemaphoreGive(s_lock);
+	return decoded;
+}
+
+bool decode_fmt2rgb888(uint8_t const *p_src, size_t const p_src_len, pixformat_t const p_format, uint8_t *p_rgb_buf) {
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	bool const converted = fmt2rgb888(p_src, p_src_len, p_format, p_rgb_buf);
+	xSemaphoreGive(s_lock);
+	return converted;
+}
+
+bool decode_frame2bmp(camera_fb_t *p_fb, uint8_t **p_out, size_t *p_out_len) {
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	bool const converted = frame2bmp(p_fb, p_out, p_out_len);
+	xSemaphoreGive(s_lock);
+	return converted;
+}
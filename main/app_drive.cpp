@@ -0,0 +1,215 @@
+#include <math.h>
+#include <stdint.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <Arduino.h>
+
+#include "app.h"
+#include "app_link.hpp"
+#include "app_drive.hpp"
+#include "app_vision.hpp"
+#include "app_metrics.hpp"
+#include "app_events.hpp"
+#include "app_controls.hpp"
+#include "protocol_car_controls.hpp"
+
+static char const *TAG = __FILE__;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static drive_output s_output = { 127, 0, 127, 0 }; // Under `s_lock`.
+static drive_axis s_steer = {};
+static drive_axis s_throttle = {};
+static bool volatile s_live = false; // Nothing's touched the pins before we do.
+
+void drive_axis_init(drive_axis *p_axis, float const p_speed, float const p_accel, float const p_jerk, int const p_start) {
+	int const window = (int) ceilf(2.0F * p_accel / p_jerk / DRIVE_DT);
+
+	p_axis->speed = p_speed;
+	p_axis->step = p_accel * DRIVE_DT;
+	p_axis->window = window < 1 ? 1 : window > DRIVE_WINDOW_MAX ? DRIVE_WINDOW_MAX : window;
+	p_axis->position = p_start;
+	p_axis->velocity = 0;
+	p_axis->sum = (float) p_start * p_axis->window;
+	p_axis->head = 0;
+	p_axis->target = p_start;
+	__atomic_store_n(&p_axis->set_at_us, 0, __ATOMIC_RELAXED);
+
+	for (int i = 0; i < p_axis->window; i++) {
+		p_axis->history[i] = p_start;
+	}
+
+	ifu(p_axis->window == DRIVE_WINDOW_MAX) {
+		ESP_LOGW(TAG, "Jerk limit too low for `DRIVE_WINDOW_MAX`. Jerk will go up to `%.0f`.", 2.0F * p_accel / (DRIVE_WINDOW_MAX * DRIVE_DT));
+	}
+}
+
+float drive_axis_step(drive_axis *p_axis, int const p_target) {
+	float const error = p_target - p_axis->position;
+	float const distance = fabsf(error);
+	float const d = p_axis->step;
+
+	// Land on the target this tick if the speed that takes is within one step of ours, *and* of standing still:
+	float const reach = distance / DRIVE_DT;
+	float const heading = error < 0 ? -p_axis->velocity : p_axis->velocity;
+
+	if (reach <= d && heading >= 0 && fabsf(reach - heading) <= d) {
+		p_axis->position = p_target;
+		p_axis->velocity = 0;
+	} else {
+		// The fastest we can go and still stop on the target, decelerating by `d` every tick from here on:
+		float brake = d * (sqrtf(1.0F + 8.0F * distance / (d * DRIVE_DT)) - 1.0F) / 2.0F;
+		brake = brake > p_axis->speed ? p_axis->speed : brake;
+
+		float const wanted = error < 0 ? -brake : brake;
+		float const change = wanted - p_axis->velocity;
+		p_axis->velocity += change > d ? d : change < -d ? -d : change;
+		p_axis->position += p_axis->velocity * DRIVE_DT;
+	}
+
+	p_axis->sum += p_axis->position - p_axis->history[p_axis->head];
+	p_axis->history[p_axis->head] = p_axis->position;
+	p_axis->head = p_axis->head + 1 == p_axis->window ? 0 : p_axis->head + 1;
+
+	// Re-summed every lap, so float error can't pile up:
+	if (p_axis->head == 0) {
+		p_axis->sum = 0;
+		for (int i = 0; i < p_axis->window; i++) {
+			p_axis->sum += p_axis->history[i];
+		}
+	}
+
+	return p_axis->sum / p_axis->window;
+}
+
+// Without the link, all the Arduino gets is the steering PWM and the two gear pins.
+static void drive_pins_write(drive_output const *p_output) {
+	static int s_steer_written = -1;
+	static int s_gear_written = -1;
+
+	if (p_output->steer != s_steer_written) {
+		analogWrite(PIN_CAR_ESP_CAM_STEER, p_output->steer);
+		s_steer_written = p_output->steer;
+	}
+
+	// Both low while avoiding obstacles. Otherwise forwards (high, low), backwards (low, high) or stop (high, high), straight
+	// off the setpoint. Full power until the profile ramped down would be no ramp at all, just a late stop:
+	int gear = 0b00;
+	if (g_carModeControls) {
+		int const target = p_output->throttle_target;
+		gear = target > DRIVE_GEAR_DEADBAND ? 0b10 : target < -DRIVE_GEAR_DEADBAND ? 0b01 : 0b11;
+	}
+
+	if (gear != s_gear_written) {
+		digitalWrite(PIN_CAR_ESP_CAM_1, gear & 0b10 ? HIGH : LOW);
+		digitalWrite(PIN_CAR_ESP_CAM_2, gear & 0b01 ? HIGH : LOW);
+		s_gear_written = gear;
+	}
+}
+
+static void drive_settle_check(drive_axis *p_axis, int const p_output, int64_t const p_now) {
+	// 64-bit, and written by `httpd`: a plain load could get read half-done.
+	int64_t set_at = __atomic_load_n(&p_axis->set_at_us, __ATOMIC_RELAXED);
+
+	// Only cleared if no new setpoint came in meanwhile. That one gets timed on its own:
+	if (set_at != 0 && p_output == p_axis->target
+		&& __atomic_compare_exchange_n(&p_axis->set_at_us, &set_at, 0, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		metrics_record(METRICS_STAGE_DRIVE_SETTLE, p_now - set_at);
+	}
+}
+
+void drive_tick() {
+	int steer_target = s_steer.target;
+
+	// While avoiding obstacles, `app_vision` steers. Through the same profile, so its suggestions don't jerk either.
+	if (!g_carModeControls) {
+		vision_result vision;
+		if (vision_get(&vision)) {
+			steer_target = vision.steer;
+		}
+
+		s_live = true;
+	}
+
+	drive_output output;
+	output.steer_target = steer_target;
+	output.throttle_target = s_throttle.target;
+	output.steer = (uint8_t) lroundf(drive_axis_step(&s_steer, steer_target));
+	output.throttle = (int8_t) lroundf(drive_axis_step(&s_throttle, output.throttle_target));
+
+	portENTER_CRITICAL(&s_lock);
+	s_output = output;
+	portEXIT_CRITICAL(&s_lock);
+
+	int64_t const now = esp_timer_get_time();
+	if (g_carModeControls) {
+		drive_settle_check(&s_steer, output.steer, now);
+	}
+	drive_settle_check(&s_throttle, output.throttle, now);
+
+#if !LINK_ENABLED // Otherwise, `app_link` picks `s_output` up with its next command.
+	if (s_live) {
+		drive_pins_write(&output);
+	}
+#endif
+}
+
+static void drive_task(void *p_param) {
+	TickType_t wake = xTaskGetTickCount();
+
+	while (true) {
+		drive_tick();
+		vTaskDelayUntil(&wake, pdMS_TO_TICKS(DRIVE_PERIOD_MS));
+	}
+}
+
+esp_err_t drive_init() {
+	drive_axis_init(&s_steer, DRIVE_STEER_SPEED, DRIVE_STEER_ACCEL, DRIVE_STEER_JERK, 127);
+	drive_axis_init(&s_throttle, DRIVE_THROTTLE_SPEED, DRIVE_THROTTLE_ACCEL, DRIVE_THROTTLE_JERK, 0);
+
+	// Core `1`, next to the link. It's a few microseconds per tick, but ticks have to be on time.
+	ifu(xTaskCreatePinnedToCore(drive_task, "drive", 3072, NULL, 5, NULL, 1) != pdPASS) {
+		ESP_LOGE(TAG, "No memory for the drive task! The car won't move.");
+		return ESP_ERR_NO_MEM;
+	}
+
+	return ESP_OK;
+}
+
+void drive_set_steer(int const p_steer) {
+	int const steer = p_steer < 0 ? 0 : p_steer > 255 ? 255 : p_steer;
+
+	if (steer != s_steer.target) {
+		s_steer.target = steer;
+		__atomic_store_n(&s_steer.set_at_us, esp_timer_get_time(), __ATOMIC_RELAXED);
+	}
+
+	s_live = true;
+}
+
+void drive_set_throttle(int const p_throttle) {
+	int const throttle = p_throttle < -127 ? -127 : p_throttle > 127 ? 127 : p_throttle;
+
+	if (throttle != s_throttle.target) {
+		// Told to stop (or turn around) while going fast? Worth a clip:
+		drive_output going;
+		drive_get(&going);
+		if ((going.throttle >= EVENTS_HARD_STOP && throttle <= 0) || (going.throttle <= -EVENTS_HARD_STOP && throttle >= 0)) {
+			events_trigger(EVENTS_CAUSE_HARD_STOP);
+		}
+
+		s_throttle.target = throttle;
+		__atomic_store_n(&s_throttle.set_at_us, esp_timer_get_time(), __ATOMIC_RELAXED);
+	}
+
+	s_live = true;
+}
+
+void drive_get(drive_output *p_out) {
+	portENTER_CRITICAL(&s_lock);
+	*p_out = s_output;
+	portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,504 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "app.h"
+#include "app_link.hpp"
+#include "app_events.hpp"
+#include "app_recorder.hpp"
+#include "app_memory.hpp"
+
+#define EVENTS_SECTOR_BYTES		512
+#define EVENTS_INDEX_BATCH		64
+#define EVENTS_CLIP_MAX			99999
+#define EVENTS_POLL_MS			20 // While flushing, or waiting for the link to go quiet.
+
+httpd_uri_t g_uri_events = {
+
+		.uri = "/events",
+		.method = HTTP_GET,
+		.handler = events_handler,
+		.user_ctx = NULL,
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL,
+#endif
+
+};
+
+static char const *TAG = __FILE__;
+static TaskHandle_t s_task = NULL;
+static events_stats s_stats = {};
+
+// `s_offer_lock` keeps two streams from offering at once. `s_lock` covers the ring's bookkeeping, which the flush reads too.
+// The frames themselves get copied in and out without either.
+static events_ring s_ring = {};
+static SemaphoreHandle_t s_offer_lock = NULL;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_sequence = 0; // Of the next entry.
+static int64_t s_newest_us = 0;
+
+// The flush reads the entry at `s_flush_at`, sequence `s_flush_sequence`, straight out of the ring. That one doesn't get evicted
+// until it's on the card. If the flush has caught up, `s_flush_sequence == s_sequence`, and `events_offer()` fills `s_flush_at` in.
+static bool s_flushing = false;
+static uint32_t s_flush_at = 0;
+static uint32_t s_flush_sequence = 0;
+static uint32_t s_flushed = 0; // Sequence after the last entry any clip got. The next clip starts there, if it's still around.
+
+// Everything below belongs to the events task only.
+static uint8_t *s_chunk = NULL;
+static int s_data_fd = -1;
+static int s_index_fd = -1;
+static uint32_t s_clip = 0;
+static uint32_t s_offset = 0;
+static uint32_t s_chunk_start = 0;
+static recorder_index_entry s_index[EVENTS_INDEX_BATCH];
+static int s_index_count = 0;
+
+events_entry* events_ring_entry(events_ring const *p_ring, uint32_t const p_at) {
+	return (events_entry*) (p_ring->buffer + p_at);
+}
+
+void events_ring_evict(events_ring *p_ring) {
+	uint32_t const size = events_ring_entry(p_ring, p_ring->tail)->size;
+
+	p_ring->tail += size;
+	p_ring->used -= size;
+	p_ring->count--;
+
+	if (p_ring->tail == p_ring->end) {
+		p_ring->tail = 0;
+		p_ring->end = p_ring->capacity;
+	}
+}
+
+int32_t events_ring_reserve(events_ring *p_ring, uint32_t const p_size, uint32_t const p_pinned) {
+	ifu(p_size > p_ring->capacity) {
+		return -1;
+	}
+
+	while (true) {
+		if (p_ring->count == 0) {
+			p_ring->head = 0;
+			p_ring->tail = 0;
+			p_ring->end = p_ring->capacity;
+		}
+
+		bool const wrapped = p_ring->count > 0 && p_ring->head <= p_ring->tail;
+
+		if (!wrapped) {
+			if (p_ring->capacity - p_ring->head >= p_size) {
+				return p_ring->head;
+			}
+
+			p_ring->end = p_ring->head;
+			p_ring->head = 0;
+			continue;
+		}
+
+		if (p_ring->tail - p_ring->head >= p_size) {
+			return p_ring->head;
+		}
+
+		ifu(p_ring->tail == p_pinned) {
+			return -1;
+		}
+
+		events_ring_evict(p_ring);
+		__atomic_fetch_add(&s_stats.evicted, 1, __ATOMIC_RELAXED);
+	}
+}
+
+void events_ring_commit(events_ring *p_ring, uint32_t const p_at) {
+	uint32_t const size = events_ring_entry(p_ring, p_at)->size;
+
+	p_ring->head = p_at + size;
+	p_ring->used += size;
+	p_ring->count++;
+}
+
+uint32_t events_ring_next(events_ring const *p_ring, uint32_t const p_at) {
+	uint32_t const next = p_at + events_ring_entry(p_ring, p_at)->size;
+	return next == p_ring->end ? 0 : next;
+}
+
+static bool events_chunk_write(uint32_t const p_len) {
+	uint32_t const len = (p_len + EVENTS_SECTOR_BYTES - 1) & ~(EVENTS_SECTOR_BYTES - 1);
+	return lseek(s_data_fd, s_chunk_start, SEEK_SET) == (off_t) s_chunk_start && write(s_data_fd, s_chunk, len) == (ssize_t) len;
+}
+
+// Same order as `app_recorder`'s: the data, *then* the index entries for it.
+static bool events_clip_sync() {
+	bool ok = s_offset == s_chunk_start || events_chunk_write(s_offset - s_chunk_start);
+	ok = ok && fsync(s_data_fd) == 0;
+
+	size_t const index_bytes = s_index_count * sizeof(recorder_index_entry);
+	ok = ok && write(s_index_fd, s_index, index_bytes) == (ssize_t) index_bytes;
+	ok = ok && fsync(s_index_fd) == 0;
+
+	s_index_count = 0;
+	return ok;
+}
+
+void events_clip_path(char *p_out, size_t const p_capacity, uint32_t const p_clip, bool const p_index) {
+	snprintf(p_out, p_capacity, EVENTS_DIRECTORY "/%05lu.%s", (unsigned long) p_clip,
+		p_index ? RECORDER_INDEX_EXTENSION : RECORDER_DATA_EXTENSION);
+}
+
+static bool events_clip_open() {
+	ifu(s_clip >= EVENTS_CLIP_MAX) {
+		return false;
+	}
+
+	char path[32];
+	s_clip++;
+	events_clip_path(path, sizeof(path), s_clip, false);
+	s_data_fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	events_clip_path(path, sizeof(path), s_clip, true);
+	s_index_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	ifu(s_data_fd < 0 || s_index_fd < 0) {
+		close(s_data_fd);
+		close(s_index_fd);
+		s_data_fd = -1;
+		s_index_fd = -1;
+		return false;
+	}
+
+	s_offset = 0;
+	s_chunk_start = 0;
+	s_index_count = 0;
+	__atomic_store_n(&s_stats.clip, s_clip, __ATOMIC_RELAXED);
+	return true;
+}
+
+// `p_busy_us` is time spent writing, not waiting for frames, so the throughput is the card's.
+static void events_clip_close(int64_t const p_busy_us, uint32_t const p_causes) {
+	int64_t const start = esp_timer_get_time();
+	bool const ok = events_clip_sync();
+	close(s_data_fd);
+	close(s_index_fd);
+	s_data_fd = -1;
+	s_index_fd = -1;
+
+	char path[32];
+	events_clip_path(path, sizeof(path), s_clip, false);
+	truncate(path, s_offset); // The last chunk went out rounded up to whole sectors.
+
+	int64_t const busy_us = p_busy_us + esp_timer_get_time() - start;
+	s_stats.flush_bytes_per_s = busy_us > 0 ? s_offset * 1000000LL / busy_us : 0;
+	__atomic_fetch_add(&s_stats.clips, 1, __ATOMIC_RELAXED);
+
+	ESP_LOGI(TAG, "Clip `%lu` (causes `0x%lx`): `%lu` KiB in `%lld` ms%s", (unsigned long) s_clip, (unsigned long) p_causes,
+		(unsigned long) (s_offset >> 10), busy_us / 1000, ok ? "." : ", but writing it failed!");
+}
+
+// Out of the ring, into the chunk, and onto the card as chunks fill up.
+static bool events_frame_write(events_entry const *p_entry) {
+	ifu(s_index_count == EVENTS_INDEX_BATCH && !events_clip_sync()) {
+		return false;
+	}
+
+	recorder_index_entry &index = s_index[s_index_count++];
+	index.offset = s_offset + sizeof(recorder_frame_header);
+	index.length = p_entry->frame.length;
+	index.timestamp_us = p_entry->frame.timestamp_us;
+
+	uint8_t const *from = (uint8_t const*) &p_entry->frame;
+	uint32_t const size = sizeof(recorder_frame_header) + p_entry->frame.length;
+
+	for (uint32_t done = 0; done < size;) {
+		uint32_t const used = s_offset - s_chunk_start;
+		uint32_t const n = size - done < RECORDER_CHUNK_BYTES - used ? size - done : RECORDER_CHUNK_BYTES - used;
+
+		memcpy(s_chunk + used, from + done, n);
+		done += n;
+		s_offset += n;
+
+		if (s_offset - s_chunk_start == RECORDER_CHUNK_BYTES) {
+			ifu(!events_chunk_write(RECORDER_CHUNK_BYTES)) {
+				return false;
+			}
+
+			s_chunk_start += RECORDER_CHUNK_BYTES;
+		}
+	}
+
+	s_stats.flushed_bytes += size; // 64-bit, so not atomic. Only ever written from here, though.
+	return true;
+}
+
+static void events_task(void *p_param) {
+	bool link_was_up = false;
+	int64_t flush_until_us = 0;
+	int64_t flush_busy_us = 0;
+	int64_t last_sync_us = 0;
+	uint32_t causes = 0;
+
+	while (true) {
+		uint32_t triggered = 0;
+		xTaskNotifyWait(0, UINT32_MAX, &triggered, s_flushing || LINK_ENABLED ? pdMS_TO_TICKS(EVENTS_POLL_MS) : portMAX_DELAY);
+
+		link_stats link;
+		bool const link_up = link_get(&link);
+		if (link_was_up && !link_up) {
+			triggered |= EVENTS_CAUSE_WATCHDOG;
+		}
+
+		link_was_up = link_up;
+		int64_t const now = esp_timer_get_time();
+
+		if (triggered != 0 && !s_flushing) {
+			ifu(!events_clip_open()) {
+				ESP_LOGE(TAG, "Couldn't create clip `%lu`! Event `0x%lx` goes unrecorded.", (unsigned long) s_clip, (unsigned long) triggered);
+				continue;
+			}
+
+			// Start with the oldest frame there is, unless the last clip already has it:
+			portENTER_CRITICAL(&s_lock);
+			s_flush_at = s_ring.tail;
+			s_flush_sequence = s_sequence - s_ring.count;
+
+			while ((int32_t) (s_flush_sequence - s_flushed) < 0 && s_flush_sequence != s_sequence) {
+				s_flush_sequence++;
+				if (s_flush_sequence != s_sequence) {
+					s_flush_at = events_ring_next(&s_ring, s_flush_at);
+				}
+			}
+
+			s_flushing = true;
+			portEXIT_CRITICAL(&s_lock);
+
+			causes = 0;
+			flush_busy_us = 0;
+			last_sync_us = now;
+			__atomic_store_n(&s_stats.flushing, true, __ATOMIC_RELAXED);
+		}
+
+		if (triggered != 0) {
+			causes |= triggered;
+			flush_until_us = now + EVENTS_POST_MS * 1000LL;
+			ESP_LOGI(TAG, "Event `0x%lx`, into clip `%lu`.", (unsigned long) triggered, (unsigned long) s_clip);
+		}
+
+		if (!s_flushing) {
+			continue;
+		}
+
+		bool done = false;
+		bool ok = true;
+
+		while (ok && !done) {
+			portENTER_CRITICAL(&s_lock);
+			bool const available = s_flush_sequence != s_sequence;
+			uint32_t const at = s_flush_at;
+			portEXIT_CRITICAL(&s_lock);
+
+			if (!available) {
+				done = now > flush_until_us;
+				break;
+			}
+
+			// Pinned, so it's safe to read without the lock:
+			events_entry const *entry = events_ring_entry(&s_ring, at);
+
+			if (entry->frame.timestamp_us > flush_until_us) {
+				done = true;
+				break;
+			}
+
+			int64_t const write_start = esp_timer_get_time();
+			ok = events_frame_write(entry);
+			flush_busy_us += esp_timer_get_time() - write_start;
+
+			portENTER_CRITICAL(&s_lock);
+			s_flush_sequence++;
+			if (s_flush_sequence != s_sequence) {
+				s_flush_at = events_ring_next(&s_ring, at);
+			}
+			portEXIT_CRITICAL(&s_lock);
+		}
+
+		if (ok && !done && esp_timer_get_time() - last_sync_us >= RECORDER_SYNC_MS * 1000LL) {
+			int64_t const sync_start = esp_timer_get_time();
+			ok = events_clip_sync();
+			last_sync_us = esp_timer_get_time();
+			flush_busy_us += last_sync_us - sync_start;
+		}
+
+		if (!ok || done) {
+			ifu(!ok) {
+				ESP_LOGE(TAG, "Writing clip `%lu` failed! Card pulled, or full?", (unsigned long) s_clip);
+			}
+
+			portENTER_CRITICAL(&s_lock);
+			s_flushing = false;
+			s_flushed = s_flush_sequence;
+			portEXIT_CRITICAL(&s_lock);
+
+			events_clip_close(flush_busy_us, causes);
+			__atomic_store_n(&s_stats.flushing, false, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+esp_err_t events_init() {
+	recorder_stats recorder;
+	recorder_get(&recorder);
+
+	ifu(!recorder.mounted) {
+		ESP_LOGW(TAG, "No microSD card, so no event clips.");
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	mkdir(EVENTS_DIRECTORY, 0755);
+	DIR *directory = opendir(EVENTS_DIRECTORY);
+
+	if (directory != NULL) {
+		for (struct dirent *entry; (entry = readdir(directory)) != NULL;) {
+			unsigned long const number = strtoul(entry->d_name, NULL, 10);
+			s_clip = number > s_clip && number <= EVENTS_CLIP_MAX ? number : s_clip;
+		}
+
+		closedir(directory);
+	}
+
+	s_ring.capacity = EVENTS_RING_BYTES;
+	s_ring.buffer = (uint8_t*) heap_caps_malloc(s_ring.capacity, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+	ifu(s_ring.buffer == NULL) { // No PSRAM. Only if `app_memory` has budgeted for it:
+		s_ring.buffer = (uint8_t*) memory_internal_alloc(MEMORY_USER_EVENTS, s_ring.capacity);
+	}
+
+	ifu(s_ring.buffer == NULL) {
+		s_ring.capacity = 0;
+		ESP_LOGW(TAG, "No PSRAM, and no internal RAM to spare. No event clips!");
+		return ESP_ERR_NO_MEM;
+	}
+
+	s_ring.end = s_ring.capacity;
+	s_chunk = (uint8_t*) heap_caps_malloc(RECORDER_CHUNK_BYTES, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+	s_offer_lock = xSemaphoreCreateMutex();
+
+	ifu(s_chunk == NULL || s_offer_lock == NULL) {
+		ESP_LOGE(TAG, "No memory for the event ring!");
+		return ESP_ERR_NO_MEM;
+	}
+
+	// Core `0` and below the recorder: a clip can take its time, the rolling recording can't.
+	ifu(xTaskCreatePinnedToCore(events_task, "events", 4096, NULL, 1, &s_task, 0) != pdPASS) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	ESP_LOGI(TAG, "Keeping the last `%d` s in `%lu` KiB. Last clip was `%lu`.",
+		EVENTS_PRE_MS / 1000, (unsigned long) (s_ring.capacity / 1024), (unsigned long) s_clip);
+	return ESP_OK;
+}
+
+void events_offer(camera_fb_t const *p_fb) {
+	ifl(s_ring.buffer == NULL || p_fb->format != PIXFORMAT_JPEG) {
+		return;
+	}
+
+	ifu(xSemaphoreTake(s_offer_lock, 0) != pdTRUE) {
+		return; // Another stream's mid-copy, with a frame just like this one.
+	}
+
+	int64_t const timestamp_us = p_fb->timestamp.tv_sec * 1000000LL + p_fb->timestamp.tv_usec;
+	uint32_t const size = (sizeof(events_entry) + p_fb->len + EVENTS_ALIGN - 1) & ~(EVENTS_ALIGN - 1);
+
+	portENTER_CRITICAL(&s_lock);
+	uint32_t const pinned = s_flushing && s_flush_sequence != s_sequence ? s_flush_at : UINT32_MAX;
+
+	// Too old to be "the last `EVENTS_PRE_MS`" anymore:
+	while (s_ring.count > 0 && s_ring.tail != pinned
+		&& events_ring_entry(&s_ring, s_ring.tail)->frame.timestamp_us < timestamp_us - EVENTS_PRE_MS * 1000LL) {
+		events_ring_evict(&s_ring);
+		s_stats.evicted++;
+	}
+
+	int32_t const at = events_ring_reserve(&s_ring, size, pinned);
+	portEXIT_CRITICAL(&s_lock);
+
+	ifu(at < 0) {
+		xSemaphoreGive(s_offer_lock);
+		__atomic_fetch_add(&s_stats.dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	events_entry *entry = events_ring_entry(&s_ring, at);
+	entry->size = size;
+	entry->frame.magic = RECORDER_FRAME_MAGIC;
+	entry->frame.length = p_fb->len;
+	entry->frame.timestamp_us = timestamp_us;
+	memcpy(entry + 1, p_fb->buf, p_fb->len);
+
+	portENTER_CRITICAL(&s_lock);
+	entry->sequence = s_sequence;
+	if (s_flushing && s_flush_sequence == s_sequence) {
+		s_flush_at = at; // The flush was waiting for this one.
+	}
+
+	s_sequence++;
+	s_newest_us = timestamp_us;
+	events_ring_commit(&s_ring, at);
+	portEXIT_CRITICAL(&s_lock);
+
+	xSemaphoreGive(s_offer_lock);
+}
+
+void events_trigger(events_cause const p_cause) {
+	if (s_task != NULL) {
+		xTaskNotify(s_task, p_cause, eSetBits);
+	}
+}
+
+void events_get(events_stats *p_out) {
+	portENTER_CRITICAL(&s_lock);
+	*p_out = s_stats;
+	p_out->frames = s_ring.count;
+	p_out->ring_used = s_ring.used;
+	p_out->ring_bytes = s_ring.capacity;
+	p_out->ring_ms = s_ring.count == 0 ? 0 : (s_newest_us - events_ring_entry(&s_ring, s_ring.tail)->frame.timestamp_us) / 1000;
+	portEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t events_handler(httpd_req_t *p_request) {
+	char str_query[32];
+	char param_value[4];
+	httpd_resp_set_hdr(p_request, "Access-Control-Allow-Origin", "*");
+
+	if (httpd_req_get_url_query_str(p_request, str_query, sizeof(str_query)) == ESP_OK
+		&& httpd_query_key_value(str_query, "trigger", param_value, sizeof(param_value)) == ESP_OK && param_value[0] == '1') {
+		events_trigger(EVENTS_CAUSE_MANUAL);
+	}
+
+	events_stats stats;
+	events_get(&stats);
+
+	char json[288];
+	int const len = snprintf(json, sizeof(json),
+		"{\"flushing\":%s,\"clip\":%lu,\"frames\":%lu,\"ring_used\":%lu,\"ring_bytes\":%lu,\"ring_ms\":%lu,\"evicted\":%lu,"
+		"\"dropped\":%lu,\"clips\":%lu,\"flushed_bytes\":%llu,\"flush_bytes_per_s\":%lu}",
+		stats.flushing ? "true" : "false", (unsigned long) stats.clip, (unsigned long) stats.frames,
+		(unsigned long) stats.ring_used, (unsigned long) stats.ring_bytes, (unsigned long) stats.ring_ms, (unsigned long) stats.evicted,
+		(unsigned long) stats.dropped, (unsigned long) stats.clips, stats.flushed_bytes, (unsigned long) stats.flush_bytes_per_s);
+
+	httpd_resp_set_type(p_request, "application/json");
+	return httpd_resp_send(p_request, json, len);
+}
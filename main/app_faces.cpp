@@ -0,0 +1,465 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_partition.h>
+#include <esp_heap_caps.h>
+
+#include <dsps_dotprod.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "app.h"
+#include "app_faces.hpp"
+#include "app_metrics.hpp"
+
+// The partition is two halves, and only one of them is the database at a time: the one with a valid header and the higher
+// `generation`. It's an array of `faces_record`-sized slots. Slot `0` is the header, the rest get filled in order and are
+// never moved, except by `faces_compact()`, which copies the live ones into the other half. NOR flash can always clear bits
+// without an erase, so the `state` byte walks `WRITING` -> `VALID` -> `DELETED` in place. That's what keeps enrolling and
+// deleting from ever rewriting the partition!
+#define FACES_PARTITION_LABEL	"fr"
+#define FACES_HEADER_MAGIC		0x31424446 // `FDB1`.
+#define FACES_RECORD_MAGIC		0x45434146 // `FACE`.
+#define FACES_VERSION			2 // `2` split the partition into halves, for compaction.
+#define FACES_FREE_MAGIC		0xFFFFFFFF // Erased flash.
+#define FACES_SECTOR_SIZE		4096 // What `esp_partition_erase_range()` erases at least.
+
+enum faces_state : uint8_t {
+
+	FACES_STATE_WRITING = 0xFF, // Power went out mid-write, if it's still this. Skipped, and reclaimed by compaction.
+	FACES_STATE_VALID = 0xFE,
+	FACES_STATE_DELETED = 0xFC,
+
+};
+
+struct faces_header {
+
+	uint32_t magic;
+	uint16_t version;
+	uint16_t length;
+	uint32_t record_size;
+	uint32_t generation; // The half with the higher one is the database. Compaction makes the other half one newer.
+	uint32_t next_id; // Compaction drops deleted faces, but their IDs still never come back.
+
+};
+
+struct faces_record {
+
+	uint32_t magic;
+	uint8_t state; // `faces_state`.
+	uint8_t reserved[3];
+	uint16_t id;
+	uint16_t length;
+	float scale; // Of the *unit* embedding: `embedding[i] * scale` is the original, normalized, component.
+	char name[FACES_NAME_LENGTH];
+	int8_t embedding[FACES_EMBEDDING_LENGTH];
+
+};
+
+static_assert(sizeof(faces_record) == 32 + FACES_EMBEDDING_LENGTH, "`faces_record` got padded!");
+
+httpd_uri_t g_uri_faces = {
+
+		.uri = "/faces",
+		.method = HTTP_GET,
+		.handler = faces_handler,
+		.user_ctx = NULL,
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL,
+#endif
+
+};
+
+static char const *TAG = __FILE__;
+static SemaphoreHandle_t s_lock = NULL;
+static esp_partition_t const *s_partition = NULL;
+static esp_partition_mmap_handle_t s_map_handle;
+static uint8_t const *s_map = NULL;
+static size_t s_half_size = 0;
+
+// Held under `s_lock`:
+static faces_record const *s_records = NULL; // The active half, memory-mapped. Slot `0` is really the `faces_header`.
+static size_t s_half_offset = 0; // Of the active half.
+static uint32_t s_generation = 0;
+static int s_slot_count = 0; // Per half.
+static int s_next_slot = 1; // First erased slot.
+static int s_live = 0;
+static uint16_t s_next_id = 0;
+static faces_record s_scratch; // Flash writes can't come straight out of the memory map, so records pass through here.
+
+// The `ae32`/`aes3` dot products want aligned inputs, and neither the memory map nor the recognizer's tensor promise that:
+static float s_query[FACES_EMBEDDING_LENGTH] __attribute__((aligned(16)));
+static float s_widened[FACES_EMBEDDING_LENGTH] __attribute__((aligned(16)));
+
+static bool faces_header_valid(faces_header const *p_header) {
+	return p_header->magic == FACES_HEADER_MAGIC && p_header->version == FACES_VERSION
+		&& p_header->length == FACES_EMBEDDING_LENGTH && p_header->record_size == sizeof(faces_record);
+}
+
+// Makes the half at `offset` the database. Magic last: until it's there, the half isn't valid, and the other one still wins.
+static esp_err_t faces_write_header(size_t const p_offset, uint32_t const p_generation, uint16_t const p_next_id) {
+	faces_header header = {};
+	header.magic = FACES_FREE_MAGIC;
+	header.version = FACES_VERSION;
+	header.length = FACES_EMBEDDING_LENGTH;
+	header.record_size = sizeof(faces_record);
+	header.generation = p_generation;
+	header.next_id = p_next_id;
+
+	esp_err_t const error = esp_partition_write(s_partition, p_offset, &header, sizeof(header));
+	uint32_t const magic = FACES_HEADER_MAGIC;
+
+	ifu(error != ESP_OK) {
+		return error;
+	}
+
+	return esp_partition_write(s_partition, p_offset + offsetof(faces_header, magic), &magic, sizeof(magic));
+}
+
+static void faces_activate(size_t const p_offset, uint32_t const p_generation) {
+	s_half_offset = p_offset;
+	s_generation = p_generation;
+	s_records = (faces_record const*) (s_map + p_offset);
+}
+
+static esp_err_t faces_format() {
+	esp_err_t error = esp_partition_erase_range(s_partition, 0, s_partition->size);
+
+	if (error == ESP_OK) {
+		error = faces_write_header(0, 1, 0);
+	}
+
+	ifu(error != ESP_OK) {
+		return error;
+	}
+
+	faces_activate(0, 1);
+	s_next_slot = 1;
+	s_live = 0;
+	s_next_id = 0;
+	return ESP_OK;
+}
+
+// The only time anything gets rewritten: when the active half's full, but some of it is deleted (or torn) records. Live
+// records get copied into the other half, one at a time, and its header goes in last. Lose power before that, and the old
+// half's still the database, untouched. After it, the new one is.
+static esp_err_t faces_compact() {
+	ifu(s_next_slot - 1 == s_live) {
+		return ESP_ERR_NO_MEM; // Nothing to reclaim.
+	}
+
+	size_t const target = s_half_offset == 0 ? s_half_size : 0;
+	esp_err_t error = esp_partition_erase_range(s_partition, target, s_half_size);
+
+	int count = 0;
+	for (int slot = 1; error == ESP_OK && slot < s_next_slot; slot++) {
+		if (s_records[slot].magic == FACES_RECORD_MAGIC && s_records[slot].state == FACES_STATE_VALID) {
+			s_scratch = s_records[slot];
+			error = esp_partition_write(s_partition, target + ++count * sizeof(faces_record), &s_scratch, sizeof(s_scratch));
+		}
+	}
+
+	if (error == ESP_OK) {
+		error = faces_write_header(target, s_generation + 1, s_next_id);
+	}
+
+	ifu(error != ESP_OK) {
+		ESP_LOGE(TAG, "Compacting the face database failed: `%s`. It's still all there.", esp_err_to_name(error));
+		return error;
+	}
+
+	faces_activate(target, s_generation + 1);
+	s_next_slot = 1 + count;
+	s_live = count;
+	ESP_LOGI(TAG, "Compacted the face database down to `%d` faces.", count);
+	return ESP_OK;
+}
+
+// Unit-length copy of `p_embedding` into `s_query`. `false` for a zero vector.
+static bool faces_normalize(float const *p_embedding) {
+	float norm = 0;
+	memcpy(s_query, p_embedding, sizeof(s_query));
+	dsps_dotprod_f32(s_query, s_query, &norm, FACES_EMBEDDING_LENGTH);
+
+	ifu(norm <= 0) {
+		return false;
+	}
+
+	float const inverse = 1.0F / sqrtf(norm);
+	for (int i = 0; i < FACES_EMBEDDING_LENGTH; i++) {
+		s_query[i] *= inverse;
+	}
+
+	return true;
+}
+
+esp_err_t faces_init() {
+	s_lock = xSemaphoreCreateMutex();
+	s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, FACES_PARTITION_LABEL);
+
+	ifu(s_lock == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	ifu(s_partition == NULL) {
+		ESP_LOGE(TAG, "No `%s` partition! Faces can't be enrolled.", FACES_PARTITION_LABEL);
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	void const *map = NULL;
+	esp_err_t error = esp_partition_mmap(s_partition, 0, s_partition->size, ESP_PARTITION_MMAP_DATA, &map, &s_map_handle);
+
+	ifu(error != ESP_OK) {
+		ESP_LOGE(TAG, "Couldn't map the `%s` partition: `%s`.", FACES_PARTITION_LABEL, esp_err_to_name(error));
+		return error;
+	}
+
+	s_map = (uint8_t const*) map;
+	s_half_size = s_partition->size / 2 / FACES_SECTOR_SIZE * FACES_SECTOR_SIZE;
+	s_slot_count = s_half_size / sizeof(faces_record);
+
+	faces_header const *first = (faces_header const*) s_map;
+	faces_header const *second = (faces_header const*) (s_map + s_half_size);
+	bool const first_valid = faces_header_valid(first);
+	bool const second_valid = faces_header_valid(second);
+
+	if (first_valid && (!second_valid || first->generation > second->generation)) {
+		faces_activate(0, first->generation);
+		s_next_id = first->next_id;
+	} else if (second_valid) {
+		faces_activate(s_half_size, second->generation);
+		s_next_id = second->next_id;
+	} else {
+		ESP_LOGW(TAG, "The `%s` partition isn't a face database (yet). Formatting it.", FACES_PARTITION_LABEL);
+		error = faces_format();
+
+		ifu(error != ESP_OK) {
+			ESP_LOGE(TAG, "Formatting failed: `%s`.", esp_err_to_name(error));
+			return error;
+		}
+	}
+
+	// Find the first erased slot, and the highest ID ever handed out. Deleted IDs never come back!:
+	s_next_slot = s_slot_count;
+	s_live = 0;
+	for (int slot = 1; slot < s_slot_count; slot++) {
+		faces_record const *record = &s_records[slot];
+
+		if (record->magic == FACES_FREE_MAGIC) {
+			s_next_slot = slot;
+			break;
+		}
+
+		if (record->magic != FACES_RECORD_MAGIC) {
+			continue;
+		}
+
+		if (record->state == FACES_STATE_VALID) {
+			s_live++;
+		}
+
+		if (record->id >= s_next_id) {
+			s_next_id = record->id + 1;
+		}
+	}
+
+	ESP_LOGI(TAG, "`%d` faces enrolled, room for `%d` more.", s_live, s_slot_count - s_next_slot);
+	return ESP_OK;
+}
+
+int faces_enroll(float const *p_embedding, int const p_length, char const *p_name) {
+	ifu(s_records == NULL || p_length != FACES_EMBEDDING_LENGTH) {
+		return -1;
+	}
+
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+
+	int id = -1;
+	if ((s_next_slot < s_slot_count || faces_compact() == ESP_OK) && s_next_slot < s_slot_count && faces_normalize(p_embedding)) {
+		float peak = 0;
+		for (int i = 0; i < FACES_EMBEDDING_LENGTH; i++) {
+			float const magnitude = fabsf(s_query[i]);
+			peak = magnitude > peak ? magnitude : peak;
+		}
+
+		memset(&s_scratch, 0xFF, sizeof(s_scratch)); // Whatever stays `0xFF` can still be programmed later.
+		s_scratch.magic = FACES_RECORD_MAGIC;
+		s_scratch.state = FACES_STATE_WRITING;
+		s_scratch.id = s_next_id;
+		s_scratch.length = FACES_EMBEDDING_LENGTH;
+		s_scratch.scale = peak / 127;
+
+		int n = 0;
+		for (; p_name != NULL && p_name[n] != '\0' && n < FACES_NAME_LENGTH - 1; n++) {
+			char const c = p_name[n];
+			s_scratch.name[n] = c < ' ' || c == '"' || c == '\\' ? '_' : c; // It ends up in JSON.
+		}
+		s_scratch.name[n] = '\0';
+
+		for (int i = 0; i < FACES_EMBEDDING_LENGTH; i++) {
+			s_scratch.embedding[i] = (int8_t) lroundf(s_query[i] / s_scratch.scale);
+		}
+
+		// Record first, then flip it to valid. A torn write never looks like a face:
+		size_t const offset = s_half_offset + s_next_slot * sizeof(faces_record);
+		uint8_t const valid = FACES_STATE_VALID;
+		esp_err_t error = esp_partition_write(s_partition, offset, &s_scratch, sizeof(s_scratch));
+
+		if (error == ESP_OK) {
+			error = esp_partition_write(s_partition, offset + offsetof(faces_record, state), &valid, 1);
+		}
+
+		// Even a failed write used the slot up:
+		s_next_slot++;
+
+		if (error == ESP_OK) {
+			id = s_next_id++;
+			s_live++;
+		} else {
+			ESP_LOGE(TAG, "Enrolling failed: `%s`.", esp_err_to_name(error));
+		}
+	}
+
+	xSemaphoreGive(s_lock);
+	return id;
+}
+
+esp_err_t faces_delete(int const p_id) {
+	ifu(s_records == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+
+	esp_err_t error = ESP_ERR_NOT_FOUND;
+	for (int slot = 1; slot < s_next_slot; slot++) {
+		faces_record const *record = &s_records[slot];
+
+		if (record->magic == FACES_RECORD_MAGIC && record->state == FACES_STATE_VALID && record->id == p_id) {
+			uint8_t const deleted = FACES_STATE_DELETED;
+			size_t const offset = s_half_offset + slot * sizeof(faces_record) + offsetof(faces_record, state);
+			error = esp_partition_write(s_partition, offset, &deleted, 1);
+
+			if (error == ESP_OK) {
+				s_live--;
+			}
+
+			break;
+		}
+	}
+
+	xSemaphoreGive(s_lock);
+	return error;
+}
+
+faces_match faces_search(float const *p_embedding, int const p_length) {
+	faces_match match = { -1, -1.0F };
+
+	ifu(s_records == NULL || p_length != FACES_EMBEDDING_LENGTH) {
+		return match;
+	}
+
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	int64_t const start = esp_timer_get_time();
+
+	if (s_live > 0 && faces_normalize(p_embedding)) {
+		for (int slot = 1; slot < s_next_slot; slot++) {
+			faces_record const *record = &s_records[slot];
+
+			if (record->magic != FACES_RECORD_MAGIC || record->state != FACES_STATE_VALID) {
+				continue;
+			}
+
+			// Widening costs about as much as the dot product itself, but it's a straight, cache-friendly pass over flash:
+			for (int i = 0; i < FACES_EMBEDDING_LENGTH; i++) {
+				s_widened[i] = record->embedding[i];
+			}
+
+			float dot = 0;
+			dsps_dotprod_f32(s_widened, s_query, &dot, FACES_EMBEDDING_LENGTH);
+
+			float const similarity = dot * record->scale;
+			if (similarity > match.similarity) {
+				match.id = record->id;
+				match.similarity = similarity;
+			}
+		}
+
+		metrics_record(METRICS_STAGE_FACE_SEARCH, esp_timer_get_time() - start);
+	}
+
+	xSemaphoreGive(s_lock);
+	return match;
+}
+
+int faces_count() {
+	return s_live;
+}
+
+esp_err_t faces_handler(httpd_req_t *p_request) {
+	char str_query[24];
+	char param_value_delete[8];
+
+	if (httpd_req_get_url_query_str(p_request, str_query, sizeof(str_query)) == ESP_OK
+		&& httpd_query_key_value(str_query, "delete", param_value_delete, sizeof(param_value_delete)) == ESP_OK) {
+		esp_err_t const error = faces_delete(atoi(param_value_delete));
+
+		ifu(error != ESP_OK) {
+			httpd_resp_send_err(p_request, HTTPD_404_NOT_FOUND, esp_err_to_name(error));
+			return ESP_FAIL;
+		}
+	}
+
+	httpd_resp_set_type(p_request, "application/json");
+	httpd_resp_set_hdr(p_request, "Access-Control-Allow-Origin", "*");
+
+	char json[64];
+	int len = snprintf(json, sizeof(json), "{\"count\":%d,\"free\":%d,\"faces\":[", s_live, s_slot_count - s_next_slot);
+	esp_err_t error = httpd_resp_send_chunk(p_request, json, len);
+
+	// Hundreds of faces won't fit in one buffer. The lock's only held per record, never across a send:
+	bool first = true;
+	for (int slot = 1; error == ESP_OK; slot++) {
+		bool valid = false;
+
+		xSemaphoreTake(s_lock, portMAX_DELAY);
+		bool const end = s_records == NULL || slot >= s_next_slot;
+
+		if (!end && s_records[slot].magic == FACES_RECORD_MAGIC && s_records[slot].state == FACES_STATE_VALID) {
+			len = snprintf(json, sizeof(json), "%s{\"id\":%u,\"name\":\"%.*s\"}", first ? "" : ",",
+				s_records[slot].id, FACES_NAME_LENGTH, s_records[slot].name);
+			valid = true;
+		}
+
+		xSemaphoreGive(s_lock);
+
+		if (end) {
+			break;
+		}
+
+		if (valid) {
+			error = httpd_resp_send_chunk(p_request, json, len);
+			first = false;
+		}
+	}
+
+	if (error == ESP_OK) {
+		error = httpd_resp_send_chunk(p_request, "]}", 2);
+	}
+
+	if (error == ESP_OK) {
+		error = httpd_resp_send_chunk(p_request, NULL, 0);
+	}
+
+	return error;
+}
@@ -0,0 +1,439 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <esp_idf_version.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include "app.h"
+#include "app_footage.hpp"
+#include "app_events.hpp"
+#include "app_recorder.hpp"
+
+// Hands the request to our own, lower-priority task, so `camera_httpd` can get back to `/controls` right away. Without it,
+// the server's task serves the transfer itself, at `FOOTAGE_PRIORITY` for the duration. `httpd_req_async_handler_begin()`
+// is ESP-IDF 5.1.3 and up, like `STREAM_SEPARATE_PORT` in `app_httpd.cpp`.
+#define FOOTAGE_ASYNC	(ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 3))
+
+// What's servable of a segment or clip: everything up to the end of its last indexed frame.
+struct footage_info {
+
+	uint32_t frames;
+	uint32_t bytes;
+	int64_t first_us;
+	int64_t last_us;
+
+};
+
+httpd_uri_t g_uri_footage = {
+
+		.uri = "/footage",
+		.method = HTTP_GET,
+		.handler = footage_handler,
+		.user_ctx = NULL,
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL,
+#endif
+
+};
+
+static char const *TAG = __FILE__;
+static uint8_t *s_buffer = NULL; // Only one transfer at a time uses it: either the task, or `camera_httpd`'s.
+static QueueHandle_t s_queue = NULL;
+
+static bool footage_index_read(int const p_fd, uint32_t const p_entry, recorder_index_entry *p_out) {
+	off_t const at = (off_t) p_entry * sizeof(recorder_index_entry);
+	return lseek(p_fd, at, SEEK_SET) == at && read(p_fd, p_out, sizeof(*p_out)) == sizeof(*p_out);
+}
+
+static bool footage_info_get(char const *p_index_path, footage_info *p_out) {
+	struct stat index;
+	*p_out = {};
+
+	ifu(stat(p_index_path, &index) != 0) {
+		return false;
+	}
+
+	p_out->frames = index.st_size / sizeof(recorder_index_entry);
+
+	ifu(p_out->frames == 0) {
+		return true;
+	}
+
+	int const fd = open(p_index_path, O_RDONLY);
+	recorder_index_entry first;
+	recorder_index_entry last;
+	bool const ok = fd >= 0 && footage_index_read(fd, 0, &first) && footage_index_read(fd, p_out->frames - 1, &last);
+
+	if (fd >= 0) {
+		close(fd);
+	}
+
+	ifu(!ok) {
+		p_out->frames = 0;
+		return false;
+	}
+
+	p_out->bytes = last.offset + last.length;
+	p_out->first_us = first.timestamp_us;
+	p_out->last_us = last.timestamp_us;
+	return true;
+}
+
+// `bytes=<first>-<last>`, `bytes=<first>-` and `bytes=-<suffix length>`. `1` if it's one of those and satisfiable, `0` if
+// it should be ignored (malformed, or more than one range), and `-1` for a `416`.
+static int footage_range_parse(char const *p_range, uint32_t const p_total, uint32_t *p_first, uint32_t *p_last) {
+	ifu(strncmp(p_range, "bytes=", 6) != 0 || strchr(p_range, ',') != NULL) {
+		return 0;
+	}
+
+	char const *at = p_range + 6;
+	char *end;
+
+	if (*at == '-') {
+		unsigned long const suffix = strtoul(at + 1, &end, 10);
+
+		ifu(end == at + 1 || *end != '\0') {
+			return 0;
+		}
+
+		ifu(suffix == 0 || p_total == 0) {
+			return -1;
+		}
+
+		*p_first = suffix >= p_total ? 0 : p_total - suffix;
+		*p_last = p_total - 1;
+		return 1;
+	}
+
+	unsigned long const first = strtoul(at, &end, 10);
+	ifu(end == at || *end != '-') {
+		return 0;
+	}
+
+	at = end + 1;
+	unsigned long last = p_total - 1;
+
+	if (*at != '\0') {
+		last = strtoul(at, &end, 10);
+
+		ifu(*end != '\0' || last < first) {
+			return 0;
+		}
+	}
+
+	ifu(first >= p_total) {
+		return -1;
+	}
+
+	*p_first = first;
+	*p_last = last >= p_total ? p_total - 1 : last;
+	return 1;
+}
+
+// `p_length` bytes from `p_offset`, `FOOTAGE_CHUNK_BYTES` at a time. Ends the response.
+static esp_err_t footage_send_bytes(httpd_req_t *p_request, int const p_fd, uint32_t const p_offset, uint32_t const p_length) {
+	ifu(lseek(p_fd, p_offset, SEEK_SET) != (off_t) p_offset) {
+		return ESP_FAIL;
+	}
+
+	for (uint32_t done = 0; done < p_length;) {
+		uint32_t const want = p_length - done < FOOTAGE_CHUNK_BYTES ? p_length - done : FOOTAGE_CHUNK_BYTES;
+		ssize_t const got = read(p_fd, s_buffer, want);
+
+		ifu(got <= 0) {
+			return ESP_FAIL;
+		}
+
+		ifu(httpd_resp_send_chunk(p_request, (char const*) s_buffer, got) != ESP_OK) {
+			return ESP_FAIL; // Client's gone.
+		}
+
+		done += got;
+	}
+
+	return httpd_resp_send_chunk(p_request, NULL, 0);
+}
+
+// The first `p_total` bytes of the file, or the part of them the `Range:` header asks for.
+static esp_err_t footage_send_file(httpd_req_t *p_request, char const *p_path, uint32_t const p_total) {
+	char range[48];
+	char content_range[48];
+	uint32_t first = 0;
+	uint32_t last = p_total - 1;
+	int partial = 0;
+
+	httpd_resp_set_type(p_request, "application/octet-stream");
+	httpd_resp_set_hdr(p_request, "Accept-Ranges", "bytes");
+
+	if (httpd_req_get_hdr_value_str(p_request, "Range", range, sizeof(range)) == ESP_OK) {
+		partial = footage_range_parse(range, p_total, &first, &last);
+	}
+
+	ifu(partial < 0) {
+		snprintf(content_range, sizeof(content_range), "bytes */%lu", (unsigned long) p_total);
+		httpd_resp_set_status(p_request, "416 Range Not Satisfiable");
+		httpd_resp_set_hdr(p_request, "Content-Range", content_range);
+		return httpd_resp_send(p_request, NULL, 0);
+	}
+
+	ifu(p_total == 0) {
+		return httpd_resp_send(p_request, NULL, 0);
+	}
+
+	if (partial > 0) {
+		snprintf(content_range, sizeof(content_range), "bytes %lu-%lu/%lu", (unsigned long) first, (unsigned long) last, (unsigned long) p_total);
+		httpd_resp_set_status(p_request, "206 Partial Content");
+		httpd_resp_set_hdr(p_request, "Content-Range", content_range);
+	}
+
+	int const fd = open(p_path, O_RDONLY);
+	ifu(fd < 0) {
+		httpd_resp_send_404(p_request);
+		return ESP_FAIL;
+	}
+
+	int64_t const start = esp_timer_get_time();
+	esp_err_t const res = footage_send_bytes(p_request, fd, first, last - first + 1);
+	close(fd);
+
+	ESP_LOGI(TAG, "Sent `%s` bytes `%lu-%lu` in `%lld` ms.", p_path, (unsigned long) first, (unsigned long) last,
+		(esp_timer_get_time() - start) / 1000);
+	return res;
+}
+
+// The last frame at or before `p_at_us` (or the first one, if they're all later). The index is in timestamp order, so that's
+// a bisection: about `17` reads for a full segment.
+static esp_err_t footage_send_frame(httpd_req_t *p_request, char const *p_data_path, char const *p_index_path,
+	footage_info const *p_info, int64_t const p_at_us) {
+	ifu(p_info->frames == 0) {
+		httpd_resp_send_404(p_request);
+		return ESP_FAIL;
+	}
+
+	int const index_fd = open(p_index_path, O_RDONLY);
+	recorder_index_entry entry;
+	uint32_t low = 0;
+	uint32_t high = p_info->frames; // The answer's in `[low, high)`.
+	bool ok = index_fd >= 0;
+
+	while (ok && high - low > 1) {
+		uint32_t const middle = low + (high - low) / 2;
+		ok = footage_index_read(index_fd, middle, &entry);
+
+		if (entry.timestamp_us <= p_at_us) {
+			low = middle;
+		} else {
+			high = middle;
+		}
+	}
+
+	ok = ok && footage_index_read(index_fd, low, &entry);
+
+	if (index_fd >= 0) {
+		close(index_fd);
+	}
+
+	int const data_fd = ok ? open(p_data_path, O_RDONLY) : -1;
+	ifu(data_fd < 0) {
+		httpd_resp_send_500(p_request);
+		return ESP_FAIL;
+	}
+
+	char timestamp[24];
+	char offset[12];
+	char frame[12];
+	snprintf(timestamp, sizeof(timestamp), "%lld.%06lld", entry.timestamp_us / 1000000, entry.timestamp_us % 1000000);
+	snprintf(offset, sizeof(offset), "%lu", (unsigned long) (entry.offset - sizeof(recorder_frame_header)));
+	snprintf(frame, sizeof(frame), "%lu", (unsigned long) low);
+
+	httpd_resp_set_type(p_request, "image/jpeg");
+	httpd_resp_set_hdr(p_request, "X-Timestamp", timestamp);
+	httpd_resp_set_hdr(p_request, "X-Offset", offset); // Of the frame's header, so `Range: bytes=<this>-` plays on from here.
+	httpd_resp_set_hdr(p_request, "X-Frame", frame);
+
+	esp_err_t const res = footage_send_bytes(p_request, data_fd, entry.offset, entry.length);
+	close(data_fd);
+	return res;
+}
+
+static esp_err_t footage_list_directory(httpd_req_t *p_request, char const *p_name, bool const p_clips, uint32_t const p_recording) {
+	char index_path[40];
+	char json[160];
+	bool first = true;
+
+	int len = snprintf(json, sizeof(json), "\"%s\":[", p_name);
+	esp_err_t res = httpd_resp_send_chunk(p_request, json, len);
+
+	DIR *directory = opendir(p_clips ? EVENTS_DIRECTORY : RECORDER_DIRECTORY);
+	for (struct dirent *entry; res == ESP_OK && directory != NULL && (entry = readdir(directory)) != NULL;) {
+		char *end;
+		unsigned long const number = strtoul(entry->d_name, &end, 10);
+
+		if (end == entry->d_name || strcmp(end, "." RECORDER_DATA_EXTENSION) != 0) {
+			continue;
+		}
+
+		footage_info info;
+		if (p_clips) {
+			events_clip_path(index_path, sizeof(index_path), number, true);
+		} else {
+			recorder_segment_path(index_path, sizeof(index_path), number, true);
+		}
+
+		footage_info_get(index_path, &info);
+		len = snprintf(json, sizeof(json), "%s{\"number\":%lu,\"frames\":%lu,\"bytes\":%lu,\"first_us\":%lld,\"last_us\":%lld,\"recording\":%s}",
+			first ? "" : ",", number, (unsigned long) info.frames, (unsigned long) info.bytes, info.first_us, info.last_us,
+			!p_clips && number == p_recording ? "true" : "false");
+		res = httpd_resp_send_chunk(p_request, json, len);
+		first = false;
+	}
+
+	if (directory != NULL) {
+		closedir(directory);
+	}
+
+	return res == ESP_OK ? httpd_resp_send_chunk(p_request, "]", 1) : res;
+}
+
+static esp_err_t footage_list(httpd_req_t *p_request) {
+	recorder_stats recorder;
+	recorder_get(&recorder);
+	httpd_resp_set_type(p_request, "application/json");
+
+	esp_err_t res = httpd_resp_send_chunk(p_request, "{", 1);
+	res = res == ESP_OK ? footage_list_directory(p_request, "segments", false, recorder.segment) : res;
+	res = res == ESP_OK ? httpd_resp_send_chunk(p_request, ",", 1) : res;
+	res = res == ESP_OK ? footage_list_directory(p_request, "clips", true, 0) : res;
+	res = res == ESP_OK ? httpd_resp_send_chunk(p_request, "}", 1) : res;
+	return res == ESP_OK ? httpd_resp_send_chunk(p_request, NULL, 0) : res;
+}
+
+static esp_err_t footage_serve(httpd_req_t *p_request) {
+	char str_query[96];
+	char param_value[24];
+	httpd_resp_set_hdr(p_request, "Access-Control-Allow-Origin", "*");
+
+	ifu(s_buffer == NULL) {
+		httpd_resp_send_404(p_request);
+		return ESP_FAIL;
+	}
+
+	if (httpd_req_get_url_query_str(p_request, str_query, sizeof(str_query)) != ESP_OK) {
+		return footage_list(p_request);
+	}
+
+	char data_path[40];
+	char index_path[40];
+
+	if (httpd_query_key_value(str_query, "segment", param_value, sizeof(param_value)) == ESP_OK) {
+		uint32_t const segment = strtoul(param_value, NULL, 10);
+		recorder_segment_path(data_path, sizeof(data_path), segment, false);
+		recorder_segment_path(index_path, sizeof(index_path), segment, true);
+	} else if (httpd_query_key_value(str_query, "clip", param_value, sizeof(param_value)) == ESP_OK) {
+		uint32_t const clip = strtoul(param_value, NULL, 10);
+		events_clip_path(data_path, sizeof(data_path), clip, false);
+		events_clip_path(index_path, sizeof(index_path), clip, true);
+	} else {
+		return footage_list(p_request);
+	}
+
+	footage_info info;
+	ifu(!footage_info_get(index_path, &info)) {
+		httpd_resp_send_404(p_request);
+		return ESP_FAIL;
+	}
+
+	if (httpd_query_key_value(str_query, "at", param_value, sizeof(param_value)) == ESP_OK) {
+		return footage_send_frame(p_request, data_path, index_path, &info, strtoll(param_value, NULL, 10));
+	}
+
+	if (httpd_query_key_value(str_query, "index", param_value, sizeof(param_value)) == ESP_OK && param_value[0] == '1') {
+		return footage_send_file(p_request, index_path, info.frames * sizeof(recorder_index_entry));
+	}
+
+	return footage_send_file(p_request, data_path, info.bytes);
+}
+
+#if FOOTAGE_ASYNC
+static void footage_task(void *p_param) {
+	while (true) {
+		httpd_req_t *request;
+		xQueueReceive(s_queue, &request, portMAX_DELAY);
+		footage_serve(request);
+		httpd_req_async_handler_complete(request);
+	}
+}
+#endif
+
+esp_err_t footage_init() {
+	recorder_stats recorder;
+	recorder_get(&recorder);
+
+	ifu(!recorder.mounted) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	s_buffer = (uint8_t*) heap_caps_malloc(FOOTAGE_CHUNK_BYTES, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+	ifu(s_buffer == NULL) {
+		ESP_LOGE(TAG, "No memory for footage transfers!");
+		return ESP_ERR_NO_MEM;
+	}
+
+#if FOOTAGE_ASYNC
+	s_queue = xQueueCreate(FOOTAGE_QUEUE, sizeof(httpd_req_t*));
+
+	// Core `0`, with the rest of the card's traffic:
+	ifu(s_queue == NULL || xTaskCreatePinnedToCore(footage_task, "footage", 4096, NULL, FOOTAGE_PRIORITY, NULL, 0) != pdPASS) {
+		heap_caps_free(s_buffer);
+		s_buffer = NULL;
+		return ESP_ERR_NO_MEM;
+	}
+#endif
+
+	return ESP_OK;
+}
+
+esp_err_t footage_handler(httpd_req_t *p_request) {
+#if FOOTAGE_ASYNC
+	httpd_req_t *request = NULL;
+
+	ifu(s_queue == NULL) {
+		return footage_serve(p_request); // Only to say `404`.
+	}
+
+	ifu(uxQueueSpacesAvailable(s_queue) == 0) {
+		httpd_resp_set_status(p_request, "503 Service Unavailable");
+		httpd_resp_set_hdr(p_request, "Retry-After", "1");
+		return httpd_resp_send(p_request, NULL, 0);
+	}
+
+	ifu(httpd_req_async_handler_begin(p_request, &request) != ESP_OK) {
+		httpd_resp_send_500(p_request);
+		return ESP_FAIL;
+	}
+
+	xQueueSend(s_queue, &request, portMAX_DELAY); // `camera_httpd` is the only sender, and there was room.
+	return ESP_OK;
+#else
+	UBaseType_t const priority = uxTaskPriorityGet(NULL);
+	vTaskPrioritySet(NULL, FOOTAGE_PRIORITY);
+	esp_err_t const res = footage_serve(p_request);
+	vTaskPrioritySet(NULL, priority);
+	return res;
+#endif
+}
@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <stdlib.h>
+
 #include "fb_gfx.h"
 #include <sdkconfig.h>
 #include <img_converters.h>
@@ -19,6 +21,8 @@
 // #include <esp_log.h>
 #include <esp_timer.h>
 #include <esp_camera.h>
+#include <esp_heap_caps.h>
+#include <esp_idf_version.h>
 #include <esp32-hal-ledc.h>
 #include <esp_http_server.h>
 
@@ -26,7 +30,25 @@
 #include "esp32-hal-log.h"
 // #endif
 
-#include "camera_index.h"
+#include "app_boot.hpp"
+#include "app_profiles.hpp"
+#include "app_controls.hpp"
+#include "app_status.hpp"
+#include "app_metrics.hpp"
+#include "app_trace.hpp"
+#include "app_vision.hpp"
+#include "app_motion.hpp"
+#include "app_overlay.hpp"
+#include "app_recorder.hpp"
+#include "app_events.hpp"
+#include "app_footage.hpp"
+#include "app_timelapse.hpp"
+#include "app_capture.hpp"
+#include "app_burst.hpp"
+#include "app_assets.hpp"
+#include "app_qos.hpp"
+#include "app_radio.hpp"
+#include "app_decode.hpp"
 
 // Face Detection will not work on boards without (or with disabled) PSRAM
 #ifdef BOARD_HAS_PSRAM
@@ -49,8 +71,12 @@
 #include "human_face_detect_mnp01.hpp"
 #include "human_face_detect_msr01.hpp"
 
+#include <list>
 #include <vector>
 
+#include <esp_heap_caps.h>
+#include <freertos/semphr.h>
+
 #define TWO_STAGE 1 /*<! 1: detect by two-stage which is more accurate but slower(with keypoints). */
 					/*<! 0: detect by one-stage which is less accurate but faster(without keypoints). */
 
@@ -65,7 +91,7 @@
 
 #define QUANT_TYPE 0 // if set to 1 => very large firmware, very slow, reboots when streaming...
 
-#define FACE_ID_SAVE_NUMBER 7
+#include "app_faces.hpp" // The recognizer only computes embeddings now. Enrolled IDs live in there.
 #endif
 
 #define FACE_COLOR_WHITE  0x00FFFFFF
@@ -100,10 +126,43 @@ typedef struct {
 #define PART_BOUNDARY "123456789000000000000987654321"
 static const char *_STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=" PART_BOUNDARY;
 static const char *_STREAM_BOUNDARY = "\r\n--" PART_BOUNDARY "\r\n";
-static const char *_STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\nX-Timestamp: %d.%06d\r\n\r\n";
+static const char *_STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\nX-Timestamp: %d.%06d\r\n"; // More headers may follow!
+
+// Per-part metadata, so clients can draw their own overlays over untouched JPEGs. `tools/stream_meta.py` parses these:
+// `X-Sent: <s>.<us>`: when the part header went out. Same clock as `X-Timestamp`, so the difference is the device's latency.
+// `X-Motion: <energy, permille>;<changed blocks>;<bitmap, hex>`: see `motion_result`. Only once frames got compared.
+// `X-Controls: <steer>;<gear>;<mode>`: `/controls` state. `mode` is `1` under manual control, `0` while avoiding obstacles.
+// `X-Faces: <face ID>;<left>,<top>,<right>,<bottom>;...`: same pixels as the frame. Only with face detection, and faces.
+
+// A parked car's frames only go out this often. `/stream?skip=0` turns skipping off, `?skip=N` changes this to `N` ms.
+#define STREAM_SKIP_KEEPALIVE_MS	1000
+
+// `/stream` lives on `camera_httpd`, with everything else, on port `80`. Each stream gets handed off to a task of its own
+// (`httpd_req_async_handler_begin()`), so the server's `select()` loop is free for controls the moment it's handed a stream.
+// Needs ESP-IDF 5.1.3: 5.1.0 through 5.1.2 don't have that yet. Before that, or with this set to `1`, it's the old second
+// server on port `81` again, which costs another server task, listening socket and control socket, and can only serve one
+// stream at a time. `/metrics` has what either costs.
+#ifndef STREAM_SEPARATE_PORT
+#define STREAM_SEPARATE_PORT		(ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 1, 3))
+#endif
 
+#if CONFIG_ESP_FACE_DETECT_ENABLED
+#define STREAM_CLIENTS_MAX			1 // The face overlay's buffers are shared.
+#else
+#define STREAM_CLIENTS_MAX			2 // Each one's a stack, and half the frame rate.
+#endif
+#define STREAM_TASK_STACK			4096 // Same as `HTTPD_DEFAULT_CONFIG()` gives a server task, which is what streams ran on.
+
+// `trace_emit()` wants one producer per channel, so each stream running gets one of these:
+static trace_channel const s_stream_channels[] = { TRACE_CHANNEL_STREAM, TRACE_CHANNEL_STREAM_2 };
+static uint32_t volatile s_stream_channels_taken = 0; // Bit `i`: `s_stream_channels[i]`.
+static_assert(STREAM_CLIENTS_MAX <= sizeof(s_stream_channels) / sizeof(s_stream_channels[0]), "A trace channel per stream!");
+
+#if STREAM_SEPARATE_PORT
 httpd_handle_t stream_httpd = NULL;
+#endif
 httpd_handle_t camera_httpd = NULL;
+uint32_t g_httpd_internal_bytes = 0; // Internal RAM the servers took to start.
 
 #if CONFIG_ESP_FACE_DETECT_ENABLED
 
@@ -202,7 +261,213 @@ static int rgb_printf(fb_data_t *fb, uint32_t color, const char *format, ...) {
 	return len;
 }
 #endif
-static void draw_face_boxes(fb_data_t *fb, std::list<dl::detect::result_t> *results, int face_id) {
+// Detector results past this many get dropped. Nobody fits more than eight faces in front of a toy car.
+#define FACE_MAX_RESULTS	8
+// Wider frames never get detection run on them (see the `fb->width > 400` checks). CIF, at 400x296, is the biggest that does.
+#define FACE_MAX_WIDTH		400
+#define FACE_MAX_HEIGHT		300
+#define FACE_JPEG_CAPACITY	(FACE_MAX_WIDTH * FACE_MAX_HEIGHT) // A byte per pixel. Quality-`90` JPEGs come nowhere near that.
+
+struct face_result {
+
+	int box[4]; // Left, top, right, bottom.
+	int keypoint[10]; // Five `(x, y)` landmarks. Only `TWO_STAGE` fills these in.
+
+};
+
+// Built once, in `face_init()`, and kept forever. They used to get built per stream connection *and* per capture!
+static HumanFaceDetectMSR01 *s_face_stage1 = NULL;
+#if TWO_STAGE
+static HumanFaceDetectMNP01 *s_face_stage2 = NULL;
+#endif
+
+// `stream_handler()` and `capture_handler()` run on different servers, so everything here is under `s_face_lock`:
+static bool s_face_ready = false;
+static SemaphoreHandle_t s_face_lock = NULL;
+static uint8_t *s_face_rgb = NULL; // RGB888 detector input, `FACE_MAX_WIDTH * FACE_MAX_HEIGHT * 3` bytes, in PSRAM.
+static face_result s_faces[FACE_MAX_RESULTS];
+static std::vector<int> s_face_shape(3); // `infer()` takes its shape by value, but at least *we* don't build a new one each time.
+#if CONFIG_ESP_FACE_RECOGNITION_ENABLED
+static std::vector<int> s_face_landmarks(10);
+#endif
+
+// `stream_handler()`'s alone. The stream server only ever runs one of those at a time:
+static uint8_t *s_face_jpeg = NULL;
+static size_t s_face_jpeg_len = 0;
+
+// The detection worker's input. `stream_handler()` copies frames in here whenever the worker is idle (`s_face_busy` clear).
+// Only the worker touches these while `s_face_busy` is set.
+static TaskHandle_t s_face_task = NULL;
+static bool volatile s_face_busy = false;
+static uint8_t *s_face_sample = NULL; // `FACE_MAX_WIDTH * FACE_MAX_HEIGHT * 2` bytes: RGB565, or a JPEG (always smaller).
+static size_t s_face_sample_len = 0;
+static uint16_t s_face_sample_width = 0;
+static uint16_t s_face_sample_height = 0;
+static pixformat_t s_face_sample_format = PIXFORMAT_RGB565;
+static int64_t s_face_sample_frame_us = 0;
+
+// What the worker found last, and in which frame. Under `s_face_result_lock`, which is only ever held for a copy:
+static SemaphoreHandle_t s_face_result_lock = NULL;
+static face_result s_face_published[FACE_MAX_RESULTS];
+static int s_face_published_count = 0;
+static int s_face_published_id = 0;
+static int64_t s_face_published_frame_us = 0;
+
+static void face_task(void *param);
+
+static bool face_init() {
+	s_face_lock = xSemaphoreCreateMutex();
+	s_face_rgb = (uint8_t *) heap_caps_malloc(FACE_MAX_WIDTH * FACE_MAX_HEIGHT * 3, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+	s_face_jpeg = (uint8_t *) heap_caps_malloc(FACE_JPEG_CAPACITY, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+	s_face_sample = (uint8_t *) heap_caps_malloc(FACE_MAX_WIDTH * FACE_MAX_HEIGHT * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+	s_face_result_lock = xSemaphoreCreateMutex();
+
+#if TWO_STAGE
+	s_face_stage1 = new HumanFaceDetectMSR01(0.1F, 0.5F, 10, 0.2F);
+	s_face_stage2 = new HumanFaceDetectMNP01(0.5F, 0.3F, 5);
+#else
+	s_face_stage1 = new HumanFaceDetectMSR01(0.3F, 0.5F, 10, 0.2F);
+#endif
+
+	if (!s_face_lock || !s_face_rgb || !s_face_jpeg || !s_face_sample || !s_face_result_lock) {
+		log_e("No memory for face detection! It stays off.");
+		return false;
+	}
+
+	// Core `1`, lowest priority there is, short of idle. The stream's httpd task and Wi-Fi get core `0` to themselves:
+	if (xTaskCreatePinnedToCore(face_task, "face", 8192, NULL, 1, &s_face_task, 1) != pdPASS) {
+		log_e("No face detection worker! It stays off.");
+		return false;
+	}
+
+	s_face_ready = true;
+	return true;
+}
+
+// Runs the detector(s) over `pixels` (RGB565 straight from the camera, or RGB888 in `s_face_rgb`) and copies whatever they
+// found into `s_faces`. Returns how many that was. Must hold `s_face_lock`!
+template <typename T> static int face_detect(T *pixels, int width, int height) {
+	s_face_shape[0] = height;
+	s_face_shape[1] = width;
+	s_face_shape[2] = 3;
+
+#if TWO_STAGE
+	std::list<dl::detect::result_t> &candidates = s_face_stage1->infer(pixels, s_face_shape);
+	std::list<dl::detect::result_t> &results = s_face_stage2->infer(pixels, s_face_shape, candidates);
+#else
+	std::list<dl::detect::result_t> &results = s_face_stage1->infer(pixels, s_face_shape);
+#endif
+
+	int count = 0;
+	for (dl::detect::result_t const &result : results) {
+		if (count == FACE_MAX_RESULTS) {
+			break;
+		}
+
+		face_result &face = s_faces[count++];
+		for (int i = 0; i < 4; i++) {
+			face.box[i] = (int) result.box[i];
+		}
+
+		for (int i = 0; i < 10; i++) {
+			face.keypoint[i] = i < (int) result.keypoint.size() ? result.keypoint[i] : 0;
+		}
+	}
+
+	return count;
+}
+
+// `fmt2jpg_cb()` sink into `s_face_jpeg`, instead of `fmt2jpg()` `malloc()`ing a new output buffer for every frame.
+static size_t face_jpeg_append(void *arg, size_t index, const void *data, size_t len) {
+	if (index + len > FACE_JPEG_CAPACITY) {
+		return 0;
+	}
+	memcpy(s_face_jpeg + index, data, len);
+	s_face_jpeg_len = index + len;
+	return len;
+}
+
+// Boxes older than this don't get drawn anymore. The face has probably moved on by then!
+#define FACE_STALE_MS		1000
+
+static void draw_face_boxes(fb_data_t *fb, face_result const *results, int count, int face_id);
+#if CONFIG_ESP_FACE_RECOGNITION_ENABLED
+static int run_face_recognition(fb_data_t *fb);
+#endif
+
+// Detection (and recognition) at whatever pace they manage, so the stream never waits for the network.
+// On chips other than the ESP32-S3, recognition can take upward of 15 seconds. Video doesn't care anymore!
+static void face_task(void *param) {
+	while (true) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		int64_t const start = esp_timer_get_time();
+		int faces = 0;
+		int face_id = 0;
+
+		xSemaphoreTake(s_face_lock, portMAX_DELAY);
+		if (s_face_sample_format == PIXFORMAT_RGB565
+#if CONFIG_ESP_FACE_RECOGNITION_ENABLED
+			&& !recognition_enabled
+#endif
+		) {
+			faces = face_detect((uint16_t *) s_face_sample, s_face_sample_width, s_face_sample_height);
+		} else if (decode_fmt2rgb888(s_face_sample, s_face_sample_len, s_face_sample_format, s_face_rgb)) {
+			faces = face_detect((uint8_t *) s_face_rgb, s_face_sample_width, s_face_sample_height);
+#if CONFIG_ESP_FACE_RECOGNITION_ENABLED
+			if (faces > 0 && recognition_enabled) {
+				fb_data_t rfb;
+				rfb.width = s_face_sample_width;
+				rfb.height = s_face_sample_height;
+				rfb.data = s_face_rgb;
+				rfb.bytes_per_pixel = 3;
+				rfb.format = FB_BGR888;
+				face_id = run_face_recognition(&rfb);
+			}
+#endif
+		} else {
+			log_e("To rgb888 failed");
+		}
+
+		xSemaphoreTake(s_face_result_lock, portMAX_DELAY);
+		memcpy(s_face_published, s_faces, faces * sizeof(face_result));
+		s_face_published_count = faces;
+		s_face_published_id = face_id;
+		s_face_published_frame_us = s_face_sample_frame_us;
+		xSemaphoreGive(s_face_result_lock);
+		xSemaphoreGive(s_face_lock);
+
+		__atomic_store_n(&s_face_busy, false, __ATOMIC_RELEASE);
+		metrics_record(METRICS_STAGE_FACE_DETECT, esp_timer_get_time() - start);
+	}
+}
+
+// Hands `fb` to the worker, if it's idle. Otherwise, it's still busy with an older frame, and this one's just dropped.
+static void face_offer(camera_fb_t const *fb) {
+	if (__atomic_load_n(&s_face_busy, __ATOMIC_ACQUIRE) || fb->len > FACE_MAX_WIDTH * FACE_MAX_HEIGHT * 2) {
+		return;
+	}
+	memcpy(s_face_sample, fb->buf, fb->len);
+	s_face_sample_len = fb->len;
+	s_face_sample_width = fb->width;
+	s_face_sample_height = fb->height;
+	s_face_sample_format = fb->format;
+	s_face_sample_frame_us = fb->timestamp.tv_sec * 1000000LL + fb->timestamp.tv_usec;
+	__atomic_store_n(&s_face_busy, true, __ATOMIC_RELEASE);
+	xTaskNotifyGive(s_face_task);
+}
+
+// Copies the latest published results into `out`. Returns how many faces there are, or `-1` if there's nothing yet.
+static int face_latest(face_result *out, int *out_face_id, int64_t *out_frame_us) {
+	xSemaphoreTake(s_face_result_lock, portMAX_DELAY);
+	int const count = s_face_published_frame_us == 0 ? -1 : s_face_published_count;
+	memcpy(out, s_face_published, s_face_published_count * sizeof(face_result));
+	*out_face_id = s_face_published_id;
+	*out_frame_us = s_face_published_frame_us;
+	xSemaphoreGive(s_face_result_lock);
+	return count;
+}
+
+static void draw_face_boxes(fb_data_t *fb, face_result const *results, int count, int face_id) {
 	int x, y, w, h;
 	uint32_t color = FACE_COLOR_YELLOW;
 	if (face_id < 0) {
@@ -214,14 +479,13 @@ static void draw_face_boxes(fb_data_t *fb, std::list<dl::detect::result_t> *resu
 		// color = ((color >> 8) & 0xF800) | ((color >> 3) & 0x07E0) | (color & 0x001F);
 		color = ((color >> 16) & 0x001F) | ((color >> 3) & 0x07E0) | ((color << 8) & 0xF800);
 	}
-	int i = 0;
-	for (std::list<dl::detect::result_t>::iterator prediction = results->begin(); prediction != results->end();
-		 prediction++, i++) {
+	for (int i = 0; i < count; i++) {
+		face_result const *prediction = &results[i];
 		// rectangle box
-		x = (int) prediction->box[0];
-		y = (int) prediction->box[1];
-		w = (int) prediction->box[2] - x + 1;
-		h = (int) prediction->box[3] - y + 1;
+		x = prediction->box[0];
+		y = prediction->box[1];
+		w = prediction->box[2] - x + 1;
+		h = prediction->box[3] - y + 1;
 		if ((x + w) > fb->width) {
 			w = fb->width - x;
 		}
@@ -236,8 +500,8 @@ static void draw_face_boxes(fb_data_t *fb, std::list<dl::detect::result_t> *resu
 		// landmarks (left eye, mouth left, nose, right eye, mouth right)
 		int x0, y0, j;
 		for (j = 0; j < 10; j += 2) {
-			x0 = (int) prediction->keypoint[j];
-			y0 = (int) prediction->keypoint[j + 1];
+			x0 = prediction->keypoint[j];
+			y0 = prediction->keypoint[j + 1];
 			fb_gfx_fillRect(fb, x0, y0, 3, 3, color);
 		}
 #endif
@@ -245,28 +509,37 @@ static void draw_face_boxes(fb_data_t *fb, std::list<dl::detect::result_t> *resu
 }
 
 #if CONFIG_ESP_FACE_RECOGNITION_ENABLED
-static int run_face_recognition(fb_data_t *fb, std::list<dl::detect::result_t> *results) {
-	std::vector<int> landmarks = results->front().keypoint;
+// Recognizes the first face in `s_faces`. Must hold `s_face_lock`!
+static int run_face_recognition(fb_data_t *fb) {
+	s_face_landmarks.assign(s_faces[0].keypoint, s_faces[0].keypoint + 10); // Same size every time, so no reallocation.
 	int id = -1;
 
 	Tensor<uint8_t> tensor;
 	tensor.set_element((uint8_t *) fb->data).set_shape({ fb->height, fb->width, 3 }).set_auto_free(false);
 
-	int enrolled_count = recognizer.get_enrolled_id_num();
+	// The recognizer has no IDs of its own anymore, so this never matches. It's only here for the embedding:
+	recognizer.recognize(tensor, s_face_landmarks);
+	Tensor<float> &embedding = recognizer.get_face_emb();
+	faces_match match = faces_search(embedding.element, embedding.get_size());
 
-	if (enrolled_count < FACE_ID_SAVE_NUMBER && is_enrolling) {
-		id = recognizer.enroll_id(tensor, landmarks, "", true);
+	// Only faces nobody knows yet get enrolled. It used to be every single frame, until all `7` slots were gone!
+	if (is_enrolling && match.similarity < FACES_MATCH_THRESHOLD) {
+		id = faces_enroll(embedding.element, embedding.get_size(), "");
 		log_i("Enrolled ID: %d", id);
-		rgb_printf(fb, FACE_COLOR_CYAN, "ID[%u]", id);
+		if (id >= 0) {
+			rgb_printf(fb, FACE_COLOR_CYAN, "ID[%u]", id);
+			match.id = id;
+			match.similarity = 1;
+		}
 	}
 
-	face_info_t recognize = recognizer.recognize(tensor, landmarks);
-	if (recognize.id >= 0) {
-		rgb_printf(fb, FACE_COLOR_GREEN, "ID[%u]: %.2f", recognize.id, recognize.similarity);
-	} else {
-		rgb_print(fb, FACE_COLOR_RED, "Intruder Alert!");
+	if (match.id >= 0 && match.similarity >= FACES_MATCH_THRESHOLD) {
+		rgb_printf(fb, FACE_COLOR_GREEN, "ID[%u]: %.2f", match.id, match.similarity);
+		return match.id;
 	}
-	return recognize.id;
+
+	rgb_print(fb, FACE_COLOR_RED, "Intruder Alert!");
+	return -1;
 }
 #endif
 #endif
@@ -284,7 +557,18 @@ void enable_led(bool en) { // Turn LED On or Off
 }
 #endif
 
-static esp_err_t stream_handler(httpd_req_t *req) {
+// There's always one free: no more than `STREAM_CLIENTS_MAX` streams get served at once.
+static uint32_t stream_channel_take() {
+	for (uint32_t i = 0; i < STREAM_CLIENTS_MAX; i++) {
+		ifl((__atomic_fetch_or(&s_stream_channels_taken, 1 << i, __ATOMIC_ACQUIRE) & 1 << i) == 0) {
+			return i;
+		}
+	}
+
+	return 0;
+}
+
+static esp_err_t stream_serve(httpd_req_t *req) {
 	camera_fb_t *fb = NULL;
 	struct timeval _timestamp;
 	esp_err_t res = ESP_OK;
@@ -301,21 +585,13 @@ static esp_err_t stream_handler(httpd_req_t *req) {
 	int64_t fr_start = 0;
 #endif
 	int face_id = 0;
-	size_t out_len = 0, out_width = 0, out_height = 0;
-	uint8_t *out_buf = NULL;
+	int faces = 0;
 	bool s = false;
-#if TWO_STAGE
-	HumanFaceDetectMSR01 s1(0.1F, 0.5F, 10, 0.2F);
-	HumanFaceDetectMNP01 s2(0.5F, 0.3F, 5);
-#else
-	HumanFaceDetectMSR01 s1(0.3F, 0.5F, 10, 0.2F);
-#endif
+	static face_result s_face_overlay[FACE_MAX_RESULTS]; // Only one stream at a time, and it's too big for this task's stack.
 #endif
 
-	static int64_t last_frame = 0;
-	if (!last_frame) {
-		last_frame = esp_timer_get_time();
-	}
+	int64_t last_frame = esp_timer_get_time();
+	uint32_t send_us = 0;
 
 	res = httpd_resp_set_type(req, _STREAM_CONTENT_TYPE);
 	if (res != ESP_OK) {
@@ -324,25 +600,88 @@ static esp_err_t stream_handler(httpd_req_t *req) {
 
 	httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
 	httpd_resp_set_hdr(req, "X-Framerate", "60");
+	qos_mark_stream(httpd_req_to_sockfd(req)); // It came in as control traffic, like every connection does.
+
+	// `?overlay=0` leaves face boxes out of the pixels, for clients that draw them from `X-Faces` instead.
+	// `?hud=1` stamps the timestamp and control state into JPEG frames, without decoding them (see `overlay_jpeg()`):
+	motion_skip skip = { .keepalive_ms = STREAM_SKIP_KEEPALIVE_MS };
+	bool overlay = true;
+	bool hud = false;
+	char str_query[48];
+	char param_value[8];
+	if (httpd_req_get_url_query_str(req, str_query, sizeof(str_query)) == ESP_OK) {
+		if (httpd_query_key_value(str_query, "skip", param_value, sizeof(param_value)) == ESP_OK) {
+			skip.keepalive_ms = strtoul(param_value, NULL, 10);
+		}
+		if (httpd_query_key_value(str_query, "overlay", param_value, sizeof(param_value)) == ESP_OK) {
+			overlay = param_value[0] != '0';
+		}
+		if (httpd_query_key_value(str_query, "hud", param_value, sizeof(param_value)) == ESP_OK) {
+			hud = param_value[0] == '1';
+		}
+	}
+
+	uint8_t *hud_jpeg = NULL; // Grows with the frames, and lives as long as the stream.
+	size_t hud_capacity = 0;
+
+	motion_result motion = {};
+
+	// The server comes up before the camera does. Clients connecting early just wait a little:
+	if (!boot_wait_camera(pdMS_TO_TICKS(10000))) {
+		log_e("Camera never came up");
+		return ESP_FAIL;
+	}
+
+	timelapse_hold(); // Asleep between time-lapse frames? Not anymore.
 
 #if CONFIG_LED_ILLUMINATOR_ENABLED
 	isStreaming = true;
 	enable_led(true);
 #endif
 
+	__atomic_fetch_add(&g_stream_stats.clients, 1, __ATOMIC_RELAXED); // Streams can run side by side now.
+	uint32_t const channel_index = stream_channel_take();
+	trace_channel const channel = s_stream_channels[channel_index];
+	trace_emit(channel, TRACE_EVENT_STREAM_BEGIN);
+	uint32_t frames_sent = 0;
+
 	while (true) {
 #if CONFIG_ESP_FACE_DETECT_ENABLED
 #if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
 		detected = false;
 #endif
 		face_id = 0;
+		faces = 0;
 #endif
 
+		// A burst wants every frame for itself, for a moment:
+		while (burst_active()) {
+			vTaskDelay(pdMS_TO_TICKS(BURST_WAIT_MS));
+		}
+
+		int64_t const fr_wait = esp_timer_get_time();
+		trace_emit(channel, TRACE_EVENT_FB_GET_BEGIN);
 		fb = esp_camera_fb_get();
+		int64_t const fr_got = esp_timer_get_time();
+		trace_emit(channel, TRACE_EVENT_FB_GET_END, fb ? fb->len : 0, fb ? (fb->width << 16 | fb->height) : 0);
 		if (!fb) {
 			log_e("Camera capture failed");
 			res = ESP_FAIL;
 		} else {
+			boot_mark(BOOT_PHASE_FIRST_FRAME, BOOT_BIT_FIRST_FRAME);
+			vision_offer(fb); // Just a `memcpy()`, and only when it's wanted.
+			recorder_offer(fb); // Also a `memcpy()`, or a dropped frame if the card's behind. Never a wait.
+			events_offer(fb);
+
+			// Same picture as the last one sent? Skip it, unless the client hasn't heard from us in a while:
+			bool const compared = motion_update(fb, &motion);
+			if (motion_skip_frame(&skip, compared, &motion, fb->len, fr_got)) {
+				__atomic_fetch_add(&g_stream_stats.suppressed, 1, __ATOMIC_RELAXED);
+				trace_emit(channel, TRACE_EVENT_STREAM_SKIP, fb->len, motion.energy);
+				esp_camera_fb_return(fb);
+				fb = NULL;
+				continue;
+			}
 			_timestamp.tv_sec = fb->timestamp.tv_sec;
 			_timestamp.tv_usec = fb->timestamp.tv_usec;
 #if CONFIG_ESP_FACE_DETECT_ENABLED
@@ -353,7 +692,7 @@ static esp_err_t stream_handler(httpd_req_t *req) {
 			fr_recognize = fr_start;
 			fr_face = fr_start;
 #endif
-			if (!detection_enabled || fb->width > 400) {
+			if (!detection_enabled || !s_face_ready || fb->width > FACE_MAX_WIDTH || fb->height > FACE_MAX_HEIGHT) {
 #endif
 				if (fb->format != PIXFORMAT_JPEG) {
 					bool jpeg_converted = frame2jpg(fb, 80, &_jpg_buf, &_jpg_buf_len);
@@ -369,140 +708,132 @@ static esp_err_t stream_handler(httpd_req_t *req) {
 				}
 #if CONFIG_ESP_FACE_DETECT_ENABLED
 			} else {
-				if (fb->format == PIXFORMAT_RGB565
-#if CONFIG_ESP_FACE_RECOGNITION_ENABLED
-					&& !recognition_enabled
-#endif
-				) {
+				// Detection itself happens in `face_task()`. Here, frames only get *offered* to it, and whatever it found last
+				// gets drawn. No waiting on the network, and no `malloc()`s either!
+				face_offer(fb);
 #if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
-					fr_ready = esp_timer_get_time();
+				fr_ready = esp_timer_get_time();
 #endif
-#if TWO_STAGE
-					std::list<dl::detect::result_t> &candidates =
-						s1.infer((uint16_t *) fb->buf, { (int) fb->height, (int) fb->width, 3 });
-					std::list<dl::detect::result_t> &results =
-						s2.infer((uint16_t *) fb->buf, { (int) fb->height, (int) fb->width, 3 }, candidates);
-#else
-					std::list<dl::detect::result_t> &results =
-						s1.infer((uint16_t *) fb->buf, { (int) fb->height, (int) fb->width, 3 });
-#endif
-#if CONFIG_ESP_FACE_DETECT_ENABLED && ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
-					fr_face = esp_timer_get_time();
-					fr_recognize = fr_face;
+				int64_t faces_frame_us = 0;
+				int64_t const frame_us = _timestamp.tv_sec * 1000000LL + _timestamp.tv_usec;
+				faces = face_latest(s_face_overlay, &face_id, &faces_frame_us);
+				if (faces >= 0) {
+					metrics_record(METRICS_STAGE_FACE_STALENESS, frame_us - faces_frame_us);
+				}
+				if (faces > 0 && frame_us - faces_frame_us < FACE_STALE_MS * 1000LL) {
+#if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
+					detected = true;
 #endif
-					if (results.size() > 0) {
+					// Only raw frames can be drawn on. JPEG streams still get the boxes, as the `X-Faces` part header:
+					if (overlay && fb->format == PIXFORMAT_RGB565) {
 						fb_data_t rfb;
 						rfb.width = fb->width;
 						rfb.height = fb->height;
 						rfb.data = fb->buf;
 						rfb.bytes_per_pixel = 2;
 						rfb.format = FB_RGB565;
+						draw_face_boxes(&rfb, s_face_overlay, faces, face_id);
+					}
+				} else {
+					faces = 0;
+				}
 #if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
-						detected = true;
+				fr_face = esp_timer_get_time();
+				fr_recognize = fr_face;
 #endif
-						draw_face_boxes(&rfb, &results, face_id);
-					}
-					s = fmt2jpg(fb->buf, fb->len, fb->width, fb->height, PIXFORMAT_RGB565, 80, &_jpg_buf,
-								&_jpg_buf_len);
+				if (fb->format == PIXFORMAT_JPEG) {
+					_jpg_buf_len = fb->len;
+					_jpg_buf = fb->buf;
+				} else {
+					s = frame2jpg_cb(fb, 80, face_jpeg_append, NULL);
 					esp_camera_fb_return(fb);
 					fb = NULL;
 					if (!s) {
-						log_e("fmt2jpg failed");
-						res = ESP_FAIL;
-					}
-#if CONFIG_ESP_FACE_DETECT_ENABLED && ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
-					fr_encode = esp_timer_get_time();
-#endif
-				} else {
-					out_len = fb->width * fb->height * 3;
-					out_width = fb->width;
-					out_height = fb->height;
-					out_buf = (uint8_t *) malloc(out_len);
-					if (!out_buf) {
-						log_e("out_buf malloc failed");
+						log_e("JPEG compression failed");
 						res = ESP_FAIL;
 					} else {
-						s = fmt2rgb888(fb->buf, fb->len, fb->format, out_buf);
-						esp_camera_fb_return(fb);
-						fb = NULL;
-						if (!s) {
-							free(out_buf);
-							log_e("To rgb888 failed");
-							res = ESP_FAIL;
-						} else {
-#if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
-							fr_ready = esp_timer_get_time();
-#endif
-
-							fb_data_t rfb;
-							rfb.width = out_width;
-							rfb.height = out_height;
-							rfb.data = out_buf;
-							rfb.bytes_per_pixel = 3;
-							rfb.format = FB_BGR888;
-
-#if TWO_STAGE
-							std::list<dl::detect::result_t> &candidates =
-								s1.infer((uint8_t *) out_buf, { (int) out_height, (int) out_width, 3 });
-							std::list<dl::detect::result_t> &results =
-								s2.infer((uint8_t *) out_buf, { (int) out_height, (int) out_width, 3 }, candidates);
-#else
-							std::list<dl::detect::result_t> &results =
-								s1.infer((uint8_t *) out_buf, { (int) out_height, (int) out_width, 3 });
-#endif
-
-#if CONFIG_ESP_FACE_DETECT_ENABLED && ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
-							fr_face = esp_timer_get_time();
-							fr_recognize = fr_face;
-#endif
-
-							if (results.size() > 0) {
+						_jpg_buf = s_face_jpeg;
+						_jpg_buf_len = s_face_jpeg_len;
+					}
+				}
 #if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
-								detected = true;
+				fr_encode = esp_timer_get_time();
 #endif
-#if CONFIG_ESP_FACE_RECOGNITION_ENABLED
-								if (recognition_enabled) {
-									face_id = run_face_recognition(&rfb, &results);
-#if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
-									fr_recognize = esp_timer_get_time();
-#endif
-								}
-#endif
-								draw_face_boxes(&rfb, &results, face_id);
-							}
-							s = fmt2jpg(out_buf, out_len, out_width, out_height, PIXFORMAT_RGB888, 90, &_jpg_buf,
-										&_jpg_buf_len);
-							free(out_buf);
-							if (!s) {
-								log_e("fmt2jpg failed");
-								res = ESP_FAIL;
-							}
-#if CONFIG_ESP_FACE_DETECT_ENABLED && ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
-							fr_encode = esp_timer_get_time();
+			}
 #endif
-						}
-					}
+		}
+		size_t const picture_len = _jpg_buf_len; // What frame skipping compares. HUD bytes change every frame!
+		if (hud && res == ESP_OK && fb != NULL && _jpg_buf == fb->buf) {
+			size_t const needed = fb->len + fb->len / 4 + 1024; // Painted blocks can come out bigger than they went in.
+			if (hud_capacity < needed) {
+				uint8_t *grown = (uint8_t *) heap_caps_realloc(hud_jpeg, needed, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+				if (grown == NULL) { // No PSRAM. About a frame's worth of internal RAM, then.
+					grown = (uint8_t *) heap_caps_realloc(hud_jpeg, needed, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+				}
+				if (grown != NULL) {
+					hud_jpeg = grown;
+					hud_capacity = needed;
 				}
 			}
-#endif
+			size_t const hud_len = hud_capacity < needed ? 0 : overlay_hud(fb, hud_jpeg, hud_capacity);
+			if (hud_len > 0) { // Otherwise, the frame just goes out without a HUD.
+				_jpg_buf = hud_jpeg;
+				_jpg_buf_len = hud_len;
+			}
 		}
+		int64_t const fr_encoded = esp_timer_get_time();
+		trace_emit(channel, TRACE_EVENT_STREAM_ENCODE_END, _jpg_buf_len);
 		if (res == ESP_OK) {
 			res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
 		}
 		if (res == ESP_OK) {
 			size_t hlen =
-				snprintf((char *) part_buf, 128, _STREAM_PART, _jpg_buf_len, _timestamp.tv_sec, _timestamp.tv_usec);
+				snprintf((char *) part_buf, sizeof(part_buf), _STREAM_PART, _jpg_buf_len, _timestamp.tv_sec, _timestamp.tv_usec);
+			if (motion.sequence > 0) {
+				hlen += snprintf((char *) part_buf + hlen, sizeof(part_buf) - hlen, "X-Motion: %u;%u;%lx\r\n", motion.energy,
+					motion.blocks, (unsigned long) motion.bitmap);
+			}
+			hlen += snprintf((char *) part_buf + hlen, sizeof(part_buf) - hlen, "X-Controls: %d;%d;%d\r\n", g_carSteerNewValue,
+				g_carGearValue, g_carModeControls ? 1 : 0);
+#if CONFIG_ESP_FACE_DETECT_ENABLED
+			if (faces > 0) {
+				hlen += snprintf((char *) part_buf + hlen, sizeof(part_buf) - hlen, "X-Faces: %d", face_id);
+				for (int i = 0; i < faces; i++) {
+					int const *box = s_face_overlay[i].box;
+					hlen += snprintf((char *) part_buf + hlen, sizeof(part_buf) - hlen, ";%d,%d,%d,%d", box[0], box[1], box[2], box[3]);
+				}
+				hlen += snprintf((char *) part_buf + hlen, sizeof(part_buf) - hlen, "\r\n");
+			}
+#endif
+			int64_t const sent_us = esp_timer_get_time(); // Last, so it's as close to the actual send as it gets.
+			hlen += snprintf((char *) part_buf + hlen, sizeof(part_buf) - hlen, "X-Sent: %d.%06d\r\n\r\n",
+				(int) (sent_us / 1000000), (int) (sent_us % 1000000));
+			__atomic_store_n(&g_stream_stats.header_bytes, hlen, __ATOMIC_RELAXED);
 			res = httpd_resp_send_chunk(req, (const char *) part_buf, hlen);
 		}
 		if (res == ESP_OK) {
 			res = httpd_resp_send_chunk(req, (const char *) _jpg_buf, _jpg_buf_len);
 		}
+		trace_emit(channel, TRACE_EVENT_STREAM_SEND_END, res);
+		if (res == ESP_OK) {
+			frames_sent++;
+			motion_skip_sent(&skip, picture_len, fr_got);
+			int64_t const fr_sent = esp_timer_get_time();
+			send_us = fr_sent - fr_encoded;
+			metrics_record(METRICS_STAGE_CAPTURE_WAIT, fr_got - fr_wait);
+			metrics_record(METRICS_STAGE_ENCODE, fr_encoded - fr_got);
+			metrics_record(METRICS_STAGE_SEND, fr_sent - fr_encoded);
+			metrics_record(METRICS_STAGE_END_TO_END, fr_sent - (_timestamp.tv_sec * 1000000LL + _timestamp.tv_usec));
+		}
 		if (fb) {
 			esp_camera_fb_return(fb);
 			fb = NULL;
 			_jpg_buf = NULL;
 		} else if (_jpg_buf) {
-			free(_jpg_buf);
+#if CONFIG_ESP_FACE_DETECT_ENABLED
+			if (_jpg_buf != s_face_jpeg) // That one's kept around for the next frame.
+#endif
+				free(_jpg_buf);
 			_jpg_buf = NULL;
 		}
 		if (res != ESP_OK) {
@@ -520,11 +851,31 @@ static esp_err_t stream_handler(httpd_req_t *req) {
 #endif
 
 		int64_t frame_time = fr_end - last_frame;
+		last_frame = fr_end;
+
+		// Someone steering, and their responses would queue behind ours? Then give them some room. Same if the link can't
+		// even carry the smallest frames at full rate:
+		uint32_t pace_ms = qos_stream_pace(send_us, frame_time, _jpg_buf_len);
+		uint32_t const interval_ms = radio_frame_interval_ms();
+		uint32_t const busy_ms = (fr_end - fr_wait) / 1000;
+		if (interval_ms > busy_ms + pace_ms) {
+			pace_ms = interval_ms - busy_ms;
+		}
+
+		if (pace_ms > 0) {
+			vTaskDelay(pdMS_TO_TICKS(pace_ms));
+		}
+
 		frame_time /= 1000;
+		__atomic_fetch_add(&g_stream_stats.frames, 1, __ATOMIC_RELAXED);
+		__atomic_store_n(&g_stream_stats.frame_bytes, _jpg_buf_len, __ATOMIC_RELAXED);
+		__atomic_store_n(&g_stream_stats.send_us, send_us, __ATOMIC_RELAXED);
+		__atomic_store_n(&g_stream_stats.frame_ms, frame_time, __ATOMIC_RELAXED);
 #if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
 		uint32_t avg_frame_time = ra_filter_run(&ra_filter, frame_time);
 #endif
-		log_i(
+		// Debug level only: at 115200 baud, this line alone takes longer than sending a QVGA frame. `/trace` has the same data.
+		log_d(
 			"MJPG: %uB %ums (%.1ffps), AVG: %ums (%.1ffps)"
 #if CONFIG_ESP_FACE_DETECT_ENABLED
 			", %u+%u+%u+%u=%u %s%d"
@@ -540,14 +891,63 @@ static esp_err_t stream_handler(httpd_req_t *req) {
 		);
 	}
 
+	uint32_t const clients = __atomic_sub_fetch(&g_stream_stats.clients, 1, __ATOMIC_RELAXED);
+	timelapse_release();
+	trace_emit(channel, TRACE_EVENT_STREAM_END, frames_sent);
+	__atomic_fetch_and(&s_stream_channels_taken, ~(1 << channel_index), __ATOMIC_RELEASE);
+	free(hud_jpeg);
+
 #if CONFIG_LED_ILLUMINATOR_ENABLED
-	isStreaming = false;
-	enable_led(false);
+	if (clients == 0) { // The last one out turns the lights off.
+		isStreaming = false;
+		enable_led(false);
+	}
 #endif
 
 	return res;
 }
 
+#if STREAM_SEPARATE_PORT
+static esp_err_t stream_handler(httpd_req_t *req) {
+	return stream_serve(req);
+}
+#else
+static uint32_t volatile s_stream_tasks = 0; // Only `camera_httpd`'s task adds to it.
+
+static void stream_task(void *p_param) {
+	httpd_req_t *req = (httpd_req_t *) p_param;
+	stream_serve(req);
+	httpd_req_async_handler_complete(req);
+	__atomic_sub_fetch(&s_stream_tasks, 1, __ATOMIC_RELAXED);
+	vTaskDelete(NULL);
+}
+
+static esp_err_t stream_handler(httpd_req_t *req) {
+	ifu(s_stream_tasks >= STREAM_CLIENTS_MAX) {
+		httpd_resp_set_status(req, "503 Service Unavailable");
+		httpd_resp_set_hdr(req, "Retry-After", "1");
+		return httpd_resp_send(req, NULL, 0);
+	}
+
+	httpd_req_t *async = NULL;
+	ifu(httpd_req_async_handler_begin(req, &async) != ESP_OK) {
+		httpd_resp_send_500(req);
+		return ESP_FAIL;
+	}
+
+	// Same priority as the server's own task, which is where streams used to run:
+	__atomic_add_fetch(&s_stream_tasks, 1, __ATOMIC_RELAXED);
+	ifu(xTaskCreate(stream_task, "stream", STREAM_TASK_STACK, async, tskIDLE_PRIORITY + 5, NULL) != pdPASS) {
+		__atomic_sub_fetch(&s_stream_tasks, 1, __ATOMIC_RELAXED);
+		httpd_resp_send_500(async);
+		httpd_req_async_handler_complete(async);
+		return ESP_FAIL;
+	}
+
+	return ESP_OK;
+}
+#endif
+
 /*
 static esp_err_t bmp_handler(httpd_req_t *req) {
 	camera_fb_t *fb = NULL;
@@ -572,7 +972,7 @@ static esp_err_t bmp_handler(httpd_req_t *req) {
 
 	uint8_t *buf = NULL;
 	size_t buf_len = 0;
-	bool converted = frame2bmp(fb, &buf, &buf_len);
+	bool converted = decode_frame2bmp(fb, &buf, &buf_len);
 	esp_camera_fb_return(fb);
 	if (!converted) {
 		log_e("BMP Conversion failed");
@@ -587,6 +987,7 @@ static esp_err_t bmp_handler(httpd_req_t *req) {
 	log_i("BMP: %llums, %uB", (uint64_t) ((fr_end - fr_start) / 1000), buf_len);
 	return res;
 }
+*/
 
 static size_t jpg_encode_stream(void *arg, size_t index, const void *data, size_t len) {
 	jpg_chunking_t *j = (jpg_chunking_t *) arg;
@@ -607,14 +1008,15 @@ static esp_err_t capture_handler(httpd_req_t *req) {
 	int64_t fr_start = esp_timer_get_time();
 #endif
 
+	// Only a frame that started exposing after the LED came on will do. Streaming? Then it's already on:
+	capture_result capture;
+	timelapse_hold();
 #if CONFIG_LED_ILLUMINATOR_ENABLED
-	enable_led(true);
-	vTaskDelay(150 / portTICK_PERIOD_MS); // The LED needs to be turned on ~150ms before the call to esp_camera_fb_get()
-	fb = esp_camera_fb_get();			  // or it won't be visible in the frame. A better way to do this is needed.
-	enable_led(false);
+	fb = capture_lit_frame(led_duty > 0 && !isStreaming ? enable_led : NULL, &capture);
 #else
-	fb = esp_camera_fb_get();
+	fb = capture_lit_frame(NULL, &capture);
 #endif
+	timelapse_release();
 
 	if (!fb) {
 		log_e("Camera capture failed");
@@ -622,6 +1024,7 @@ static esp_err_t capture_handler(httpd_req_t *req) {
 		return ESP_FAIL;
 	}
 
+	metrics_record(METRICS_STAGE_CAPTURE, capture.latency_us);
 	httpd_resp_set_type(req, "image/jpeg");
 	httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=capture.jpg");
 	httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
@@ -630,6 +1033,12 @@ static esp_err_t capture_handler(httpd_req_t *req) {
 	snprintf(ts, 32, "%lld.%06ld", static_cast<long long>(fb->timestamp.tv_sec), static_cast<long>(fb->timestamp.tv_usec));
 	httpd_resp_set_hdr(req, "X-Timestamp", (const char *) ts);
 
+	// How long it took, and how, for whoever's tuning this:
+	char latency[48];
+	snprintf(latency, sizeof(latency), "%lu us, %lu thrown, %s", (unsigned long) capture.latency_us,
+		(unsigned long) capture.thrown, capture.synced ? "synced" : "unsynced");
+	httpd_resp_set_hdr(req, "X-Capture-Latency", latency);
+
 #if CONFIG_ESP_FACE_DETECT_ENABLED
 	size_t out_len, out_width, out_height;
 	uint8_t *out_buf;
@@ -638,7 +1047,8 @@ static esp_err_t capture_handler(httpd_req_t *req) {
 	bool detected = false;
 #endif
 	int face_id = 0;
-	if (!detection_enabled || fb->width > 400) {
+	int faces = 0;
+	if (!detection_enabled || !s_face_ready || fb->width > FACE_MAX_WIDTH || fb->height > FACE_MAX_HEIGHT) {
 #endif
 #if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
 		size_t fb_len = 0;
@@ -666,24 +1076,15 @@ static esp_err_t capture_handler(httpd_req_t *req) {
 	}
 
 	jpg_chunking_t jchunk = { req, 0 };
+	xSemaphoreTake(s_face_lock, portMAX_DELAY); // Shared with `stream_handler()`.
 
 	if (fb->format == PIXFORMAT_RGB565
 #if CONFIG_ESP_FACE_RECOGNITION_ENABLED
 		&& !recognition_enabled
 #endif
 	) {
-#if TWO_STAGE
-		HumanFaceDetectMSR01 s1(0.1F, 0.5F, 10, 0.2F);
-		HumanFaceDetectMNP01 s2(0.5F, 0.3F, 5);
-		std::list<dl::detect::result_t> &candidates =
-			s1.infer((uint16_t *) fb->buf, { (int) fb->height, (int) fb->width, 3 });
-		std::list<dl::detect::result_t> &results =
-			s2.infer((uint16_t *) fb->buf, { (int) fb->height, (int) fb->width, 3 }, candidates);
-#else
-		HumanFaceDetectMSR01 s1(0.3F, 0.5F, 10, 0.2F);
-		std::list<dl::detect::result_t> &results = s1.infer((uint16_t *) fb->buf, { (int) fb->height, (int) fb->width, 3 });
-#endif
-		if (results.size() > 0) {
+		faces = face_detect((uint16_t *) fb->buf, fb->width, fb->height);
+		if (faces > 0) {
 			fb_data_t rfb;
 			rfb.width = fb->width;
 			rfb.height = fb->height;
@@ -693,7 +1094,7 @@ static esp_err_t capture_handler(httpd_req_t *req) {
 #if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
 			detected = true;
 #endif
-			draw_face_boxes(&rfb, &results, face_id);
+			draw_face_boxes(&rfb, s_faces, faces, face_id);
 		}
 		s = fmt2jpg_cb(fb->buf, fb->len, fb->width, fb->height, PIXFORMAT_RGB565, 90, jpg_encode_stream, &jchunk);
 		esp_camera_fb_return(fb);
@@ -701,16 +1102,11 @@ static esp_err_t capture_handler(httpd_req_t *req) {
 		out_len = fb->width * fb->height * 3;
 		out_width = fb->width;
 		out_height = fb->height;
-		out_buf = (uint8_t *) malloc(out_len);
-		if (!out_buf) {
-			log_e("out_buf malloc failed");
-			httpd_resp_send_500(req);
-			return ESP_FAIL;
-		}
-		s = fmt2rgb888(fb->buf, fb->len, fb->format, out_buf);
+		out_buf = s_face_rgb;
+		s = decode_fmt2rgb888(fb->buf, fb->len, fb->format, out_buf);
 		esp_camera_fb_return(fb);
 		if (!s) {
-			free(out_buf);
+			xSemaphoreGive(s_face_lock);
 			log_e("To rgb888 failed");
 			httpd_resp_send_500(req);
 			return ESP_FAIL;
@@ -723,34 +1119,25 @@ static esp_err_t capture_handler(httpd_req_t *req) {
 		rfb.bytes_per_pixel = 3;
 		rfb.format = FB_BGR888;
 
-#if TWO_STAGE
-		HumanFaceDetectMSR01 s1(0.1F, 0.5F, 10, 0.2F);
-		HumanFaceDetectMNP01 s2(0.5F, 0.3F, 5);
-		std::list<dl::detect::result_t> &candidates =
-			s1.infer((uint8_t *) out_buf, { (int) out_height, (int) out_width, 3 });
-		std::list<dl::detect::result_t> &results =
-			s2.infer((uint8_t *) out_buf, { (int) out_height, (int) out_width, 3 }, candidates);
-#else
-		HumanFaceDetectMSR01 s1(0.3F, 0.5F, 10, 0.2F);
-		std::list<dl::detect::result_t> &results = s1.infer((uint8_t *) out_buf, { (int) out_height, (int) out_width, 3 });
-#endif
+		faces = face_detect((uint8_t *) out_buf, out_width, out_height);
 
-		if (results.size() > 0) {
+		if (faces > 0) {
 #if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
 			detected = true;
 #endif
 #if CONFIG_ESP_FACE_RECOGNITION_ENABLED
 			if (recognition_enabled) {
-				face_id = run_face_recognition(&rfb, &results);
+				face_id = run_face_recognition(&rfb);
 			}
 #endif
-			draw_face_boxes(&rfb, &results, face_id);
+			draw_face_boxes(&rfb, s_faces, faces, face_id);
 		}
 
 		s = fmt2jpg_cb(out_buf, out_len, out_width, out_height, PIXFORMAT_RGB888, 90, jpg_encode_stream, &jchunk);
-		free(out_buf);
 	}
 
+	xSemaphoreGive(s_face_lock);
+
 	if (!s) {
 		log_e("JPEG compression failed");
 		httpd_resp_send_500(req);
@@ -765,6 +1152,89 @@ static esp_err_t capture_handler(httpd_req_t *req) {
 #endif
 }
 
+static int print_reg(char *p, sensor_t *s, uint16_t reg, uint32_t mask) {
+	return sprintf(p, "\"0x%x\":%u,", reg, s->get_reg(s, reg, mask));
+}
+
+// The old `/status` JSON, sensor register reads and all. `app_status` benchmarks its CBOR against this. Needs `1024` bytes!
+size_t status_print_json(char *p_buffer) {
+	sensor_t *s = esp_camera_sensor_get();
+	char *p = p_buffer;
+	*p++ = '{';
+
+	if (s->id.PID == OV5640_PID || s->id.PID == OV3660_PID) {
+		for (int reg = 0x3400; reg < 0x3406; reg += 2) {
+			p += print_reg(p, s, reg, 0xFFF); // 12 bit
+		}
+		p += print_reg(p, s, 0x3406, 0xFF);
+
+		p += print_reg(p, s, 0x3500, 0xFFFF0); // 16 bit
+		p += print_reg(p, s, 0x3503, 0xFF);
+		p += print_reg(p, s, 0x350a, 0x3FF);  // 10 bit
+		p += print_reg(p, s, 0x350c, 0xFFFF); // 16 bit
+
+		for (int reg = 0x5480; reg <= 0x5490; reg++) {
+			p += print_reg(p, s, reg, 0xFF);
+		}
+
+		for (int reg = 0x5380; reg <= 0x538b; reg++) {
+			p += print_reg(p, s, reg, 0xFF);
+		}
+
+		for (int reg = 0x5580; reg < 0x558a; reg++) {
+			p += print_reg(p, s, reg, 0xFF);
+		}
+		p += print_reg(p, s, 0x558a, 0x1FF); // 9 bit
+	} else if (s->id.PID == OV2640_PID) {
+		p += print_reg(p, s, 0xd3, 0xFF);
+		p += print_reg(p, s, 0x111, 0xFF);
+		p += print_reg(p, s, 0x132, 0xFF);
+	}
+
+	p += sprintf(p, "\"xclk\":%u,", s->xclk_freq_hz / 1000000);
+	p += sprintf(p, "\"pixformat\":%u,", s->pixformat);
+	p += sprintf(p, "\"framesize\":%u,", s->status.framesize);
+	p += sprintf(p, "\"quality\":%u,", s->status.quality);
+	p += sprintf(p, "\"brightness\":%d,", s->status.brightness);
+	p += sprintf(p, "\"contrast\":%d,", s->status.contrast);
+	p += sprintf(p, "\"saturation\":%d,", s->status.saturation);
+	p += sprintf(p, "\"sharpness\":%d,", s->status.sharpness);
+	p += sprintf(p, "\"special_effect\":%u,", s->status.special_effect);
+	p += sprintf(p, "\"wb_mode\":%u,", s->status.wb_mode);
+	p += sprintf(p, "\"awb\":%u,", s->status.awb);
+	p += sprintf(p, "\"awb_gain\":%u,", s->status.awb_gain);
+	p += sprintf(p, "\"aec\":%u,", s->status.aec);
+	p += sprintf(p, "\"aec2\":%u,", s->status.aec2);
+	p += sprintf(p, "\"ae_level\":%d,", s->status.ae_level);
+	p += sprintf(p, "\"aec_value\":%u,", s->status.aec_value);
+	p += sprintf(p, "\"agc\":%u,", s->status.agc);
+	p += sprintf(p, "\"agc_gain\":%u,", s->status.agc_gain);
+	p += sprintf(p, "\"gainceiling\":%u,", s->status.gainceiling);
+	p += sprintf(p, "\"bpc\":%u,", s->status.bpc);
+	p += sprintf(p, "\"wpc\":%u,", s->status.wpc);
+	p += sprintf(p, "\"raw_gma\":%u,", s->status.raw_gma);
+	p += sprintf(p, "\"lenc\":%u,", s->status.lenc);
+	p += sprintf(p, "\"hmirror\":%u,", s->status.hmirror);
+	p += sprintf(p, "\"dcw\":%u,", s->status.dcw);
+	p += sprintf(p, "\"colorbar\":%u", s->status.colorbar);
+#if CONFIG_LED_ILLUMINATOR_ENABLED
+	p += sprintf(p, ",\"led_intensity\":%u", led_duty);
+#else
+	p += sprintf(p, ",\"led_intensity\":%d", -1);
+#endif
+#if CONFIG_ESP_FACE_DETECT_ENABLED
+	p += sprintf(p, ",\"face_detect\":%u", detection_enabled);
+#if CONFIG_ESP_FACE_RECOGNITION_ENABLED
+	p += sprintf(p, ",\"face_enroll\":%u,", is_enrolling);
+	p += sprintf(p, "\"face_recognize\":%u", recognition_enabled);
+#endif
+#endif
+	*p++ = '}';
+	*p = 0;
+	return p - p_buffer;
+}
+
+/*
 static esp_err_t parse_get(httpd_req_t *req, char **obuf) {
 	char *buf = NULL;
 	size_t buf_len = 0;
@@ -809,7 +1279,9 @@ static esp_err_t cmd_handler(httpd_req_t *req) {
 
 	if (!strcmp(variable, "framesize")) {
 		if (s->pixformat == PIXFORMAT_JPEG) {
+			profiles_framesize_take(portMAX_DELAY); // Not from under `/burst` or `app_radio`.
 			res = s->set_framesize(s, (framesize_t) val);
+			profiles_framesize_give();
 		}
 	} else if (!strcmp(variable, "quality")) {
 		res = s->set_quality(s, val);
@@ -901,89 +1373,13 @@ static esp_err_t cmd_handler(httpd_req_t *req) {
 	return httpd_resp_send(req, NULL, 0);
 }
 
-static int print_reg(char *p, sensor_t *s, uint16_t reg, uint32_t mask) {
-	return sprintf(p, "\"0x%x\":%u,", reg, s->get_reg(s, reg, mask));
-}
-
 static esp_err_t status_handler(httpd_req_t *req) {
 	static char json_response[1024];
 
-	sensor_t *s = esp_camera_sensor_get();
-	char *p = json_response;
-	*p++ = '{';
-
-	if (s->id.PID == OV5640_PID || s->id.PID == OV3660_PID) {
-		for (int reg = 0x3400; reg < 0x3406; reg += 2) {
-			p += print_reg(p, s, reg, 0xFFF); // 12 bit
-		}
-		p += print_reg(p, s, 0x3406, 0xFF);
-
-		p += print_reg(p, s, 0x3500, 0xFFFF0); // 16 bit
-		p += print_reg(p, s, 0x3503, 0xFF);
-		p += print_reg(p, s, 0x350a, 0x3FF);  // 10 bit
-		p += print_reg(p, s, 0x350c, 0xFFFF); // 16 bit
-
-		for (int reg = 0x5480; reg <= 0x5490; reg++) {
-			p += print_reg(p, s, reg, 0xFF);
-		}
-
-		for (int reg = 0x5380; reg <= 0x538b; reg++) {
-			p += print_reg(p, s, reg, 0xFF);
-		}
-
-		for (int reg = 0x5580; reg < 0x558a; reg++) {
-			p += print_reg(p, s, reg, 0xFF);
-		}
-		p += print_reg(p, s, 0x558a, 0x1FF); // 9 bit
-	} else if (s->id.PID == OV2640_PID) {
-		p += print_reg(p, s, 0xd3, 0xFF);
-		p += print_reg(p, s, 0x111, 0xFF);
-		p += print_reg(p, s, 0x132, 0xFF);
-	}
-
-	p += sprintf(p, "\"xclk\":%u,", s->xclk_freq_hz / 1000000);
-	p += sprintf(p, "\"pixformat\":%u,", s->pixformat);
-	p += sprintf(p, "\"framesize\":%u,", s->status.framesize);
-	p += sprintf(p, "\"quality\":%u,", s->status.quality);
-	p += sprintf(p, "\"brightness\":%d,", s->status.brightness);
-	p += sprintf(p, "\"contrast\":%d,", s->status.contrast);
-	p += sprintf(p, "\"saturation\":%d,", s->status.saturation);
-	p += sprintf(p, "\"sharpness\":%d,", s->status.sharpness);
-	p += sprintf(p, "\"special_effect\":%u,", s->status.special_effect);
-	p += sprintf(p, "\"wb_mode\":%u,", s->status.wb_mode);
-	p += sprintf(p, "\"awb\":%u,", s->status.awb);
-	p += sprintf(p, "\"awb_gain\":%u,", s->status.awb_gain);
-	p += sprintf(p, "\"aec\":%u,", s->status.aec);
-	p += sprintf(p, "\"aec2\":%u,", s->status.aec2);
-	p += sprintf(p, "\"ae_level\":%d,", s->status.ae_level);
-	p += sprintf(p, "\"aec_value\":%u,", s->status.aec_value);
-	p += sprintf(p, "\"agc\":%u,", s->status.agc);
-	p += sprintf(p, "\"agc_gain\":%u,", s->status.agc_gain);
-	p += sprintf(p, "\"gainceiling\":%u,", s->status.gainceiling);
-	p += sprintf(p, "\"bpc\":%u,", s->status.bpc);
-	p += sprintf(p, "\"wpc\":%u,", s->status.wpc);
-	p += sprintf(p, "\"raw_gma\":%u,", s->status.raw_gma);
-	p += sprintf(p, "\"lenc\":%u,", s->status.lenc);
-	p += sprintf(p, "\"hmirror\":%u,", s->status.hmirror);
-	p += sprintf(p, "\"dcw\":%u,", s->status.dcw);
-	p += sprintf(p, "\"colorbar\":%u", s->status.colorbar);
-#if CONFIG_LED_ILLUMINATOR_ENABLED
-	p += sprintf(p, ",\"led_intensity\":%u", led_duty);
-#else
-	p += sprintf(p, ",\"led_intensity\":%d", -1);
-#endif
-#if CONFIG_ESP_FACE_DETECT_ENABLED
-	p += sprintf(p, ",\"face_detect\":%u", detection_enabled);
-#if CONFIG_ESP_FACE_RECOGNITION_ENABLED
-	p += sprintf(p, ",\"face_enroll\":%u,", is_enrolling);
-	p += sprintf(p, "\"face_recognize\":%u", recognition_enabled);
-#endif
-#endif
-	*p++ = '}';
-	*p++ = 0;
+	size_t const len = status_print_json(json_response);
 	httpd_resp_set_type(req, "application/json");
 	httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-	return httpd_resp_send(req, json_response, strlen(json_response));
+	return httpd_resp_send(req, json_response, len);
 }
 
 static esp_err_t xclk_handler(httpd_req_t *req) {
@@ -1171,8 +1567,8 @@ static esp_err_t index_handler(httpd_req_t *req) {
 
 void startCameraServer() {
 	httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-	// config.max_uri_handlers = 16;
-	config.max_uri_handlers = 2;
+	config.max_uri_handlers = 20;
+	config.open_fn = qos_session_open;
 
 	httpd_uri_t stream_uri = {
 
@@ -1188,6 +1584,20 @@ void startCameraServer() {
 
 	};
 
+	httpd_uri_t capture_uri = {
+
+		.uri = "/capture",
+		.method = HTTP_GET,
+		.handler = capture_handler,
+		.user_ctx = NULL,
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL
+#endif
+
+	};
+
 	extern httpd_uri_t g_uri_controls;
 
 	/*
@@ -1224,17 +1634,6 @@ void startCameraServer() {
 	#endif
 		};
 
-		httpd_uri_t capture_uri = { .uri = "/capture",
-								   .method = HTTP_GET,
-								   .handler = capture_handler,
-								   .user_ctx = NULL,
-	#ifdef CONFIG_HTTPD_WS_SUPPORT
-								   .is_websocket = true,
-								   .handle_ws_control_frames = false,
-								   .supported_subprotocol = NULL
-	#endif
-		};
-
 		httpd_uri_t bmp_uri = { .uri = "/bmp",
 							   .method = HTTP_GET,
 							   .handler = bmp_handler,
@@ -1303,21 +1702,49 @@ void startCameraServer() {
 	*/
 
 	ra_filter_init(&ra_filter, 20);
+	metrics_init();
+	motion_init();
+	overlay_init();
+#if CONFIG_ESP_FACE_DETECT_ENABLED
+	face_init();
+#endif
 
 #if CONFIG_ESP_FACE_RECOGNITION_ENABLED
-	recognizer.set_partition(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "fr");
-
-	// load ids from flash partition
-	recognizer.set_ids_from_flash();
+	faces_init();
 #endif
+	size_t const internal_before = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+
 	log_i("Starting web server on port: '%d'", config.server_port);
 	if (httpd_start(&camera_httpd, &config) == ESP_OK) {
+#if !STREAM_SEPARATE_PORT
+		httpd_register_uri_handler(camera_httpd, &stream_uri);
+#endif
 		// httpd_register_uri_handler(camera_httpd, &index_uri);
 		// httpd_register_uri_handler(camera_httpd, &cmd_uri);
 		// httpd_register_uri_handler(camera_httpd, &status_uri);
-		// httpd_register_uri_handler(camera_httpd, &capture_uri);
+		httpd_register_uri_handler(camera_httpd, &capture_uri);
+		httpd_register_uri_handler(camera_httpd, &g_uri_burst);
+		httpd_register_uri_handler(camera_httpd, &g_uri_index);
 		// httpd_register_uri_handler(camera_httpd, &bmp_uri);
 		httpd_register_uri_handler(camera_httpd, &g_uri_controls);
+		httpd_register_uri_handler(camera_httpd, &g_uri_profile);
+		httpd_register_uri_handler(camera_httpd, &g_uri_status);
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		httpd_register_uri_handler(camera_httpd, &g_uri_status_ws);
+#endif
+		httpd_register_uri_handler(camera_httpd, &g_uri_metrics);
+		httpd_register_uri_handler(camera_httpd, &g_uri_trace);
+		httpd_register_uri_handler(camera_httpd, &g_uri_vision);
+		httpd_register_uri_handler(camera_httpd, &g_uri_motion);
+		httpd_register_uri_handler(camera_httpd, &g_uri_overlay);
+		httpd_register_uri_handler(camera_httpd, &g_uri_recorder);
+		httpd_register_uri_handler(camera_httpd, &g_uri_events);
+		httpd_register_uri_handler(camera_httpd, &g_uri_footage);
+		httpd_register_uri_handler(camera_httpd, &g_uri_timelapse);
+#if CONFIG_ESP_FACE_RECOGNITION_ENABLED
+		httpd_register_uri_handler(camera_httpd, &g_uri_faces);
+#endif
+		status_init(camera_httpd);
 
 		// httpd_register_uri_handler(camera_httpd, &xclk_uri);
 		// httpd_register_uri_handler(camera_httpd, &reg_uri);
@@ -1326,6 +1753,7 @@ void startCameraServer() {
 		// httpd_register_uri_handler(camera_httpd, &win_uri);
 	}
 
+#if STREAM_SEPARATE_PORT
 	config.ctrl_port += 1;
 	config.server_port += 1;
 	log_i("Starting stream server on port: '%d'", config.server_port);
@@ -1333,6 +1761,11 @@ void startCameraServer() {
 	if (httpd_start(&stream_httpd, &config) == ESP_OK) {
 		httpd_register_uri_handler(stream_httpd, &stream_uri);
 	}
+#endif
+
+	// Handlers' own allocations (`status_init()`'s and such) included, but those are the same either way:
+	g_httpd_internal_bytes = internal_before - heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+	log_i("Servers took %lu bytes of internal RAM", (unsigned long) g_httpd_internal_bytes);
 }
 
 // void setupLedFlash(int pin) {
@@ -0,0 +1,213 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <driver/uart.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "app.h"
+#include "app_link.hpp"
+#include "app_drive.hpp"
+#include "app_metrics.hpp"
+#include "app_controls.hpp"
+#include "protocol_car_controls.hpp"
+
+#define LINK_UART			UART_NUM_1 // `UART_NUM_0` is `Serial`, and our logs.
+#define LINK_PIN_TX			PIN_CAR_ESP_CAM_STEER
+#define LINK_PIN_RX			PIN_CAR_ESP_CAM_2
+#define LINK_RX_BUFFER		256 // The driver wants more than the hardware FIFO's `128`.
+#define LINK_IN_FLIGHT		16 // Commands we remember the send time of, for round trips. Power of two!
+
+static char const *TAG = __FILE__;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static link_stats s_stats = {}; // Under `s_lock`.
+static int64_t s_sent_us[LINK_IN_FLIGHT]; // The link task's alone.
+static uint16_t s_sent_sequence[LINK_IN_FLIGHT];
+
+int link_parse(link_parser *p_parser, uint8_t const p_byte) {
+	switch (p_parser->state) {
+		case LINK_PARSER_SYNC_0:
+			p_parser->state = p_byte == LINK_SYNC_0 ? LINK_PARSER_SYNC_1 : LINK_PARSER_SYNC_0;
+			return 0;
+
+		case LINK_PARSER_SYNC_1:
+			p_parser->state = p_byte == LINK_SYNC_1 ? LINK_PARSER_TYPE : p_byte == LINK_SYNC_0 ? LINK_PARSER_SYNC_1 : LINK_PARSER_SYNC_0;
+			return 0;
+
+		case LINK_PARSER_TYPE:
+			p_parser->type = p_byte;
+			p_parser->state = LINK_PARSER_LENGTH;
+			return 0;
+
+		case LINK_PARSER_LENGTH:
+			p_parser->length = p_byte;
+			p_parser->index = 0;
+			p_parser->state = p_byte > LINK_MAX_PAYLOAD ? LINK_PARSER_SYNC_0 : p_byte == 0 ? LINK_PARSER_CRC_LOW : LINK_PARSER_PAYLOAD;
+			return 0;
+
+		case LINK_PARSER_PAYLOAD:
+			p_parser->payload[p_parser->index++] = p_byte;
+			p_parser->state = p_parser->index == p_parser->length ? LINK_PARSER_CRC_LOW : LINK_PARSER_PAYLOAD;
+			return 0;
+
+		case LINK_PARSER_CRC_LOW:
+			p_parser->crc = p_byte;
+			p_parser->state = LINK_PARSER_CRC_HIGH;
+			return 0;
+
+		case LINK_PARSER_CRC_HIGH: {
+			p_parser->crc |= p_byte << 8;
+			p_parser->state = LINK_PARSER_SYNC_0;
+
+			uint8_t const header[2] = { p_parser->type, p_parser->length };
+			uint16_t const crc = link_crc16(link_crc16(0xFFFF, header, 2), p_parser->payload, p_parser->length);
+			return crc == p_parser->crc ? 1 : -1;
+		}
+	}
+
+	p_parser->state = LINK_PARSER_SYNC_0;
+	return 0;
+}
+
+int link_frame(link_message const p_type, void const *p_payload, uint8_t const p_length, uint8_t *p_out) {
+	p_out[0] = LINK_SYNC_0;
+	p_out[1] = LINK_SYNC_1;
+	p_out[2] = p_type;
+	p_out[3] = p_length;
+	memcpy(p_out + 4, p_payload, p_length);
+
+	uint16_t const crc = link_crc16(0xFFFF, p_out + 2, 2 + p_length);
+	p_out[4 + p_length] = crc & 0xFF;
+	p_out[5 + p_length] = crc >> 8;
+	return LINK_FRAME_OVERHEAD + p_length;
+}
+
+static void link_on_frame(link_parser const *p_parser) {
+	if (p_parser->type != LINK_MESSAGE_TELEMETRY || p_parser->length != sizeof(link_telemetry)) {
+		return; // Newer Arduino firmware, maybe. Not an error.
+	}
+
+	link_telemetry telemetry;
+	memcpy(&telemetry, p_parser->payload, sizeof(telemetry));
+
+	int64_t const now = esp_timer_get_time();
+	int const slot = telemetry.ack & (LINK_IN_FLIGHT - 1);
+	bool const known = s_sent_sequence[slot] == telemetry.ack && s_sent_us[slot] != 0;
+	uint32_t const rtt = known ? now - s_sent_us[slot] : 0;
+
+	if (known) {
+		s_sent_us[slot] = 0; // Duplicate acks don't count twice.
+		metrics_record(METRICS_STAGE_LINK_RTT, rtt);
+	}
+
+	portENTER_CRITICAL(&s_lock);
+	s_stats.telemetry = telemetry;
+	s_stats.last_telemetry_us = now;
+	if (known) {
+		s_stats.acked++;
+		s_stats.rtt_us = rtt;
+	}
+	portEXIT_CRITICAL(&s_lock);
+}
+
+// Whatever `app_drive`'s profile is at right now.
+static void link_command_build(link_command *p_command) {
+	drive_output drive;
+	drive_get(&drive);
+
+	p_command->steer = drive.steer;
+	p_command->throttle = drive.throttle;
+	p_command->mode = g_carModeControls ? 1 : 0;
+	p_command->gear = g_carGearValue;
+}
+
+static void link_task(void *p_param) {
+	link_parser parser = {};
+	link_command command = {};
+	uint8_t rx[64];
+	uint8_t tx[LINK_FRAME_OVERHEAD + sizeof(link_command)];
+	TickType_t wake = xTaskGetTickCount();
+
+	while (true) {
+		// Whatever arrived since last time. Never waits: the send below is what keeps time.
+		for (int n; (n = uart_read_bytes(LINK_UART, rx, sizeof(rx), 0)) > 0;) {
+			for (int i = 0; i < n; i++) {
+				int const result = link_parse(&parser, rx[i]);
+
+				if (result > 0) {
+					link_on_frame(&parser);
+				} else if (result < 0) {
+					portENTER_CRITICAL(&s_lock);
+					s_stats.crc_errors++;
+					portEXIT_CRITICAL(&s_lock);
+				}
+			}
+		}
+
+		command.sequence++;
+		link_command_build(&command);
+
+		int const slot = command.sequence & (LINK_IN_FLIGHT - 1);
+		s_sent_sequence[slot] = command.sequence;
+		s_sent_us[slot] = esp_timer_get_time();
+		uart_write_bytes(LINK_UART, tx, link_frame(LINK_MESSAGE_COMMAND, &command, sizeof(command), tx));
+
+		portENTER_CRITICAL(&s_lock);
+		s_stats.sent++;
+		portEXIT_CRITICAL(&s_lock);
+
+		vTaskDelayUntil(&wake, pdMS_TO_TICKS(LINK_PERIOD_MS));
+	}
+}
+
+esp_err_t link_init() {
+#if LINK_ENABLED
+	uart_config_t const config = {
+
+		.baud_rate = LINK_BAUD,
+		.data_bits = UART_DATA_8_BITS,
+		.parity = UART_PARITY_DISABLE,
+		.stop_bits = UART_STOP_BITS_1,
+		.flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+		.rx_flow_ctrl_thresh = 0,
+		.source_clk = UART_SCLK_DEFAULT,
+
+	};
+
+	esp_err_t error = uart_driver_install(LINK_UART, LINK_RX_BUFFER, 0, 0, NULL, 0);
+	if (error == ESP_OK) {
+		error = uart_param_config(LINK_UART, &config);
+	}
+	if (error == ESP_OK) {
+		error = uart_set_pin(LINK_UART, LINK_PIN_TX, LINK_PIN_RX, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+	}
+
+	ifu(error != ESP_OK) {
+		ESP_LOGE(TAG, "Couldn't set the UART up: `%s`.", esp_err_to_name(error));
+		return error;
+	}
+
+	// Core `1`, above the vision and face tasks. A late command is the one thing here the car can feel!
+	ifu(xTaskCreatePinnedToCore(link_task, "link", 3072, NULL, 5, NULL, 1) != pdPASS) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	ESP_LOGI(TAG, "Link up at `%d` baud, a command every `%d` ms.", LINK_BAUD, LINK_PERIOD_MS);
+	return ESP_OK;
+#else
+	(void) TAG;
+	(void) link_task;
+	return ESP_OK;
+#endif
+}
+
+bool link_get(link_stats *p_out) {
+	portENTER_CRITICAL(&s_lock);
+	*p_out = s_stats;
+	portEXIT_CRITICAL(&s_lock);
+
+	return p_out->last_telemetry_us != 0 && esp_timer_get_time() - p_out->last_telemetry_us < LINK_TIMEOUT_MS * 1000LL;
+}
@@ -0,0 +1,60 @@
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+
+#include "app.h"
+#include "app_memory.hpp"
+
+static char const *TAG = __FILE__;
+
+// In `memory_user` order. Driving comes first, then seeing what's in the way, then everything else:
+static constexpr size_t s_shares[MEMORY_USER_COUNT] = {
+
+	26 * 1024, // Vision: a `driving` frame to analyze (16 KiB), and its downscaled decode (10).
+	15 * 1024, // Motion: an SVGA frame, decoded at 1/8.
+	8 * 1024, // Overlay: the HUD's text, unscaled, across an SVGA frame.
+	4 * 1024, // Trace: `TRACE_DRAIN_SIZE_INTERNAL` records for `/trace`.
+	0, // Recorder.
+	0, // Event ring.
+
+};
+
+static size_t s_taken[MEMORY_USER_COUNT];
+
+static constexpr size_t memory_shares_total() {
+	size_t total = 0;
+	for (size_t const share : s_shares) {
+		total += share;
+	}
+
+	return total;
+}
+
+static_assert(memory_shares_total() <= MEMORY_INTERNAL_BUDGET, "The shares add up to more than `MEMORY_INTERNAL_BUDGET`!");
+
+void* memory_internal_alloc(memory_user const p_user, size_t const p_size) {
+	ifu(s_taken[p_user] + p_size > s_shares[p_user]) {
+		ESP_LOGW(TAG, "`%zu` bytes would put user `%d` over its `%zu` byte share of internal RAM.", p_size, (int) p_user,
+			s_shares[p_user]);
+		return NULL;
+	}
+
+	void *pointer = heap_caps_malloc(p_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+	s_taken[p_user] += pointer == NULL ? 0 : p_size;
+	return pointer;
+}
+
+void memory_log() {
+	size_t taken = 0;
+	for (size_t const user_taken : s_taken) {
+		taken += user_taken;
+	}
+
+	size_t const free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+	size_t const largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+	ESP_LOGI(TAG, "Internal RAM: `%zu` KiB free, `%zu` KiB in one block. `%zu` of `%d` KiB budgeted for no PSRAM taken.",
+		free / 1024, largest / 1024, taken / 1024, MEMORY_INTERNAL_BUDGET / 1024);
+
+	ifu(free < MEMORY_INTERNAL_RESERVE) {
+		ESP_LOGW(TAG, "Less than `%d` KiB of internal RAM left! Expect Wi-Fi to drop frames.", MEMORY_INTERNAL_RESERVE / 1024);
+	}
+}
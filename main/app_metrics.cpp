@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_cpu.h>
+#include <esp_private/esp_clk.h>
+
+#include "app.h"
+#include "app_metrics.hpp"
+#include "app_status.hpp"
+#include "app_recorder.hpp"
+#include "app_events.hpp"
+#include "app_timelapse.hpp"
+#include "app_assets.hpp"
+#include "app_qos.hpp"
+#include "app_radio.hpp"
+
+#define METRICS_CALIBRATION_SAMPLES 1024
+
+httpd_uri_t g_uri_metrics = {
+
+		.uri = "/metrics",
+		.method = HTTP_GET,
+		.handler = metrics_handler,
+		.user_ctx = NULL,
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL,
+#endif
+
+};
+
+extern uint32_t g_httpd_internal_bytes; // From `app_httpd.cpp`.
+
+static char const *TAG = __FILE__;
+static metrics_histogram s_histograms[METRICS_STAGE_COUNT];
+static uint32_t s_record_cost_ns = 0;
+
+static char const *s_stage_names[METRICS_STAGE_COUNT] = {
+
+	"capture_wait",
+	"encode",
+	"send",
+	"end_to_end",
+	"vision",
+	"motion",
+	"face_detect",
+	"face_staleness",
+	"face_search",
+	"overlay",
+	"link_rtt",
+	"drive_settle",
+	"recorder_write",
+	"recorder_sync",
+	"timelapse_warmup",
+	"capture",
+	"control_queue",
+
+};
+
+static inline uint32_t metrics_bucket_index(uint32_t const p_value) {
+	ifu(p_value < METRICS_HISTOGRAM_SUB_BUCKETS) {
+		return p_value;
+	}
+
+	uint32_t const log2 = 31 - __builtin_clz(p_value); // Xtensa has `NSAU` for this. It's one instruction!
+	ifu(log2 > METRICS_HISTOGRAM_MAX_LOG2) {
+		return METRICS_HISTOGRAM_BUCKETS - 1;
+	}
+
+	// The bits right under the leading one pick the sub-bucket:
+	uint32_t const sub = (p_value >> (log2 - METRICS_HISTOGRAM_SUB_BUCKETS_LOG2)) & (METRICS_HISTOGRAM_SUB_BUCKETS - 1);
+	return METRICS_HISTOGRAM_SUB_BUCKETS * (log2 - METRICS_HISTOGRAM_SUB_BUCKETS_LOG2 + 1) + sub;
+}
+
+// The biggest value bucket `index` holds, in microseconds. Inclusive, like Prometheus' `le`: the next value up is the next
+// bucket's.
+static uint32_t metrics_bucket_le(uint32_t const p_index) {
+	ifu(p_index < METRICS_HISTOGRAM_SUB_BUCKETS) {
+		return p_index;
+	}
+
+	uint32_t const log2 = p_index / METRICS_HISTOGRAM_SUB_BUCKETS + METRICS_HISTOGRAM_SUB_BUCKETS_LOG2 - 1;
+	uint32_t const sub = p_index % METRICS_HISTOGRAM_SUB_BUCKETS;
+	return ((uint32_t) (METRICS_HISTOGRAM_SUB_BUCKETS + sub + 1) << (log2 - METRICS_HISTOGRAM_SUB_BUCKETS_LOG2)) - 1;
+}
+
+static inline void metrics_histogram_record(metrics_histogram *p_histogram, int64_t p_value) {
+	ifu(p_value < 0) { // Clock went weird. Don't let it wrap into the top bucket.
+		p_value = 0;
+	}
+
+	uint32_t const value = p_value > UINT32_MAX ? UINT32_MAX : (uint32_t) p_value;
+	__atomic_fetch_add(&p_histogram->buckets[metrics_bucket_index(value)], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&p_histogram->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&p_histogram->sum, value, __ATOMIC_RELAXED); // Two streams record the same stages. Wraps, see `sum`.
+}
+
+void metrics_init() {
+	// Record into a scratch histogram, with the real code path, and see how long that takes:
+	static metrics_histogram scratch;
+	uint32_t const start = esp_cpu_get_cycle_count();
+
+	for (int i = 0; i < METRICS_CALIBRATION_SAMPLES; i++) {
+		metrics_histogram_record(&scratch, i * 97); // Spread across buckets, so it's not all one cache line.
+	}
+
+	uint32_t const cycles = esp_cpu_get_cycle_count() - start;
+	uint32_t const mhz = esp_clk_cpu_freq() / 1000000;
+	s_record_cost_ns = (cycles * 1000ULL) / ((uint64_t) mhz * METRICS_CALIBRATION_SAMPLES);
+
+	ESP_LOGI(TAG, "`metrics_record()` costs ~`%lu` ns, `%d` per frame. `%zu` bytes of histograms.",
+		(unsigned long) s_record_cost_ns, METRICS_STAGE_VISION, sizeof(s_histograms));
+}
+
+void metrics_record(metrics_stage const p_stage, int64_t const p_value_us) {
+	metrics_histogram_record(&s_histograms[p_stage], p_value_us);
+}
+
+metrics_histogram const* metrics_get(metrics_stage const p_stage) {
+	return &s_histograms[p_stage];
+}
+
+uint32_t metrics_quantile(metrics_histogram const *p_histogram, float const p_q) {
+	uint32_t const count = p_histogram->count;
+
+	ifu(count == 0) {
+		return 0;
+	}
+
+	uint32_t const rank = (uint32_t) (p_q * (count - 1)) + 1;
+	uint32_t seen = 0;
+
+	for (uint32_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+		seen += p_histogram->buckets[i];
+
+		if (seen >= rank) {
+			return metrics_bucket_le(i);
+		}
+	}
+
+	return metrics_bucket_le(METRICS_HISTOGRAM_BUCKETS - 1);
+}
+
+// Prometheus text format. One histogram family, `frame_stage_latency_us`, with a `stage` label. Empty buckets are skipped
+// (they're cumulative, so that's allowed), and the quantiles are precomputed for anyone reading this with `curl`.
+esp_err_t metrics_handler(httpd_req_t *p_request) {
+	char line[128];
+	int len;
+	esp_err_t res = ESP_OK;
+
+	httpd_resp_set_type(p_request, "text/plain; version=0.0.4");
+	httpd_resp_set_hdr(p_request, "Access-Control-Allow-Origin", "*");
+
+#define METRICS_SEND(...) do { \
+		len = snprintf(line, sizeof(line), __VA_ARGS__); \
+		ifl(res == ESP_OK) { \
+			res = httpd_resp_send_chunk(p_request, line, len); \
+		} \
+	} while (false)
+
+	METRICS_SEND("# HELP frame_stage_latency_us Per-stage latency of streamed frames, in microseconds.\n");
+	METRICS_SEND("# TYPE frame_stage_latency_us histogram\n");
+
+	for (int s = 0; s < METRICS_STAGE_COUNT; s++) {
+		// Copy first, so the buckets, `_count` and quantiles at least agree with *each other*:
+		metrics_histogram snapshot;
+		memcpy(&snapshot, &s_histograms[s], sizeof(snapshot));
+
+		uint32_t cumulative = 0;
+		for (uint32_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+			if (snapshot.buckets[i] == 0) {
+				continue;
+			}
+
+			cumulative += snapshot.buckets[i];
+			METRICS_SEND("frame_stage_latency_us_bucket{stage=\"%s\",le=\"%lu\"} %lu\n",
+				s_stage_names[s], (unsigned long) metrics_bucket_le(i), (unsigned long) cumulative);
+		}
+
+		METRICS_SEND("frame_stage_latency_us_bucket{stage=\"%s\",le=\"+Inf\"} %lu\n", s_stage_names[s], (unsigned long) cumulative);
+		METRICS_SEND("frame_stage_latency_us_sum{stage=\"%s\"} %lu\n", s_stage_names[s], (unsigned long) snapshot.sum);
+		METRICS_SEND("frame_stage_latency_us_count{stage=\"%s\"} %lu\n", s_stage_names[s], (unsigned long) cumulative);
+	}
+
+	METRICS_SEND("# HELP frame_stage_latency_quantile_us Biggest value in the bucket holding the quantile.\n");
+	METRICS_SEND("# TYPE frame_stage_latency_quantile_us gauge\n");
+
+	static float const quantiles[] = { 0.5F, 0.95F, 0.99F };
+	for (int s = 0; s < METRICS_STAGE_COUNT; s++) {
+		for (float const q : quantiles) {
+			METRICS_SEND("frame_stage_latency_quantile_us{stage=\"%s\",quantile=\"%.2f\"} %lu\n",
+				s_stage_names[s], q, (unsigned long) metrics_quantile(&s_histograms[s], q));
+		}
+	}
+
+	METRICS_SEND("# HELP stream_frames_total Frames streamed, by what happened to them.\n");
+	METRICS_SEND("# TYPE stream_frames_total counter\n");
+	METRICS_SEND("stream_frames_total{outcome=\"sent\"} %lu\n", (unsigned long) g_stream_stats.frames);
+	METRICS_SEND("stream_frames_total{outcome=\"suppressed\"} %lu\n", (unsigned long) g_stream_stats.suppressed);
+
+	uint32_t const frame_ms = g_stream_stats.frame_ms;
+	METRICS_SEND("# HELP stream_fps Frame rate of the stream, from the last frame interval.\n");
+	METRICS_SEND("# TYPE stream_fps gauge\n");
+	METRICS_SEND("stream_fps %.1f\n", frame_ms == 0 ? 0.0 : 1000.0 / frame_ms);
+
+	METRICS_SEND("# HELP stream_frame_bytes Size of the last frame sent, JPEG only.\n");
+	METRICS_SEND("# TYPE stream_frame_bytes gauge\n");
+	METRICS_SEND("stream_frame_bytes %lu\n", (unsigned long) g_stream_stats.frame_bytes);
+	METRICS_SEND("# HELP stream_header_bytes Size of the last part header sent, metadata included.\n");
+	METRICS_SEND("# TYPE stream_header_bytes gauge\n");
+	METRICS_SEND("stream_header_bytes %lu\n", (unsigned long) g_stream_stats.header_bytes);
+
+	recorder_stats recorder;
+	recorder_get(&recorder);
+	METRICS_SEND("# HELP recorder_frames_total Frames offered to the recorder, by what happened to them.\n");
+	METRICS_SEND("# TYPE recorder_frames_total counter\n");
+	METRICS_SEND("recorder_frames_total{outcome=\"written\"} %lu\n", (unsigned long) recorder.frames);
+	METRICS_SEND("recorder_frames_total{outcome=\"dropped\"} %lu\n", (unsigned long) recorder.dropped);
+	METRICS_SEND("# HELP recorder_ring_bytes Bytes waiting in the recorder's ring for the card.\n");
+	METRICS_SEND("# TYPE recorder_ring_bytes gauge\n");
+	METRICS_SEND("recorder_ring_bytes %lu\n", (unsigned long) recorder.ring_used);
+
+	events_stats events;
+	events_get(&events);
+	METRICS_SEND("# HELP events_ring_bytes Bytes of frames in the pre-event ring.\n");
+	METRICS_SEND("# TYPE events_ring_bytes gauge\n");
+	METRICS_SEND("events_ring_bytes %lu\n", (unsigned long) events.ring_used);
+	METRICS_SEND("# HELP events_ring_seconds Time from the oldest frame in the pre-event ring to the newest.\n");
+	METRICS_SEND("# TYPE events_ring_seconds gauge\n");
+	METRICS_SEND("events_ring_seconds %.2f\n", events.ring_ms / 1000.0);
+	METRICS_SEND("# HELP events_frames_total Frames that left the pre-event ring unflushed, or never got in.\n");
+	METRICS_SEND("# TYPE events_frames_total counter\n");
+	METRICS_SEND("events_frames_total{outcome=\"evicted\"} %lu\n", (unsigned long) events.evicted);
+	METRICS_SEND("events_frames_total{outcome=\"dropped\"} %lu\n", (unsigned long) events.dropped);
+	METRICS_SEND("# HELP events_clips_total Event clips written to the card.\n");
+	METRICS_SEND("# TYPE events_clips_total counter\n");
+	METRICS_SEND("events_clips_total %lu\n", (unsigned long) events.clips);
+	METRICS_SEND("# HELP events_flushed_bytes_total Bytes of frames flushed into event clips.\n");
+	METRICS_SEND("# TYPE events_flushed_bytes_total counter\n");
+	METRICS_SEND("events_flushed_bytes_total %llu\n", events.flushed_bytes);
+	METRICS_SEND("# HELP events_flush_bytes_per_second Write throughput of the last clip, waits for frames left out.\n");
+	METRICS_SEND("# TYPE events_flush_bytes_per_second gauge\n");
+	METRICS_SEND("events_flush_bytes_per_second %lu\n", (unsigned long) events.flush_bytes_per_s);
+
+	timelapse_stats timelapse;
+	timelapse_get(&timelapse);
+	METRICS_SEND("# HELP timelapse_awake_ratio Share of the time the sensor's been clocked and powered, since time-lapse went on.\n");
+	METRICS_SEND("# TYPE timelapse_awake_ratio gauge\n");
+	METRICS_SEND("timelapse_awake_ratio %.4f\n", timelapse.elapsed_us == 0 ? 0.0 : (double) timelapse.awake_us / timelapse.elapsed_us);
+	METRICS_SEND("# HELP timelapse_awake_us_per_frame Sensor awake time per time-lapse frame. A proxy for its average current.\n");
+	METRICS_SEND("# TYPE timelapse_awake_us_per_frame gauge\n");
+	METRICS_SEND("timelapse_awake_us_per_frame %llu\n", timelapse.frames == 0 ? 0ULL : timelapse.awake_us / timelapse.frames);
+
+	METRICS_SEND("# HELP httpd_internal_bytes Internal RAM the HTTP servers took to start, their handlers' own allocations included.\n");
+	METRICS_SEND("# TYPE httpd_internal_bytes gauge\n");
+	METRICS_SEND("httpd_internal_bytes %lu\n", (unsigned long) g_httpd_internal_bytes);
+
+	assets_stats assets;
+	assets_get(&assets);
+	METRICS_SEND("# HELP assets_responses_total Web UI files served, whole or as a `304`.\n");
+	METRICS_SEND("# TYPE assets_responses_total counter\n");
+	METRICS_SEND("assets_responses_total{status=\"200\"} %lu\n", (unsigned long) assets.sent);
+	METRICS_SEND("assets_responses_total{status=\"304\"} %lu\n", (unsigned long) assets.not_modified);
+	METRICS_SEND("# HELP assets_saved_bytes_total Bytes the `304`s didn't have to send.\n");
+	METRICS_SEND("# TYPE assets_saved_bytes_total counter\n");
+	METRICS_SEND("assets_saved_bytes_total %llu\n", assets.bytes_saved);
+
+	qos_stats qos;
+	qos_get(&qos);
+	METRICS_SEND("# HELP stream_throttle_ms What the stream waits between frames, to keep control responses from queueing behind it.\n");
+	METRICS_SEND("# TYPE stream_throttle_ms gauge\n");
+	METRICS_SEND("stream_throttle_ms %lu\n", (unsigned long) qos.throttle_ms);
+	METRICS_SEND("# HELP stream_throttled_frames_total Frames the stream waited after, for someone steering.\n");
+	METRICS_SEND("# TYPE stream_throttled_frames_total counter\n");
+	METRICS_SEND("stream_throttled_frames_total %lu\n", (unsigned long) qos.throttled_frames);
+
+	radio_stats radio;
+	radio_get(&radio);
+	METRICS_SEND("# HELP wifi_rssi_dbm Signal strength of the access point, last sampled. `0` when not associated.\n");
+	METRICS_SEND("# TYPE wifi_rssi_dbm gauge\n");
+	METRICS_SEND("wifi_rssi_dbm %d\n", radio.rssi);
+	METRICS_SEND("# HELP wifi_predicted_kbps TCP throughput the link should manage a little from now.\n");
+	METRICS_SEND("# TYPE wifi_predicted_kbps gauge\n");
+	METRICS_SEND("wifi_predicted_kbps %lu\n", (unsigned long) radio.predicted_kbps);
+	METRICS_SEND("# HELP wifi_goodput_kbps What the stream got through lately, when it was pushing the link. `0` if it wasn't.\n");
+	METRICS_SEND("# TYPE wifi_goodput_kbps gauge\n");
+	METRICS_SEND("wifi_goodput_kbps %lu\n", (unsigned long) radio.goodput_kbps);
+	METRICS_SEND("# HELP stream_framesize Frame size (a `framesize_t`) the stream gets, and the one that was picked.\n");
+	METRICS_SEND("# TYPE stream_framesize gauge\n");
+	METRICS_SEND("stream_framesize{size=\"governed\"} %d\n", (int) radio.framesize);
+	METRICS_SEND("stream_framesize{size=\"wanted\"} %d\n", (int) radio.wanted);
+	METRICS_SEND("# HELP stream_frame_interval_ms Least time between frames, when even the smallest size is too much for the link.\n");
+	METRICS_SEND("# TYPE stream_frame_interval_ms gauge\n");
+	METRICS_SEND("stream_frame_interval_ms %lu\n", (unsigned long) radio.interval_ms);
+	METRICS_SEND("# HELP stream_framesize_changes_total Frame size steps the link governor took.\n");
+	METRICS_SEND("# TYPE stream_framesize_changes_total counter\n");
+	METRICS_SEND("stream_framesize_changes_total{direction=\"down\"} %lu\n", (unsigned long) radio.steps_down);
+	METRICS_SEND("stream_framesize_changes_total{direction=\"up\"} %lu\n", (unsigned long) radio.steps_up);
+
+	METRICS_SEND("# HELP metrics_record_cost_ns Measured cost of one histogram update.\n");
+	METRICS_SEND("# TYPE metrics_record_cost_ns gauge\n");
+	METRICS_SEND("metrics_record_cost_ns %lu\n", (unsigned long) s_record_cost_ns);
+
+#undef METRICS_SEND
+
+	ifu(res != ESP_OK) {
+		return res;
+	}
+
+	return httpd_resp_send_chunk(p_request, NULL, 0);
+}
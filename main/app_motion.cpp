@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <img_converters.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "app.h"
+#include "app_motion.hpp"
+#include "app_metrics.hpp"
+#include "app_decode.hpp"
+#include "app_memory.hpp"
+
+#define MOTION_DECODE_MAX_WIDTH		200 // UXGA at 1/8.
+#define MOTION_DECODE_MAX_HEIGHT	150
+#define MOTION_DECODE_MAX_WIDTH_INTERNAL	100 // SVGA at 1/8. Without PSRAM, `60` KiB of internal RAM for UXGA is too much to ask.
+#define MOTION_DECODE_MAX_HEIGHT_INTERNAL	75
+#define MOTION_BLOCK_THRESHOLD		4 // Mean absolute difference (7-bit luma) per pixel for a block to count as changed.
+#define MOTION_WORDS_PER_ROW		(MOTION_WIDTH / 4)
+
+httpd_uri_t g_uri_motion = {
+
+		.uri = "/motion",
+		.method = HTTP_GET,
+		.handler = motion_handler,
+		.user_ctx = NULL,
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL,
+#endif
+
+};
+
+static char const *TAG = __FILE__;
+static SemaphoreHandle_t s_lock = NULL;
+static motion_result s_result = {};
+
+// Held under `s_lock`:
+static uint8_t *s_rgb = NULL;
+static int s_decode_max_width = MOTION_DECODE_MAX_WIDTH;
+static int s_decode_max_height = MOTION_DECODE_MAX_HEIGHT;
+static uint32_t s_thumbnails[2][MOTION_HEIGHT * MOTION_WORDS_PER_ROW];
+static uint32_t *s_current = s_thumbnails[0];
+static uint32_t *s_previous = s_thumbnails[1];
+static bool s_has_previous = false;
+static uint16_t s_previous_width = 0;
+static uint16_t s_previous_height = 0;
+static int64_t s_previous_frame_us = 0;
+static bool s_warned_size = false;
+
+// Per byte: `|a - b|`, for four 7-bit values at once. Bit 7 of every byte is free, so `a | 0x80` can never borrow from
+// its neighbour, and what comes out is `a - b` as a signed byte. Negating only the negative bytes then gives the absolute
+// value. No carries anywhere, since every result fits in 7 bits. Xtensa LX6 has no packed SIMD, so this is as close as it gets!
+static inline uint32_t motion_absdiff_x4(uint32_t const p_a, uint32_t const p_b) {
+	uint32_t const diff = ((p_a | 0x80808080) - p_b) ^ 0x80808080;
+	uint32_t const negative = (diff >> 7) & 0x01010101;
+	return (diff ^ (negative * 0xFF)) + negative;
+}
+
+// Box-filters the 1/8-scale decode down to the thumbnail. QVGA decodes to exactly 40x30, so then this is just a copy.
+static void motion_thumbnail(uint16_t const *p_rgb, int const p_width, int const p_height, uint32_t *p_out) {
+	uint8_t *out = (uint8_t*) p_out;
+
+	for (int ty = 0; ty < MOTION_HEIGHT; ty++) {
+		int const y0 = ty * p_height / MOTION_HEIGHT;
+		int const y1 = y0 + 1 > (ty + 1) * p_height / MOTION_HEIGHT ? y0 + 1 : (ty + 1) * p_height / MOTION_HEIGHT; // Upscales too.
+
+		for (int tx = 0; tx < MOTION_WIDTH; tx++) {
+			int const x0 = tx * p_width / MOTION_WIDTH;
+			int const x1 = x0 + 1 > (tx + 1) * p_width / MOTION_WIDTH ? x0 + 1 : (tx + 1) * p_width / MOTION_WIDTH;
+
+			uint32_t sum = 0;
+			for (int y = y0; y < y1; y++) {
+				for (int x = x0; x < x1; x++) {
+					uint16_t const pixel = p_rgb[y * p_width + x];
+					sum += (((pixel >> 8) & 0xF8) * 77 + ((pixel >> 3) & 0xFC) * 150 + ((pixel << 3) & 0xF8) * 29) >> 8;
+				}
+			}
+
+			out[ty * MOTION_WIDTH + tx] = (sum / ((y1 - y0) * (x1 - x0))) >> 1; // 7 bits, for `motion_absdiff_x4()`.
+		}
+	}
+}
+
+esp_err_t motion_init() {
+	s_lock = xSemaphoreCreateMutex();
+	s_rgb = (uint8_t*) heap_caps_malloc(MOTION_DECODE_MAX_WIDTH * MOTION_DECODE_MAX_HEIGHT * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+	ifu(s_rgb == NULL) { // No PSRAM. Smaller frames only, then.
+		s_decode_max_width = MOTION_DECODE_MAX_WIDTH_INTERNAL;
+		s_decode_max_height = MOTION_DECODE_MAX_HEIGHT_INTERNAL;
+		s_rgb = (uint8_t*) memory_internal_alloc(MEMORY_USER_MOTION, s_decode_max_width * s_decode_max_height * 2);
+	}
+
+	ifu(s_lock == NULL || s_rgb == NULL) {
+		ESP_LOGE(TAG, "No memory for motion detection!");
+		return ESP_ERR_NO_MEM;
+	}
+
+	return ESP_OK;
+}
+
+bool motion_update(camera_fb_t const *p_fb, motion_result *p_out) {
+	ifu(s_lock == NULL || p_fb->format != PIXFORMAT_JPEG) {
+		return false;
+	}
+
+	// Whoever's already comparing a frame is comparing one just as fresh. No point waiting for them:
+	ifu(xSemaphoreTake(s_lock, 0) != pdTRUE) {
+		ifl(p_out != NULL) {
+			motion_get(p_out);
+		}
+
+		return false;
+	}
+
+	int64_t const start = esp_timer_get_time();
+	int64_t const frame_us = p_fb->timestamp.tv_sec * 1000000LL + p_fb->timestamp.tv_usec;
+	int const width = p_fb->width >> JPG_SCALE_8X;
+	int const height = p_fb->height >> JPG_SCALE_8X;
+	bool compared = false;
+
+	if (frame_us == s_previous_frame_us) {
+		// Same frame, handed in twice (stream *and* recorder, say). Nothing changed, by definition.
+	} else if (width > s_decode_max_width || height > s_decode_max_height) {
+		if (!s_warned_size) {
+			ESP_LOGW(TAG, "Frames of `%ux%u` are too big to compare!", p_fb->width, p_fb->height);
+			s_warned_size = true;
+		}
+	} else if (!decode_jpg2rgb565(p_fb->buf, p_fb->len, s_rgb, JPG_SCALE_8X)) {
+		ESP_LOGW(TAG, "JPEG decode failed.");
+	} else {
+		motion_thumbnail((uint16_t const*) s_rgb, width, height, s_current);
+
+		// A new frame size means a different field of view, probably. Don't compare those!:
+		compared = s_has_previous && p_fb->width == s_previous_width && p_fb->height == s_previous_height;
+
+		if (compared) {
+			uint32_t bitmap = 0;
+			uint32_t total = 0;
+
+			for (int by = 0; by < MOTION_BLOCKS_Y; by++) {
+				for (int bx = 0; bx < MOTION_BLOCKS_X; bx++) {
+					// Two 16-bit lanes. `12` words of at most `4 * 127`, split across two lanes, can't overflow either:
+					uint32_t lanes = 0;
+
+					for (int y = by * MOTION_BLOCK_HEIGHT; y < (by + 1) * MOTION_BLOCK_HEIGHT; y++) {
+						int const word = y * MOTION_WORDS_PER_ROW + bx * (MOTION_BLOCK_WIDTH / 4);
+						uint32_t const d0 = motion_absdiff_x4(s_current[word], s_previous[word]);
+						uint32_t const d1 = motion_absdiff_x4(s_current[word + 1], s_previous[word + 1]);
+						lanes += (d0 & 0x00FF00FF) + ((d0 >> 8) & 0x00FF00FF);
+						lanes += (d1 & 0x00FF00FF) + ((d1 >> 8) & 0x00FF00FF);
+					}
+
+					uint32_t const sad = (lanes & 0xFFFF) + (lanes >> 16);
+					total += sad;
+
+					if (sad >= MOTION_BLOCK_THRESHOLD * MOTION_BLOCK_WIDTH * MOTION_BLOCK_HEIGHT) {
+						bitmap |= 1UL << (by * MOTION_BLOCKS_X + bx);
+					}
+				}
+			}
+
+			s_result.sequence++;
+			s_result.frame_us = frame_us;
+			s_result.bitmap = bitmap;
+			s_result.blocks = __builtin_popcount(bitmap);
+			s_result.energy = (uint16_t) ((total * 1000ULL) / (MOTION_WIDTH * MOTION_HEIGHT * 127));
+			s_result.compute_us = esp_timer_get_time() - start;
+			metrics_record(METRICS_STAGE_MOTION, s_result.compute_us);
+		}
+
+		uint32_t *swap = s_previous;
+		s_previous = s_current;
+		s_current = swap;
+
+		s_has_previous = true;
+		s_previous_width = p_fb->width;
+		s_previous_height = p_fb->height;
+		s_previous_frame_us = frame_us;
+	}
+
+	ifl(p_out != NULL) {
+		*p_out = s_result;
+	}
+
+	xSemaphoreGive(s_lock);
+	return compared;
+}
+
+bool motion_skip_frame(motion_skip const *p_skip, bool const p_compared, motion_result const *p_motion, size_t const p_len,
+	int64_t const p_now_us) {
+	bool const unchanged = p_skip->keepalive_ms > 0 && p_compared && p_motion->blocks == 0
+		&& (size_t) labs((long) p_len - (long) p_skip->last_sent_len) * 100 <= p_skip->last_sent_len * MOTION_SKIP_LENGTH_PERCENT;
+	return unchanged && p_now_us - p_skip->last_sent_us < p_skip->keepalive_ms * 1000LL;
+}
+
+void motion_skip_sent(motion_skip *p_skip, size_t const p_len, int64_t const p_now_us) {
+	p_skip->last_sent_us = p_now_us;
+	p_skip->last_sent_len = p_len;
+}
+
+bool motion_get(motion_result *p_out) {
+	ifu(s_lock == NULL) {
+		return false;
+	}
+
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	*p_out = s_result;
+	xSemaphoreGive(s_lock);
+
+	return p_out->sequence > 0;
+}
+
+esp_err_t motion_handler(httpd_req_t *p_request) {
+	motion_result result = {};
+	motion_get(&result);
+
+	char str_query[16];
+	char param_value_map[2];
+	bool const map = httpd_req_get_url_query_str(p_request, str_query, sizeof(str_query)) == ESP_OK
+		&& httpd_query_key_value(str_query, "map", param_value_map, sizeof(param_value_map)) == ESP_OK
+		&& param_value_map[0] == '1';
+
+	char json[256];
+	int len = snprintf(json, sizeof(json), "{\"seq\":%lu,\"frame_us\":%lld,\"bitmap\":%lu,\"blocks\":%u,\"energy\":%u,\"compute_us\":%lu",
+		(unsigned long) result.sequence, result.frame_us, (unsigned long) result.bitmap, result.blocks, result.energy,
+		(unsigned long) result.compute_us);
+
+	if (map) {
+		len += snprintf(json + len, sizeof(json) - len, ",\"map\":[");
+
+		for (int by = 0; by < MOTION_BLOCKS_Y; by++) {
+			char row[MOTION_BLOCKS_X + 1];
+			for (int bx = 0; bx < MOTION_BLOCKS_X; bx++) {
+				row[bx] = result.bitmap & (1UL << (by * MOTION_BLOCKS_X + bx)) ? '#' : '.';
+			}
+
+			row[MOTION_BLOCKS_X] = '\0';
+			len += snprintf(json + len, sizeof(json) - len, "%s\"%s\"", by == 0 ? "" : ",", row);
+		}
+
+		len += snprintf(json + len, sizeof(json) - len, "]");
+	}
+
+	len += snprintf(json + len, sizeof(json) - len, "}");
+
+	httpd_resp_set_type(p_request, "application/json");
+	httpd_resp_set_hdr(p_request, "Access-Control-Allow-Origin", "*");
+	return httpd_resp_send(p_request, json, len);
+}
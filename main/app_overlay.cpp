@@ -0,0 +1,1040 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <img_converters.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "app.h"
+#include "app_boot.hpp"
+#include "app_overlay.hpp"
+#include "app_metrics.hpp"
+#include "app_controls.hpp"
+#include "app_timelapse.hpp"
+#include "app_decode.hpp"
+#include "app_memory.hpp"
+
+#define OVERLAY_MAX_COMPONENTS	3
+#define OVERLAY_MAX_SAMPLING	2 // Per component, per axis. Covers 4:2:2 and 4:2:0.
+#define OVERLAY_LOOKUP_BITS		9 // Huffman codes this short get decoded with one table lookup. Most of them are.
+#define OVERLAY_HUD_MAX_SCALE	5 // UXGA is `1600 / 320`.
+#define OVERLAY_HUD_MAX_WIDTH	1600
+#define OVERLAY_HUD_MAX_HEIGHT	(10 * OVERLAY_HUD_MAX_SCALE)
+#define OVERLAY_HUD_MAX_SCALE_INTERNAL	1 // Without PSRAM. Small print at SVGA, for half `app_memory`'s share of `2`.
+#define OVERLAY_HUD_MAX_WIDTH_INTERNAL	800
+
+struct overlay_decoder {
+
+	uint16_t lookup[1 << OVERLAY_LOOKUP_BITS]; // `length << 8 | symbol`. `0` means "longer code".
+	int32_t max_code[17]; // `-1` if there are no codes of that length.
+	int32_t first_code[17];
+	uint8_t first_index[17];
+	uint8_t symbols[256];
+
+};
+
+struct overlay_encoder {
+
+	uint16_t codes[256];
+	uint8_t lengths[256]; // `0` if the table doesn't have that symbol at all.
+
+};
+
+struct overlay_component {
+
+	uint8_t id;
+	uint8_t h;
+	uint8_t v;
+	uint8_t quant;
+	uint8_t dc;
+	uint8_t ac;
+	int dc_in; // DC predictors: the original one, and the one for what we write.
+	int dc_out;
+
+};
+
+// Everything for one `overlay_jpeg()` call. ~9 KB, so it's static, and under `s_lock`.
+struct overlay_state {
+
+	uint16_t quant[4][64]; // Zigzag order, same as the coefficients.
+	overlay_decoder decoders[2][4]; // `[DC/AC][table]`.
+	overlay_encoder encoders[2][4];
+	overlay_component components[OVERLAY_MAX_COMPONENTS];
+	int component_count;
+	int width;
+	int height;
+	int h_max;
+	int v_max;
+	uint8_t palette[OVERLAY_PALETTE_SIZE][OVERLAY_MAX_COMPONENTS]; // The canvas's, in YCbCr.
+
+	// Reading. `in_bits` is MSB-first. Past a marker, zeroes get fed in, and counted in `in_fake`:
+	uint8_t const *in;
+	size_t in_pos;
+	size_t in_end;
+	uint32_t in_bits;
+	int in_count;
+	int in_fake;
+	size_t in_consumed; // Bits, not counting stuffing.
+	bool error;
+
+	// Writing:
+	uint8_t *out;
+	size_t out_len;
+	size_t out_capacity;
+	uint32_t out_bits;
+	int out_count;
+
+};
+
+// `zigzag[i]` is where the `i`th coefficient goes in natural (row-major) order.
+static uint8_t const s_zigzag[64] = {
+	0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55,
+	62, 63,
+};
+
+// Classic 5x7 font, `' '` to `'_'`. One byte per column, LSB at the top.
+static uint8_t const s_font[64][5] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5F, 0x00, 0x00 }, { 0x00, 0x07, 0x00, 0x07, 0x00 },
+	{ 0x14, 0x7F, 0x14, 0x7F, 0x14 }, { 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 },
+	{ 0x36, 0x49, 0x56, 0x20, 0x50 }, { 0x00, 0x08, 0x07, 0x03, 0x00 }, { 0x00, 0x1C, 0x22, 0x41, 0x00 },
+	{ 0x00, 0x41, 0x22, 0x1C, 0x00 }, { 0x2A, 0x1C, 0x7F, 0x1C, 0x2A }, { 0x08, 0x08, 0x3E, 0x08, 0x08 },
+	{ 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x00, 0x60, 0x60, 0x00, 0x00 },
+	{ 0x20, 0x10, 0x08, 0x04, 0x02 }, { 0x3E, 0x51, 0x49, 0x45, 0x3E }, { 0x00, 0x42, 0x7F, 0x40, 0x00 },
+	{ 0x72, 0x49, 0x49, 0x49, 0x46 }, { 0x21, 0x41, 0x49, 0x4D, 0x33 }, { 0x18, 0x14, 0x12, 0x7F, 0x10 },
+	{ 0x27, 0x45, 0x45, 0x45, 0x39 }, { 0x3C, 0x4A, 0x49, 0x49, 0x31 }, { 0x41, 0x21, 0x11, 0x09, 0x07 },
+	{ 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x46, 0x49, 0x49, 0x29, 0x1E }, { 0x00, 0x00, 0x14, 0x00, 0x00 },
+	{ 0x00, 0x40, 0x34, 0x00, 0x00 }, { 0x00, 0x08, 0x14, 0x22, 0x41 }, { 0x14, 0x14, 0x14, 0x14, 0x14 },
+	{ 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x59, 0x09, 0x06 }, { 0x3E, 0x41, 0x5D, 0x59, 0x4E },
+	{ 0x7C, 0x12, 0x11, 0x12, 0x7C }, { 0x7F, 0x49, 0x49, 0x49, 0x36 }, { 0x3E, 0x41, 0x41, 0x41, 0x22 },
+	{ 0x7F, 0x41, 0x41, 0x41, 0x3E }, { 0x7F, 0x49, 0x49, 0x49, 0x41 }, { 0x7F, 0x09, 0x09, 0x09, 0x01 },
+	{ 0x3E, 0x41, 0x41, 0x51, 0x73 }, { 0x7F, 0x08, 0x08, 0x08, 0x7F }, { 0x00, 0x41, 0x7F, 0x41, 0x00 },
+	{ 0x20, 0x40, 0x41, 0x3F, 0x01 }, { 0x7F, 0x08, 0x14, 0x22, 0x41 }, { 0x7F, 0x40, 0x40, 0x40, 0x40 },
+	{ 0x7F, 0x02, 0x1C, 0x02, 0x7F }, { 0x7F, 0x04, 0x08, 0x10, 0x7F }, { 0x3E, 0x41, 0x41, 0x41, 0x3E },
+	{ 0x7F, 0x09, 0x09, 0x09, 0x06 }, { 0x3E, 0x41, 0x51, 0x21, 0x5E }, { 0x7F, 0x09, 0x19, 0x29, 0x46 },
+	{ 0x26, 0x49, 0x49, 0x49, 0x32 }, { 0x03, 0x01, 0x7F, 0x01, 0x03 }, { 0x3F, 0x40, 0x40, 0x40, 0x3F },
+	{ 0x1F, 0x20, 0x40, 0x20, 0x1F }, { 0x3F, 0x40, 0x38, 0x40, 0x3F }, { 0x63, 0x14, 0x08, 0x14, 0x63 },
+	{ 0x03, 0x04, 0x78, 0x04, 0x03 }, { 0x61, 0x59, 0x49, 0x4D, 0x43 }, { 0x00, 0x7F, 0x41, 0x41, 0x41 },
+	{ 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x41, 0x7F }, { 0x04, 0x02, 0x01, 0x02, 0x04 },
+	{ 0x40, 0x40, 0x40, 0x40, 0x40 },
+};
+
+httpd_uri_t g_uri_overlay = {
+
+		.uri = "/overlay",
+		.method = HTTP_GET,
+		.handler = overlay_handler,
+		.user_ctx = NULL,
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL,
+#endif
+
+};
+
+static char const *TAG = __FILE__;
+static SemaphoreHandle_t s_lock = NULL;
+static overlay_state s_state; // Under `s_lock`.
+static float s_cosines[8][8]; // `C(u) / 2 * cos((2x + 1) * u * pi / 16)`, `[x][u]`.
+static SemaphoreHandle_t s_hud_lock = NULL;
+static uint8_t *s_hud_pixels = NULL; // `overlay_hud()`'s canvas, under `s_hud_lock`.
+static int s_hud_max_scale = OVERLAY_HUD_MAX_SCALE;
+static int s_hud_max_width = OVERLAY_HUD_MAX_WIDTH;
+
+#pragma region Bits.
+static inline void overlay_fill_bits(overlay_state *p_state) {
+	while (p_state->in_count <= 24) {
+		uint32_t byte = 0;
+
+		if (p_state->in_pos >= p_state->in_end) {
+			p_state->in_fake += 8;
+		} else if (p_state->in[p_state->in_pos] != 0xFF) {
+			byte = p_state->in[p_state->in_pos++];
+		} else if (p_state->in_pos + 1 < p_state->in_end && p_state->in[p_state->in_pos + 1] == 0x00) {
+			byte = 0xFF;
+			p_state->in_pos += 2;
+		} else {
+			p_state->in_fake += 8; // A marker. Don't go past it!
+		}
+
+		p_state->in_bits |= byte << (24 - p_state->in_count);
+		p_state->in_count += 8;
+	}
+}
+
+static inline uint32_t overlay_peek(overlay_state *p_state, int const p_count) {
+	return p_state->in_bits >> (32 - p_count);
+}
+
+static inline void overlay_skip(overlay_state *p_state, int const p_count) {
+	p_state->in_bits <<= p_count;
+	p_state->in_count -= p_count;
+	p_state->in_consumed += p_count;
+}
+
+// Reads `p_count` bits (up to `16`), sign-extended the JPEG way.
+static inline int overlay_receive(overlay_state *p_state, int const p_count) {
+	if (p_count == 0) {
+		return 0;
+	}
+
+	overlay_fill_bits(p_state);
+	int value = overlay_peek(p_state, p_count);
+	overlay_skip(p_state, p_count);
+	return value < (1 << (p_count - 1)) ? value - (1 << p_count) + 1 : value;
+}
+
+static inline int overlay_decode(overlay_state *p_state, overlay_decoder const *p_decoder) {
+	overlay_fill_bits(p_state);
+	uint16_t const entry = p_decoder->lookup[overlay_peek(p_state, OVERLAY_LOOKUP_BITS)];
+
+	ifl(entry != 0) {
+		overlay_skip(p_state, entry >> 8);
+		return entry & 0xFF;
+	}
+
+	for (int length = OVERLAY_LOOKUP_BITS + 1; length <= 16; length++) {
+		int32_t const code = overlay_peek(p_state, length);
+
+		if (code <= p_decoder->max_code[length]) {
+			overlay_skip(p_state, length);
+			return p_decoder->symbols[p_decoder->first_index[length] + code - p_decoder->first_code[length]];
+		}
+	}
+
+	p_state->error = true;
+	return 0;
+}
+
+static inline void overlay_put(overlay_state *p_state, uint32_t const p_bits, int const p_count) {
+	p_state->out_bits = (p_state->out_bits << p_count) | (p_bits & ((1UL << p_count) - 1));
+	p_state->out_count += p_count;
+
+	while (p_state->out_count >= 8) {
+		p_state->out_count -= 8;
+		uint8_t const byte = p_state->out_bits >> p_state->out_count;
+
+		ifu(p_state->out_len + 2 > p_state->out_capacity) {
+			p_state->error = true;
+			return;
+		}
+
+		p_state->out[p_state->out_len++] = byte;
+		if (byte == 0xFF) {
+			p_state->out[p_state->out_len++] = 0x00; // Byte stuffing.
+		}
+	}
+}
+
+static inline bool overlay_put_symbol(overlay_state *p_state, overlay_encoder const *p_encoder, uint8_t const p_symbol) {
+	ifu(p_encoder->lengths[p_symbol] == 0) {
+		p_state->error = true; // The sensor's tables never needed it, so they don't have it.
+		return false;
+	}
+
+	overlay_put(p_state, p_encoder->codes[p_symbol], p_encoder->lengths[p_symbol]);
+	return true;
+}
+#pragma endregion
+
+#pragma region Blocks.
+// One block's coefficients, zigzag order. The DC one comes out absolute, not as a difference.
+static void overlay_read_block(overlay_state *p_state, overlay_component *p_component, int16_t *p_coefficients) {
+	memset(p_coefficients, 0, 64 * sizeof(int16_t));
+
+	int const size = overlay_decode(p_state, &p_state->decoders[0][p_component->dc]);
+	p_component->dc_in += overlay_receive(p_state, size);
+	p_coefficients[0] = p_component->dc_in;
+
+	overlay_decoder const *ac = &p_state->decoders[1][p_component->ac];
+	for (int k = 1; k < 64 && !p_state->error;) {
+		int const symbol = overlay_decode(p_state, ac);
+		int const run = symbol >> 4;
+		int const bits = symbol & 0x0F;
+
+		if (bits == 0) {
+			if (run != 15) {
+				break; // End of block.
+			}
+
+			k += 16;
+			continue;
+		}
+
+		k += run;
+		ifu(k > 63) {
+			p_state->error = true;
+			break;
+		}
+
+		p_coefficients[k++] = overlay_receive(p_state, bits);
+	}
+}
+
+static inline int overlay_bit_size(int p_value) {
+	p_value = p_value < 0 ? -p_value : p_value;
+	return p_value == 0 ? 0 : 32 - __builtin_clz(p_value);
+}
+
+// Same run-length coding every baseline encoder does, so blocks nobody touched come out bit-for-bit the same.
+static void overlay_write_block(overlay_state *p_state, overlay_component *p_component, int16_t const *p_coefficients) {
+	int const diff = p_coefficients[0] - p_component->dc_out;
+	int const dc_size = overlay_bit_size(diff);
+	p_component->dc_out = p_coefficients[0];
+
+	overlay_put_symbol(p_state, &p_state->encoders[0][p_component->dc], dc_size);
+	overlay_put(p_state, diff < 0 ? diff - 1 : diff, dc_size);
+
+	overlay_encoder const *ac = &p_state->encoders[1][p_component->ac];
+	int run = 0;
+	for (int k = 1; k < 64; k++) {
+		int const value = p_coefficients[k];
+
+		if (value == 0) {
+			run++;
+			continue;
+		}
+
+		for (; run > 15; run -= 16) {
+			overlay_put_symbol(p_state, ac, 0xF0);
+		}
+
+		int const size = overlay_bit_size(value);
+		overlay_put_symbol(p_state, ac, run << 4 | size);
+		overlay_put(p_state, value < 0 ? value - 1 : value, size);
+		run = 0;
+	}
+
+	if (run > 0) {
+		overlay_put_symbol(p_state, ac, 0x00);
+	}
+}
+
+// Palette index at a frame pixel. `0` outside the canvas.
+static inline uint8_t overlay_canvas_at(overlay_canvas const *p_canvas, int const p_x, int const p_y) {
+	int const x = p_x - p_canvas->x;
+	int const y = p_y - p_canvas->y;
+	return x < 0 || y < 0 || x >= p_canvas->width || y >= p_canvas->height ? 0 : p_canvas->pixels[y * p_canvas->width + x];
+}
+
+// The slow path, for blocks the canvas covers: dequantize, IDCT, paint, FDCT, quantize. `false` if nothing got painted.
+static bool overlay_paint_block(overlay_state *p_state, overlay_canvas const *p_canvas, int const p_component,
+	int const p_x, int const p_y, int16_t *p_coefficients) {
+	overlay_component const *component = &p_state->components[p_component];
+	int const scale_x = p_state->h_max / component->h;
+	int const scale_y = p_state->v_max / component->v;
+
+	// Which samples get painted, and with what. Chroma samples cover several pixels: any painted pixel paints the sample.
+	int8_t paint[64];
+	bool painted = false;
+	for (int sy = 0; sy < 8; sy++) {
+		for (int sx = 0; sx < 8; sx++) {
+			int color = 0;
+
+			for (int py = 0; py < scale_y && color == 0; py++) {
+				for (int px = 0; px < scale_x && color == 0; px++) {
+					color = overlay_canvas_at(p_canvas, (p_x + sx) * scale_x + px, (p_y + sy) * scale_y + py);
+				}
+			}
+
+			paint[sy * 8 + sx] = color;
+			painted |= color != 0;
+		}
+	}
+
+	if (!painted) {
+		return false;
+	}
+
+	uint16_t const *quant = p_state->quant[component->quant];
+	float block[64];
+	float temp[64];
+
+	for (int i = 0; i < 64; i++) {
+		block[s_zigzag[i]] = p_coefficients[i] * quant[i];
+	}
+
+	// IDCT. Rows, then columns. Plain `O(n^3)`, but it's only ever a handful of blocks:
+	for (int y = 0; y < 8; y++) {
+		for (int x = 0; x < 8; x++) {
+			float sum = 0;
+			for (int u = 0; u < 8; u++) {
+				sum += s_cosines[x][u] * block[y * 8 + u];
+			}
+			temp[y * 8 + x] = sum;
+		}
+	}
+
+	for (int x = 0; x < 8; x++) {
+		for (int y = 0; y < 8; y++) {
+			float sum = 0;
+			for (int v = 0; v < 8; v++) {
+				sum += s_cosines[y][v] * temp[v * 8 + x];
+			}
+
+			int const color = paint[y * 8 + x];
+			block[y * 8 + x] = color == 0 ? sum : p_state->palette[color][p_component] - 128.0F;
+		}
+	}
+
+	// FDCT, the same way back:
+	for (int y = 0; y < 8; y++) {
+		for (int u = 0; u < 8; u++) {
+			float sum = 0;
+			for (int x = 0; x < 8; x++) {
+				sum += s_cosines[x][u] * block[y * 8 + x];
+			}
+			temp[y * 8 + u] = sum;
+		}
+	}
+
+	for (int u = 0; u < 8; u++) {
+		for (int v = 0; v < 8; v++) {
+			float sum = 0;
+			for (int y = 0; y < 8; y++) {
+				sum += s_cosines[y][v] * temp[y * 8 + u];
+			}
+			block[v * 8 + u] = sum;
+		}
+	}
+
+	for (int i = 0; i < 64; i++) {
+		int const value = lroundf(block[s_zigzag[i]] / quant[i]);
+		p_coefficients[i] = value > 1023 ? 1023 : value < -1023 ? -1023 : value; // Fits the `10`-bit AC size category.
+	}
+
+	return true;
+}
+#pragma endregion
+
+#pragma region Headers.
+static inline int overlay_u16(uint8_t const *p_data) {
+	return p_data[0] << 8 | p_data[1];
+}
+
+static bool overlay_parse_dht(overlay_state *p_state, uint8_t const *p_data, int p_length) {
+	while (p_length > 17) {
+		int const type = p_data[0] >> 4;
+		int const id = p_data[0] & 0x0F;
+
+		ifu(type > 1 || id > 3) {
+			return false;
+		}
+
+		overlay_decoder *decoder = &p_state->decoders[type][id];
+		overlay_encoder *encoder = &p_state->encoders[type][id];
+		uint8_t const *counts = p_data + 1;
+		int total = 0;
+
+		for (int i = 0; i < 16; i++) {
+			total += counts[i];
+		}
+
+		ifu(total > 256 || 17 + total > p_length) {
+			return false;
+		}
+
+		memset(decoder, 0, sizeof(*decoder));
+		memset(encoder, 0, sizeof(*encoder));
+		memcpy(decoder->symbols, p_data + 17, total);
+
+		// Canonical Huffman codes, as in Annex C of the spec:
+		int code = 0;
+		int index = 0;
+		for (int length = 1; length <= 16; length++) {
+			decoder->first_code[length] = code;
+			decoder->first_index[length] = index;
+
+			for (int i = 0; i < counts[length - 1]; i++, code++, index++) {
+				uint8_t const symbol = decoder->symbols[index];
+				encoder->codes[symbol] = code;
+				encoder->lengths[symbol] = length;
+
+				if (length <= OVERLAY_LOOKUP_BITS) {
+					int const shift = OVERLAY_LOOKUP_BITS - length;
+					for (int fill = 0; fill < 1 << shift; fill++) {
+						decoder->lookup[(code << shift) | fill] = length << 8 | symbol;
+					}
+				}
+			}
+
+			decoder->max_code[length] = counts[length - 1] == 0 ? -1 : code - 1;
+			code <<= 1;
+		}
+
+		p_data += 17 + total;
+		p_length -= 17 + total;
+	}
+
+	return true;
+}
+
+static bool overlay_parse_dqt(overlay_state *p_state, uint8_t const *p_data, int p_length) {
+	while (p_length > 0) {
+		int const precision = p_data[0] >> 4;
+		int const id = p_data[0] & 0x0F;
+		int const size = 1 + 64 * (precision + 1);
+
+		ifu(id > 3 || size > p_length) {
+			return false;
+		}
+
+		for (int i = 0; i < 64; i++) {
+			p_state->quant[id][i] = precision == 0 ? p_data[1 + i] : overlay_u16(p_data + 1 + 2 * i);
+		}
+
+		p_data += size;
+		p_length -= size;
+	}
+
+	return true;
+}
+
+static bool overlay_parse_sof(overlay_state *p_state, uint8_t const *p_data, int const p_length) {
+	p_state->height = overlay_u16(p_data + 1);
+	p_state->width = overlay_u16(p_data + 3);
+	p_state->component_count = p_data[5];
+
+	ifu(p_data[0] != 8 || p_state->component_count < 1 || p_state->component_count > OVERLAY_MAX_COMPONENTS
+		|| p_length < 6 + 3 * p_state->component_count) {
+		return false;
+	}
+
+	p_state->h_max = 1;
+	p_state->v_max = 1;
+	for (int i = 0; i < p_state->component_count; i++) {
+		overlay_component *component = &p_state->components[i];
+		component->id = p_data[6 + 3 * i];
+		component->h = p_data[7 + 3 * i] >> 4;
+		component->v = p_data[7 + 3 * i] & 0x0F;
+		component->quant = p_data[8 + 3 * i] & 0x03;
+
+		// A lone component is never interleaved, whatever it claims:
+		if (p_state->component_count == 1) {
+			component->h = 1;
+			component->v = 1;
+		}
+
+		ifu(component->h < 1 || component->v < 1 || component->h > OVERLAY_MAX_SAMPLING || component->v > OVERLAY_MAX_SAMPLING) {
+			return false;
+		}
+
+		p_state->h_max = component->h > p_state->h_max ? component->h : p_state->h_max;
+		p_state->v_max = component->v > p_state->v_max ? component->v : p_state->v_max;
+	}
+
+	return true;
+}
+
+static bool overlay_parse_sos(overlay_state *p_state, uint8_t const *p_data, int const p_length) {
+	int const count = p_data[0];
+
+	// One interleaved scan with every component in it, and no spectral selection. That's all of baseline:
+	ifu(count != p_state->component_count || p_length < 4 + 2 * count) {
+		return false;
+	}
+
+	for (int i = 0; i < count; i++) {
+		overlay_component *component = &p_state->components[i];
+
+		ifu(p_data[1 + 2 * i] != component->id) {
+			return false;
+		}
+
+		component->dc = p_data[2 + 2 * i] >> 4 & 0x03;
+		component->ac = p_data[2 + 2 * i] & 0x03;
+	}
+
+	uint8_t const *spectral = p_data + 1 + 2 * count;
+	return spectral[0] == 0 && spectral[1] == 63 && spectral[2] == 0;
+}
+
+// Walks the markers up to the scan. Returns where the entropy-coded data starts, or `0`.
+static size_t overlay_parse(overlay_state *p_state, uint8_t const *p_jpeg, size_t const p_len) {
+	bool frame = false;
+
+	ifu(p_len < 4 || p_jpeg[0] != 0xFF || p_jpeg[1] != 0xD8) {
+		return 0;
+	}
+
+	for (size_t pos = 2; pos + 4 <= p_len;) {
+		ifu(p_jpeg[pos] != 0xFF) {
+			return 0;
+		}
+
+		uint8_t const marker = p_jpeg[pos + 1];
+		if (marker == 0xFF) {
+			pos++; // Fill byte.
+			continue;
+		}
+
+		int const length = overlay_u16(p_jpeg + pos + 2) - 2;
+		uint8_t const *data = p_jpeg + pos + 4;
+
+		ifu(length < 0 || pos + 4 + length > p_len) {
+			return 0;
+		}
+
+		bool ok = true;
+		switch (marker) {
+			case 0xC0: // Baseline.
+			case 0xC1: // Extended, but still Huffman and sequential. Same thing, as long as it's 8-bit.
+				ok = overlay_parse_sof(p_state, data, length);
+				frame = true;
+				break;
+
+			case 0xC4:
+				ok = overlay_parse_dht(p_state, data, length);
+				break;
+
+			case 0xDB:
+				ok = overlay_parse_dqt(p_state, data, length);
+				break;
+
+			case 0xDD: // Restart markers would have to be rewritten too. No sensor here uses them.
+				ok = length >= 2 && overlay_u16(data) == 0;
+				break;
+
+			case 0xDA:
+				return frame && overlay_parse_sos(p_state, data, length) ? pos + 4 + length : 0;
+
+			default:
+				// Progressive, arithmetic-coded, hierarchical... no:
+				ok = !(marker >= 0xC2 && marker <= 0xCF) || marker == 0xC4 || marker == 0xC8 || marker == 0xCC;
+				break;
+		}
+
+		ifu(!ok) {
+			return 0;
+		}
+
+		pos += 4 + length;
+	}
+
+	return 0;
+}
+#pragma endregion
+
+#pragma region Compositing.
+static void overlay_set_palette(overlay_state *p_state, overlay_canvas const *p_canvas) {
+	for (int i = 1; i < OVERLAY_PALETTE_SIZE; i++) {
+		float const r = p_canvas->palette[i] >> 16 & 0xFF;
+		float const g = p_canvas->palette[i] >> 8 & 0xFF;
+		float const b = p_canvas->palette[i] & 0xFF;
+
+		// JFIF's YCbCr. Pure red or blue land on `255.5`, hence the clamping:
+		float const ycc[3] = {
+			0.299F * r + 0.587F * g + 0.114F * b,
+			128 - 0.168736F * r - 0.331264F * g + 0.5F * b,
+			128 + 0.5F * r - 0.418688F * g - 0.081312F * b,
+		};
+
+		for (int c = 0; c < OVERLAY_MAX_COMPONENTS; c++) {
+			p_state->palette[i][c] = ycc[c] > 255 ? 255 : lroundf(ycc[c]);
+		}
+	}
+}
+
+// Hands the rest of the scan, from wherever the reader is, straight to the writer. It still has to be shifted into place
+// bit by bit, but there's no Huffman decoding, no IDCT, nothing. Returns where the marker after the scan is.
+static size_t overlay_copy_tail(overlay_state *p_state) {
+	int const real = p_state->in_count - p_state->in_fake;
+
+	for (int left = real; left > 0;) {
+		int const count = left > 16 ? 16 : left;
+		overlay_put(p_state, overlay_peek(p_state, count), count);
+		overlay_skip(p_state, count);
+		left -= count;
+	}
+
+	size_t pos = p_state->in_pos;
+	while (pos < p_state->in_end && !p_state->error) {
+		uint8_t const byte = p_state->in[pos];
+
+		if (byte == 0xFF) {
+			if (pos + 1 >= p_state->in_end || p_state->in[pos + 1] != 0x00) {
+				break;
+			}
+			pos++;
+		}
+
+		overlay_put(p_state, byte, 8);
+		pos++;
+	}
+
+	return pos;
+}
+
+// Copies the first `p_bits` bits of the scan as they are. Whole bytes go over as raw bytes, stuffing and all.
+static void overlay_copy_head(overlay_state *p_state, size_t const p_start, size_t p_bits) {
+	size_t pos = p_start;
+
+	for (; p_bits >= 8; p_bits -= 8) {
+		uint8_t const byte = p_state->in[pos++];
+		p_state->out[p_state->out_len++] = byte;
+
+		if (byte == 0xFF) {
+			p_state->out[p_state->out_len++] = p_state->in[pos++]; // The stuffed `0x00`.
+		}
+	}
+
+	if (p_bits > 0) {
+		overlay_put(p_state, p_state->in[pos] >> (8 - p_bits), p_bits);
+	}
+}
+
+size_t overlay_jpeg(uint8_t const *p_jpeg, size_t const p_len, overlay_canvas const *p_canvas, uint8_t *p_out,
+	size_t const p_capacity) {
+	ifu(s_lock == NULL) {
+		return 0;
+	}
+
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	overlay_state *state = &s_state;
+	size_t const scan = overlay_parse(state, p_jpeg, p_len);
+	size_t result = 0;
+
+	ifu(scan == 0 || p_len > p_capacity) {
+		ESP_LOGD(TAG, "Not a JPEG `overlay_jpeg()` can handle.");
+		xSemaphoreGive(s_lock);
+		return 0;
+	}
+
+	overlay_set_palette(state, p_canvas);
+	state->in = p_jpeg;
+	state->in_pos = scan;
+	state->in_end = p_len;
+	state->in_bits = 0;
+	state->in_count = 0;
+	state->in_fake = 0;
+	state->in_consumed = 0;
+	state->error = false;
+	state->out = p_out;
+	state->out_len = scan;
+	state->out_capacity = p_capacity;
+	state->out_bits = 0;
+	state->out_count = 0;
+	memcpy(p_out, p_jpeg, scan);
+
+	for (int i = 0; i < state->component_count; i++) {
+		state->components[i].dc_in = 0;
+		state->components[i].dc_out = 0;
+	}
+
+	int const mcu_width = 8 * state->h_max;
+	int const mcu_height = 8 * state->v_max;
+	int const mcus_x = (state->width + mcu_width - 1) / mcu_width;
+	int const mcus_y = (state->height + mcu_height - 1) / mcu_height;
+
+	// The MCUs the canvas could touch:
+	int const left = p_canvas->x < 0 ? 0 : p_canvas->x / mcu_width;
+	int const top = p_canvas->y < 0 ? 0 : p_canvas->y / mcu_height;
+	int right = (p_canvas->x + p_canvas->width - 1) / mcu_width;
+	int bottom = (p_canvas->y + p_canvas->height - 1) / mcu_height;
+	right = right >= mcus_x ? mcus_x - 1 : right;
+	bottom = bottom >= mcus_y ? mcus_y - 1 : bottom;
+
+	int const first = top * mcus_x + left;
+	int const last = bottom * mcus_x + right;
+	int const total = mcus_x * mcus_y;
+	int16_t coefficients[64];
+
+	ifu(left > right || top > bottom || p_canvas->width <= 0 || p_canvas->height <= 0) {
+		// Nowhere on the frame. Still a valid result, just an expensive copy:
+		memcpy(p_out, p_jpeg, p_len);
+		xSemaphoreGive(s_lock);
+		return p_len <= p_capacity ? p_len : 0;
+	}
+
+	// Up to the first MCU the canvas touches, nothing changes. Only decode, to find out where it ends, and copy it over after:
+	for (int mcu = 0; mcu < first && !state->error; mcu++) {
+		for (int c = 0; c < state->component_count; c++) {
+			for (int block = 0; block < state->components[c].h * state->components[c].v; block++) {
+				overlay_read_block(state, &state->components[c], coefficients);
+			}
+		}
+	}
+
+	overlay_copy_head(state, scan, state->in_consumed);
+	for (int c = 0; c < state->component_count; c++) {
+		state->components[c].dc_out = state->components[c].dc_in;
+	}
+
+	// One MCU past the last touched one is enough: every component's DC predictor is back in sync by then.
+	int const end_mcu = last + 1 < total ? last + 1 : last;
+	for (int mcu = first; mcu <= end_mcu && !state->error; mcu++) {
+		int const mcu_x = mcu % mcus_x;
+		int const mcu_y = mcu / mcus_x;
+		bool const touched = mcu_x >= left && mcu_x <= right && mcu_y >= top && mcu_y <= bottom;
+
+		for (int c = 0; c < state->component_count; c++) {
+			overlay_component *component = &state->components[c];
+
+			for (int by = 0; by < component->v; by++) {
+				for (int bx = 0; bx < component->h; bx++) {
+					overlay_read_block(state, component, coefficients);
+
+					if (touched) {
+						overlay_paint_block(state, p_canvas, c, (mcu_x * component->h + bx) * 8,
+							(mcu_y * component->v + by) * 8, coefficients);
+					}
+
+					overlay_write_block(state, component, coefficients);
+				}
+			}
+		}
+	}
+
+	size_t end = overlay_copy_tail(state);
+
+	// Flush, padding with `1`s:
+	if (state->out_count > 0) {
+		overlay_put(state, 0xFF, 8 - state->out_count);
+	}
+
+	// Whatever follows the scan (`EOI`, mostly) goes over as it is:
+	if (!state->error && state->out_len + (p_len - end) <= p_capacity) {
+		memcpy(p_out + state->out_len, p_jpeg + end, p_len - end);
+		result = state->out_len + (p_len - end);
+	}
+
+	xSemaphoreGive(s_lock);
+	return result;
+}
+#pragma endregion
+
+esp_err_t overlay_init() {
+	for (int x = 0; x < 8; x++) {
+		for (int u = 0; u < 8; u++) {
+			s_cosines[x][u] = (u == 0 ? sqrtf(0.5F) : 1.0F) / 2 * cosf((2 * x + 1) * u * (float) M_PI / 16);
+		}
+	}
+
+	s_lock = xSemaphoreCreateMutex();
+	s_hud_lock = xSemaphoreCreateMutex();
+	s_hud_pixels = (uint8_t*) heap_caps_malloc(OVERLAY_HUD_MAX_WIDTH * OVERLAY_HUD_MAX_HEIGHT, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+	ifu(s_hud_pixels == NULL) { // No PSRAM. A smaller HUD from internal RAM, then. Bigger frames just get it smaller.
+		s_hud_max_scale = OVERLAY_HUD_MAX_SCALE_INTERNAL;
+		s_hud_max_width = OVERLAY_HUD_MAX_WIDTH_INTERNAL;
+		s_hud_pixels = (uint8_t*) memory_internal_alloc(MEMORY_USER_OVERLAY, s_hud_max_width * 10 * s_hud_max_scale);
+	}
+
+	ifu(s_lock == NULL || s_hud_lock == NULL || s_hud_pixels == NULL) {
+		ESP_LOGE(TAG, "No memory for overlays!");
+		return ESP_ERR_NO_MEM;
+	}
+
+	return ESP_OK;
+}
+
+#pragma region Drawing.
+void overlay_clear(overlay_canvas *p_canvas) {
+	memset(p_canvas->pixels, 0, p_canvas->width * p_canvas->height);
+}
+
+void overlay_fill(overlay_canvas *p_canvas, int p_x, int p_y, int p_width, int p_height, uint8_t const p_color) {
+	int const x0 = p_x - p_canvas->x < 0 ? 0 : p_x - p_canvas->x;
+	int const y0 = p_y - p_canvas->y < 0 ? 0 : p_y - p_canvas->y;
+	int const x1 = p_x + p_width - p_canvas->x > p_canvas->width ? p_canvas->width : p_x + p_width - p_canvas->x;
+	int const y1 = p_y + p_height - p_canvas->y > p_canvas->height ? p_canvas->height : p_y + p_height - p_canvas->y;
+
+	for (int y = y0; y < y1; y++) {
+		if (x1 > x0) {
+			memset(p_canvas->pixels + y * p_canvas->width + x0, p_color, x1 - x0);
+		}
+	}
+}
+
+void overlay_box(overlay_canvas *p_canvas, int const p_left, int const p_top, int const p_right, int const p_bottom,
+	uint8_t const p_color) {
+	overlay_fill(p_canvas, p_left, p_top, p_right - p_left + 1, 1, p_color);
+	overlay_fill(p_canvas, p_left, p_bottom, p_right - p_left + 1, 1, p_color);
+	overlay_fill(p_canvas, p_left, p_top, 1, p_bottom - p_top + 1, p_color);
+	overlay_fill(p_canvas, p_right, p_top, 1, p_bottom - p_top + 1, p_color);
+}
+
+void overlay_text(overlay_canvas *p_canvas, int p_x, int const p_y, int const p_scale, uint8_t const p_color,
+	char const *p_text) {
+	for (; *p_text != '\0'; p_text++, p_x += 6 * p_scale) {
+		char c = *p_text;
+		c = c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+		c = c < ' ' || c > '_' ? '?' : c;
+
+		for (int column = 0; column < 5; column++) {
+			uint8_t const bits = s_font[c - ' '][column];
+
+			for (int row = 0; row < 7; row++) {
+				if (bits & (1 << row)) {
+					overlay_fill(p_canvas, p_x + column * p_scale, p_y + row * p_scale, p_scale, p_scale, p_color);
+				}
+			}
+		}
+	}
+}
+
+// The same canvas, the expensive way: straight onto a decoded frame (`fmt2rgb888()` writes BGR).
+static void overlay_blend_bgr888(overlay_canvas const *p_canvas, uint8_t *p_bgr, int const p_width, int const p_height) {
+	for (int y = 0; y < p_height; y++) {
+		for (int x = 0; x < p_width; x++) {
+			uint8_t const color = overlay_canvas_at(p_canvas, x, y);
+
+			if (color != 0) {
+				uint8_t *pixel = p_bgr + (y * p_width + x) * 3;
+				pixel[0] = p_canvas->palette[color];
+				pixel[1] = p_canvas->palette[color] >> 8;
+				pixel[2] = p_canvas->palette[color] >> 16;
+			}
+		}
+	}
+}
+#pragma endregion
+
+// Under `s_hud_lock`. White on black, one character cell tall, a fifth of the height of a character cell of padding.
+static void overlay_hud_canvas(camera_fb_t const *p_fb, overlay_canvas *p_canvas) {
+	int scale = p_fb->width / 320;
+	scale = scale < 1 ? 1 : scale > s_hud_max_scale ? s_hud_max_scale : scale;
+
+	char const gear = g_carGearValue;
+	char text[48];
+	int const len = snprintf(text, sizeof(text), "%ld.%03ld S%d G%c %s", (long) p_fb->timestamp.tv_sec,
+		(long) p_fb->timestamp.tv_usec / 1000, g_carSteerNewValue, gear > ' ' ? gear : '-', g_carModeControls ? "MAN" : "AUTO");
+
+	int const width = (6 * len + 3) * scale;
+	p_canvas->pixels = s_hud_pixels;
+	p_canvas->x = 0;
+	p_canvas->y = 0;
+	p_canvas->width = width > (int) p_fb->width ? p_fb->width : width > s_hud_max_width ? s_hud_max_width : width;
+	p_canvas->height = 10 * scale;
+	p_canvas->palette[0] = 0;
+	p_canvas->palette[1] = 0x000000;
+	p_canvas->palette[2] = 0xFFFFFF;
+	p_canvas->palette[3] = 0xFFFF00;
+
+	overlay_fill(p_canvas, 0, 0, p_canvas->width, p_canvas->height, 1);
+	overlay_text(p_canvas, 2 * scale, 2 * scale, scale, 2, text);
+}
+
+size_t overlay_hud(camera_fb_t const *p_fb, uint8_t *p_out, size_t const p_capacity) {
+	ifu(s_hud_lock == NULL || p_fb->format != PIXFORMAT_JPEG) {
+		return 0;
+	}
+
+	int64_t const start = esp_timer_get_time();
+	overlay_canvas canvas;
+
+	xSemaphoreTake(s_hud_lock, portMAX_DELAY);
+	overlay_hud_canvas(p_fb, &canvas);
+	size_t const len = overlay_jpeg(p_fb->buf, p_fb->len, &canvas, p_out, p_capacity);
+	xSemaphoreGive(s_hud_lock);
+
+	metrics_record(METRICS_STAGE_OVERLAY, esp_timer_get_time() - start);
+	return len;
+}
+
+esp_err_t overlay_handler(httpd_req_t *p_request) {
+	char str_query[16];
+	char param_value_image[2];
+	bool const image = httpd_req_get_url_query_str(p_request, str_query, sizeof(str_query)) == ESP_OK
+		&& httpd_query_key_value(str_query, "image", param_value_image, sizeof(param_value_image)) == ESP_OK
+		&& param_value_image[0] == '1';
+
+	ifu(s_hud_lock == NULL || !boot_wait_camera(pdMS_TO_TICKS(5000))) {
+		httpd_resp_send_500(p_request);
+		return ESP_FAIL;
+	}
+
+	timelapse_hold();
+	camera_fb_t *fb = esp_camera_fb_get();
+	timelapse_release();
+
+	ifu(fb == NULL || fb->format != PIXFORMAT_JPEG) {
+		if (fb != NULL) {
+			esp_camera_fb_return(fb);
+		}
+
+		httpd_resp_send_err(p_request, HTTPD_500_INTERNAL_SERVER_ERROR, "Needs JPEG frames.");
+		return ESP_FAIL;
+	}
+
+	size_t const capacity = fb->len + fb->len / 4 + 1024; // Painted blocks can come out bigger than they went in.
+	uint8_t *out = (uint8_t*) heap_caps_malloc(capacity, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+	ifu(out == NULL) { // No PSRAM. It's about as big as the frame, so internal RAM has room, mostly.
+		out = (uint8_t*) heap_caps_malloc(capacity, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+	}
+
+	ifu(out == NULL) {
+		esp_camera_fb_return(fb);
+		httpd_resp_send_500(p_request);
+		return ESP_FAIL;
+	}
+
+	overlay_canvas canvas;
+	xSemaphoreTake(s_hud_lock, portMAX_DELAY);
+	overlay_hud_canvas(fb, &canvas);
+
+	int64_t start = esp_timer_get_time();
+	size_t const overlay_len = overlay_jpeg(fb->buf, fb->len, &canvas, out, capacity);
+	int64_t const overlay_us = esp_timer_get_time() - start;
+
+	// The round trip this replaces. At UXGA, the RGB888 frame alone is bigger than all of PSRAM, so it might not even run.
+	// Without PSRAM, only tiny frames (`96x96`, `QQVGA`...) leave it room in internal RAM:
+	int64_t roundtrip_us = -1;
+	size_t roundtrip_len = 0;
+	if (!image) {
+		uint8_t *bgr = (uint8_t*) heap_caps_malloc(fb->width * fb->height * 3, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+		if (bgr == NULL) {
+			bgr = (uint8_t*) heap_caps_malloc(fb->width * fb->height * 3, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+		}
+
+		if (bgr != NULL) {
+			uint8_t *jpeg = NULL;
+			start = esp_timer_get_time();
+
+			if (decode_fmt2rgb888(fb->buf, fb->len, fb->format, bgr)) {
+				overlay_blend_bgr888(&canvas, bgr, fb->width, fb->height);
+				if (fmt2jpg(bgr, fb->width * fb->height * 3, fb->width, fb->height, PIXFORMAT_RGB888, 80, &jpeg, &roundtrip_len)) {
+					roundtrip_us = esp_timer_get_time() - start;
+				}
+			}
+
+			free(jpeg);
+			free(bgr);
+		}
+	}
+
+	xSemaphoreGive(s_hud_lock);
+
+	esp_err_t error;
+	if (image && overlay_len > 0) {
+		httpd_resp_set_type(p_request, "image/jpeg");
+		httpd_resp_set_hdr(p_request, "Access-Control-Allow-Origin", "*");
+		error = httpd_resp_send(p_request, (char const*) out, overlay_len);
+	} else {
+		char json[224];
+		int const len = snprintf(json, sizeof(json),
+			"{\"width\":%u,\"height\":%u,\"jpeg_bytes\":%u,\"overlay_us\":%lld,\"overlay_bytes\":%u,"
+			"\"roundtrip_us\":%lld,\"roundtrip_bytes\":%u}",
+			(unsigned) fb->width, (unsigned) fb->height, (unsigned) fb->len, overlay_len > 0 ? overlay_us : -1LL,
+			(unsigned) overlay_len, roundtrip_us, (unsigned) roundtrip_len);
+
+		httpd_resp_set_type(p_request, "application/json");
+		httpd_resp_set_hdr(p_request, "Access-Control-Allow-Origin", "*");
+		error = httpd_resp_send(p_request, json, len);
+	}
+
+	esp_camera_fb_return(fb);
+	free(out);
+	return error;
+}
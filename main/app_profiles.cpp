@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <nvs.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_camera.h>
+
+#include <driver/ledc.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "app.h"
+#include "app_profiles.hpp"
+
+#define PROFILES_NVS_NAMESPACE	"profiles"
+#define PROFILES_NVS_KEY		"store"
+#define PROFILES_NVS_VERSION	2 // `2` dropped the per-profile control transport. Controls are always plain HTTP.
+
+httpd_uri_t g_uri_profile = {
+
+		.uri = "/profile",
+		.method = HTTP_GET,
+		.handler = profile_handler,
+		.user_ctx = NULL,
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL,
+#endif
+
+};
+
+stream_profile_id volatile g_profile_active = STREAM_PROFILE_DRIVING;
+
+// Everything goes into *one* blob, so boot costs one `nvs_get_blob()` no matter how many profiles there are.
+struct __attribute__((packed)) profile_store {
+
+	uint8_t version;
+	uint8_t active; // A `stream_profile_id`.
+	stream_profile profiles[STREAM_PROFILE_COUNT];
+
+};
+
+static char const *TAG = __FILE__;
+static bool s_loaded = false;
+static profile_store s_store;
+static StaticSemaphore_t s_framesize_lock_buffer;
+static SemaphoreHandle_t s_framesize_lock = NULL;
+
+static char const *s_profile_names[STREAM_PROFILE_COUNT] = {
+
+	"driving",
+	"recording",
+	"low_light",
+
+};
+
+static esp_err_t profiles_save() {
+	nvs_handle_t handle;
+	esp_err_t err = nvs_open(PROFILES_NVS_NAMESPACE, NVS_READWRITE, &handle);
+
+	ifu(err != ESP_OK) {
+		ESP_LOGE(TAG, "Couldn't open NVS namespace `%s`. Reason: \"%s\".", PROFILES_NVS_NAMESPACE, esp_err_to_name(err));
+		return err;
+	}
+
+	err = nvs_set_blob(handle, PROFILES_NVS_KEY, &s_store, sizeof(s_store));
+	ifl(err == ESP_OK) {
+		err = nvs_commit(handle);
+	}
+
+	nvs_close(handle);
+	return err;
+}
+
+// Fills every profile from what the sensor is doing *right now* (so board-specific tweaks from `app_main()` carry over),
+// then layers each profile's own idea of frame size, quality, clock and exposure on top.
+static void profiles_seed(sensor_t *p_sensor) {
+	camera_status_t const &status = p_sensor->status;
+
+	stream_profile base = {};
+	base.frame_size = status.framesize;
+	base.jpeg_quality = status.quality;
+	base.xclk_mhz = p_sensor->xclk_freq_hz / 1000000;
+	base.brightness = status.brightness;
+	base.contrast = status.contrast;
+	base.saturation = status.saturation;
+	base.sharpness = status.sharpness;
+	base.ae_level = status.ae_level;
+	base.gainceiling = status.gainceiling;
+	base.aec = status.aec;
+	base.aec2 = status.aec2;
+	base.agc = status.agc;
+	base.awb = status.awb;
+	base.vflip = status.vflip;
+	base.hmirror = status.hmirror;
+
+	stream_profile &driving = s_store.profiles[STREAM_PROFILE_DRIVING];
+	driving = base;
+	driving.frame_size = FRAMESIZE_QVGA;
+	driving.jpeg_quality = 12;
+
+	stream_profile &recording = s_store.profiles[STREAM_PROFILE_RECORDING];
+	recording = base;
+	recording.frame_size = FRAMESIZE_SVGA;
+	recording.jpeg_quality = 10;
+
+	stream_profile &low_light = s_store.profiles[STREAM_PROFILE_LOW_LIGHT];
+	low_light = base;
+	low_light.frame_size = FRAMESIZE_VGA;
+	low_light.jpeg_quality = 12;
+	low_light.xclk_mhz = 10; // Slower pixel clock, longer maximum exposure.
+	low_light.ae_level = 2;
+	low_light.aec2 = 1; // Night mode on the OV2640.
+	low_light.gainceiling = GAINCEILING_32X;
+
+	s_store.version = PROFILES_NVS_VERSION;
+	s_store.active = STREAM_PROFILE_DRIVING;
+}
+
+bool profiles_load() {
+	s_framesize_lock = xSemaphoreCreateMutexStatic(&s_framesize_lock_buffer); // Static, so it can't fail.
+
+	nvs_handle_t handle;
+	esp_err_t err = nvs_open(PROFILES_NVS_NAMESPACE, NVS_READONLY, &handle);
+
+	ifu(err != ESP_OK) { // First boot, most likely. Namespaces only exist once written to.
+		ESP_LOGI(TAG, "No saved profiles. Reason: \"%s\".", esp_err_to_name(err));
+		return false;
+	}
+
+	size_t size = sizeof(s_store);
+	err = nvs_get_blob(handle, PROFILES_NVS_KEY, &s_store, &size);
+	nvs_close(handle);
+
+	ifu(err != ESP_OK || size != sizeof(s_store) || s_store.version != PROFILES_NVS_VERSION) {
+		ESP_LOGW(TAG, "Saved profiles unusable (\"%s\", `%zu` bytes, version `%u`). Re-seeding.", esp_err_to_name(err), size, s_store.version);
+		return false;
+	}
+
+	ifu(s_store.active >= STREAM_PROFILE_COUNT) {
+		s_store.active = STREAM_PROFILE_DRIVING;
+	}
+
+	g_profile_active = (stream_profile_id) s_store.active;
+	s_loaded = true;
+	return true;
+}
+
+esp_err_t profiles_init() {
+	sensor_t *sensor = esp_camera_sensor_get();
+
+	ifu(sensor == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	ifu(!s_loaded) {
+		profiles_seed(sensor);
+		s_loaded = true;
+
+		esp_err_t const err = profiles_save();
+		ifu(err != ESP_OK) { // Not fatal. We'll just seed again next boot.
+			ESP_LOGW(TAG, "Couldn't save seeded profiles. Reason: \"%s\".", esp_err_to_name(err));
+		}
+	}
+
+	int64_t time_us;
+	esp_err_t const err = profiles_apply((stream_profile_id) s_store.active, &time_us);
+	ESP_LOGI(TAG, "Profile `%s` restored in `%lld` us.", s_profile_names[s_store.active], time_us);
+	return err;
+}
+
+stream_profile const* profiles_get(stream_profile_id const p_id) {
+	ifu(p_id >= STREAM_PROFILE_COUNT) {
+		return NULL;
+	}
+
+	return &s_store.profiles[p_id];
+}
+
+esp_err_t profiles_apply(stream_profile_id const p_id, int64_t *p_out_us) {
+	int64_t const start = esp_timer_get_time();
+	sensor_t *s = esp_camera_sensor_get();
+
+	ifu(s == NULL || p_id >= STREAM_PROFILE_COUNT) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	stream_profile const &p = s_store.profiles[p_id];
+	camera_status_t const &status = s->status;
+	int res = 0;
+	int writes = 0;
+
+	// Every setter is at least one SCCB transaction at 100 kHz, and the sensor caches what it last wrote in `status`.
+	// So we batch by skipping everything that's already right. Switching between similar profiles touches a register or two!
+#define PROFILE_APPLY(current, wanted, call) do { \
+		if ((current) != (wanted)) { \
+			res |= (call); \
+			writes++; \
+		} \
+	} while (false)
+
+	PROFILE_APPLY(s->xclk_freq_hz / 1000000, p.xclk_mhz, s->set_xclk(s, LEDC_TIMER_0, p.xclk_mhz));
+	PROFILE_APPLY(status.quality, p.jpeg_quality, s->set_quality(s, p.jpeg_quality));
+	PROFILE_APPLY(status.brightness, p.brightness, s->set_brightness(s, p.brightness));
+	PROFILE_APPLY(status.contrast, p.contrast, s->set_contrast(s, p.contrast));
+	PROFILE_APPLY(status.saturation, p.saturation, s->set_saturation(s, p.saturation));
+	PROFILE_APPLY(status.sharpness, p.sharpness, s->set_sharpness(s, p.sharpness));
+	PROFILE_APPLY(status.ae_level, p.ae_level, s->set_ae_level(s, p.ae_level));
+	PROFILE_APPLY(status.gainceiling, p.gainceiling, s->set_gainceiling(s, (gainceiling_t) p.gainceiling));
+	PROFILE_APPLY(status.aec, p.aec, s->set_exposure_ctrl(s, p.aec));
+	PROFILE_APPLY(status.aec2, p.aec2, s->set_aec2(s, p.aec2));
+	PROFILE_APPLY(status.agc, p.agc, s->set_gain_ctrl(s, p.agc));
+	PROFILE_APPLY(status.awb, p.awb, s->set_whitebal(s, p.awb));
+	PROFILE_APPLY(status.vflip, p.vflip, s->set_vflip(s, p.vflip));
+	PROFILE_APPLY(status.hmirror, p.hmirror, s->set_hmirror(s, p.hmirror));
+
+	// Last, since on the OV2640 this one rewrites the whole window and waits for the sensor to settle. Mid-burst, that's
+	// after the burst's put its own size back:
+	if (s->pixformat == PIXFORMAT_JPEG) {
+		profiles_framesize_take(portMAX_DELAY);
+		PROFILE_APPLY(status.framesize, p.frame_size, s->set_framesize(s, (framesize_t) p.frame_size));
+		profiles_framesize_give();
+	}
+
+#undef PROFILE_APPLY
+
+	g_profile_active = p_id;
+
+	int64_t const time = esp_timer_get_time() - start;
+	ESP_LOGD(TAG, "Profile `%s`: `%d` sensor writes, `%lld` us.", s_profile_names[p_id], writes, time);
+
+	if (p_out_us != NULL) {
+		*p_out_us = time;
+	}
+
+	return res == 0 ? ESP_OK : ESP_FAIL;
+}
+
+bool profiles_framesize_take(TickType_t const p_wait) {
+	return xSemaphoreTake(s_framesize_lock, p_wait) == pdTRUE;
+}
+
+void profiles_framesize_give() {
+	xSemaphoreGive(s_framesize_lock);
+}
+
+stream_profile_id profiles_id_from_name(char const *p_name) {
+	for (int i = 0; i < STREAM_PROFILE_COUNT; i++) {
+		if (strcmp(p_name, s_profile_names[i]) == 0) {
+			return (stream_profile_id) i;
+		}
+	}
+
+	return STREAM_PROFILE_COUNT;
+}
+
+char const* profiles_name(stream_profile_id const p_id) {
+	ifu(p_id >= STREAM_PROFILE_COUNT) {
+		return "none";
+	}
+
+	return s_profile_names[p_id];
+}
+
+// `/profile?name=driving` switches live. Add `&save=1` to first overwrite that profile with the sensor's current tuning.
+// Replies with the switch latency in microseconds, both as the body and as `X-Switch-Time`.
+esp_err_t profile_handler(httpd_req_t *p_request) {
+	char str_query[64];
+	char param_value_name[16];
+	char param_value_save[2];
+
+	ifu(httpd_req_get_url_query_str(p_request, str_query, sizeof(str_query)) != ESP_OK
+		|| httpd_query_key_value(str_query, "name", param_value_name, sizeof(param_value_name)) != ESP_OK) {
+		ESP_LOGW(TAG, "`/profile` needs a `name`. 400.");
+		return httpd_resp_send_err(p_request, HTTPD_400_BAD_REQUEST, NULL);
+	}
+
+	stream_profile_id const id = profiles_id_from_name(param_value_name);
+	ifu(id == STREAM_PROFILE_COUNT) {
+		ESP_LOGW(TAG, "No profile called `%s`. 404.", param_value_name);
+		return httpd_resp_send_err(p_request, HTTPD_404_NOT_FOUND, NULL);
+	}
+
+	if (httpd_query_key_value(str_query, "save", param_value_save, sizeof(param_value_save)) == ESP_OK && param_value_save[0] == '1') {
+		sensor_t *sensor = esp_camera_sensor_get();
+		ifu(sensor == NULL) {
+			return httpd_resp_send_500(p_request);
+		}
+
+		// Same as seeding, but for one profile:
+		stream_profile &p = s_store.profiles[id];
+		camera_status_t const &status = sensor->status;
+		p.frame_size = status.framesize;
+		p.jpeg_quality = status.quality;
+		p.xclk_mhz = sensor->xclk_freq_hz / 1000000;
+		p.brightness = status.brightness;
+		p.contrast = status.contrast;
+		p.saturation = status.saturation;
+		p.sharpness = status.sharpness;
+		p.ae_level = status.ae_level;
+		p.gainceiling = status.gainceiling;
+		p.aec = status.aec;
+		p.aec2 = status.aec2;
+		p.agc = status.agc;
+		p.awb = status.awb;
+		p.vflip = status.vflip;
+		p.hmirror = status.hmirror;
+	}
+
+	int64_t time_us = 0;
+	ifu(profiles_apply(id, &time_us) != ESP_OK) {
+		ESP_LOGE(TAG, "Profile `%s` only partially applied. 500.", param_value_name);
+		return httpd_resp_send_500(p_request);
+	}
+
+	s_store.active = id;
+	esp_err_t const err = profiles_save(); // The flash write is *not* part of the switch latency. The car already switched!
+	ifu(err != ESP_OK) {
+		ESP_LOGW(TAG, "Profile `%s` active, but not saved. Reason: \"%s\".", param_value_name, esp_err_to_name(err));
+	}
+
+	ESP_LOGI(TAG, "Switched to profile `%s` in `%lld` us.", param_value_name, time_us);
+
+	char str_time[24];
+	int const len = snprintf(str_time, sizeof(str_time), "%lld", time_us);
+
+	httpd_resp_set_type(p_request, "text/plain");
+	httpd_resp_set_hdr(p_request, "Access-Control-Allow-Origin", "*");
+	httpd_resp_set_hdr(p_request, "X-Switch-Time", str_time);
+	return httpd_resp_send(p_request, str_time, len);
+}
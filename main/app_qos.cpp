@@ -0,0 +1,75 @@
+#include <stdint.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <lwip/sockets.h>
+
+#include "app.h"
+#include "app_qos.hpp"
+#include "app_metrics.hpp"
+
+static char const *TAG = __FILE__;
+static int64_t s_control_us = INT64_MIN / 2; // Long enough ago.
+static qos_stats s_stats = {}; // Every stream task writes these, so only ever atomically.
+
+static void qos_mark(int const p_sockfd, int const p_tos) {
+	ifu(setsockopt(p_sockfd, IPPROTO_IP, IP_TOS, &p_tos, sizeof(p_tos)) != 0) {
+		ESP_LOGW(TAG, "Couldn't mark socket `%d` with TOS `0x%02x`!", p_sockfd, p_tos);
+	}
+}
+
+esp_err_t qos_session_open(httpd_handle_t p_handle, int const p_sockfd) {
+	int const nodelay = 1;
+	qos_mark(p_sockfd, QOS_CONTROL_TOS);
+	setsockopt(p_sockfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay)); // Control responses are tiny. Out they go!
+	return ESP_OK;
+}
+
+void qos_mark_stream(int const p_sockfd) {
+	qos_mark(p_sockfd, QOS_STREAM_TOS);
+}
+
+void qos_control_seen() {
+	__atomic_store_n(&s_control_us, esp_timer_get_time(), __ATOMIC_RELAXED); // 64-bit: a plain store could get read half-done.
+}
+
+uint32_t qos_stream_pace(uint32_t const p_send_us, uint32_t const p_period_us, size_t const p_bytes) {
+	ifl(esp_timer_get_time() - __atomic_load_n(&s_control_us, __ATOMIC_RELAXED) > QOS_CONTROL_ACTIVE_MS * 1000LL) {
+		__atomic_store_n(&s_stats.throttle_ms, 0, __ATOMIC_RELAXED);
+		return 0;
+	}
+
+	uint32_t throttle_ms = __atomic_load_n(&s_stats.throttle_ms, __ATOMIC_RELAXED);
+	ifu(p_send_us == 0 || p_period_us == 0 || p_bytes == 0) {
+		return throttle_ms;
+	}
+
+	// A full queue drains at the rate this frame went out. A control response only waits behind it if it comes in while a
+	// frame's being sent, which is `send / period` of the time:
+	uint64_t const drain_us = (uint64_t) QOS_QUEUE_BYTES * p_send_us / p_bytes;
+	uint32_t const delay_us = drain_us * p_send_us / (p_period_us > p_send_us ? p_period_us : p_send_us);
+
+	__atomic_store_n(&s_stats.control_delay_us, delay_us, __ATOMIC_RELAXED);
+	metrics_record(METRICS_STAGE_CONTROL_QUEUE, delay_us);
+
+	// Another stream may have stepped it since, so retry on top of whatever that one left:
+	uint32_t next_ms;
+	do {
+		uint32_t const stepped_ms = throttle_ms + QOS_THROTTLE_STEP_MS;
+		next_ms = delay_us > QOS_CONTROL_LATENCY_MS * 1000
+			? (stepped_ms < QOS_THROTTLE_MAX_MS ? stepped_ms : QOS_THROTTLE_MAX_MS)
+			: throttle_ms / 2;
+	} while (!__atomic_compare_exchange_n(&s_stats.throttle_ms, &throttle_ms, next_ms, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	if (next_ms > 0) {
+		__atomic_fetch_add(&s_stats.throttled_frames, 1, __ATOMIC_RELAXED);
+	}
+
+	return next_ms;
+}
+
+void qos_get(qos_stats *p_out) {
+	p_out->throttle_ms = __atomic_load_n(&s_stats.throttle_ms, __ATOMIC_RELAXED);
+	p_out->throttled_frames = __atomic_load_n(&s_stats.throttled_frames, __ATOMIC_RELAXED);
+	p_out->control_delay_us = __atomic_load_n(&s_stats.control_delay_us, __ATOMIC_RELAXED);
+}
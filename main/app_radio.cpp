@@ -0,0 +1,131 @@
+#include <stdint.h>
+
+#include <sdkconfig.h>
+#include <esp_log.h>
+#include <esp_wifi.h>
+#include <esp_timer.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "app.h"
+#include "app_boot.hpp"
+#include "app_burst.hpp"
+#include "app_radio.hpp"
+#include "app_radio_model.hpp"
+#include "app_status.hpp"
+#include "app_profiles.hpp"
+
+static char const *TAG = __FILE__;
+static uint32_t volatile s_interval_ms = 0;
+static radio_state s_state = {}; // The task's only.
+static radio_stats s_stats = {}; // The task writes, `radio_get()` reads. A torn read's just a slightly off scrape.
+
+static void radio_task(void *p_param) {
+	boot_wait_camera(portMAX_DELAY);
+	TickType_t last_wake = xTaskGetTickCount();
+	framesize_t applied = FRAMESIZE_INVALID; // What we last set, or last saw someone else set.
+	framesize_t wanted_size = FRAMESIZE_INVALID;
+	uint32_t frames_seen = 0;
+	uint32_t frames_at_change = 0;
+	uint8_t frame_step = 0;
+
+	while (true) {
+		vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(RADIO_SAMPLE_MS));
+		sensor_t *sensor = esp_camera_sensor_get();
+		wifi_ap_record_t ap;
+
+		ifu(sensor == NULL || esp_wifi_sta_get_ap_info(&ap) != ESP_OK) { // Not associated (yet, or anymore).
+			s_stats.rssi = 0;
+			continue;
+		}
+
+		// Only measured off frames much bigger than the socket's send buffer. Then most of each one had to wait for the link:
+		int64_t const now_us = esp_timer_get_time();
+		uint32_t const frames = g_stream_stats.frames;
+		uint32_t const frame_bytes = g_stream_stats.frame_bytes;
+		uint32_t const send_us = g_stream_stats.send_us;
+		uint32_t goodput_kbps = 0;
+
+		if (frames != frames_seen && frame_bytes > 2 * CONFIG_LWIP_TCP_SND_BUF_DEFAULT && send_us > 0) {
+			goodput_kbps = (uint64_t) (frame_bytes - CONFIG_LWIP_TCP_SND_BUF_DEFAULT) * 8000 / send_us;
+		}
+
+		uint32_t const phy_max_kbps = ap.phy_11n ? UINT32_MAX : ap.phy_11g ? 54000 : 11000;
+		radio_predict(&s_state, ap.rssi, phy_max_kbps, goodput_kbps, now_us);
+		s_stats.rssi = ap.rssi;
+		s_stats.predicted_kbps = s_state.predicted_kbps;
+		s_stats.goodput_kbps = (uint32_t) s_state.goodput_kbps;
+
+		// From here to setting it, nobody else gets to change the size. Someone is? This sample's just not acted on, then:
+		ifu(!profiles_framesize_take(0)) {
+			continue;
+		}
+
+		ifu(burst_active()) { // Mid-burst, the size isn't anybody's choice. Checked under the lock, so it can't start now.
+			profiles_framesize_give();
+			continue;
+		}
+
+		// Someone else changed it (a profile, most likely)? That's the new ceiling, then:
+		uint32_t pixels[RADIO_LADDER_COUNT];
+		framesize_t const current = sensor->status.framesize;
+		if (current != applied) {
+			wanted_size = current;
+			applied = current;
+			s_state.step = radio_ladder(wanted_size, pixels);
+			frame_step = s_state.step;
+		}
+
+		uint8_t const wanted = radio_ladder(wanted_size, pixels);
+
+		// The driver's buffers still hold a couple of frames from before a change:
+		if (frames - frames_at_change > 2) {
+			frame_step = s_state.step;
+		}
+
+		if (g_stream_stats.clients == 0 || frame_bytes == 0) { // Nobody watching? Back to what was picked.
+			s_state.step = wanted;
+			s_state.interval_ms = 0;
+		} else { // Stalled or not. A stall's when it matters most!
+			radio_decide(&s_state, pixels, wanted, frame_bytes, frame_step, now_us);
+		}
+
+		frames_seen = frames;
+		s_interval_ms = s_state.interval_ms;
+
+		framesize_t const size = s_state.step == wanted ? wanted_size : g_radio_ladder[s_state.step];
+		if (size != applied) {
+			ESP_LOGI(TAG, "Link's at `%d` dBm, good for `%lu` kbit/s: frame size `%d` -> `%d`.",
+				(int) s_stats.rssi, (unsigned long) s_state.predicted_kbps, applied, size);
+			sensor->set_framesize(sensor, size);
+			applied = size;
+			frames_at_change = frames;
+		}
+
+		profiles_framesize_give();
+
+		s_stats.wanted = wanted_size;
+		s_stats.framesize = applied;
+		s_stats.interval_ms = s_state.interval_ms;
+		s_stats.steps_down = s_state.steps_down;
+		s_stats.steps_up = s_state.steps_up;
+	}
+}
+
+esp_err_t radio_init() {
+	// Low priority: a sample late is nothing.
+	ifu(xTaskCreatePinnedToCore(radio_task, "radio", 3072, NULL, 1, NULL, 0) != pdPASS) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	return ESP_OK;
+}
+
+uint32_t radio_frame_interval_ms() {
+	return s_interval_ms;
+}
+
+void radio_get(radio_stats *p_out) {
+	*p_out = s_stats;
+}
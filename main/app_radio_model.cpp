@@ -0,0 +1,141 @@
+#include <stdint.h>
+
+#include <esp_camera.h>
+
+#include "app_radio_model.hpp"
+
+framesize_t const g_radio_ladder[RADIO_LADDER_COUNT] = {
+
+	FRAMESIZE_UXGA,
+	FRAMESIZE_SXGA,
+	FRAMESIZE_XGA,
+	FRAMESIZE_SVGA,
+	FRAMESIZE_VGA,
+	FRAMESIZE_CIF,
+	FRAMESIZE_QVGA,
+	FRAMESIZE_HQVGA,
+
+};
+
+struct radio_rate {
+
+	int8_t rssi; // At least this...
+	uint32_t kbps; // ...for this PHY rate.
+
+};
+
+// HT20, one spatial stream, long guard interval. Roughly the ESP32's own receive sensitivity for each MCS, plus a few dB.
+// The access point's is usually better, but it's our frames that have to get there.
+static radio_rate const s_rates[] = {
+
+	{ -67, 65000 },
+	{ -68, 58500 },
+	{ -70, 52000 },
+	{ -74, 39000 },
+	{ -77, 26000 },
+	{ -80, 19500 },
+	{ -83, 13000 },
+	{ -86, 6500 },
+
+};
+
+uint32_t radio_phy_kbps(float const p_rssi) {
+	for (radio_rate const &rate : s_rates) {
+		if (p_rssi >= rate.rssi) {
+			return rate.kbps;
+		}
+	}
+
+	return RADIO_RATE_FLOOR_KBPS;
+}
+
+static uint32_t radio_pixels(framesize_t const p_size) {
+	return resolution[p_size].width * resolution[p_size].height;
+}
+
+uint8_t radio_ladder(framesize_t const p_wanted, uint32_t *p_pixels) {
+	uint32_t const wanted_pixels = radio_pixels(p_wanted);
+	uint8_t wanted = RADIO_LADDER_COUNT - 1; // Smaller than all of them? Then there's no stepping down, just spacing out.
+
+	for (uint8_t i = RADIO_LADDER_COUNT; i-- > 0;) {
+		p_pixels[i] = radio_pixels(g_radio_ladder[i]);
+
+		if (p_pixels[i] <= wanted_pixels) {
+			wanted = i;
+		}
+	}
+
+	p_pixels[wanted] = wanted_pixels;
+	return wanted;
+}
+
+void radio_predict(radio_state *p_state, int8_t const p_rssi, uint32_t const p_phy_max_kbps,
+	uint32_t const p_goodput_kbps, int64_t const p_now_us) {
+	if (!p_state->primed) {
+		p_state->rssi = p_rssi;
+		p_state->slope = 0.0F;
+		p_state->primed = true;
+	}
+
+	float const last = p_state->rssi;
+	p_state->rssi += (p_rssi - p_state->rssi) / 4.0F;
+	p_state->slope += ((p_state->rssi - last) / RADIO_SAMPLE_MS - p_state->slope) / 4.0F;
+
+	// Falling? Then it's judged by where it's headed. Rising only counts once it's there:
+	float const ahead = p_state->rssi + (p_state->slope < 0.0F ? p_state->slope * RADIO_HORIZON_MS : 0.0F);
+	uint32_t const phy_kbps = radio_phy_kbps(ahead);
+	uint32_t predicted = (uint64_t) (phy_kbps < p_phy_max_kbps ? phy_kbps : p_phy_max_kbps) * RADIO_EFFICIENCY_PERCENT / 100;
+
+	// Down right away, back up slowly. One quick frame doesn't mean the interference is gone:
+	if (p_goodput_kbps > 0) {
+		p_state->goodput_kbps = p_state->goodput_kbps == 0.0F || p_goodput_kbps < p_state->goodput_kbps ? p_goodput_kbps
+			: p_state->goodput_kbps + (p_goodput_kbps - p_state->goodput_kbps) / 8.0F;
+		p_state->goodput_at_us = p_now_us;
+	} else if (p_now_us - p_state->goodput_at_us > RADIO_GOODPUT_STALE_MS * 1000LL) {
+		p_state->goodput_kbps = 0.0F;
+	}
+
+	if (p_state->goodput_kbps > 0.0F && p_state->goodput_kbps < predicted) {
+		predicted = (uint32_t) p_state->goodput_kbps;
+	}
+
+	p_state->predicted_kbps = predicted;
+}
+
+void radio_decide(radio_state *p_state, uint32_t const *p_pixels, uint8_t const p_wanted, uint32_t const p_frame_bytes,
+	uint8_t const p_frame_step, int64_t const p_now_us) {
+	uint32_t const headroom_kbps = (uint64_t) p_state->predicted_kbps * RADIO_HEADROOM_PERCENT / 100;
+	uint32_t const budget_kbps = headroom_kbps > 0 ? headroom_kbps : 1;
+
+	uint32_t demand_kbps[RADIO_LADDER_COUNT];
+	for (uint8_t i = 0; i < RADIO_LADDER_COUNT; i++) {
+		demand_kbps[i] = (uint64_t) p_frame_bytes * p_pixels[i] / p_pixels[p_frame_step] * 8 * RADIO_FPS_TARGET / 1000;
+	}
+
+	if (p_state->step < p_wanted) {
+		p_state->step = p_wanted;
+	}
+
+	uint8_t fits = RADIO_LADDER_COUNT - 1;
+	for (uint8_t i = p_wanted; i < RADIO_LADDER_COUNT; i++) {
+		if (demand_kbps[i] <= budget_kbps) {
+			fits = i;
+			break;
+		}
+	}
+
+	if (fits > p_state->step) {
+		p_state->step = fits;
+		p_state->hold_until_us = p_now_us + RADIO_HOLD_MS * 1000LL;
+		p_state->steps_down++;
+	} else if (fits < p_state->step && p_now_us >= p_state->hold_until_us
+		&& (uint64_t) demand_kbps[p_state->step - 1] * RADIO_UP_MARGIN_PERCENT / 100 <= budget_kbps) {
+		p_state->step--; // One at a time.
+		p_state->hold_until_us = p_now_us + RADIO_HOLD_MS * 1000LL;
+		p_state->steps_up++;
+	}
+
+	// Even the smallest is too much? Then fewer of them:
+	p_state->interval_ms = demand_kbps[p_state->step] > budget_kbps
+		? (uint64_t) demand_kbps[p_state->step] * 1000 / RADIO_FPS_TARGET / budget_kbps : 0;
+}
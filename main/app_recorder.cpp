@@ -0,0 +1,568 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <SD_MMC.h>
+
+#include "app.h"
+#include "app_boot.hpp"
+#include "app_status.hpp"
+#include "app_metrics.hpp"
+#include "app_recorder.hpp"
+#include "app_events.hpp"
+#include "app_timelapse.hpp"
+#include "app_burst.hpp"
+#include "app_memory.hpp"
+#include "protocol_car_controls.hpp"
+
+#define RECORDER_SECTOR_BYTES	512
+#define RECORDER_QUEUE_LENGTH	64 // Frames in the ring at once. More than `RECORDER_RING_BYTES` fits of any real frame size.
+#define RECORDER_INDEX_BATCH	64 // Index entries held back until the data they point at is synced.
+#define RECORDER_SEGMENT_MAX	99999
+
+// One per frame in the ring. The bytes themselves are already laid out there exactly as they'll go on the card.
+struct recorder_pending {
+
+	uint32_t size; // Header and JPEG.
+	uint32_t length; // JPEG only.
+	int64_t timestamp_us;
+
+};
+
+httpd_uri_t g_uri_recorder = {
+
+		.uri = "/recorder",
+		.method = HTTP_GET,
+		.handler = recorder_handler,
+		.user_ctx = NULL,
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL,
+#endif
+
+};
+
+static char const *TAG = __FILE__;
+static bool s_mounted = false;
+static bool volatile s_recording = false;
+static recorder_stats s_stats = {}; // Counters only get relaxed atomic increments, except `bytes`.
+
+// The ring. Only `recorder_offer()` moves `s_head` (under `s_offer_lock`), and only the writer moves `s_tail`.
+static uint8_t *s_ring = NULL;
+static uint32_t s_ring_bytes = RECORDER_RING_BYTES;
+static uint32_t s_head = 0;
+static uint32_t s_tail = 0;
+static SemaphoreHandle_t s_offer_lock = NULL;
+static QueueHandle_t s_queue = NULL;
+
+// Everything below belongs to the writer task only.
+static uint8_t *s_chunk = NULL; // DMA-capable, so the SD driver takes it as-is instead of bouncing it sector by sector.
+static int s_data_fd = -1;
+static int s_index_fd = -1;
+static uint32_t s_segment = 0; // Last one opened. Numbers only ever go up.
+static uint32_t s_oldest = 0; // Oldest one on the card, for when it fills up.
+static uint32_t s_offset = 0; // Bytes of frames in the segment.
+static uint32_t s_chunk_start = 0; // Segment offset of `s_chunk[0]`.
+static uint32_t s_synced = 0; // `s_offset` as of the last sync.
+static int64_t s_last_sync_us = 0;
+static recorder_index_entry s_index[RECORDER_INDEX_BATCH];
+static int s_index_count = 0;
+
+void recorder_segment_path(char *p_out, size_t const p_capacity, uint32_t const p_segment, bool const p_index) {
+	snprintf(p_out, p_capacity, RECORDER_DIRECTORY "/%05lu.%s", (unsigned long) p_segment,
+		p_index ? RECORDER_INDEX_EXTENSION : RECORDER_DATA_EXTENSION);
+}
+
+static void recorder_ring_copy_in(uint32_t const p_at, void const *p_data, uint32_t const p_len) {
+	uint32_t const at = p_at & (s_ring_bytes - 1);
+	uint32_t const first = p_len < s_ring_bytes - at ? p_len : s_ring_bytes - at;
+
+	memcpy(s_ring + at, p_data, first);
+	memcpy(s_ring, (uint8_t const*) p_data + first, p_len - first);
+}
+
+static void recorder_ring_copy_out(uint32_t const p_at, void *p_data, uint32_t const p_len) {
+	uint32_t const at = p_at & (s_ring_bytes - 1);
+	uint32_t const first = p_len < s_ring_bytes - at ? p_len : s_ring_bytes - at;
+
+	memcpy(p_data, s_ring + at, first);
+	memcpy((uint8_t*) p_data + first, s_ring, p_len - first);
+}
+
+// The first `p_len` bytes of `s_chunk`, at `s_chunk_start`. A partial chunk gets rounded up to whole sectors, and gets
+// written again once it's full.
+static bool recorder_chunk_write(uint32_t const p_len) {
+	int64_t const start = esp_timer_get_time();
+
+	uint32_t const len = (p_len + RECORDER_SECTOR_BYTES - 1) & ~(RECORDER_SECTOR_BYTES - 1);
+	bool const ok = lseek(s_data_fd, s_chunk_start, SEEK_SET) == (off_t) s_chunk_start && write(s_data_fd, s_chunk, len) == (ssize_t) len;
+
+	metrics_record(METRICS_STAGE_RECORDER_WRITE, esp_timer_get_time() - start);
+	return ok;
+}
+
+// Data first, *then* the index entries for it. Power can go out anywhere in here, and the index still only points at frames
+// that made it.
+static bool recorder_sync() {
+	ifu(s_data_fd < 0 || s_offset == s_synced) {
+		return true;
+	}
+
+	int64_t const start = esp_timer_get_time();
+	bool ok = true;
+
+	if (s_offset > s_chunk_start) {
+		ok = recorder_chunk_write(s_offset - s_chunk_start);
+	}
+
+	ok = ok && fsync(s_data_fd) == 0;
+
+	size_t const index_bytes = s_index_count * sizeof(recorder_index_entry);
+	ok = ok && write(s_index_fd, s_index, index_bytes) == (ssize_t) index_bytes;
+	ok = ok && fsync(s_index_fd) == 0;
+
+	s_index_count = 0;
+	s_synced = s_offset;
+	metrics_record(METRICS_STAGE_RECORDER_SYNC, esp_timer_get_time() - start);
+
+	ifu(!ok) {
+		ESP_LOGE(TAG, "Sync of segment `%lu` failed! Card pulled, or full?", (unsigned long) s_segment);
+	}
+
+	return ok;
+}
+
+static void recorder_segment_close() {
+	ifu(s_data_fd < 0) {
+		return;
+	}
+
+	recorder_sync();
+	close(s_data_fd);
+	close(s_index_fd);
+	s_data_fd = -1;
+	s_index_fd = -1;
+
+	// Give back what the segment didn't use:
+	char path[32];
+	recorder_segment_path(path, sizeof(path), s_segment, false);
+	truncate(path, s_offset);
+	__atomic_store_n(&s_stats.segment, 0, __ATOMIC_RELAXED);
+}
+
+static uint64_t recorder_free_bytes() {
+	return SD_MMC.totalBytes() - SD_MMC.usedBytes();
+}
+
+// Oldest first, like a dashcam.
+static void recorder_make_room() {
+	char path[32];
+
+	while (recorder_free_bytes() < 2ULL * RECORDER_SEGMENT_BYTES && s_oldest != 0 && s_oldest < s_segment) {
+		recorder_segment_path(path, sizeof(path), s_oldest, false);
+		unlink(path);
+		recorder_segment_path(path, sizeof(path), s_oldest, true);
+		unlink(path);
+
+		ESP_LOGI(TAG, "Card's full, deleted segment `%lu`.", (unsigned long) s_oldest);
+		s_oldest++;
+	}
+}
+
+static bool recorder_segment_open() {
+	ifu(s_segment >= RECORDER_SEGMENT_MAX) {
+		return false;
+	}
+
+	s_segment++;
+	s_oldest = s_oldest == 0 ? s_segment : s_oldest;
+	recorder_make_room();
+
+	char path[32];
+	recorder_segment_path(path, sizeof(path), s_segment, false);
+	s_data_fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	recorder_segment_path(path, sizeof(path), s_segment, true);
+	s_index_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	// Allocate the whole segment now: writing the last byte makes FAT chain every cluster up to it. After this, writes
+	// never stop to allocate, and the file's size no longer changes, so syncs don't have to touch the directory entry either.
+	int64_t const start = esp_timer_get_time();
+	bool const ok = s_data_fd >= 0 && s_index_fd >= 0
+		&& lseek(s_data_fd, RECORDER_SEGMENT_BYTES - 1, SEEK_SET) == RECORDER_SEGMENT_BYTES - 1
+		&& write(s_data_fd, "", 1) == 1 && fsync(s_data_fd) == 0;
+
+	ifu(!ok) {
+		ESP_LOGE(TAG, "Couldn't create segment `%lu`! Recording stops.", (unsigned long) s_segment);
+		close(s_data_fd);
+		close(s_index_fd);
+		s_data_fd = -1;
+		s_index_fd = -1;
+		return false;
+	}
+
+	ESP_LOGI(TAG, "Segment `%lu` allocated in `%lld` ms.", (unsigned long) s_segment, (esp_timer_get_time() - start) / 1000);
+	s_offset = 0;
+	s_chunk_start = 0;
+	s_synced = 0;
+	s_index_count = 0;
+	__atomic_store_n(&s_stats.segment, s_segment, __ATOMIC_RELAXED);
+	return true;
+}
+
+// Moves one frame out of the ring, into the chunk, and the chunk onto the card whenever it fills.
+static void recorder_frame_write(recorder_pending const *p_frame) {
+	uint32_t const tail = s_tail;
+
+	// Stopped (or failed) with frames still in the ring. If the segment's already closed, they don't get to start a new one:
+	ifu(!s_recording && s_data_fd < 0) {
+		__atomic_store_n(&s_tail, tail + p_frame->size, __ATOMIC_RELEASE);
+		return;
+	}
+
+	if (s_data_fd >= 0 && s_offset + p_frame->size > RECORDER_SEGMENT_BYTES) {
+		recorder_segment_close();
+	}
+
+	ifu((s_data_fd < 0 && !recorder_segment_open()) || (s_index_count == RECORDER_INDEX_BATCH && !recorder_sync())) {
+		s_recording = false;
+		__atomic_store_n(&s_tail, tail + p_frame->size, __ATOMIC_RELEASE);
+		return;
+	}
+
+	recorder_index_entry &entry = s_index[s_index_count++];
+	entry.offset = s_offset + sizeof(recorder_frame_header);
+	entry.length = p_frame->length;
+	entry.timestamp_us = p_frame->timestamp_us;
+
+	for (uint32_t done = 0; done < p_frame->size;) {
+		uint32_t const used = s_offset - s_chunk_start;
+		uint32_t const left = p_frame->size - done;
+		uint32_t const n = left < RECORDER_CHUNK_BYTES - used ? left : RECORDER_CHUNK_BYTES - used;
+
+		recorder_ring_copy_out(tail + done, s_chunk + used, n);
+		done += n;
+		s_offset += n;
+
+		if (s_offset - s_chunk_start == RECORDER_CHUNK_BYTES) {
+			ifu(!recorder_chunk_write(RECORDER_CHUNK_BYTES)) {
+				ESP_LOGE(TAG, "Write to segment `%lu` failed! Recording stops.", (unsigned long) s_segment);
+				s_recording = false;
+			}
+
+			s_chunk_start += RECORDER_CHUNK_BYTES;
+		}
+	}
+
+	__atomic_store_n(&s_tail, tail + p_frame->size, __ATOMIC_RELEASE);
+	__atomic_fetch_add(&s_stats.frames, 1, __ATOMIC_RELAXED);
+	s_stats.bytes += p_frame->size; // 64-bit, so not atomic. Only ever written from here, though.
+}
+
+void recorder_tick() {
+	recorder_pending frame;
+
+	if (xQueueReceive(s_queue, &frame, pdMS_TO_TICKS(1000 / RECORDER_MAX_FPS)) == pdTRUE) {
+		recorder_frame_write(&frame);
+	} else if (s_recording && g_stream_stats.clients == 0 && !timelapse_active() && !burst_active()) {
+		// Nobody's streaming, so nobody's handing us frames. Grab one ourselves. Unless it's time-lapse, which hands us its own:
+		camera_fb_t *fb = esp_camera_fb_get();
+
+		if (fb != NULL) {
+			recorder_offer(fb);
+			events_offer(fb);
+			esp_camera_fb_return(fb);
+		}
+	}
+
+	int64_t const now = esp_timer_get_time();
+	if (now - s_last_sync_us >= RECORDER_SYNC_MS * 1000LL) {
+		recorder_sync();
+		s_last_sync_us = now;
+	}
+
+	// Stopped? Finish whatever's still in the ring first:
+	if (!s_recording && s_data_fd >= 0 && uxQueueMessagesWaiting(s_queue) == 0) {
+		recorder_segment_close();
+	}
+}
+
+static void recorder_task(void *p_param) {
+	boot_wait_camera(portMAX_DELAY);
+
+	while (true) {
+		recorder_tick();
+	}
+}
+
+// Finds the newest and oldest segments. If the newest was never closed (power went out), cuts its index down to whole
+// entries, and the segment down to the end of the last frame the index knows about.
+static void recorder_recover() {
+	DIR *directory = opendir(RECORDER_DIRECTORY);
+
+	ifu(directory == NULL) {
+		return;
+	}
+
+	for (struct dirent *entry; (entry = readdir(directory)) != NULL;) {
+		char *end;
+		unsigned long const number = strtoul(entry->d_name, &end, 10);
+
+		if (end == entry->d_name || strcmp(end, "." RECORDER_DATA_EXTENSION) != 0 || number == 0 || number > RECORDER_SEGMENT_MAX) {
+			continue;
+		}
+
+		s_segment = number > s_segment ? number : s_segment;
+		s_oldest = s_oldest == 0 || number < s_oldest ? number : s_oldest;
+	}
+
+	closedir(directory);
+
+	ifu(s_segment == 0) {
+		return;
+	}
+
+	char data_path[32];
+	char index_path[32];
+	struct stat data;
+	struct stat index;
+	recorder_segment_path(data_path, sizeof(data_path), s_segment, false);
+	recorder_segment_path(index_path, sizeof(index_path), s_segment, true);
+
+	ifl(stat(data_path, &data) != 0 || data.st_size != RECORDER_SEGMENT_BYTES || stat(index_path, &index) != 0) {
+		return; // Closed properly.
+	}
+
+	off_t const entries = index.st_size / sizeof(recorder_index_entry);
+	recorder_index_entry last = {};
+
+	int const fd = open(index_path, O_RDONLY);
+	if (fd >= 0) {
+		if (entries > 0 && lseek(fd, (entries - 1) * sizeof(recorder_index_entry), SEEK_SET) >= 0) {
+			read(fd, &last, sizeof(last));
+		}
+
+		close(fd);
+	}
+
+	truncate(index_path, entries * sizeof(recorder_index_entry));
+	truncate(data_path, entries > 0 ? last.offset + last.length : 0);
+	ESP_LOGW(TAG, "Segment `%lu` wasn't closed. Recovered `%ld` frames from it.", (unsigned long) s_segment, (long) entries);
+}
+
+esp_err_t recorder_init() {
+	// In 1-bit mode, the card's on GPIO `2` (data), `14` (clock) and `15` (command). Those are free on the AI-Thinker board
+	// *only* if the car's wiring left them alone:
+	int const car_pins[] = { PIN_CAR_ESP_CAM_STEER, PIN_CAR_ESP_CAM_1, PIN_CAR_ESP_CAM_2 };
+	for (int const pin : car_pins) {
+		ifu(pin == 2 || pin == 14 || pin == 15) {
+			ESP_LOGE(TAG, "GPIO `%d` is wired to the car, and the microSD slot needs it. No recording!", pin);
+			return ESP_ERR_INVALID_STATE;
+		}
+	}
+
+	// Before the card's mounted, so without a ring, nothing else on the card (clips, `/footage`) starts either:
+	s_ring = (uint8_t*) heap_caps_malloc(s_ring_bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+	ifu(s_ring == NULL) { // No PSRAM. Only if `app_memory` has budgeted for it:
+		s_ring = (uint8_t*) memory_internal_alloc(MEMORY_USER_RECORDER, s_ring_bytes);
+	}
+
+	ifu(s_ring == NULL) {
+		ESP_LOGW(TAG, "No PSRAM, and no internal RAM to spare. No recording!");
+		return ESP_ERR_NO_MEM;
+	}
+
+	ifu(!SD_MMC.begin(RECORDER_MOUNT_POINT, true, false, SDMMC_FREQ_HIGHSPEED, 4)) {
+		ESP_LOGW(TAG, "No microSD card. No recording!");
+		heap_caps_free(s_ring);
+		s_ring = NULL;
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	s_mounted = true;
+	mkdir(RECORDER_DIRECTORY, 0755);
+	recorder_recover();
+
+	s_chunk = (uint8_t*) heap_caps_malloc(RECORDER_CHUNK_BYTES, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+	s_offer_lock = xSemaphoreCreateMutex();
+	s_queue = xQueueCreate(RECORDER_QUEUE_LENGTH, sizeof(recorder_pending));
+
+	ifu(s_chunk == NULL || s_offer_lock == NULL || s_queue == NULL) {
+		ESP_LOGE(TAG, "No memory for the recorder!");
+		return ESP_ERR_NO_MEM;
+	}
+
+	// Core `0`: the card's mostly DMA and waiting, and core `1` has the camera and everything that has to be on time.
+	ifu(xTaskCreatePinnedToCore(recorder_task, "recorder", 4096, NULL, 2, NULL, 0) != pdPASS) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	ESP_LOGI(TAG, "Recording to `%s`, `%llu` MiB free. Last segment was `%lu`.",
+		RECORDER_DIRECTORY, recorder_free_bytes() >> 20, (unsigned long) s_segment);
+	s_recording = true;
+	return ESP_OK;
+}
+
+void recorder_offer(camera_fb_t const *p_fb) {
+	ifl(!s_recording || p_fb->format != PIXFORMAT_JPEG) {
+		return;
+	}
+
+	// Some other stream's mid-copy. Both are getting frames from the same camera, so this one's a near-duplicate anyway:
+	ifu(xSemaphoreTake(s_offer_lock, 0) != pdTRUE) {
+		__atomic_fetch_add(&s_stats.dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	uint32_t const size = sizeof(recorder_frame_header) + p_fb->len;
+	uint32_t const used = s_head - __atomic_load_n(&s_tail, __ATOMIC_ACQUIRE);
+
+	ifu(size > s_ring_bytes - used || uxQueueSpacesAvailable(s_queue) == 0) {
+		xSemaphoreGive(s_offer_lock);
+		__atomic_fetch_add(&s_stats.dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	recorder_frame_header header;
+	header.magic = RECORDER_FRAME_MAGIC;
+	header.length = p_fb->len;
+	header.timestamp_us = p_fb->timestamp.tv_sec * 1000000LL + p_fb->timestamp.tv_usec;
+
+	recorder_ring_copy_in(s_head, &header, sizeof(header));
+	recorder_ring_copy_in(s_head + sizeof(header), p_fb->buf, p_fb->len);
+	__atomic_store_n(&s_head, s_head + size, __ATOMIC_RELEASE);
+
+	recorder_pending const frame = { size, header.length, header.timestamp_us };
+	xQueueSend(s_queue, &frame, 0);
+	xSemaphoreGive(s_offer_lock);
+}
+
+void recorder_get(recorder_stats *p_out) {
+	*p_out = s_stats;
+	p_out->mounted = s_mounted;
+	p_out->recording = s_recording;
+	p_out->ring_used = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE) - __atomic_load_n(&s_tail, __ATOMIC_ACQUIRE);
+	p_out->ring_bytes = s_ring == NULL ? 0 : s_ring_bytes;
+}
+
+// Writes `p_bytes` to a scratch file, `p_chunk` at a time, allocated up front and synced every second, like a segment.
+static esp_err_t recorder_bench(httpd_req_t *p_request, uint32_t const p_bytes, uint32_t const p_chunk) {
+	uint8_t *buffer = (uint8_t*) heap_caps_malloc(p_chunk, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+
+	ifu(buffer == NULL) {
+		httpd_resp_send_500(p_request);
+		return ESP_FAIL;
+	}
+
+	memset(buffer, 0xA5, p_chunk);
+	int const fd = open(RECORDER_DIRECTORY "/bench.tmp", O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+	int64_t const start = esp_timer_get_time();
+	bool ok = fd >= 0 && lseek(fd, p_bytes - 1, SEEK_SET) == (off_t) p_bytes - 1 && write(fd, "", 1) == 1 && fsync(fd) == 0;
+	ok = ok && lseek(fd, 0, SEEK_SET) == 0;
+
+	int64_t const written_from = esp_timer_get_time();
+	int64_t last_sync = written_from;
+	uint32_t worst_write_us = 0;
+	uint32_t worst_sync_us = 0;
+
+	for (uint32_t done = 0; ok && done < p_bytes; done += p_chunk) {
+		int64_t const before = esp_timer_get_time();
+		ok = write(fd, buffer, p_chunk) == (ssize_t) p_chunk;
+		int64_t const after = esp_timer_get_time();
+
+		worst_write_us = after - before > worst_write_us ? after - before : worst_write_us;
+
+		if (after - last_sync >= RECORDER_SYNC_MS * 1000LL) {
+			ok = ok && fsync(fd) == 0;
+			last_sync = esp_timer_get_time();
+			worst_sync_us = last_sync - after > worst_sync_us ? last_sync - after : worst_sync_us;
+		}
+	}
+
+	ok = ok && fsync(fd) == 0;
+	int64_t const end = esp_timer_get_time();
+
+	if (fd >= 0) {
+		close(fd);
+	}
+
+	unlink(RECORDER_DIRECTORY "/bench.tmp");
+	heap_caps_free(buffer);
+
+	ifu(!ok) {
+		httpd_resp_send_500(p_request);
+		return ESP_FAIL;
+	}
+
+	char json[192];
+	int const len = snprintf(json, sizeof(json),
+		"{\"bytes\":%lu,\"chunk\":%lu,\"allocate_ms\":%lld,\"write_ms\":%lld,\"mib_per_s\":%.2f,\"worst_write_us\":%lu,\"worst_sync_us\":%lu}",
+		(unsigned long) p_bytes, (unsigned long) p_chunk, (written_from - start) / 1000, (end - written_from) / 1000,
+		p_bytes / 1048576.0 / ((end - written_from) / 1e6), (unsigned long) worst_write_us, (unsigned long) worst_sync_us);
+
+	httpd_resp_set_type(p_request, "application/json");
+	return httpd_resp_send(p_request, json, len);
+}
+
+esp_err_t recorder_handler(httpd_req_t *p_request) {
+	char str_query[48];
+	char param_value[12];
+	httpd_resp_set_hdr(p_request, "Access-Control-Allow-Origin", "*");
+
+	if (httpd_req_get_url_query_str(p_request, str_query, sizeof(str_query)) == ESP_OK) {
+		if (s_mounted && httpd_query_key_value(str_query, "record", param_value, sizeof(param_value)) == ESP_OK) {
+			s_recording = param_value[0] == '1';
+		}
+
+		if (httpd_query_key_value(str_query, "bench", param_value, sizeof(param_value)) == ESP_OK) {
+			uint32_t const mib = strtoul(param_value, NULL, 10);
+			uint32_t chunk = RECORDER_CHUNK_BYTES;
+
+			if (httpd_query_key_value(str_query, "chunk", param_value, sizeof(param_value)) == ESP_OK) {
+				chunk = strtoul(param_value, NULL, 10);
+			}
+
+			ifu(!s_mounted || s_recording || s_stats.segment != 0) {
+				httpd_resp_send_err(p_request, HTTPD_400_BAD_REQUEST, "Card missing, or still recording. `?record=0` first.");
+				return ESP_FAIL;
+			}
+
+			ifu(mib == 0 || mib > 256 || chunk < RECORDER_SECTOR_BYTES || chunk > 64 * 1024 || chunk % RECORDER_SECTOR_BYTES != 0) {
+				httpd_resp_send_err(p_request, HTTPD_400_BAD_REQUEST, "`bench` is `1` to `256` MiB, `chunk` whole sectors up to 64 KiB.");
+				return ESP_FAIL;
+			}
+
+			return recorder_bench(p_request, mib << 20, chunk);
+		}
+	}
+
+	recorder_stats stats;
+	recorder_get(&stats);
+
+	char json[256];
+	int const len = snprintf(json, sizeof(json),
+		"{\"mounted\":%s,\"recording\":%s,\"segment\":%lu,\"frames\":%lu,\"dropped\":%lu,\"bytes\":%llu,\"ring_used\":%lu,\"ring_bytes\":%lu,\"free_mib\":%llu}",
+		stats.mounted ? "true" : "false", stats.recording ? "true" : "false", (unsigned long) stats.segment,
+		(unsigned long) stats.frames, (unsigned long) stats.dropped, stats.bytes, (unsigned long) stats.ring_used,
+		(unsigned long) stats.ring_bytes, stats.mounted ? recorder_free_bytes() >> 20 : 0ULL);
+
+	httpd_resp_set_type(p_request, "application/json");
+	return httpd_resp_send(p_request, json, len);
+}
@@ -0,0 +1,411 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cbor.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_camera.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "app.h"
+#include "app_status.hpp"
+#include "app_controls.hpp"
+#include "app_profiles.hpp"
+#include "app_vision.hpp"
+#include "app_motion.hpp"
+#include "app_link.hpp"
+
+#define STATUS_CBOR_MAX_SIZE	256 // Every field, all at once, worst case, is a bit under 200 bytes.
+#define STATUS_JSON_MAX_SIZE	1024 // Same as the old `json_response`.
+#define STATUS_WS_MAX_CLIENTS	4
+#define STATUS_WS_PERIOD_MS		100
+
+httpd_uri_t g_uri_status = {
+
+		.uri = "/status",
+		.method = HTTP_GET,
+		.handler = status_handler,
+		.user_ctx = NULL,
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL,
+#endif
+
+};
+
+httpd_uri_t g_uri_status_ws = {
+
+		.uri = "/status/ws",
+		.method = HTTP_GET,
+		.handler = status_ws_handler,
+		.user_ctx = NULL,
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = true,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL,
+#endif
+
+};
+
+stream_stats g_stream_stats = {};
+
+extern int led_duty; // From `app_httpd.cpp`.
+extern size_t status_print_json(char *buffer); // From `app_httpd.cpp`.
+
+static char const *TAG = __FILE__;
+static SemaphoreHandle_t s_lock = NULL;
+
+// For every field: what it was at the last snapshot, and the sequence number at which it last changed.
+// The sequence number only moves when *something* changes, so an idle car answers every poll with just `{0: seq}`.
+static uint32_t s_sequence = 0;
+static int32_t s_values[STATUS_FIELD_COUNT];
+static uint32_t s_changed_at[STATUS_FIELD_COUNT];
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+struct status_ws_client {
+
+	int fd; // `-1` if the slot is free.
+	uint32_t sequence; // What we last sent them.
+
+};
+
+static httpd_handle_t s_server = NULL;
+static status_ws_client s_ws_clients[STATUS_WS_MAX_CLIENTS];
+
+static void status_ws_push_task(void *p_param);
+#endif
+
+// Must hold `s_lock`.
+static void status_snapshot() {
+	int32_t now[STATUS_FIELD_COUNT];
+	memcpy(now, s_values, sizeof(now)); // Keeps sensor fields as they were if the camera isn't up yet.
+
+	sensor_t *s = esp_camera_sensor_get();
+	if (s != NULL) {
+		camera_status_t const &status = s->status;
+
+		now[STATUS_FIELD_XCLK] = s->xclk_freq_hz / 1000000;
+		now[STATUS_FIELD_PIXFORMAT] = s->pixformat;
+		now[STATUS_FIELD_FRAMESIZE] = status.framesize;
+		now[STATUS_FIELD_QUALITY] = status.quality;
+		now[STATUS_FIELD_BRIGHTNESS] = status.brightness;
+		now[STATUS_FIELD_CONTRAST] = status.contrast;
+		now[STATUS_FIELD_SATURATION] = status.saturation;
+		now[STATUS_FIELD_SHARPNESS] = status.sharpness;
+		now[STATUS_FIELD_SPECIAL_EFFECT] = status.special_effect;
+		now[STATUS_FIELD_WB_MODE] = status.wb_mode;
+		now[STATUS_FIELD_AWB] = status.awb;
+		now[STATUS_FIELD_AWB_GAIN] = status.awb_gain;
+		now[STATUS_FIELD_AEC] = status.aec;
+		now[STATUS_FIELD_AEC2] = status.aec2;
+		now[STATUS_FIELD_AE_LEVEL] = status.ae_level;
+		now[STATUS_FIELD_AEC_VALUE] = status.aec_value;
+		now[STATUS_FIELD_AGC] = status.agc;
+		now[STATUS_FIELD_AGC_GAIN] = status.agc_gain;
+		now[STATUS_FIELD_GAINCEILING] = status.gainceiling;
+		now[STATUS_FIELD_BPC] = status.bpc;
+		now[STATUS_FIELD_WPC] = status.wpc;
+		now[STATUS_FIELD_RAW_GMA] = status.raw_gma;
+		now[STATUS_FIELD_LENC] = status.lenc;
+		now[STATUS_FIELD_HMIRROR] = status.hmirror;
+		now[STATUS_FIELD_VFLIP] = status.vflip;
+		now[STATUS_FIELD_DCW] = status.dcw;
+		now[STATUS_FIELD_COLORBAR] = status.colorbar;
+	}
+
+	now[STATUS_FIELD_STREAM_CLIENTS] = g_stream_stats.clients;
+	now[STATUS_FIELD_STREAM_FRAMES] = g_stream_stats.frames;
+	now[STATUS_FIELD_STREAM_FRAME_BYTES] = g_stream_stats.frame_bytes;
+	now[STATUS_FIELD_STREAM_FRAME_MS] = g_stream_stats.frame_ms;
+	now[STATUS_FIELD_PROFILE] = g_profile_active;
+
+	now[STATUS_FIELD_CONTROL_STEER] = g_carSteerNewValue;
+	now[STATUS_FIELD_CONTROL_GEAR] = g_carGearValue;
+	now[STATUS_FIELD_CONTROL_MODE] = g_carModeControls;
+	now[STATUS_FIELD_LED_INTENSITY] = led_duty;
+
+	vision_result vision = {};
+	vision_get(&vision);
+	now[STATUS_FIELD_VISION_FREE_SPACE] = vision.free_space;
+	now[STATUS_FIELD_VISION_STEER] = vision.steer;
+
+	motion_result motion = {};
+	motion_get(&motion);
+	now[STATUS_FIELD_MOTION_ENERGY] = motion.energy;
+	now[STATUS_FIELD_MOTION_BLOCKS] = motion.blocks;
+	now[STATUS_FIELD_STREAM_SUPPRESSED] = g_stream_stats.suppressed;
+
+	link_stats link = {};
+	now[STATUS_FIELD_LINK_UP] = link_get(&link);
+	now[STATUS_FIELD_LINK_WHEEL_SPEED] = link.telemetry.wheel_speed;
+	now[STATUS_FIELD_LINK_BATTERY_MV] = link.telemetry.battery_mv;
+
+	now[STATUS_FIELD_CONTROL_THROTTLE] = g_carThrottleValue;
+
+	bool bumped = false;
+	for (int i = STATUS_FIELD_SEQUENCE + 1; i < STATUS_FIELD_COUNT; i++) {
+		if (now[i] == s_values[i]) {
+			continue;
+		}
+
+		if (!bumped) {
+			s_sequence++;
+			bumped = true;
+		}
+
+		s_values[i] = now[i];
+		s_changed_at[i] = s_sequence;
+	}
+
+	s_values[STATUS_FIELD_SEQUENCE] = s_sequence;
+}
+
+// Must hold `s_lock`. Returns the encoded size, or `0` if `buffer` was too small.
+static size_t status_encode_cbor(uint32_t p_since, uint8_t *p_buffer, size_t p_size) {
+	// A client that's *ahead* of us saw a previous boot. Everything's new to it!
+	if (p_since > s_sequence) {
+		p_since = 0;
+	}
+
+	CborEncoder encoder;
+	CborEncoder map;
+	CborError err = CborNoError;
+
+	cbor_encoder_init(&encoder, p_buffer, p_size, 0);
+	err = err != CborNoError ? err : cbor_encoder_create_map(&encoder, &map, CborIndefiniteLength);
+	err = err != CborNoError ? err : cbor_encode_uint(&map, STATUS_FIELD_SEQUENCE);
+	err = err != CborNoError ? err : cbor_encode_uint(&map, s_sequence);
+
+	for (int i = STATUS_FIELD_SEQUENCE + 1; i < STATUS_FIELD_COUNT && err == CborNoError; i++) {
+		if (s_changed_at[i] <= p_since) {
+			continue;
+		}
+
+		err = cbor_encode_uint(&map, i);
+		err = err != CborNoError ? err : cbor_encode_int(&map, s_values[i]);
+	}
+
+	err = err != CborNoError ? err : cbor_encoder_close_container(&encoder, &map);
+
+	ifu(err != CborNoError) {
+		ESP_LOGE(TAG, "CBOR encoding failed! Reason: \"%s\".", cbor_error_string(err));
+		return 0;
+	}
+
+	return cbor_encoder_get_buffer_size(&encoder, p_buffer);
+}
+
+esp_err_t status_init(httpd_handle_t p_server) {
+	ifl(s_lock == NULL) {
+		s_lock = xSemaphoreCreateMutex();
+	}
+
+	ifu(s_lock == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	for (int i = 0; i < STATUS_FIELD_COUNT; i++) {
+		s_values[i] = INT32_MIN; // So that the first snapshot counts every field as changed.
+	}
+	status_snapshot();
+	xSemaphoreGive(s_lock);
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+	s_server = p_server;
+	for (int i = 0; i < STATUS_WS_MAX_CLIENTS; i++) {
+		s_ws_clients[i].fd = -1;
+	}
+
+	ifu(xTaskCreate(status_ws_push_task, "status_ws", 3072, NULL, 2, NULL) != pdPASS) {
+		return ESP_ERR_NO_MEM;
+	}
+#endif
+
+	return ESP_OK;
+}
+
+esp_err_t status_handler(httpd_req_t *p_request) {
+	char str_query[48] = "";
+	char param_value[12];
+	uint32_t since = 0;
+	bool bench = false;
+
+	ifl(httpd_req_get_url_query_str(p_request, str_query, sizeof(str_query)) == ESP_OK) {
+		if (httpd_query_key_value(str_query, "since", param_value, sizeof(param_value)) == ESP_OK) {
+			since = strtoul(param_value, NULL, 10);
+		}
+
+		bench = httpd_query_key_value(str_query, "bench", param_value, sizeof(param_value)) == ESP_OK && param_value[0] == '1';
+	}
+
+	uint8_t cbor[STATUS_CBOR_MAX_SIZE];
+	char str_bench[4][12];
+	size_t full_len = 0;
+	int64_t time_cbor = 0;
+
+	// Heap, not stack: the `httpd` task's stack isn't *that* big. The old handler needs a sensor to talk to, too.
+	char *json = NULL;
+	if (bench) {
+		json = esp_camera_sensor_get() == NULL ? NULL : (char*) malloc(STATUS_JSON_MAX_SIZE + STATUS_CBOR_MAX_SIZE);
+		bench = json != NULL;
+	}
+
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	status_snapshot();
+	size_t const len = status_encode_cbor(since, cbor, sizeof(cbor));
+
+	if (bench) { // Everything, like the old handler always sent.
+		int64_t const start_cbor = esp_timer_get_time();
+		full_len = status_encode_cbor(0, (uint8_t*) json + STATUS_JSON_MAX_SIZE, STATUS_CBOR_MAX_SIZE);
+		time_cbor = esp_timer_get_time() - start_cbor;
+	}
+	xSemaphoreGive(s_lock);
+
+	if (bench) {
+		// The whole old path, SCCB register reads included. Outside `s_lock`, since those take a while:
+		int64_t const start_json = esp_timer_get_time();
+		size_t const json_len = status_print_json(json);
+		int64_t const time_json = esp_timer_get_time() - start_json;
+		free(json);
+
+		snprintf(str_bench[0], sizeof(str_bench[0]), "%zu", full_len);
+		snprintf(str_bench[1], sizeof(str_bench[1]), "%lld", time_cbor);
+		snprintf(str_bench[2], sizeof(str_bench[2]), "%zu", json_len);
+		snprintf(str_bench[3], sizeof(str_bench[3]), "%lld", time_json);
+		ESP_LOGI(TAG, "Status: CBOR delta `%zu` B, full `%zu` B in `%lld` us. Old JSON `%zu` B in `%lld` us.", len, full_len, time_cbor, json_len, time_json);
+	}
+
+	ifu(len == 0) {
+		return httpd_resp_send_500(p_request);
+	}
+
+	httpd_resp_set_type(p_request, "application/cbor");
+	httpd_resp_set_hdr(p_request, "Access-Control-Allow-Origin", "*");
+	httpd_resp_set_hdr(p_request, "Cache-Control", "no-store");
+
+	if (bench) {
+		httpd_resp_set_hdr(p_request, "X-Cbor-Full-Bytes", str_bench[0]);
+		httpd_resp_set_hdr(p_request, "X-Cbor-Time", str_bench[1]);
+		httpd_resp_set_hdr(p_request, "X-Json-Bytes", str_bench[2]);
+		httpd_resp_set_hdr(p_request, "X-Json-Time", str_bench[3]);
+	}
+
+	return httpd_resp_send(p_request, (char const*) cbor, len);
+}
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+// Snapshots every `STATUS_WS_PERIOD_MS`, and pushes each subscriber whatever changed since *their* last push.
+static void status_ws_push_task(void *p_param) {
+	uint8_t cbor[STATUS_CBOR_MAX_SIZE];
+
+	while (true) {
+		vTaskDelay(pdMS_TO_TICKS(STATUS_WS_PERIOD_MS));
+		xSemaphoreTake(s_lock, portMAX_DELAY);
+		status_snapshot();
+
+		for (int i = 0; i < STATUS_WS_MAX_CLIENTS; i++) {
+			status_ws_client &client = s_ws_clients[i];
+
+			if (client.fd < 0 || client.sequence == s_sequence) {
+				continue;
+			}
+
+			ifu(httpd_ws_get_fd_info(s_server, client.fd) != HTTPD_WS_CLIENT_WEBSOCKET) { // They left.
+				client.fd = -1;
+				continue;
+			}
+
+			size_t const len = status_encode_cbor(client.sequence, cbor, sizeof(cbor));
+			httpd_ws_frame_t frame = {};
+			frame.final = true;
+			frame.type = HTTPD_WS_TYPE_BINARY;
+			frame.payload = cbor;
+			frame.len = len;
+
+			ifl(len > 0 && httpd_ws_send_frame_async(s_server, client.fd, &frame) == ESP_OK) {
+				client.sequence = s_sequence;
+			} else {
+				ESP_LOGW(TAG, "Status push to socket `%d` failed. Dropping them.", client.fd);
+				client.fd = -1;
+			}
+		}
+
+		xSemaphoreGive(s_lock);
+	}
+}
+#endif
+
+// Connect, and deltas get pushed as binary frames as they happen. Send a text frame with a sequence number to get
+// everything since then right away (e.g. `0` after connecting, or your last one after a reconnect).
+esp_err_t status_ws_handler(httpd_req_t *p_request) {
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+	int const fd = httpd_req_to_sockfd(p_request);
+
+	if (p_request->method == HTTP_GET) { // The handshake.
+		xSemaphoreTake(s_lock, portMAX_DELAY);
+
+		int slot = -1;
+		for (int i = 0; i < STATUS_WS_MAX_CLIENTS; i++) {
+			if (s_ws_clients[i].fd < 0) {
+				slot = i;
+				break;
+			}
+		}
+
+		ifl(slot >= 0) {
+			s_ws_clients[slot].fd = fd;
+			s_ws_clients[slot].sequence = s_sequence; // They ask for the backlog themselves.
+		}
+
+		xSemaphoreGive(s_lock);
+
+		ifu(slot < 0) {
+			ESP_LOGW(TAG, "Too many status subscribers. Socket `%d` only gets replies.", fd);
+		}
+
+		return ESP_OK;
+	}
+
+	char str_since[12] = "";
+	httpd_ws_frame_t frame = {};
+	frame.payload = (uint8_t*) str_since;
+
+	esp_err_t err = httpd_ws_recv_frame(p_request, &frame, sizeof(str_since) - 1);
+	ifu(err != ESP_OK) {
+		ESP_LOGW(TAG, "Status WebSocket receive failed. Reason: \"%s\".", esp_err_to_name(err));
+		return err;
+	}
+
+	uint32_t const since = strtoul(str_since, NULL, 10);
+	uint8_t cbor[STATUS_CBOR_MAX_SIZE];
+
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	status_snapshot();
+	size_t const len = status_encode_cbor(since, cbor, sizeof(cbor));
+
+	for (int i = 0; i < STATUS_WS_MAX_CLIENTS; i++) {
+		if (s_ws_clients[i].fd == fd) {
+			s_ws_clients[i].sequence = s_sequence;
+		}
+	}
+	xSemaphoreGive(s_lock);
+
+	frame = {};
+	frame.final = true;
+	frame.type = HTTPD_WS_TYPE_BINARY;
+	frame.payload = cbor;
+	frame.len = len;
+	return httpd_ws_send_frame(p_request, &frame);
+#else
+	return httpd_resp_send_err(p_request, HTTPD_404_NOT_FOUND, "WebSockets are disabled. Use `/status`.");
+#endif
+}
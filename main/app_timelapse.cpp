@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <driver/gpio.h>
+#include <driver/ledc.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "app.h"
+#include "app_boot.hpp"
+#include "app_burst.hpp"
+#include "app_metrics.hpp"
+#include "app_recorder.hpp"
+#include "app_timelapse.hpp"
+
+httpd_uri_t g_uri_timelapse = {
+
+		.uri = "/timelapse",
+		.method = HTTP_GET,
+		.handler = timelapse_handler,
+		.user_ctx = NULL,
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL,
+#endif
+
+};
+
+static char const *TAG = __FILE__;
+static camera_config_t const *s_config = NULL;
+static TaskHandle_t s_task = NULL;
+static uint32_t volatile s_interval_ms = 0;
+
+// Everything below is under `s_lock`.
+static SemaphoreHandle_t s_lock = NULL;
+static bool s_asleep = false;
+static int s_holds = 0;
+static int64_t s_awake_since_us = 0;
+static int64_t s_enabled_at_us = 0;
+static timelapse_stats s_stats = {};
+
+static void timelapse_sleep() {
+	gpio_set_level((gpio_num_t) s_config->pin_pwdn, 1);
+	ledc_timer_pause(LEDC_LOW_SPEED_MODE, s_config->ledc_timer);
+
+	s_stats.awake_us += esp_timer_get_time() - s_awake_since_us;
+	s_asleep = true;
+}
+
+static void timelapse_wake() {
+	s_awake_since_us = esp_timer_get_time();
+	ledc_timer_resume(LEDC_LOW_SPEED_MODE, s_config->ledc_timer);
+	gpio_set_level((gpio_num_t) s_config->pin_pwdn, 0);
+	vTaskDelay(pdMS_TO_TICKS(TIMELAPSE_POWER_UP_MS));
+	s_asleep = false;
+}
+
+// The first frame exposed after `p_since_us` that comes out about as big as the one before it. Whatever's still sitting in the
+// frame buffers from before the sensor went to sleep is older than that, and goes too.
+static camera_fb_t* timelapse_settled_frame(int64_t const p_since_us, uint32_t *p_thrown) {
+	size_t last_len = 0;
+	*p_thrown = 0;
+
+	while (true) {
+		camera_fb_t *fb = esp_camera_fb_get();
+
+		ifu(fb == NULL) {
+			return NULL;
+		}
+
+		bool const fresh = fb->timestamp.tv_sec * 1000000LL + fb->timestamp.tv_usec >= p_since_us;
+		bool const settled = fresh && last_len > 0 && (size_t) labs((long) fb->len - (long) last_len) * 100 <= last_len * TIMELAPSE_SETTLE_PERCENT;
+
+		if (settled || (fresh && *p_thrown >= TIMELAPSE_WARMUP_FRAMES_MAX)) {
+			return fb;
+		}
+
+		last_len = fresh ? fb->len : 0;
+		(*p_thrown)++;
+		esp_camera_fb_return(fb);
+	}
+}
+
+static void timelapse_task(void *p_param) {
+	boot_wait_camera(portMAX_DELAY);
+	TickType_t last_wake = xTaskGetTickCount();
+
+	while (true) {
+		uint32_t const interval_ms = s_interval_ms;
+
+		if (interval_ms == 0) {
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			last_wake = xTaskGetTickCount();
+			continue;
+		}
+
+		// Woken up early if the interval changes:
+		TickType_t const due = last_wake + pdMS_TO_TICKS(interval_ms);
+		TickType_t const now = xTaskGetTickCount();
+		if ((int32_t) (due - now) > 0 && ulTaskNotifyTake(pdTRUE, due - now) > 0) {
+			continue;
+		}
+
+		last_wake = due;
+		xSemaphoreTake(s_lock, portMAX_DELAY);
+
+		ifu(s_interval_ms == 0 || burst_active()) { // Switched off while we waited for the lock, or mid-burst. Next time, then.
+			xSemaphoreGive(s_lock);
+			continue;
+		}
+
+		int64_t const start = esp_timer_get_time();
+		bool const was_asleep = s_asleep;
+		uint32_t thrown = 0;
+		camera_fb_t *fb = NULL;
+
+		if (was_asleep) {
+			timelapse_wake();
+			fb = timelapse_settled_frame(start, &thrown);
+		} else {
+			fb = esp_camera_fb_get(); // Someone's holding it awake, so it's been exposing all along.
+		}
+
+		if (fb != NULL) {
+			recorder_offer(fb);
+			esp_camera_fb_return(fb);
+			s_stats.frames++;
+		}
+
+		if (was_asleep) {
+			s_stats.warmup_frames = thrown;
+			s_stats.warmup_us = esp_timer_get_time() - start;
+			metrics_record(METRICS_STAGE_TIMELAPSE_WARMUP, s_stats.warmup_us);
+		}
+
+		if (s_holds == 0) {
+			timelapse_sleep();
+		}
+
+		xSemaphoreGive(s_lock);
+
+		ifu(fb == NULL) {
+			ESP_LOGW(TAG, "No frame this time!");
+		}
+
+		// Missed a few? Don't try to catch up on them all at once:
+		if ((int32_t) (xTaskGetTickCount() - last_wake) > (int32_t) pdMS_TO_TICKS(interval_ms)) {
+			last_wake = xTaskGetTickCount();
+		}
+	}
+}
+
+esp_err_t timelapse_init(camera_config_t const *p_config) {
+	ifu(p_config->pin_pwdn < 0) {
+		ESP_LOGW(TAG, "No `PWDN` pin on this board. No time-lapse!");
+		return ESP_ERR_NOT_SUPPORTED;
+	}
+
+	s_config = p_config;
+	s_lock = xSemaphoreCreateMutex();
+
+	// Below the recorder, which it feeds, and on the same core:
+	ifu(s_lock == NULL || xTaskCreatePinnedToCore(timelapse_task, "timelapse", 3072, NULL, 2, &s_task, 0) != pdPASS) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	return ESP_OK;
+}
+
+void timelapse_set(uint32_t const p_interval_ms) {
+	ifu(s_lock == NULL) {
+		return;
+	}
+
+	uint32_t const interval_ms = p_interval_ms == 0 || p_interval_ms >= TIMELAPSE_INTERVAL_MIN_MS ? p_interval_ms : TIMELAPSE_INTERVAL_MIN_MS;
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+
+	if (interval_ms == 0 && s_asleep) {
+		timelapse_wake();
+	}
+
+	if (s_interval_ms == 0 && interval_ms != 0) {
+		s_stats = {};
+		s_enabled_at_us = esp_timer_get_time();
+		s_awake_since_us = s_enabled_at_us;
+	}
+
+	s_interval_ms = interval_ms;
+	xSemaphoreGive(s_lock);
+	xTaskNotifyGive(s_task);
+
+	if (interval_ms == 0) {
+		ESP_LOGI(TAG, "Time-lapse off.");
+	} else {
+		ESP_LOGI(TAG, "Time-lapse: a frame every `%lu` ms.", (unsigned long) interval_ms);
+	}
+}
+
+bool timelapse_active() {
+	return s_interval_ms != 0;
+}
+
+void timelapse_hold() {
+	ifu(s_lock == NULL) {
+		return;
+	}
+
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	s_holds++;
+
+	if (s_asleep) {
+		timelapse_wake();
+
+		// The next frames were exposed in the dark, or for some other scene. Not the holder's problem to sort out:
+		uint32_t thrown;
+		camera_fb_t *fb = timelapse_settled_frame(esp_timer_get_time(), &thrown);
+		if (fb != NULL) {
+			esp_camera_fb_return(fb);
+		}
+	}
+
+	xSemaphoreGive(s_lock);
+}
+
+void timelapse_release() {
+	ifu(s_lock == NULL) {
+		return;
+	}
+
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	s_holds--;
+	xSemaphoreGive(s_lock); // The next time-lapse frame puts it back to sleep, if nobody else needs it.
+}
+
+void timelapse_get(timelapse_stats *p_out) {
+	*p_out = {};
+
+	ifu(s_lock == NULL) {
+		return;
+	}
+
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	*p_out = s_stats;
+	p_out->interval_ms = s_interval_ms;
+	p_out->asleep = s_asleep;
+
+	if (s_interval_ms != 0) {
+		int64_t const now = esp_timer_get_time();
+		p_out->elapsed_us = now - s_enabled_at_us;
+		p_out->awake_us += s_asleep ? 0 : now - s_awake_since_us;
+	}
+
+	xSemaphoreGive(s_lock);
+}
+
+esp_err_t timelapse_handler(httpd_req_t *p_request) {
+	char str_query[32];
+	char param_value[12];
+	httpd_resp_set_hdr(p_request, "Access-Control-Allow-Origin", "*");
+
+	if (httpd_req_get_url_query_str(p_request, str_query, sizeof(str_query)) == ESP_OK
+		&& httpd_query_key_value(str_query, "interval", param_value, sizeof(param_value)) == ESP_OK) {
+		timelapse_set(strtoul(param_value, NULL, 10) * 1000);
+	}
+
+	timelapse_stats stats;
+	timelapse_get(&stats);
+
+	char json[224];
+	int const len = snprintf(json, sizeof(json),
+		"{\"interval_ms\":%lu,\"asleep\":%s,\"frames\":%lu,\"warmup_frames\":%lu,\"warmup_ms\":%lu,\"awake_ms_per_frame\":%lu,\"duty\":%.4f}",
+		(unsigned long) stats.interval_ms, stats.asleep ? "true" : "false", (unsigned long) stats.frames,
+		(unsigned long) stats.warmup_frames, (unsigned long) (stats.warmup_us / 1000),
+		(unsigned long) (stats.frames == 0 ? 0 : stats.awake_us / 1000 / stats.frames),
+		stats.elapsed_us == 0 ? 0.0 : (double) stats.awake_us / stats.elapsed_us);
+
+	httpd_resp_set_type(p_request, "application/json");
+	return httpd_resp_send(p_request, json, len);
+}
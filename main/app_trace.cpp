@@ -0,0 +1,192 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_cpu.h>
+#include <esp_timer.h>
+#include <esp_attr.h>
+#include <esp_heap_caps.h>
+#include <esp_private/esp_clk.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "app.h"
+#include "app_trace.hpp"
+#include "app_memory.hpp"
+
+#define TRACE_RING_MASK				(TRACE_RING_SIZE - 1)
+#define TRACE_DRAIN_PERIOD_MS		50
+#define TRACE_CALIBRATION_SAMPLES	(TRACE_RING_SIZE / 2)
+
+httpd_uri_t g_uri_trace = {
+
+		.uri = "/trace",
+		.method = HTTP_GET,
+		.handler = trace_handler,
+		.user_ctx = NULL,
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL,
+#endif
+
+};
+
+// Single-producer, single-consumer. `head` and `tail` run freely and only get masked on access.
+// The producer owns `head` and `dropped`, the drainer owns `tail`.
+struct trace_ring {
+
+	uint32_t head;
+	uint32_t tail;
+	uint32_t dropped;
+	trace_record records[TRACE_RING_SIZE];
+
+};
+
+static char const *TAG = __FILE__;
+static DRAM_ATTR trace_ring s_rings[TRACE_CHANNEL_COUNT]; // Internal RAM. PSRAM writes would cost more than the event!
+static uint32_t s_emit_cost_ns = 0;
+
+// The drainer's side. Not a hot path at all, so a plain mutex-protected overwrite-oldest ring does.
+static SemaphoreHandle_t s_drain_lock = NULL;
+static trace_record *s_drain = NULL;
+static uint32_t s_drain_head = 0;
+static uint32_t s_drain_count = 0;
+static uint32_t s_drain_size = TRACE_DRAIN_SIZE;
+
+static inline void trace_ring_push(trace_ring *p_ring, trace_record const &p_record) {
+	uint32_t const head = p_ring->head;
+	uint32_t const tail = __atomic_load_n(&p_ring->tail, __ATOMIC_ACQUIRE);
+
+	ifu(head - tail >= TRACE_RING_SIZE) {
+		p_ring->dropped++;
+		return;
+	}
+
+	p_ring->records[head & TRACE_RING_MASK] = p_record;
+	__atomic_store_n(&p_ring->head, head + 1, __ATOMIC_RELEASE); // Publishes the record.
+}
+
+void IRAM_ATTR trace_emit(trace_channel const p_channel, trace_event const p_event, uint32_t const p_arg0, uint32_t const p_arg1) {
+	trace_record record;
+	record.timestamp_us = (uint32_t) esp_timer_get_time();
+	record.event = p_event;
+	record.channel = p_channel;
+	record.core = (uint8_t) xPortGetCoreID();
+	record.arg0 = p_arg0;
+	record.arg1 = p_arg1;
+
+	trace_ring_push(&s_rings[p_channel], record);
+}
+
+static void trace_drain_task(void *p_param) {
+	while (true) {
+		vTaskDelay(pdMS_TO_TICKS(TRACE_DRAIN_PERIOD_MS));
+		xSemaphoreTake(s_drain_lock, portMAX_DELAY);
+
+		for (int c = 0; c < TRACE_CHANNEL_COUNT; c++) {
+			trace_ring *ring = &s_rings[c];
+			uint32_t tail = ring->tail;
+			uint32_t const head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+			for (; tail != head; tail++) {
+				s_drain[s_drain_head] = ring->records[tail & TRACE_RING_MASK];
+				s_drain_head = (s_drain_head + 1) % s_drain_size;
+
+				if (s_drain_count < s_drain_size) {
+					s_drain_count++;
+				}
+			}
+
+			__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE); // Frees the slots for the producer.
+		}
+
+		xSemaphoreGive(s_drain_lock);
+	}
+}
+
+esp_err_t trace_init() {
+	// Benchmark with the real code path, on a ring nobody else uses yet, then hand it back empty:
+	trace_ring *ring = &s_rings[TRACE_CHANNEL_COUNT - 1];
+	uint32_t const start = esp_cpu_get_cycle_count();
+
+	for (int i = 0; i < TRACE_CALIBRATION_SAMPLES; i++) {
+		trace_emit((trace_channel) (TRACE_CHANNEL_COUNT - 1), TRACE_EVENT_NONE, i, 0);
+	}
+
+	uint32_t const cycles = esp_cpu_get_cycle_count() - start;
+	s_emit_cost_ns = (cycles * 1000ULL) / ((uint64_t) (esp_clk_cpu_freq() / 1000000) * TRACE_CALIBRATION_SAMPLES);
+	ring->head = 0;
+	ring->tail = 0;
+
+	ESP_LOGI(TAG, "`trace_emit()` costs ~`%lu` ns. Rings: `%zu` bytes.", (unsigned long) s_emit_cost_ns, sizeof(s_rings));
+
+	s_drain_lock = xSemaphoreCreateMutex();
+	s_drain = (trace_record*) heap_caps_malloc(s_drain_size * sizeof(trace_record), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+	ifu(s_drain == NULL) { // No PSRAM. Internal RAM it is, then, and not as much of it.
+		s_drain_size = TRACE_DRAIN_SIZE_INTERNAL;
+		s_drain = (trace_record*) memory_internal_alloc(MEMORY_USER_TRACE, s_drain_size * sizeof(trace_record));
+	}
+
+	ifu(s_drain_lock == NULL || s_drain == NULL) {
+		ESP_LOGE(TAG, "No memory for the trace drain! Tracing disabled.");
+		return ESP_ERR_NO_MEM;
+	}
+
+	// Priority `1`: right above idle. If it falls behind, rings fill and events get counted as dropped. Nothing stalls.
+	ifu(xTaskCreate(trace_drain_task, "trace_drain", 2048, NULL, 1, NULL) != pdPASS) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	return ESP_OK;
+}
+
+esp_err_t trace_handler(httpd_req_t *p_request) {
+	ifu(s_drain == NULL) {
+		return httpd_resp_send_err(p_request, HTTPD_500_INTERNAL_SERVER_ERROR, "Tracing disabled.");
+	}
+
+	httpd_resp_set_type(p_request, "application/octet-stream");
+	httpd_resp_set_hdr(p_request, "Content-Disposition", "attachment; filename=trace.bin");
+	httpd_resp_set_hdr(p_request, "Access-Control-Allow-Origin", "*");
+
+	xSemaphoreTake(s_drain_lock, portMAX_DELAY);
+
+	trace_dump_header header;
+	header.magic = TRACE_MAGIC;
+	header.record_size = sizeof(trace_record);
+	header.record_count = s_drain_count;
+	header.emit_cost_ns = s_emit_cost_ns;
+
+	for (int c = 0; c < TRACE_CHANNEL_COUNT; c++) {
+		header.dropped[c] = s_rings[c].dropped;
+	}
+
+	esp_err_t res = httpd_resp_send_chunk(p_request, (char const*) &header, sizeof(header));
+
+	// Oldest first. The ring may wrap, so that's up to two contiguous runs:
+	uint32_t const first = (s_drain_head + s_drain_size - s_drain_count) % s_drain_size;
+	uint32_t const run = first + s_drain_count > s_drain_size ? s_drain_size - first : s_drain_count;
+
+	ifl(res == ESP_OK && run > 0) {
+		res = httpd_resp_send_chunk(p_request, (char const*) &s_drain[first], run * sizeof(trace_record));
+	}
+
+	ifl(res == ESP_OK && run < s_drain_count) {
+		res = httpd_resp_send_chunk(p_request, (char const*) s_drain, (s_drain_count - run) * sizeof(trace_record));
+	}
+
+	s_drain_count = 0;
+	xSemaphoreGive(s_drain_lock);
+
+	ifu(res != ESP_OK) {
+		return res;
+	}
+
+	return httpd_resp_send_chunk(p_request, NULL, 0);
+}
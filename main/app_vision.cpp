@@ -0,0 +1,351 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <img_converters.h>
+
+#include <dsps_conv.h>
+#include <dspm_mult.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <Arduino.h>
+
+#include "app.h"
+#include "app_boot.hpp"
+#include "app_vision.hpp"
+#include "app_status.hpp"
+#include "app_metrics.hpp"
+#include "app_controls.hpp"
+#include "app_timelapse.hpp"
+#include "app_burst.hpp"
+#include "app_decode.hpp"
+#include "app_memory.hpp"
+#include "protocol_car_controls.hpp"
+
+#define VISION_JPEG_CAPACITY		(48 * 1024) // A `driving` QVGA frame is ~10 KiB. VGA is ~30.
+#define VISION_JPEG_CAPACITY_INTERNAL	(16 * 1024) // Without PSRAM. Bigger frames only get analyzed when the task grabs its own.
+#define VISION_IDLE_WAIT_MS			100
+#define VISION_POLL_KEEPALIVE_US	(2 * 1000 * 1000) // Keep analyzing for this long after the last `/vision` poll.
+
+#define VISION_FLOOR_ROWS			4 // Rows right in front of the bumper. Assumed to be floor; that's where its brightness comes from.
+#define VISION_FLOOR_TOLERANCE		28.0F // Luma distance from the floor's that still counts as floor.
+#define VISION_EDGE_THRESHOLD		30.0F // Vertical gradient that counts as the bottom edge of *something*. ~40 luma steps.
+#define VISION_GAP_ROWS				2 // Non-floor rows to put up with before calling it an obstacle. Specks, tape, reflections...
+#define VISION_STEER_GAIN			2.0F
+
+// Columns of the weight matrix. The first `VISION_SECTOR_COUNT` average one sector each:
+#define VISION_WEIGHT_MEAN			(VISION_SECTOR_COUNT)
+#define VISION_WEIGHT_MOMENT		(VISION_SECTOR_COUNT + 1)
+#define VISION_WEIGHT_COUNT			(VISION_SECTOR_COUNT + 2)
+
+httpd_uri_t g_uri_vision = {
+
+		.uri = "/vision",
+		.method = HTTP_GET,
+		.handler = vision_handler,
+		.user_ctx = NULL,
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+		.is_websocket = false,
+		.handle_ws_control_frames = false,
+		.supported_subprotocol = NULL,
+#endif
+
+};
+
+static char const *TAG = __FILE__;
+static TaskHandle_t s_task = NULL;
+static SemaphoreHandle_t s_result_lock = NULL;
+static vision_result s_result = {};
+static int64_t volatile s_polled_at = INT64_MIN / 2;
+
+// Handed over by `vision_offer()`. `s_busy` says who owns these: `false` - the offering side, `true` - the vision task.
+static bool volatile s_busy = false;
+static uint8_t *s_jpeg = NULL;
+static size_t s_jpeg_capacity = 0;
+static size_t s_jpeg_len = 0;
+static uint16_t s_jpeg_width = 0;
+static uint16_t s_jpeg_height = 0;
+
+// Everything below belongs to the vision task only.
+static uint8_t *s_rgb = NULL; // RGB565, row-major, straight out of the JPEG decoder.
+static float *s_gray = NULL; // Luma, *column*-major, so every column is one contiguous signal for `dsps_conv_f32()`.
+static float s_edge[VISION_MAX_HEIGHT + 4];
+static float s_free[VISION_MAX_WIDTH];
+static float s_free_smooth[VISION_MAX_WIDTH + 2];
+static float s_weights[VISION_MAX_WIDTH * VISION_WEIGHT_COUNT]; // `width` rows, `VISION_WEIGHT_COUNT` columns.
+static float s_sums[VISION_WEIGHT_COUNT];
+static int s_weights_width = 0;
+static bool s_warned_size = false;
+
+// Vertical derivative of a slightly smoothed column. Positive where it gets brighter going *down*.
+static float const s_edge_kernel[] = { 0.125F, 0.25F, 0.0F, -0.25F, -0.125F };
+static float const s_smooth_kernel[] = { 0.25F, 0.5F, 0.25F };
+
+static inline bool vision_wanted() {
+	return !g_carModeControls || esp_timer_get_time() - s_polled_at < VISION_POLL_KEEPALIVE_US;
+}
+
+// One row per column of the image: which sector it's in, `1/width` for the mean, and where it sits from `-1` (left) to `1`.
+// Multiplying the free-space profile by this gets every sum we need in one `dspm_mult_f32()`.
+static void vision_weights_build(int const p_width) {
+	int counts[VISION_SECTOR_COUNT] = {};
+	for (int x = 0; x < p_width; x++) {
+		counts[x * VISION_SECTOR_COUNT / p_width]++;
+	}
+
+	float const half = (p_width - 1) / 2.0F;
+	for (int x = 0; x < p_width; x++) {
+		float *row = &s_weights[x * VISION_WEIGHT_COUNT];
+		int const sector = x * VISION_SECTOR_COUNT / p_width;
+
+		for (int s = 0; s < VISION_SECTOR_COUNT; s++) {
+			row[s] = s == sector ? 1.0F / counts[s] : 0.0F;
+		}
+
+		row[VISION_WEIGHT_MEAN] = 1.0F / p_width;
+		row[VISION_WEIGHT_MOMENT] = (x - half) / (half * p_width);
+	}
+
+	s_weights_width = p_width;
+}
+
+// Floor segmentation, column by column: walk up from the bumper for as long as pixels look like the floor right in front of
+// the car (similar brightness, no strong horizontal edge). How far each column gets is how much free space it has.
+bool vision_analyze(uint8_t const *p_jpeg, size_t const p_len, int const p_width, int const p_height) {
+	int64_t const start = esp_timer_get_time();
+
+	// Smallest downscale that fits. At least `2X`, it's not like we need more:
+	int shift = JPG_SCALE_2X;
+	while (shift <= JPG_SCALE_8X && ((p_width >> shift) > VISION_MAX_WIDTH || (p_height >> shift) > VISION_MAX_HEIGHT)) {
+		shift++;
+	}
+
+	int const w = p_width >> shift;
+	int const h = p_height >> shift;
+
+	ifu(shift > JPG_SCALE_8X || w < VISION_SECTOR_COUNT * 2 || h < VISION_FLOOR_ROWS * 2) {
+		if (!s_warned_size) {
+			ESP_LOGW(TAG, "Can't analyze `%dx%d` frames. Pick a smaller profile!", p_width, p_height);
+			s_warned_size = true;
+		}
+
+		return false;
+	}
+
+	ifu(!decode_jpg2rgb565(p_jpeg, p_len, s_rgb, (jpg_scale_t) shift)) {
+		ESP_LOGW(TAG, "JPEG decode failed.");
+		return false;
+	}
+
+	// The decoder writes each pixel low byte first, so these are native `uint16_t`s:
+	uint16_t const *rgb = (uint16_t const*) s_rgb;
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			uint16_t const pixel = rgb[y * w + x];
+			uint32_t const r = (pixel >> 8) & 0xF8;
+			uint32_t const g = (pixel >> 3) & 0xFC;
+			uint32_t const b = (pixel << 3) & 0xF8;
+			s_gray[x * h + y] = (float) ((r * 77 + g * 150 + b * 29) >> 8);
+		}
+	}
+
+	// What the floor looks like today. Middle third, bottom rows:
+	float floor_sum = 0.0F;
+	int floor_count = 0;
+	for (int x = w / 3; x < w - w / 3; x++) {
+		for (int y = h - VISION_FLOOR_ROWS; y < h; y++) {
+			floor_sum += s_gray[x * h + y];
+			floor_count++;
+		}
+	}
+
+	float const floor_luma = floor_sum / floor_count;
+
+	for (int x = 0; x < w; x++) {
+		float const *column = &s_gray[x * h];
+		dsps_conv_f32(column, h, s_edge_kernel, sizeof(s_edge_kernel) / sizeof(float), s_edge); // `s_edge[y + 2]` is row `y`.
+
+		int top = h; // Topmost row that's still floor, connected to the bumper. `h` means "not even the first one".
+		int gap = 0;
+		for (int y = h - 1; y >= 0; y--) {
+			bool const floor = fabsf(column[y] - floor_luma) < VISION_FLOOR_TOLERANCE && fabsf(s_edge[y + 2]) < VISION_EDGE_THRESHOLD;
+
+			if (floor) {
+				top = y;
+				gap = 0;
+			} else if (++gap > VISION_GAP_ROWS) {
+				break;
+			}
+		}
+
+		s_free[x] = (float) (h - top) / h;
+	}
+
+	// Neighbouring columns shouldn't disagree much. `s_free_smooth[x + 1]` is column `x`:
+	dsps_conv_f32(s_free, w, s_smooth_kernel, sizeof(s_smooth_kernel) / sizeof(float), s_free_smooth);
+
+	if (s_weights_width != w) {
+		vision_weights_build(w);
+	}
+
+	dspm_mult_f32(s_free_smooth + 1, s_weights, s_sums, 1, w, VISION_WEIGHT_COUNT);
+
+	// Steer towards the middle of the free space. Where "the middle" is, is the free-space-weighted mean column position:
+	float const mean = s_sums[VISION_WEIGHT_MEAN];
+	float lean = mean > 0.01F ? VISION_STEER_GAIN * s_sums[VISION_WEIGHT_MOMENT] / mean : 0.0F;
+	lean = lean < -1.0F ? -1.0F : (lean > 1.0F ? 1.0F : lean);
+
+	int const steer = (int) (127.0F + 128.0F * lean);
+	int64_t const compute_us = esp_timer_get_time() - start;
+
+	xSemaphoreTake(s_result_lock, portMAX_DELAY);
+	s_result.sequence++;
+	s_result.compute_us = compute_us;
+	s_result.free_space = (uint8_t) (100.0F * mean + 0.5F);
+	s_result.steer = (uint8_t) (steer < 0 ? 0 : (steer > 255 ? 255 : steer));
+	s_result.width = w;
+	s_result.height = h;
+
+	for (int s = 0; s < VISION_SECTOR_COUNT; s++) {
+		s_result.sectors[s] = (uint8_t) (100.0F * s_sums[s] + 0.5F);
+	}
+
+	xSemaphoreGive(s_result_lock);
+
+	metrics_record(METRICS_STAGE_VISION, compute_us);
+	return true;
+}
+
+static void vision_task(void *p_param) {
+	ifu(!boot_wait_camera(portMAX_DELAY)) {
+		ESP_LOGE(TAG, "No camera, no vision.");
+		s_task = NULL;
+		vTaskDelete(NULL);
+		return;
+	}
+
+	TickType_t wait = pdMS_TO_TICKS(VISION_IDLE_WAIT_MS);
+
+	while (true) {
+		ifl(ulTaskNotifyTake(pdTRUE, wait) > 0) {
+			vision_analyze(s_jpeg, s_jpeg_len, s_jpeg_width, s_jpeg_height);
+			__atomic_store_n(&s_busy, false, __ATOMIC_RELEASE);
+			wait = pdMS_TO_TICKS(VISION_IDLE_WAIT_MS);
+			continue;
+		}
+
+		// Nothing was offered. If nobody's streaming, nobody will offer anything, so get frames ourselves.
+		// `esp_camera_fb_get()` waits for the next frame, so this loop runs at the sensor's frame rate, not faster.
+		if (g_stream_stats.clients > 0 || !vision_wanted() || burst_active()) {
+			wait = pdMS_TO_TICKS(VISION_IDLE_WAIT_MS);
+			continue;
+		}
+
+		timelapse_hold();
+		camera_fb_t *fb = esp_camera_fb_get();
+		timelapse_release();
+
+		ifl(fb != NULL) {
+			if (fb->format == PIXFORMAT_JPEG) {
+				vision_analyze(fb->buf, fb->len, fb->width, fb->height);
+			}
+
+			esp_camera_fb_return(fb);
+		}
+
+		wait = 0;
+	}
+}
+
+esp_err_t vision_init() {
+	s_result_lock = xSemaphoreCreateMutex();
+	s_jpeg_capacity = VISION_JPEG_CAPACITY;
+	s_jpeg = (uint8_t*) heap_caps_malloc(s_jpeg_capacity, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+	s_rgb = (uint8_t*) heap_caps_malloc(VISION_MAX_WIDTH * VISION_MAX_HEIGHT * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+	ifu(s_jpeg == NULL) { // No PSRAM. `driving` frames still fit in this much:
+		s_jpeg_capacity = VISION_JPEG_CAPACITY_INTERNAL;
+		s_jpeg = (uint8_t*) memory_internal_alloc(MEMORY_USER_VISION, s_jpeg_capacity);
+	}
+
+	ifu(s_rgb == NULL) { // Only the downscaled decode goes in here, so it's just 10 KiB.
+		s_rgb = (uint8_t*) memory_internal_alloc(MEMORY_USER_VISION, VISION_MAX_WIDTH * VISION_MAX_HEIGHT * 2);
+	}
+
+	// The float image gets walked over a few times per frame. Internal RAM if at all possible:
+	size_t const gray_size = VISION_MAX_WIDTH * VISION_MAX_HEIGHT * sizeof(float);
+	s_gray = (float*) heap_caps_malloc(gray_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+
+	ifu(s_gray == NULL) {
+		s_gray = (float*) malloc(gray_size);
+	}
+
+	ifu(s_result_lock == NULL || s_jpeg == NULL || s_rgb == NULL || s_gray == NULL) {
+		ESP_LOGE(TAG, "No memory for vision! Obstacle avoidance is on its own.");
+		return ESP_ERR_NO_MEM;
+	}
+
+	// Core `1`, with the camera. Below `httpd` (priority `5`), so the stream never waits on us:
+	ifu(xTaskCreatePinnedToCore(vision_task, "vision", 4096, NULL, 2, &s_task, 1) != pdPASS) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	return ESP_OK;
+}
+
+void vision_offer(camera_fb_t const *p_fb) {
+	ifu(s_task == NULL || p_fb->format != PIXFORMAT_JPEG || p_fb->len > s_jpeg_capacity) {
+		return;
+	}
+
+	ifl(__atomic_load_n(&s_busy, __ATOMIC_ACQUIRE) || !vision_wanted()) {
+		return;
+	}
+
+	memcpy(s_jpeg, p_fb->buf, p_fb->len);
+	s_jpeg_len = p_fb->len;
+	s_jpeg_width = p_fb->width;
+	s_jpeg_height = p_fb->height;
+
+	__atomic_store_n(&s_busy, true, __ATOMIC_RELEASE);
+	xTaskNotifyGive(s_task);
+}
+
+bool vision_get(vision_result *p_out) {
+	ifu(s_result_lock == NULL) {
+		return false;
+	}
+
+	xSemaphoreTake(s_result_lock, portMAX_DELAY);
+	*p_out = s_result;
+	xSemaphoreGive(s_result_lock);
+
+	return p_out->sequence > 0;
+}
+
+esp_err_t vision_handler(httpd_req_t *p_request) {
+	s_polled_at = esp_timer_get_time();
+
+	vision_result result = {};
+	vision_get(&result);
+
+	char json[192];
+	int const len = snprintf(json, sizeof(json),
+		"{\"seq\":%lu,\"compute_us\":%lu,\"free\":%u,\"steer\":%u,\"sectors\":[%u,%u,%u],\"size\":[%u,%u],\"driving\":%s}",
+		(unsigned long) result.sequence, (unsigned long) result.compute_us, result.free_space, result.steer,
+		result.sectors[VISION_SECTOR_LEFT], result.sectors[VISION_SECTOR_CENTER], result.sectors[VISION_SECTOR_RIGHT],
+		result.width, result.height, g_carModeControls ? "false" : "true");
+
+	httpd_resp_set_type(p_request, "application/json");
+	httpd_resp_set_hdr(p_request, "Access-Control-Allow-Origin", "*");
+	return httpd_resp_send(p_request, json, len);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <esp_err.h>
+#include <esp_http_server.h>
+
+// The web UI's files, served straight from where they sit in flash (memory-mapped `.rodata`, already gzipped), never copied.
+// Each one's ETag is an FNV-1a hash of its bytes, worked out by the compiler, so a new build with a changed page gets a new
+// tag by itself. `If-None-Match` that matches gets a bodiless `304`, and the page doesn't cross the Wi-Fi the stream needs.
+#define ASSETS_CACHE_CONTROL	"no-cache" // Revalidate every time. The URL stays the same across firmware updates, and a `304` is cheap.
+#define ASSETS_IF_NONE_MATCH_MAX	256 // Longer `If-None-Match` headers aren't read, and the asset's just sent whole.
+
+struct assets_entry {
+
+	char const *uri;
+	char const *type;
+	char const *encoding; // `NULL` if it's stored as-is.
+	uint8_t const *data;
+	size_t len;
+	uint64_t hash;
+
+};
+
+struct assets_stats {
+
+	uint32_t sent; // `200`s.
+	uint32_t not_modified; // `304`s.
+	uint64_t bytes_saved; // What the `304`s didn't send.
+
+};
+
+extern httpd_uri_t g_uri_index;
+
+// `If-None-Match` against an entity tag (quotes included). Weak comparison, as RFC 9110 wants for it: `W/"x"` matches `"x"`.
+// A list matches if any of its tags does, and `*` matches anything. `test/test_assets.cpp` has the cases.
+bool assets_etag_matches(char const *if_none_match, char const *etag);
+
+void assets_get(assets_stats *out);
+
+esp_err_t assets_handler(httpd_req_t *request);
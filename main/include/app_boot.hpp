@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+// Bits in `g_boot_events`. Everything that used to be a sequential step in `app_main()` is now a bit somebody can wait on!
+#define BOOT_BIT_CAMERA_READY	(1 << 0)
+#define BOOT_BIT_CAMERA_FAILED	(1 << 1)
+#define BOOT_BIT_WIFI_READY		(1 << 2)
+#define BOOT_BIT_SERVER_READY	(1 << 3)
+#define BOOT_BIT_FIRST_FRAME	(1 << 4)
+
+#define BOOT_BITS_CAMERA_DONE	(BOOT_BIT_CAMERA_READY | BOOT_BIT_CAMERA_FAILED)
+
+enum boot_phase {
+
+	BOOT_PHASE_ARDUINO,		// `initArduino()` returned.
+	BOOT_PHASE_WIFI_BEGIN,	// `WiFi.begin()` returned (association runs in the background from here on).
+	BOOT_PHASE_SERVER,		// Both `httpd` instances are listening.
+	BOOT_PHASE_CAMERA,		// `esp_camera_init()` returned and the sensor got its tweaks.
+	BOOT_PHASE_WIFI_IP,		// We got an IP!
+	BOOT_PHASE_FIRST_FRAME,	// `stream_handler()` got its first frame buffer.
+
+	BOOT_PHASE_COUNT,
+
+};
+
+extern EventGroupHandle_t g_boot_events;
+
+void boot_init();
+
+// Records the time of `phase` and sets `bits`, if any. Only the first call per phase does anything.
+void boot_mark(boot_phase phase, EventBits_t bits = 0);
+
+// `true` if *all* of `bits` got set within `timeout`.
+bool boot_wait(EventBits_t bits, TickType_t timeout);
+
+// Blocks until the camera task is done, one way or another. `true` if it actually worked.
+bool boot_wait_camera(TickType_t timeout);
+
+void boot_log_timeline();
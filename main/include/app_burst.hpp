@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <esp_http_server.h>
+
+// `/burst?frames=<n>`: `n` back-to-back UXGA frames, as one `multipart/mixed` response. `esp32-camera` only has its two frame
+// buffers, so each frame's copied out into its own PSRAM allocation and the buffer goes right back to the driver. The pool
+// grows by a frame at a time for as long as the burst lasts, and PSRAM running out just ends it early. No PSRAM at all is a
+// `503`: the camera's buffers are SVGA-sized then.
+// Meanwhile `/stream` waits, and the self-grabbing tasks (`app_vision`, `app_recorder`, `app_timelapse`) skip their turns, so
+// the frames really are consecutive. The last part is JSON with the timestamps, the gaps between them, and the throughput.
+#define BURST_FRAMES_DEFAULT	5
+#define BURST_FRAMES_MAX		10 // Also in `burst_handler()`'s `400` message.
+#define BURST_FLUSH_MAX			4 // Frames started before the switch to UXGA, thrown away at most.
+#define BURST_WAIT_MS			10 // How often `/stream` checks whether a burst's over.
+
+extern httpd_uri_t g_uri_burst;
+
+bool burst_active();
+
+esp_err_t burst_handler(httpd_req_t *request);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <esp_camera.h>
+
+// Single shots, lit by the LED, with no fixed warm-up delay. The frames already in the buffers were exposed before anyone
+// asked, so they go. Then the LED comes on right at a VSYNC edge (predicted from the frame timestamps, then caught by spinning
+// on the pin for the last couple of milliseconds), and the frame that starts one period later is kept: with a rolling shutter,
+// every row of *that* one started exposing after the LED did. Missed the edge? Then it's the second frame to start after the
+// LED came on, which costs half a frame period on average.
+// Assumes exposure fits in one frame period, which holds unless the sensor's night mode stretches frames out.
+#define CAPTURE_VSYNC_LEAD_US	2000 // Start spinning on the pin this long before the predicted edge.
+#define CAPTURE_VSYNC_SPIN_US	4000 // Give up on catching the edge after spinning this long.
+#define CAPTURE_FRAMES_MAX		8 // Fetched per capture, stale ones included. The last one's kept, lit or not.
+
+struct capture_result {
+
+	uint32_t latency_us; // From the call to the kept frame in hand.
+	uint32_t period_us; // The sensor's frame period, as measured.
+	uint32_t thrown; // Stale or unlit frames thrown away.
+	bool synced; // The LED came on at a VSYNC edge.
+
+};
+
+// `config` is what the camera got initialized with, for its VSYNC pin.
+esp_err_t capture_init(camera_config_t const *config);
+
+// Like `esp_camera_fb_get()`, but the frame's exposure started after `light(true)`. `light(false)` comes after, either way.
+// `light` must be quick, and can be `NULL` without an illuminator: then it's just the first frame started after the call.
+camera_fb_t* capture_lit_frame(void (*light)(bool on), capture_result *out);
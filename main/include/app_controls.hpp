@@ -6,6 +6,9 @@
 extern httpd_uri_t g_uri_controls;
 extern int volatile g_carSteerNewValue;
 extern int volatile g_carSteerPreviousValue;
+extern char volatile g_carGearValue; // An `android_gear_value`.
+extern int volatile g_carThrottleValue; // `-127` to `127`. `gear` sets it to one of the ends, or `0`.
+extern bool volatile g_carModeControls; // `false` while the car avoids obstacles on its own.
 
 esp_err_t send_200(httpd_req_t *request);
 esp_err_t send_400(httpd_req_t *request);
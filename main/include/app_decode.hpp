@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <esp_camera.h>
+#include <img_converters.h>
+
+// `esp32-camera`'s `esp_jpg_decode()` keeps its decoder's working memory in one `static` array, so two tasks decoding at once
+// corrupt each other's tables (and pictures). Everything that ends up in there (`jpg2rgb565()`, `fmt2rgb888()` and
+// `frame2bmp()`, on JPEG frames) goes through these instead, which take turns. Each one waits for whoever's decoding.
+
+// Before anything decodes a JPEG.
+esp_err_t decode_init();
+
+bool decode_jpg2rgb565(uint8_t const *src, size_t src_len, uint8_t *out, jpg_scale_t scale);
+bool decode_fmt2rgb888(uint8_t const *src, size_t src_len, pixformat_t format, uint8_t *rgb_buf);
+bool decode_frame2bmp(camera_fb_t *fb, uint8_t **out, size_t *out_len);
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_err.h>
+
+// Steering and throttle don't jump to what `/controls` (or `app_vision`) asks for. They follow it through a motion profile
+// instead, updated every `DRIVE_PERIOD_MS`: speed, acceleration and jerk are all limited. Limits are in `/controls` units
+// (`0` to `255` steering, `-127` to `127` throttle) per second, second² and second³. `test/test_drive.cpp` checks the output against them.
+// Without the link, the gear pins skip the throttle's profile: they're all or nothing, so a ramp would only delay a stop.
+#define DRIVE_PERIOD_MS			5
+#define DRIVE_STEER_SPEED		1200.0F
+#define DRIVE_STEER_ACCEL		8000.0F
+#define DRIVE_STEER_JERK		80000.0F
+#define DRIVE_THROTTLE_SPEED	400.0F
+#define DRIVE_THROTTLE_ACCEL	1500.0F
+#define DRIVE_THROTTLE_JERK		15000.0F
+#define DRIVE_GEAR_DEADBAND		32 // Without the link, the gear pins only say forwards, backwards or stop. Stop below this setpoint.
+#define DRIVE_DT				(DRIVE_PERIOD_MS / 1000.0F)
+#define DRIVE_WINDOW_MAX		64
+
+// Two stages per axis. First a trapezoid: speed and acceleration limited, and braking just in time to land on the target.
+// Then a moving average over `2 * accel / jerk` seconds. Averaging a signal whose acceleration stays within `±accel` over
+// that long can't change acceleration faster than `jerk`, and can't overshoot either, since the trapezoid never does.
+struct drive_axis {
+
+	float speed;
+	float step; // Speed change allowed per tick.
+	int window; // Ticks averaged.
+
+	float position; // Of the trapezoid.
+	float velocity;
+	float history[DRIVE_WINDOW_MAX];
+	float sum;
+	int head;
+
+	int volatile target; // The setpoint, from `/controls`.
+	int64_t set_at_us; // When `target` last changed, for `METRICS_STAGE_DRIVE_SETTLE`. `0` once reached. `__atomic_*()` only!
+
+};
+
+struct drive_output {
+
+	uint8_t steer;
+	int8_t throttle;
+	uint8_t steer_target;
+	int8_t throttle_target;
+
+};
+
+// Starts the profile task. Until the first setpoint (or obstacle-avoidance mode), it leaves the pins alone.
+esp_err_t drive_init();
+
+// Setpoints. Both take effect on the next tick, and never as a step.
+void drive_set_steer(int steer);
+void drive_set_throttle(int throttle);
+
+// What's going out right now.
+void drive_get(drive_output *out);
+
+// One axis of the profile, on its own. The drive task has two.
+void drive_axis_init(drive_axis *axis, float speed, float accel, float jerk, int start);
+
+// One tick towards `target`. Returns the smoothed position.
+float drive_axis_step(drive_axis *axis, int target);
+
+// What the drive task does every `DRIVE_PERIOD_MS`: both axes one tick on, and the result out to `drive_get()` (and the pins).
+void drive_tick();
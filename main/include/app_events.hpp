@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <esp_err.h>
+#include <esp_camera.h>
+#include <esp_http_server.h>
+
+#include "app_recorder.hpp"
+
+// The last `EVENTS_PRE_MS` of frames always sit in a ring, in PSRAM (no PSRAM, no ring, see `app_memory.hpp`). When
+// something happens, they go to the card as a clip, together with the `EVENTS_POST_MS` after it, while the ring keeps
+// filling. Clips are `<number>.mjp` and `<number>.idx` in `EVENTS_DIRECTORY`, in the same format as `app_recorder`'s
+// segments, and don't get deleted to make room for those.
+#define EVENTS_DIRECTORY		RECORDER_MOUNT_POINT "/events"
+#define EVENTS_RING_BYTES		(1536 * 1024) // At UXGA, that's only a second or two. Smaller profiles get closer to `EVENTS_PRE_MS`.
+#define EVENTS_PRE_MS			5000
+#define EVENTS_POST_MS			5000
+#define EVENTS_HARD_STOP		64 // A throttle setpoint of `0` (or reverse) while going at least this fast.
+#define EVENTS_ALIGN			8 // For the `int64_t` in every ring entry.
+
+enum events_cause {
+
+	EVENTS_CAUSE_HARD_STOP = 1 << 0,
+	EVENTS_CAUSE_OBSTACLE_MODE = 1 << 1, // `/controls?mode`, switching obstacle avoidance *on*.
+	EVENTS_CAUSE_WATCHDOG = 1 << 2, // The link went quiet for `LINK_TIMEOUT_MS`. The Arduino stops the motors by itself then.
+	EVENTS_CAUSE_MANUAL = 1 << 3, // `/events?trigger=1`.
+
+};
+
+struct events_stats {
+
+	bool flushing;
+	uint32_t clip; // Last one written, or being written. `0` if none.
+	uint32_t frames; // In the ring.
+	uint32_t ring_used; // Bytes.
+	uint32_t ring_bytes; // `EVENTS_RING_BYTES`. `0` without PSRAM: no ring, no clips.
+	uint32_t ring_ms; // From the oldest frame in the ring to the newest.
+	uint32_t evicted; // Pushed out of the ring, by age or for room.
+	uint32_t dropped; // Not let in: the flush was still reading what would've been evicted.
+	uint32_t clips;
+	uint64_t flushed_bytes;
+	uint32_t flush_bytes_per_s; // Of the last clip, counting only the time spent writing it.
+
+};
+
+// Entries are whole: one never wraps around the end of the buffer. If it doesn't fit before the end, the rest is left as
+// a gap and it goes at `0`. The oldest is always at `tail`, and its `size` says where the next one is, so evicting is
+// `O(1)`: no searching, no freeing, no fragmentation. `test/test_events.cpp` throws random sizes at it.
+struct events_entry {
+
+	uint32_t size; // This, the frame header, the JPEG and padding up to `EVENTS_ALIGN`.
+	uint32_t sequence;
+	recorder_frame_header frame; // Then the JPEG. These two go on the card exactly as they are.
+
+};
+
+struct events_ring {
+
+	uint8_t *buffer;
+	uint32_t capacity;
+	uint32_t head; // Where the next entry goes.
+	uint32_t tail; // The oldest entry.
+	uint32_t end; // Entries stop here, and carry on from `0`. `capacity` when they don't wrap.
+	uint32_t count;
+	uint32_t used; // Bytes in entries. The gap doesn't count.
+
+};
+
+extern httpd_uri_t g_uri_events;
+
+// Only does anything with the card mounted, so after `recorder_init()`.
+esp_err_t events_init();
+
+// `stream_handler()`'s (and the recorder's own grabs) frames. A copy into the ring, evicting as needed. Never waits.
+void events_offer(camera_fb_t const *fb);
+
+// Any task. A trigger during a flush just stretches it.
+void events_trigger(events_cause cause);
+
+void events_get(events_stats *out);
+
+// `EVENTS_DIRECTORY "/00007.mjp"` and friends, like `recorder_segment_path()`.
+void events_clip_path(char *out, size_t capacity, uint32_t clip, bool index);
+
+// JSON with `events_get()`. `?trigger=1` writes a clip.
+esp_err_t events_handler(httpd_req_t *request);
+
+events_entry* events_ring_entry(events_ring const *ring, uint32_t at);
+
+// Where an entry of `size` bytes can go, evicting the oldest ones for room. Never evicts the one at `pinned` though, and
+// gives up with `-1` if it'd have to.
+int32_t events_ring_reserve(events_ring *ring, uint32_t size, uint32_t pinned);
+
+// The entry at `at` (from `events_ring_reserve()`) is written. Makes it the newest.
+void events_ring_commit(events_ring *ring, uint32_t at);
+
+void events_ring_evict(events_ring *ring);
+
+// Only if there *is* a next one!
+uint32_t events_ring_next(events_ring const *ring, uint32_t at);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <esp_http_server.h>
+
+// `FaceRecognition112V1S8` (and `S16`) embeddings. Stored as `int8_t`s with one `float` scale each.
+#define FACES_EMBEDDING_LENGTH	512
+#define FACES_NAME_LENGTH		16
+#define FACES_MATCH_THRESHOLD	0.5F // Cosine similarity. Same as the recognizer's own default.
+
+struct faces_match {
+
+	int id; // `-1` if the database is empty.
+	float similarity; // `-1` to `1`. Cosine similarity with the closest enrolled face.
+
+};
+
+extern httpd_uri_t g_uri_faces;
+
+// Memory-maps the `fr` partition and scans it. Formats it if it holds anything else (like the recognizer's own ID format).
+esp_err_t faces_init();
+
+// Appends a face. Returns its ID, or `-1` if the partition is full (even after compacting it) or broken.
+int faces_enroll(float const *embedding, int length, char const *name);
+
+// Marks the face as deleted. Flash bits only ever get cleared for that, so nothing gets erased or rewritten.
+esp_err_t faces_delete(int id);
+
+// Nearest enrolled face, by cosine similarity. Reads straight out of flash, through the memory map.
+faces_match faces_search(float const *embedding, int length);
+
+int faces_count();
+
+// JSON list of enrolled faces. `?delete=<ID>` deletes one first.
+esp_err_t faces_handler(httpd_req_t *request);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <esp_err.h>
+#include <esp_http_server.h>
+
+// Gets `app_recorder`'s segments and `app_events`' clips off the card, over `camera_httpd`:
+// - `/footage`: JSON listing both, with frame counts and first and last timestamps from their indexes.
+// - `/footage?segment=<n>` (or `?clip=<n>`): the `.mjp`, with `Range:` support. Only up to the last indexed frame, so the
+//   segment being recorded can be pulled too. Add `&index=1` for the `.idx` instead.
+// - `/footage?segment=<n>&at=<us>`: just the JPEG of the last frame at or before that timestamp, found by bisecting the index.
+//   `X-Offset` says where it sits in the segment, for carrying on from there with `Range:`.
+// `tools/footage_fetch.py` pulls a segment the way a player would, checks it against its index, and measures throughput.
+#define FOOTAGE_CHUNK_BYTES	(16 * 1024) // Read from the card and sent in one go. DMA-capable, so the SD driver needn't bounce it.
+#define FOOTAGE_PRIORITY	1 // Below both servers' tasks (`tskIDLE_PRIORITY + 5`), so the live stream always goes first.
+#define FOOTAGE_QUEUE		2 // Requests waiting behind the one being served. More get a `503`.
+
+extern httpd_uri_t g_uri_footage;
+
+// Starts the transfer task. Without a card, `/footage` just answers `404`.
+esp_err_t footage_init();
+
+esp_err_t footage_handler(httpd_req_t *request);
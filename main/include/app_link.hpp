@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_err.h>
+
+#include "protocol_car_link.hpp"
+
+// `1` once the Arduino speaks `protocol_car_link.hpp`. The steering PWM pin becomes our TX and the second gear pin our RX,
+// and steering, gear and mode all go over the link instead.
+#define LINK_ENABLED	0
+
+struct link_stats {
+
+	uint32_t sent;
+	uint32_t acked;
+	uint32_t crc_errors;
+	uint32_t rtt_us; // Of the last acknowledged command.
+	int64_t last_telemetry_us; // `esp_timer_get_time()`. `0` if never.
+	link_telemetry telemetry; // The latest.
+
+};
+
+enum link_parser_state : uint8_t {
+
+	LINK_PARSER_SYNC_0,
+	LINK_PARSER_SYNC_1,
+	LINK_PARSER_TYPE,
+	LINK_PARSER_LENGTH,
+	LINK_PARSER_PAYLOAD,
+	LINK_PARSER_CRC_LOW,
+	LINK_PARSER_CRC_HIGH,
+
+};
+
+struct link_parser {
+
+	link_parser_state state;
+	uint8_t type;
+	uint8_t length;
+	uint8_t index;
+	uint16_t crc; // What came over the wire.
+	uint8_t payload[LINK_MAX_PAYLOAD];
+
+};
+
+// Sets the UART up and starts the link task. Does nothing without `LINK_ENABLED`. The framing's tested on the host, in
+// `test/test_link.cpp`.
+esp_err_t link_init();
+
+// `false` if nothing's been heard from the Arduino for `LINK_TIMEOUT_MS`.
+bool link_get(link_stats *out);
+
+// Feeds one received byte in. `1` once a frame's complete and its CRC checks out, `-1` if the CRC didn't, `0` otherwise.
+// Start `parser` out zeroed.
+int link_parse(link_parser *parser, uint8_t byte);
+
+// Writes a whole frame into `out`, which needs `LINK_FRAME_OVERHEAD + length` bytes. Returns that.
+int link_frame(link_message type, void const *payload, uint8_t length, uint8_t *out);
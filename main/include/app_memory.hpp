@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Internal RAM for what'd go in PSRAM, when there's none (there isn't, in this project's `sdkconfig`). Each module's
+// fallback only gets its share of `MEMORY_INTERNAL_BUDGET`, fixed up front in `app_memory.cpp`, instead of whichever
+// `_init()` runs first getting as much as it asks for. The camera's SVGA frame buffer (~`96` KiB) comes out of internal RAM
+// at the same time, and Wi-Fi, lwIP and every task's stack need what's left after that.
+// A share of `0` means the module stays off without PSRAM: the recorder and the event ring, which only ever held a few
+// frames in internal RAM anyway. `/footage` needs the recorder's card, so it's off too.
+#define MEMORY_INTERNAL_BUDGET		(56 * 1024)
+#define MEMORY_INTERNAL_RESERVE		(32 * 1024) // Free after boot, at the least. Wi-Fi's buffers come and go out of this.
+
+enum memory_user : uint8_t {
+
+	MEMORY_USER_VISION,
+	MEMORY_USER_MOTION,
+	MEMORY_USER_OVERLAY,
+	MEMORY_USER_TRACE,
+	MEMORY_USER_RECORDER,
+	MEMORY_USER_EVENTS,
+	MEMORY_USER_COUNT,
+
+};
+
+// `size` bytes of internal RAM for `user`, if its share has room left. `NULL` otherwise, and the module goes without.
+// Only from `_init()`s, which all run from `app_main()`.
+void* memory_internal_alloc(memory_user user, size_t size);
+
+// Free internal RAM, its largest block, and how much of the budget got taken. Once boot's done taking what it takes.
+void memory_log();
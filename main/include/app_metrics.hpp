@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <esp_http_server.h>
+
+// Log-linear buckets: values below `4` get a bucket each, then every power of two is split into `4` sub-buckets.
+// That's at most 25% relative error on any quantile, for 104 `uint32_t`s per histogram, covering 1 us up to over a minute.
+#define METRICS_HISTOGRAM_SUB_BUCKETS_LOG2	2
+#define METRICS_HISTOGRAM_SUB_BUCKETS		(1 << METRICS_HISTOGRAM_SUB_BUCKETS_LOG2)
+#define METRICS_HISTOGRAM_MAX_LOG2			26
+#define METRICS_HISTOGRAM_BUCKETS			(METRICS_HISTOGRAM_SUB_BUCKETS * (METRICS_HISTOGRAM_MAX_LOG2 - METRICS_HISTOGRAM_SUB_BUCKETS_LOG2 + 2))
+
+enum metrics_stage : uint8_t {
+
+	METRICS_STAGE_CAPTURE_WAIT, // Inside `esp_camera_fb_get()`.
+	METRICS_STAGE_ENCODE, // From having a frame buffer to having JPEG bytes (conversion, drawing face boxes...).
+	METRICS_STAGE_SEND, // The three `httpd_resp_send_chunk()`s.
+	METRICS_STAGE_END_TO_END, // From VSYNC (the frame buffer's timestamp) to the last byte handed to the socket.
+	METRICS_STAGE_VISION, // `vision_analyze()`: downscaled JPEG decode plus floor segmentation. Not part of streaming!
+	METRICS_STAGE_MOTION, // `motion_update()`, when it actually compared two frames.
+	METRICS_STAGE_FACE_DETECT, // One run of `face_task()`: conversion, detection and maybe recognition.
+	METRICS_STAGE_FACE_STALENESS, // Per streamed frame: how much older the frame the face boxes came from is.
+	METRICS_STAGE_FACE_SEARCH, // `faces_search()`: one query against every enrolled face.
+	METRICS_STAGE_OVERLAY, // `overlay_hud()`: drawing the HUD, and compositing it into the JPEG.
+	METRICS_STAGE_LINK_RTT, // A `link_command` going out to the Arduino, until its `link_telemetry` comes back.
+	METRICS_STAGE_DRIVE_SETTLE, // A new `/controls` setpoint, until `app_drive`'s output gets there.
+	METRICS_STAGE_RECORDER_WRITE, // One chunk of a recording, written to the microSD card.
+	METRICS_STAGE_RECORDER_SYNC, // `app_recorder`'s periodic `fsync()`s: the data, then its index entries.
+	METRICS_STAGE_TIMELAPSE_WARMUP, // Waking the sensor up for a time-lapse frame, until a settled one's in hand.
+	METRICS_STAGE_CAPTURE, // `/capture`, from the request to a lit frame in hand.
+	METRICS_STAGE_CONTROL_QUEUE, // `qos_stream_pace()`'s guess at how long a control response waits behind a stream's bytes.
+
+	METRICS_STAGE_COUNT,
+
+};
+
+// Fixed memory. Writers only ever do relaxed atomic adds (`S32C1I` loops on Xtensa, no locks), so readers may see a sample
+// in `count` but not in `sum` yet (or the other way around). Fine for a scrape! `sum` wraps once the samples add up to ~71
+// minutes, which Prometheus' `rate()` takes as a counter reset.
+struct metrics_histogram {
+
+	uint32_t buckets[METRICS_HISTOGRAM_BUCKETS];
+	uint32_t count;
+	uint32_t sum;
+
+};
+
+extern httpd_uri_t g_uri_metrics;
+
+// Times `metrics_record()` once at boot, so the cost of the instrumentation itself gets scraped along with everything else.
+void metrics_init();
+
+void metrics_record(metrics_stage stage, int64_t value_us);
+
+// The biggest value, in microseconds, the bucket holding quantile `q` (`0.0F` to `1.0F`) holds. `0` if nothing was recorded.
+uint32_t metrics_quantile(metrics_histogram const *histogram, float q);
+
+metrics_histogram const* metrics_get(metrics_stage stage);
+
+esp_err_t metrics_handler(httpd_req_t *request);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <esp_camera.h>
+#include <esp_http_server.h>
+
+// The thumbnail every frame gets boiled down to. 7-bit luma, row-major, four pixels per `uint32_t`.
+#define MOTION_WIDTH		40
+#define MOTION_HEIGHT		30
+
+// Blocks are two words wide, so a block row is always exactly two `uint32_t`s.
+#define MOTION_BLOCK_WIDTH	8
+#define MOTION_BLOCK_HEIGHT	6
+#define MOTION_BLOCKS_X		(MOTION_WIDTH / MOTION_BLOCK_WIDTH)
+#define MOTION_BLOCKS_Y		(MOTION_HEIGHT / MOTION_BLOCK_HEIGHT)
+
+#define MOTION_SKIP_LENGTH_PERCENT	5 // JPEG size change that always counts as "changed", motion map or not.
+
+struct motion_result {
+
+	uint32_t sequence; // Frames compared so far.
+	int64_t frame_us; // The frame's own (VSYNC) timestamp.
+	uint32_t bitmap; // Bit `y * MOTION_BLOCKS_X + x` is set if block `(x, y)` changed. Top-left is bit `0`.
+	uint16_t energy; // Mean absolute luma difference, in thousandths of full scale.
+	uint8_t blocks; // Set bits in `bitmap`.
+	uint32_t compute_us;
+
+};
+
+// Frame skipping, for one stream (`/stream?skip=`).
+struct motion_skip {
+
+	uint32_t keepalive_ms; // Unchanged frames still go out this often. `0` never skips.
+	int64_t last_sent_us;
+	size_t last_sent_len;
+
+};
+
+extern httpd_uri_t g_uri_motion;
+
+esp_err_t motion_init();
+
+// Compares `fb` (JPEG) against the previous frame anyone passed in. Cheap enough to run per frame: the JPEG gets decoded at
+// 1/8 scale, which skips the IDCT entirely. `false` if `fb` couldn't be compared (first frame, new frame size, same frame
+// again, another caller mid-update...), in which case `*out` still gets the latest result.
+bool motion_update(camera_fb_t const *fb, motion_result *out);
+
+// Nothing moved and the JPEG is about as big as the last one sent? Then it's the same picture: `true`, skip it. Unless the
+// client hasn't heard from us in `keepalive_ms`. The first frame that *does* move goes out right away. `compared` and
+// `motion` are what `motion_update()` said about the frame.
+bool motion_skip_frame(motion_skip const *skip, bool compared, motion_result const *motion, size_t len, int64_t now_us);
+
+// After a frame went out.
+void motion_skip_sent(motion_skip *skip, size_t len, int64_t now_us);
+
+// The latest result. `false` if there's none yet.
+bool motion_get(motion_result *out);
+
+// JSON with the latest `motion_result`. `?map=1` adds the bitmap as rows of `.` and `#`.
+esp_err_t motion_handler(httpd_req_t *request);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <esp_camera.h>
+#include <esp_http_server.h>
+
+#define OVERLAY_PALETTE_SIZE	4 // Index `0` is always transparent.
+
+// What gets drawn, in frame pixels: one palette index per pixel.
+struct overlay_canvas {
+
+	uint8_t *pixels; // `width * height` of them.
+	int x; // Where the canvas sits in the frame.
+	int y;
+	int width;
+	int height;
+	uint32_t palette[OVERLAY_PALETTE_SIZE]; // `0xRRGGBB`. `palette[0]` is ignored.
+
+};
+
+extern httpd_uri_t g_uri_overlay;
+
+esp_err_t overlay_init();
+
+// Clears the canvas to transparent. Coordinates for drawing are in *frame* pixels, and get clipped to the canvas.
+void overlay_clear(overlay_canvas *canvas);
+void overlay_fill(overlay_canvas *canvas, int x, int y, int width, int height, uint8_t color);
+void overlay_box(overlay_canvas *canvas, int left, int top, int right, int bottom, uint8_t color);
+// Built-in 5x7 font, `6 * scale` pixels per character. Lowercase gets drawn as uppercase.
+void overlay_text(overlay_canvas *canvas, int x, int y, int scale, uint8_t color, char const *text);
+
+// Composites `canvas` into a baseline JPEG, *without* decoding it. Only blocks the canvas actually covers go through the
+// IDCT and back. Everything else is just Huffman-decoded and re-encoded, and whatever comes after the last touched MCU is
+// copied over verbatim. Returns the new length, or `0` if this JPEG can't be done (progressive, restart markers, tables
+// missing a symbol...) or `out` is too small. `out` should have room for at least `len` bytes, plus a bit.
+size_t overlay_jpeg(uint8_t const *jpeg, size_t len, overlay_canvas const *canvas, uint8_t *out, size_t capacity);
+
+// Stamps the HUD (frame timestamp and `/controls` state) into the top-left corner of a JPEG frame. Same return value.
+size_t overlay_hud(camera_fb_t const *fb, uint8_t *out, size_t capacity);
+
+// Grabs a frame and stamps the HUD on it twice: with `overlay_jpeg()`, and by decoding, drawing and re-encoding. JSON with the
+// timings of both. `?image=1` returns the `overlay_jpeg()` result instead.
+esp_err_t overlay_handler(httpd_req_t *request);
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <esp_http_server.h>
+
+#include <freertos/FreeRTOS.h>
+
+enum stream_profile_id : uint8_t {
+
+	STREAM_PROFILE_DRIVING, // Small frames, fast. Latency over everything.
+	STREAM_PROFILE_RECORDING, // Big frames, good quality. For when nobody's steering off the stream.
+	STREAM_PROFILE_LOW_LIGHT, // Gain ceiling up, exposure up, slower XCLK for longer exposures.
+
+	STREAM_PROFILE_COUNT,
+
+};
+
+// Stored as-is in NVS, so: only fixed-width fields, no padding, and bump `PROFILES_NVS_VERSION` when this changes!
+struct __attribute__((packed)) stream_profile {
+
+	uint8_t frame_size; // A `framesize_t`.
+	uint8_t jpeg_quality;
+	uint8_t xclk_mhz;
+
+	int8_t brightness;
+	int8_t contrast;
+	int8_t saturation;
+	int8_t sharpness;
+	int8_t ae_level;
+
+	uint8_t gainceiling;
+	uint8_t aec;
+	uint8_t aec2;
+	uint8_t agc;
+	uint8_t awb;
+	uint8_t vflip;
+	uint8_t hmirror;
+
+};
+
+extern httpd_uri_t g_uri_profile;
+extern stream_profile_id volatile g_profile_active;
+
+// Reads every profile in one go from NVS. Doesn't need the camera, so `app_main()` can call it before `esp_camera_init()` and
+// bake the active profile's XCLK and JPEG quality right into the `camera_config_t`. `false` if nothing was saved yet.
+// Also sets up the frame size lock, so call it before anything else touches the sensor.
+bool profiles_load();
+
+// Everything that sets the sensor's frame size holds this while it does: `profiles_apply()`, `/burst` (for the whole burst,
+// restoring included), `app_radio` and `/control?var=framesize`. Otherwise one of them restores or overwrites a size right
+// from under another. `false` if it's still taken after `wait`.
+bool profiles_framesize_take(TickType_t wait);
+void profiles_framesize_give();
+
+// Seeds the profiles from the sensor's current state if `profiles_load()` found none, then applies the active one.
+// Needs the camera to be up!
+esp_err_t profiles_init();
+
+stream_profile const* profiles_get(stream_profile_id id);
+
+// Applies profile `id` to the sensor. Only touches registers whose value actually differs. Returns the time taken in `*out_us`.
+esp_err_t profiles_apply(stream_profile_id id, int64_t *out_us);
+
+stream_profile_id profiles_id_from_name(char const *name); // `STREAM_PROFILE_COUNT` if there's no such profile.
+char const* profiles_name(stream_profile_id id);
+
+esp_err_t profile_handler(httpd_req_t *request);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <sdkconfig.h>
+#include <esp_err.h>
+#include <esp_http_server.h>
+
+// Controls before pictures. Every connection the servers accept starts out marked DSCP CS6 (its ACKs too, they come off the
+// same PCB), which any WMM mapping (the old precedence one or RFC 8325's) puts in the voice queue. `/stream`'s socket gets
+// re-marked CS1 (background) as soon as it's known to be one.
+// Marks only help past the socket, though: here, a `/controls` response still lands behind whatever JPEG bytes are queued
+// up already. So while someone's steering, the stream paces itself: it guesses how long a control response would wait
+// behind its queue, and if that's over `QOS_CONTROL_LATENCY_MS`, it waits a bit longer between frames (more every frame it
+// stays over, half as much every frame it doesn't).
+#define QOS_CONTROL_TOS			0xC0 // CS6.
+#define QOS_STREAM_TOS			0x20 // CS1.
+#define QOS_CONTROL_ACTIVE_MS	1000 // Since the last `/controls` request. Nobody steering? No pacing.
+#define QOS_CONTROL_LATENCY_MS	15 // About a frame at the sensor's full rate.
+#define QOS_THROTTLE_STEP_MS	5
+#define QOS_THROTTLE_MAX_MS		250
+
+// What can sit in front of a control response: the Wi-Fi driver's TX buffers, which every socket shares. The stream socket's
+// own send buffer doesn't count, since control responses go out through their own sockets, with their own buffers.
+#define QOS_QUEUE_BYTES			(CONFIG_ESP_WIFI_DYNAMIC_TX_BUFFER_NUM * CONFIG_LWIP_TCP_MSS)
+
+struct qos_stats {
+
+	uint32_t throttle_ms; // What the stream waits between frames right now.
+	uint32_t throttled_frames; // Frames that got waited after.
+	uint32_t control_delay_us; // Last guess at how long a control response waits behind the stream.
+
+};
+
+// `httpd_config_t::open_fn`. Marks the connection as control traffic and turns Nagle off on it.
+esp_err_t qos_session_open(httpd_handle_t handle, int sockfd);
+
+// For `/stream`'s socket, right when it starts.
+void qos_mark_stream(int sockfd);
+
+// From `/controls`: someone's steering.
+void qos_control_seen();
+
+// After each frame the stream sends: `bytes` went out in `send_us`, and `period_us` passed since the last one was done.
+// How long to wait before the next one, in milliseconds. Streams share one throttle, it's only ever a guess anyway.
+uint32_t qos_stream_pace(uint32_t send_us, uint32_t period_us, size_t bytes);
+
+void qos_get(qos_stats *out);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <esp_camera.h>
+
+// Keeps `/stream` inside what the Wi-Fi link can carry, before the TCP window collapses and the picture freezes. Every
+// `RADIO_SAMPLE_MS`, it reads the RSSI, guesses the PHY rate from it (IDF 5.1 has no getter for the rate it's actually using,
+// or for TX retries), and takes `RADIO_EFFICIENCY_PERCENT` of that as TCP throughput. Retries and interference show up as the
+// stream draining slower than that, so whatever the stream measured wins if it's lower. RSSI falling? Then it's judged by
+// where it'll be `RADIO_HORIZON_MS` from now.
+// Frames too big for that at `RADIO_FPS_TARGET` step the resolution down, right away. Going back up waits `RADIO_HOLD_MS`, and
+// needs some margin. Past the smallest size, the stream gets spaced out (`radio_frame_interval_ms()`) instead.
+// Whatever size the active profile (or anyone else) picked stays the ceiling. It only kicks in while someone's streaming.
+#define RADIO_SAMPLE_MS				250
+#define RADIO_HORIZON_MS			2000
+#define RADIO_EFFICIENCY_PERCENT	30 // ~20 Mbit/s of TCP out of 65 Mbit/s MCS7. About what an ESP32 manages.
+#define RADIO_HEADROOM_PERCENT		70 // Of the predicted throughput, for the stream. The rest's for controls and wobbles.
+#define RADIO_FPS_TARGET			15
+#define RADIO_UP_MARGIN_PERCENT		130 // Stepping back up needs room for this percent of the bigger size's demand.
+#define RADIO_HOLD_MS				3000 // After any change, before stepping up again.
+#define RADIO_GOODPUT_STALE_MS		5000 // Nothing measured for this long? Then the stream's not pushing the link anymore.
+
+struct radio_stats {
+
+	int8_t rssi; // dBm, the last sample. `0` when not associated.
+	uint32_t predicted_kbps;
+	uint32_t goodput_kbps; // Measured off the stream. `0` if it's not been pushing the link lately.
+	framesize_t wanted; // What whoever set the size picked.
+	framesize_t framesize; // What the stream gets now.
+	uint32_t interval_ms; // Between frames, past the smallest size. `0` otherwise.
+	uint32_t steps_down;
+	uint32_t steps_up;
+
+};
+
+// Starts the governor's task. The governor itself is `app_radio_model`, and `test/test_radio.cpp` replays recorded link
+// traces through it.
+esp_err_t radio_init();
+
+// What the stream should leave between its frames, at least. `0` most of the time.
+uint32_t radio_frame_interval_ms();
+
+void radio_get(radio_stats *out);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_camera.h>
+
+#include "app_radio.hpp"
+
+// `app_radio`'s governor, without the radio: RSSI and goodput in, a frame size and spacing out. No Wi-Fi, no tasks, no
+// clock of its own, so `test/test_radio.cpp` replays recorded link traces through exactly what the car runs.
+#define RADIO_LADDER_COUNT		8
+#define RADIO_RATE_FLOOR_KBPS	1000 // 802.11b's slowest. Still associated, barely.
+
+struct radio_state {
+
+	bool primed;
+	float rssi; // Smoothed, dBm.
+	float slope; // Of `rssi`, in dB per millisecond. Smoothed too.
+	float goodput_kbps; // `0` if the stream hasn't pushed the link lately.
+	int64_t goodput_at_us;
+	uint32_t predicted_kbps;
+	uint8_t step; // Into `g_radio_ladder`.
+	uint32_t interval_ms;
+	int64_t hold_until_us;
+	uint32_t steps_down;
+	uint32_t steps_up;
+
+};
+
+// Biggest first. The governor only ever steps through these, plus whatever size was picked.
+extern framesize_t const g_radio_ladder[RADIO_LADDER_COUNT];
+
+// The PHY rate an RSSI's good for, going by the ESP32's receive sensitivity.
+uint32_t radio_phy_kbps(float rssi);
+
+// The step `wanted` stands in for: the first one no bigger than it. `pixels` gets every step's size, the wanted one's included.
+uint8_t radio_ladder(framesize_t wanted, uint32_t *pixels);
+
+// One RSSI sample, and what the stream measured since the last one (`0` for nothing), into `state->predicted_kbps`.
+void radio_predict(radio_state *state, int8_t rssi, uint32_t phy_max_kbps, uint32_t goodput_kbps, int64_t now_us);
+
+// `frame_bytes` is how big the last frame was, at step `frame_step`'s size. JPEG size goes about with the pixel count.
+// Moves `state->step` and sets `state->interval_ms`, off `state->predicted_kbps`.
+void radio_decide(radio_state *state, uint32_t const *pixels, uint8_t wanted, uint32_t frame_bytes, uint8_t frame_step,
+	int64_t now_us);
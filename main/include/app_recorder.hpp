@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <esp_err.h>
+#include <esp_camera.h>
+#include <esp_http_server.h>
+
+// Segments go to `RECORDER_DIRECTORY` on the microSD card as `<number>.mjp`, each with a `<number>.idx` next to it. A segment
+// is frames back to back, each a `recorder_frame_header` and then the JPEG. Its index is one `recorder_index_entry` per frame.
+// Data gets `fsync()`ed *before* the index entries pointing at it are even written, so whatever the index says is on the card,
+// is. After a power cut, that's everything up to the last sync, which happens every `RECORDER_SYNC_MS`.
+#ifndef RECORDER_MOUNT_POINT // `test/test_recorder.cpp` records into a directory of its own.
+#define RECORDER_MOUNT_POINT	"/sdcard"
+#endif
+#define RECORDER_DIRECTORY		RECORDER_MOUNT_POINT "/rec"
+#define RECORDER_DATA_EXTENSION		"mjp" // 8.3 names only! `sdkconfig` builds FatFs without long file names (`CONFIG_FATFS_LFN_NONE`).
+#define RECORDER_INDEX_EXTENSION	"idx"
+#define RECORDER_SEGMENT_BYTES	(32 * 1024 * 1024) // Allocated in one go when the segment opens, trimmed when it closes.
+#define RECORDER_CHUNK_BYTES	(16 * 1024) // Data goes out in writes this big, each starting on a multiple of it.
+#define RECORDER_RING_BYTES		(1024 * 1024) // PSRAM, between `recorder_offer()` and the writer. Power of two!
+#define RECORDER_SYNC_MS		1000
+#define RECORDER_MAX_FPS		10 // For frames the recorder grabs itself, while nobody streams.
+#define RECORDER_FRAME_MAGIC	0x4D524652 // `RFRM`.
+
+struct recorder_frame_header {
+
+	uint32_t magic;
+	uint32_t length; // Of the JPEG that follows.
+	int64_t timestamp_us; // The frame buffer's.
+
+};
+
+struct recorder_index_entry {
+
+	uint32_t offset; // Of the JPEG itself, in the segment. Its header is right before it.
+	uint32_t length;
+	int64_t timestamp_us;
+
+};
+
+struct recorder_stats {
+
+	bool mounted;
+	bool recording;
+	uint32_t segment; // Being written. `0` if none.
+	uint32_t frames; // Written, since boot.
+	uint32_t dropped; // Ring full (card too slow), or another stream was mid-offer.
+	uint64_t bytes;
+	uint32_t ring_used;
+	uint32_t ring_bytes; // `RECORDER_RING_BYTES`. `0` without PSRAM, which means no recording at all.
+
+};
+
+extern httpd_uri_t g_uri_recorder;
+
+// Mounts the card (1-bit mode: GPIO `2`, `14` and `15`, and the flash LED stays off), recovers the last segment if power
+// went out while it was open, and starts recording. Fails without touching any pins if the car's pins overlap the card's.
+esp_err_t recorder_init();
+
+// `stream_handler()` hands every frame it gets over here. A copy into the ring if there's room, never a wait.
+void recorder_offer(camera_fb_t const *fb);
+
+void recorder_get(recorder_stats *out);
+
+// One round of the writer task: a frame out of the ring and onto the card (or, if none came and nobody streams, one grabbed
+// off the camera), a sync if one's due, and closing the segment once recording's stopped. Only the writer task calls this
+// on the device. `test/test_recorder.cpp` calls it instead, since tasks never run on the host.
+void recorder_tick();
+
+// `RECORDER_DIRECTORY "/00042.mjp"` and friends.
+void recorder_segment_path(char *out, size_t capacity, uint32_t segment, bool index);
+
+// JSON with `recorder_get()`. `?record=0` / `?record=1` stops and starts recording. `?bench=<MiB>` (only while stopped) writes
+// that much to a scratch file the way the recorder does, `&chunk=<bytes>` at a time, and reports the throughput.
+esp_err_t recorder_handler(httpd_req_t *request);
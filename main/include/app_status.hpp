@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <esp_http_server.h>
+
+// CBOR map keys. Integers, not strings, so a whole delta usually fits in a few dozen bytes.
+// **Append only!** Clients hard-code these.
+enum status_field : uint8_t {
+
+	STATUS_FIELD_SEQUENCE, // Always sent. Not a real field; the sequence number this reply brings the client up to.
+
+	// Sensor (from `sensor_t::status`, which the driver caches in RAM. No SCCB reads!):
+	STATUS_FIELD_XCLK,
+	STATUS_FIELD_PIXFORMAT,
+	STATUS_FIELD_FRAMESIZE,
+	STATUS_FIELD_QUALITY,
+	STATUS_FIELD_BRIGHTNESS,
+	STATUS_FIELD_CONTRAST,
+	STATUS_FIELD_SATURATION,
+	STATUS_FIELD_SHARPNESS,
+	STATUS_FIELD_SPECIAL_EFFECT,
+	STATUS_FIELD_WB_MODE,
+	STATUS_FIELD_AWB,
+	STATUS_FIELD_AWB_GAIN,
+	STATUS_FIELD_AEC,
+	STATUS_FIELD_AEC2,
+	STATUS_FIELD_AE_LEVEL,
+	STATUS_FIELD_AEC_VALUE,
+	STATUS_FIELD_AGC,
+	STATUS_FIELD_AGC_GAIN,
+	STATUS_FIELD_GAINCEILING,
+	STATUS_FIELD_BPC,
+	STATUS_FIELD_WPC,
+	STATUS_FIELD_RAW_GMA,
+	STATUS_FIELD_LENC,
+	STATUS_FIELD_HMIRROR,
+	STATUS_FIELD_VFLIP,
+	STATUS_FIELD_DCW,
+	STATUS_FIELD_COLORBAR,
+
+	// Stream:
+	STATUS_FIELD_STREAM_CLIENTS,
+	STATUS_FIELD_STREAM_FRAMES,
+	STATUS_FIELD_STREAM_FRAME_BYTES,
+	STATUS_FIELD_STREAM_FRAME_MS,
+	STATUS_FIELD_PROFILE,
+
+	// Car:
+	STATUS_FIELD_CONTROL_STEER,
+	STATUS_FIELD_CONTROL_GEAR,
+	STATUS_FIELD_CONTROL_MODE,
+	STATUS_FIELD_LED_INTENSITY,
+
+	// Vision:
+	STATUS_FIELD_VISION_FREE_SPACE,
+	STATUS_FIELD_VISION_STEER,
+	STATUS_FIELD_MOTION_ENERGY,
+	STATUS_FIELD_MOTION_BLOCKS,
+	STATUS_FIELD_STREAM_SUPPRESSED,
+
+	// Arduino link (all `0` without `LINK_ENABLED`):
+	STATUS_FIELD_LINK_UP,
+	STATUS_FIELD_LINK_WHEEL_SPEED,
+	STATUS_FIELD_LINK_BATTERY_MV,
+
+	STATUS_FIELD_CONTROL_THROTTLE,
+
+	STATUS_FIELD_COUNT,
+
+};
+
+// Written by `stream_handler()` only. Everyone else just reads.
+struct stream_stats {
+
+	uint32_t volatile clients;
+	uint32_t volatile frames;
+	uint32_t volatile frame_bytes;
+	uint32_t volatile frame_ms;
+	uint32_t volatile suppressed; // Frames not sent because nothing changed. Not in `frames`.
+	uint32_t volatile header_bytes; // The last frame's part header, metadata included. Compare with `frame_bytes`.
+	uint32_t volatile send_us; // The last frame's `httpd_resp_send_chunk()`s. What `app_radio` measures the link by.
+
+};
+
+extern stream_stats g_stream_stats;
+extern httpd_uri_t g_uri_status;
+extern httpd_uri_t g_uri_status_ws;
+
+// Starts the WebSocket push task. Does nothing without `CONFIG_HTTPD_WS_SUPPORT`, and `g_uri_status_ws` isn't registered then.
+esp_err_t status_init(httpd_handle_t server);
+
+// `/status?since=N` replies with a CBOR map of every field that changed after sequence number `N` (so `since=0` gets
+// everything). `&bench=1` adds `X-Cbor-*`/`X-Json-*` headers comparing this against the old `sprintf()` JSON handler,
+// sensor register reads and all.
+esp_err_t status_handler(httpd_req_t *request);
+esp_err_t status_ws_handler(httpd_req_t *request);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <esp_camera.h>
+#include <esp_http_server.h>
+
+// Parked? One frame every `interval`, into `app_recorder`, with the sensor asleep in between: XCLK's LEDC timer paused and
+// `PWDN` held high. Waking it up, the first frames are still exposed for whatever the scene was before, so they get thrown
+// away until one comes out about the same size as the one before it (auto exposure and white balance have settled).
+// Whoever else needs frames (`/stream`, `app_vision`...) holds the sensor awake meanwhile.
+#define TIMELAPSE_INTERVAL_MIN_MS		1000
+#define TIMELAPSE_POWER_UP_MS			10 // Same as `esp_camera_init()` waits after its `PWDN` pulse.
+#define TIMELAPSE_SETTLE_PERCENT		4
+#define TIMELAPSE_WARMUP_FRAMES_MAX		15 // Settled or not, the frame after this many is kept.
+
+struct timelapse_stats {
+
+	uint32_t interval_ms; // `0` when off.
+	bool asleep;
+	uint32_t frames;
+	uint32_t warmup_frames; // Thrown away before the last frame that was kept.
+	uint32_t warmup_us; // From waking up to the kept frame, last time.
+	uint64_t awake_us; // Sensor clocked and powered, since time-lapse was switched on.
+	uint64_t elapsed_us; // Since time-lapse was switched on. `awake_us / elapsed_us` is the sensor's duty cycle.
+
+};
+
+extern httpd_uri_t g_uri_timelapse;
+
+// `config` is what the camera got initialized with, for its `PWDN` pin and XCLK timer. Starts off.
+esp_err_t timelapse_init(camera_config_t const *config);
+
+// `interval_ms` of `0` switches it off, and wakes the sensor up for good.
+void timelapse_set(uint32_t interval_ms);
+bool timelapse_active();
+
+// Wakes the sensor up (if it's asleep, this waits for it to warm up) and keeps it awake until every hold's released.
+void timelapse_hold();
+void timelapse_release();
+
+void timelapse_get(timelapse_stats *out);
+
+// JSON with `timelapse_get()`. `?interval=<s>` sets it, `0` for off.
+esp_err_t timelapse_handler(httpd_req_t *request);
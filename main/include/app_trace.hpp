@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <esp_http_server.h>
+
+#define TRACE_MAGIC			0x31435254 // `TRC1`, little-endian.
+#define TRACE_RING_SIZE		256 // Records per channel. Power of two!
+#define TRACE_DRAIN_SIZE	2048 // Records the drainer keeps for `/trace`.
+#define TRACE_DRAIN_SIZE_INTERNAL	256 // Without PSRAM. Fetch `/trace` more often!
+
+// One ring per *producer*, not per core: two tasks on the same core can still preempt each other mid-write, and then the ring
+// wouldn't be single-producer anymore. Producers are few and fixed, so this costs nothing extra.
+enum trace_channel : uint8_t {
+
+	TRACE_CHANNEL_CAMERA, // `camera_init_task()`. The driver's own `cam_task` is vendored, so frames show up on `STREAM`.
+	TRACE_CHANNEL_STREAM, // `stream_handler()`, including its waits on the driver. The first stream, if there's more than one.
+	TRACE_CHANNEL_CONTROL, // `android_controls_handler()`.
+	TRACE_CHANNEL_STREAM_2, // A second stream, running side by side with the first. Same events.
+
+	TRACE_CHANNEL_COUNT,
+
+};
+
+// **Append only!** `tools/trace_decode.py` knows these by number.
+enum trace_event : uint16_t {
+
+	TRACE_EVENT_NONE,
+
+	TRACE_EVENT_CAMERA_INIT_BEGIN,
+	TRACE_EVENT_CAMERA_INIT_END, // `arg0`: `esp_err_t`.
+	TRACE_EVENT_FB_GET_BEGIN,
+	TRACE_EVENT_FB_GET_END, // `arg0`: bytes, `arg1`: width << 16 | height.
+
+	TRACE_EVENT_STREAM_BEGIN,
+	TRACE_EVENT_STREAM_ENCODE_END, // `arg0`: JPEG bytes.
+	TRACE_EVENT_STREAM_SEND_END, // `arg0`: `esp_err_t`.
+	TRACE_EVENT_STREAM_END, // `arg0`: frames sent.
+
+	TRACE_EVENT_CONTROL_BEGIN, // `arg0`: query length.
+	TRACE_EVENT_CONTROL_STEER, // `arg0`: value.
+	TRACE_EVENT_CONTROL_GEAR, // `arg0`: the gear `char`.
+	TRACE_EVENT_CONTROL_MODE, // `arg0`: `1` if now listening to controls, `0` if avoiding obstacles.
+	TRACE_EVENT_CONTROL_END, // `arg0`: HTTP status. Closes every `TRACE_EVENT_CONTROL_BEGIN`, after the reply went out.
+
+	TRACE_EVENT_STREAM_SKIP, // `arg0`: JPEG bytes not sent, `arg1`: motion energy.
+	TRACE_EVENT_CONTROL_THROTTLE, // `arg0`: value, as an `int32_t`.
+
+	TRACE_EVENT_COUNT,
+
+};
+
+struct __attribute__((packed)) trace_record {
+
+	uint32_t timestamp_us; // Low 32 bits of `esp_timer_get_time()`. Wraps every ~71 minutes; the decoder unwraps it.
+	uint16_t event; // A `trace_event`.
+	uint8_t channel; // A `trace_channel`.
+	uint8_t core;
+	uint32_t arg0;
+	uint32_t arg1;
+
+};
+
+// What `/trace` sends before the records.
+struct __attribute__((packed)) trace_dump_header {
+
+	uint32_t magic;
+	uint16_t record_size;
+	uint16_t record_count;
+	uint32_t emit_cost_ns; // Measured at boot.
+	uint32_t dropped[TRACE_CHANNEL_COUNT]; // Records lost to full rings, ever.
+
+};
+
+extern httpd_uri_t g_uri_trace;
+
+// Benchmarks `trace_emit()` and starts the low-priority drainer.
+esp_err_t trace_init();
+
+// Wait-free. Drops the record (and counts it) if the ring is full, rather than ever blocking a hot path.
+// Only ever call this from the one task that owns `channel`!
+void trace_emit(trace_channel channel, trace_event event, uint32_t arg0 = 0, uint32_t arg1 = 0);
+
+// Sends (and forgets) everything the drainer collected so far, as a `trace_dump_header` followed by `trace_record`s.
+esp_err_t trace_handler(httpd_req_t *request);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <esp_camera.h>
+#include <esp_http_server.h>
+
+// Frames get decoded at 1/2, 1/4 or 1/8 scale, whichever is the biggest that fits in here.
+// QVGA (the `driving` profile) lands on 80x60, and so do VGA and SVGA (well, 100x75 won't, so SVGA gets skipped).
+#define VISION_MAX_WIDTH	80
+#define VISION_MAX_HEIGHT	64
+
+enum vision_sector : uint8_t {
+
+	VISION_SECTOR_LEFT,
+	VISION_SECTOR_CENTER,
+	VISION_SECTOR_RIGHT,
+
+	VISION_SECTOR_COUNT,
+
+};
+
+struct vision_result {
+
+	uint32_t sequence; // Frames analyzed so far. `0` means nothing's been analyzed yet.
+	uint32_t compute_us; // JPEG decode *and* analysis, for this frame.
+	uint8_t free_space; // `0` to `100`: how much of the view, bottom-up, looks like drivable floor.
+	uint8_t steer; // Same scale as `/controls?steer`: `0` is full left, `127` straight, `255` full right.
+	uint8_t sectors[VISION_SECTOR_COUNT]; // `free_space`, but per third of the view.
+	uint8_t width; // Of the downscaled frame.
+	uint8_t height;
+
+};
+
+extern httpd_uri_t g_uri_vision;
+
+// Allocates the buffers and starts the vision task. The task waits for the camera by itself.
+esp_err_t vision_init();
+
+// `stream_handler()` hands every JPEG frame it gets over here. Copies it only if the vision task is idle *and* wants frames
+// (while avoiding obstacles, or while someone polls `/vision`). Never blocks.
+void vision_offer(camera_fb_t const *fb);
+
+// Decodes and analyzes one JPEG frame, then publishes the result. `false` if the frame's too big (or too small) to analyze,
+// or didn't decode. The vision task's buffers are used, so on the device only the vision task calls this. `test/test_vision.cpp`
+// replays recorded frames through it on the host, where that task never runs.
+bool vision_analyze(uint8_t const *jpeg, size_t len, int width, int height);
+
+// The latest result. `false` if there's none yet.
+bool vision_get(vision_result *out);
+
+// JSON with the latest `vision_result`. Polling this also keeps the vision task running outside of obstacle-avoidance mode.
+esp_err_t vision_handler(httpd_req_t *request);
@@ -2,7 +2,7 @@
 
 // File: index_ov2640.html.gz, Size: 6787
 #define index_ov2640_html_gz_len 6787
-const uint8_t index_ov2640_html_gz[] = {
+constexpr uint8_t index_ov2640_html_gz[] = {
 
   0x1F, 0x8B, 0x08, 0x08, 0x23, 0xFC, 0x69, 0x5E, 0x00, 0x03, 0x69, 0x6E, 0x64, 0x65, 0x78, 0x5F, 0x6F, 0x76, 0x32,
   0x36, 0x34, 0x30, 0x2E, 0x68, 0x74, 0x6D, 0x6C, 0x00, 0xED, 0x3D, 0x6B, 0x73, 0xDB, 0x46, 0x92, 0xDF, 0xFD, 0x2B,
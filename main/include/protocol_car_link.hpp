@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+// The serial link between us and the Arduino that drives the motors. Meant to be shared with the Arduino side, like
+// `protocol_car_controls.hpp`. Both ends are little-endian, so the structs below go over the wire as they are.
+//
+// Frame: `LINK_SYNC_0`, `LINK_SYNC_1`, type, payload length, payload, CRC-16/CCITT-FALSE (little-endian) over type, length
+// and payload. A bad CRC drops the frame. The receiver then hunts for the next sync pair, so a lost byte costs that frame,
+// and at worst the next one too.
+//
+// We send `link_command`s every `LINK_PERIOD_MS`. The Arduino answers each with a `link_telemetry`, echoing the sequence
+// number. If it hears nothing valid for `LINK_TIMEOUT_MS`, it should stop the motors on its own.
+
+#define LINK_SYNC_0			0xA5
+#define LINK_SYNC_1			0x5A
+#define LINK_BAUD			250000 // Exact on a 16 MHz AVR. `115200` is `2.1%` off there!
+#define LINK_PERIOD_MS		5 // 200 Hz.
+#define LINK_TIMEOUT_MS		100
+#define LINK_MAX_PAYLOAD	16
+#define LINK_FRAME_OVERHEAD	6 // Sync, type, length, CRC.
+
+enum link_message : uint8_t {
+
+	LINK_MESSAGE_COMMAND = 1, // `link_command`, from us.
+	LINK_MESSAGE_TELEMETRY = 2, // `link_telemetry`, from the Arduino.
+
+};
+
+struct __attribute__((packed)) link_command {
+
+	uint16_t sequence; // Wraps.
+	uint8_t steer; // `0` is full left, `127` straight, `255` full right. What used to be the PWM duty.
+	int8_t throttle; // `-127` (full reverse) to `127` (full forward).
+	uint8_t mode; // `1` under manual control, `0` while avoiding obstacles.
+	uint8_t gear; // An `android_gear_value`, for Arduino firmware that only cares about direction.
+
+};
+
+struct __attribute__((packed)) link_telemetry {
+
+	uint16_t ack; // `sequence` of the last `link_command` received.
+	int16_t wheel_speed; // Millimeters per second. Negative in reverse.
+	uint16_t battery_mv;
+	uint8_t flags; // Arduino-defined. `0` means all's well.
+
+};
+
+static inline uint16_t link_crc16(uint16_t p_crc, uint8_t const *p_data, int p_len) {
+	while (p_len-- > 0) {
+		p_crc ^= (uint16_t) *p_data++ << 8;
+
+		for (int i = 0; i < 8; i++) {
+			p_crc = p_crc & 0x8000 ? (p_crc << 1) ^ 0x1021 : p_crc << 1;
+		}
+	}
+
+	return p_crc;
+}
@@ -4,12 +4,27 @@
 #include <esp_log.h>
 
 #include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <driver/ledc.h>
 
 #include <Arduino.h>
 #include <WiFi.h>
 
 #include "app.h"
+#include "app_boot.hpp"
+#include "app_profiles.hpp"
+#include "app_link.hpp"
+#include "app_drive.hpp"
+#include "app_trace.hpp"
+#include "app_vision.hpp"
+#include "app_recorder.hpp"
+#include "app_events.hpp"
+#include "app_footage.hpp"
+#include "app_timelapse.hpp"
+#include "app_capture.hpp"
+#include "app_radio.hpp"
+#include "app_decode.hpp"
+#include "app_memory.hpp"
 #include "protocol_car_controls.hpp"
 
 // **Changed some files from the IDF to get this to build! (see `managed_components/espressif__arduino-esp32`):**
@@ -34,14 +49,10 @@ const char *password = "ThisIsNotSecure"; // It indeed isn't, because this is av
 extern void startCameraServer();
 // extern void setupLedFlash(int pin);
 
-extern "C" void app_main() {
-	initArduino();
-
-	Serial.begin(11'5200);
-	Serial.setDebugOutput(true);
-	Serial.println();
+static camera_config_t s_camera_config;
 
-	camera_config_t config;
+static void camera_config_build(camera_config_t *p_config) {
+	camera_config_t &config = *p_config;
 
 	config.fb_count = 1;
 	config.jpeg_quality = 12;
@@ -100,16 +111,22 @@ extern "C" void app_main() {
 		config.fb_count = 2;
 #endif
 	}
+}
 
-#if defined(CAMERA_MODEL_ESP_EYE) // Pins `13` and `14` are `INPUT_PULLUP` pins...
-	pinMode(13, INPUT_PULLUP);
-	pinMode(14, INPUT_PULLUP);
-#endif
+// Runs concurrently with Wi-Fi association and the server coming up. SCCB probing is the slow part of this.
+// For `CAMERA_MODEL_AI_THINKER`, `sdkconfig` only enables the sensors that board actually ships with, so `camera_probe()` doesn't
+// knock on the door of every sensor model `esp32-camera` knows about.
+static void camera_init_task(void *p_param) {
+	camera_config_t const &config = *(camera_config_t*) p_param;
 
+	trace_emit(TRACE_CHANNEL_CAMERA, TRACE_EVENT_CAMERA_INIT_BEGIN);
 	// This variable is not reused after this *one* check:
 	esp_err_t const err = esp_camera_init(&config);
+	trace_emit(TRACE_CHANNEL_CAMERA, TRACE_EVENT_CAMERA_INIT_END, err);
 	if (err != ESP_OK) {
 		Serial.printf("Camera init failed with error 0x%x", err);
+		boot_mark(BOOT_PHASE_CAMERA, BOOT_BIT_CAMERA_FAILED);
+		vTaskDelete(NULL);
 		return;
 	}
 
@@ -121,11 +138,6 @@ extern "C" void app_main() {
 		sensor->set_saturation(sensor, -2); // Lower the saturation.
 	}
 
-	// Drop down the frame-size for a higher *initial frame-rate:*
-	if (config.pixel_format == PIXFORMAT_JPEG) {
-		sensor->set_framesize(sensor, FRAMESIZE_QVGA);
-	}
-
 #if defined(CAMERA_MODEL_M5STACK_WIDE) || defined(CAMERA_MODEL_M5STACK_ESP32CAM)
 	sensor->set_vflip(sensor, 1);
 	sensor->set_hmirror(sensor, 1);
@@ -135,35 +147,108 @@ extern "C" void app_main() {
 	sensor->set_vflip(sensor, 1);
 #endif
 
-	// Setup LED FLash if LED pin is defined in camera_pins.h
-#if defined(LED_GPIO_NUM)
-	// setupLedFlash(LED_GPIO_NUM);
+	// The active profile (`driving` on first boot) also drops the frame-size down for a higher *initial frame-rate:*
+	profiles_init();
+
+	boot_mark(BOOT_PHASE_CAMERA, BOOT_BIT_CAMERA_READY);
+	vTaskDelete(NULL);
+}
+
+static void wifi_on_got_ip(arduino_event_id_t p_event) {
+	boot_mark(BOOT_PHASE_WIFI_IP, BOOT_BIT_WIFI_READY);
+}
+
+extern "C" void app_main() {
+	initArduino();
+	boot_init();
+	boot_mark(BOOT_PHASE_ARDUINO);
+
+	Serial.begin(11'5200);
+	Serial.setDebugOutput(true);
+	Serial.println();
+
+	// Before anything that emits events starts running:
+	trace_init();
+
+	// Before the camera's up, or anything that decodes its frames starts:
+	decode_init();
+
+	camera_config_build(&s_camera_config);
+
+	// Saved profile? Start the sensor with its clock and quality right away, instead of fixing them up after `esp_camera_init()`:
+	if (profiles_load()) {
+		stream_profile const *profile = profiles_get(g_profile_active);
+		s_camera_config.xclk_freq_hz = profile->xclk_mhz * 1000000;
+		s_camera_config.jpeg_quality = profile->jpeg_quality;
+	}
+
+#if defined(CAMERA_MODEL_ESP_EYE) // Pins `13` and `14` are `INPUT_PULLUP` pins...
+	pinMode(13, INPUT_PULLUP);
+	pinMode(14, INPUT_PULLUP);
 #endif
 
+	// Association takes the longest, so it goes first. Nothing below needs it to have finished!
+	WiFi.onEvent(wifi_on_got_ip, ARDUINO_EVENT_WIFI_STA_GOT_IP);
 	WiFi.begin(ssid, password);
 	WiFi.setSleep(false);
+	boot_mark(BOOT_PHASE_WIFI_BEGIN);
 
-	while (WiFi.status() != WL_CONNECTED) {
-		delay(500);
-		Serial.print(".");
-	}
+	// Core `1`, since the Wi-Fi task lives on core `0`:
+	xTaskCreatePinnedToCore(camera_init_task, "camera_init", 4096, &s_camera_config, 5, NULL, 1);
 
-	Serial.println();
-	Serial.println("WiFi connected!");
+	// Setup LED FLash if LED pin is defined in camera_pins.h
+#if defined(LED_GPIO_NUM)
+	// setupLedFlash(LED_GPIO_NUM);
+#endif
 
 	// Modding these into `INPUT` pins might help the Arduino not pick up on these:
 	// pinMode(PIN_CAR_ESP_CAM_STEER, OUTPUT);
+#if LINK_ENABLED // These become the link's UART, which `link_init()` sets up.
+	link_init();
+#else
 	pinMode(PIN_CAR_ESP_CAM_1, OUTPUT);
 	pinMode(PIN_CAR_ESP_CAM_2, OUTPUT);
+#endif
+
+	// Before the servers, so `/controls` always has a profile to feed:
+	drive_init();
 
+	// The servers bind to every interface, so they can start listening before we even have an IP.
+	// `stream_handler()` waits for the camera by itself.
 	startCameraServer();
+	boot_mark(BOOT_PHASE_SERVER, BOOT_BIT_SERVER_READY);
+
+	// Waits for the camera on its own, like `stream_handler()`:
+	vision_init();
+
+	// No card, or the car's pins are in its way? Then there's just no recording:
+	recorder_init();
+	events_init();
+	footage_init();
+	timelapse_init(&s_camera_config); // Off until `/timelapse?interval=<s>`.
+	capture_init(&s_camera_config);
+	radio_init(); // Only steps in while someone streams.
+
+	while (!boot_wait(BOOT_BIT_WIFI_READY, pdMS_TO_TICKS(500))) {
+		Serial.print(".");
+	}
+
+	Serial.println();
+	Serial.println("WiFi connected!");
+
+	if (!boot_wait_camera(pdMS_TO_TICKS(5000))) {
+		Serial.println("Camera isn't up! Controls will still work.");
+	}
+
+	boot_log_timeline();
+	memory_log(); // Everything's taken what it's going to, by now.
 
 	// Friendly URL logs!
 
 	auto const ipAddr = WiFi.localIP();
 	const char *ipStr = ipAddr.toString(true).c_str(); // Doesn't print the IP address :/
 
-	Serial.printf("Camera stream! ...Now available on `http://%s:81/stream`. Enjoy!\n", ipStr);
+	Serial.printf("Camera stream! ...Now available on `http://%s/stream`. Enjoy!\n", ipStr); // `:81` with `STREAM_SEPARATE_PORT`.
 	Serial.println("Controls also available!:");
 
 	Serial.println("- Visit / `curl` to move the car backwards:");
@@ -175,6 +260,9 @@ extern "C" void app_main() {
 	Serial.println("- Visit / `curl` to stop the car entirely:");
 	Serial.printf("  `http://%s/controls?gear=N`.\n", ipStr);
 
+	Serial.println("- Visit / `curl` to move the car forwards at half speed (`-127` to `127`):");
+	Serial.printf("  `http://%s/controls?throttle=64`.\n", ipStr);
+
 	Serial.println("- Visit / `curl` to steer the car straight:");
 	Serial.printf("  `http://%s/controls?steer=127`.\n", ipStr);
 
@@ -0,0 +1,14 @@
+#include "app_boot.hpp"
+
+EventGroupHandle_t g_boot_events = NULL;
+
+void boot_mark(boot_phase, EventBits_t) {
+}
+
+bool boot_wait(EventBits_t, TickType_t) {
+	return true;
+}
+
+bool boot_wait_camera(TickType_t) {
+	return true;
+}
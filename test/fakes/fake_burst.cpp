@@ -0,0 +1,5 @@
+#include "app_burst.hpp"
+
+bool burst_active() {
+	return false;
+}
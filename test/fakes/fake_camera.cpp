@@ -0,0 +1,22 @@
+#include <stddef.h>
+
+#include "fakes.h"
+
+static camera_fb_t *s_queued = NULL;
+
+void fake_camera_queue(camera_fb_t *p_fb) {
+	s_queued = p_fb;
+}
+
+camera_fb_t* esp_camera_fb_get() {
+	camera_fb_t *fb = s_queued;
+	s_queued = NULL;
+	return fb;
+}
+
+void esp_camera_fb_return(camera_fb_t*) {
+}
+
+sensor_t* esp_camera_sensor_get() {
+	return NULL;
+}
@@ -0,0 +1,8 @@
+#include "app_controls.hpp"
+#include "protocol_android_controls.hpp"
+
+int volatile g_carSteerNewValue = 0;
+int volatile g_carSteerPreviousValue = 0;
+char volatile g_carGearValue = ANDROID_GEAR_NEUTRAL;
+int volatile g_carThrottleValue = 0;
+bool volatile g_carModeControls = true;
@@ -0,0 +1,6 @@
+#include "app_drive.hpp"
+
+// Straight, and standing still.
+void drive_get(drive_output *p_out) {
+	*p_out = { 127, 0, 127, 0 };
+}
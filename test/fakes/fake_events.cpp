@@ -0,0 +1,20 @@
+#include "fakes.h"
+
+static uint32_t s_triggers;
+static events_cause s_last;
+
+void events_trigger(events_cause const p_cause) {
+	s_triggers++;
+	s_last = p_cause;
+}
+
+uint32_t fake_events_count() {
+	return s_triggers;
+}
+
+events_cause fake_events_last() {
+	return s_last;
+}
+
+void events_offer(camera_fb_t const*) {
+}
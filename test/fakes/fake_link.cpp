@@ -0,0 +1,7 @@
+#include "app_link.hpp"
+
+// Never heard from the Arduino.
+bool link_get(link_stats *p_out) {
+	*p_out = {};
+	return false;
+}
@@ -0,0 +1,17 @@
+#include "fakes.h"
+
+static uint32_t s_counts[METRICS_STAGE_COUNT];
+static int64_t s_last[METRICS_STAGE_COUNT];
+
+void metrics_record(metrics_stage const p_stage, int64_t const p_value_us) {
+	s_counts[p_stage]++;
+	s_last[p_stage] = p_value_us;
+}
+
+uint32_t fake_metrics_count(metrics_stage const p_stage) {
+	return s_counts[p_stage];
+}
+
+int64_t fake_metrics_last(metrics_stage const p_stage) {
+	return s_last[p_stage];
+}
@@ -0,0 +1,3 @@
+#include "app_status.hpp"
+
+stream_stats g_stream_stats = {};
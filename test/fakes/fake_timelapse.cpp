@@ -0,0 +1,11 @@
+#include "app_timelapse.hpp"
+
+bool timelapse_active() {
+	return false;
+}
+
+void timelapse_hold() {
+}
+
+void timelapse_release() {
+}
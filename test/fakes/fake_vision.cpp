@@ -0,0 +1,13 @@
+#include "fakes.h"
+
+static vision_result s_result = {};
+
+void fake_vision_steer(uint8_t const p_steer) {
+	s_result.sequence++;
+	s_result.steer = p_steer;
+}
+
+bool vision_get(vision_result *p_out) {
+	*p_out = s_result;
+	return s_result.sequence != 0;
+}
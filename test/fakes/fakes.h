@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_camera.h>
+
+#include "app_events.hpp"
+#include "app_vision.hpp"
+#include "app_metrics.hpp"
+
+// Stand-ins for the modules a test doesn't build. Each lives in its own file in the `fakes` library, so a test that links the
+// real module never pulls in its fake.
+
+// `fake_metrics.cpp`: how often, and with what, `metrics_record()` got called.
+uint32_t fake_metrics_count(metrics_stage stage);
+int64_t fake_metrics_last(metrics_stage stage);
+
+// `fake_camera.cpp`: `esp_camera_fb_get()` hands out `fb` (once), or `NULL`. No sensor.
+void fake_camera_queue(camera_fb_t *fb);
+
+// `fake_events.cpp`: how many times `events_trigger()` got called, and with what, last.
+uint32_t fake_events_count();
+events_cause fake_events_last();
+
+// `fake_vision.cpp`: a vision result that says to steer like this. `vision_get()` has nothing before the first one.
+void fake_vision_steer(uint8_t steer);
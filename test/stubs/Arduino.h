@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_heap_caps.h"
+
+#define HIGH	1
+#define LOW		0
+#define INPUT	0x01
+#define OUTPUT	0x03
+
+// Follows `g_stub_psram`.
+bool psramFound();
+
+unsigned long millis();
+void pinMode(uint8_t pin, uint8_t mode);
+// Both land in `g_stub_pins`, so tests can see what went out.
+void digitalWrite(uint8_t pin, uint8_t value);
+void analogWrite(uint8_t pin, int value);
+
+#define STUB_PIN_COUNT	40
+extern int g_stub_pins[STUB_PIN_COUNT];
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SDMMC_FREQ_DEFAULT		20000
+#define SDMMC_FREQ_HIGHSPEED	40000
+
+// The "card" is a directory on the host: whatever `begin()` is given as the mount point, relative to where the test runs.
+// Files go through the host's own `open()`, `write()` and `fsync()`. `g_stub_sd_card` says whether there's one in the slot.
+extern bool g_stub_sd_card;
+extern uint64_t g_stub_sd_total_bytes;
+
+class SDMMCFS {
+
+public:
+	bool begin(char const *mountpoint = "/sdcard", bool mode1bit = false, bool format_if_mount_failed = false, int sdmmc_frequency = SDMMC_FREQ_DEFAULT, uint8_t max_open_files = 5);
+	uint64_t totalBytes();
+	uint64_t usedBytes(); // What the files under the mount point take up, holes and all, like FAT would.
+
+};
+
+extern SDMMCFS SD_MMC;
@@ -0,0 +1,23 @@
+#pragma once
+
+typedef enum {
+
+	LEDC_TIMER_0,
+	LEDC_TIMER_1,
+	LEDC_TIMER_2,
+	LEDC_TIMER_3,
+
+} ledc_timer_t;
+
+typedef enum {
+
+	LEDC_CHANNEL_0,
+	LEDC_CHANNEL_1,
+	LEDC_CHANNEL_2,
+	LEDC_CHANNEL_3,
+	LEDC_CHANNEL_4,
+	LEDC_CHANNEL_5,
+	LEDC_CHANNEL_6,
+	LEDC_CHANNEL_7,
+
+} ledc_channel_t;
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+
+// Nothing's ever received, and whatever's written goes nowhere. `test_link.cpp` feeds the parser bytes itself.
+typedef enum {
+
+	UART_NUM_0,
+	UART_NUM_1,
+	UART_NUM_2,
+
+} uart_port_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int uart_read_bytes(uart_port_t port, void *buffer, uint32_t length, TickType_t timeout);
+int uart_write_bytes(uart_port_t port, void const *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
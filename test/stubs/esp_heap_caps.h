@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MALLOC_CAP_EXEC			(1 << 0)
+#define MALLOC_CAP_32BIT		(1 << 1)
+#define MALLOC_CAP_8BIT			(1 << 2)
+#define MALLOC_CAP_DMA			(1 << 3)
+#define MALLOC_CAP_SPIRAM		(1 << 10)
+#define MALLOC_CAP_INTERNAL		(1 << 11)
+#define MALLOC_CAP_DEFAULT		(1 << 12)
+
+// Whether there's "PSRAM" for `MALLOC_CAP_SPIRAM` to come from. Off by default, like in this project's `sdkconfig`.
+extern bool g_stub_psram;
+
+// Everything that's ever been allocated from "internal RAM" and not freed yet, `heap_caps_free()`d or `free()`d alike.
+// Lets tests check that a module's no-PSRAM fallback stays small.
+size_t stub_internal_in_use(void);
+
+void* heap_caps_malloc(size_t size, uint32_t caps);
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void* heap_caps_realloc(void *pointer, size_t size, uint32_t caps);
+void heap_caps_free(void *pointer);
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+
+#ifdef __cplusplus
+}
+#endif
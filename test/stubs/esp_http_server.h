@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "esp_err.h"
+
+// A fake `esp_http_server`: handlers run against an `httpd_req_t` a test filled in, and everything they send back lands
+// in `httpd_req_t::response`. No sockets, no threads.
+typedef void *httpd_handle_t;
+
+typedef enum {
+
+	HTTP_DELETE,
+	HTTP_GET,
+	HTTP_HEAD,
+	HTTP_POST,
+	HTTP_PUT,
+
+} httpd_method_t;
+
+typedef enum {
+
+	HTTPD_500_INTERNAL_SERVER_ERROR,
+	HTTPD_501_METHOD_NOT_IMPLEMENTED,
+	HTTPD_505_VERSION_NOT_SUPPORTED,
+	HTTPD_400_BAD_REQUEST,
+	HTTPD_401_UNAUTHORIZED,
+	HTTPD_403_FORBIDDEN,
+	HTTPD_404_NOT_FOUND,
+	HTTPD_405_METHOD_NOT_ALLOWED,
+	HTTPD_408_REQ_TIMEOUT,
+	HTTPD_411_LENGTH_REQUIRED,
+	HTTPD_414_URI_TOO_LONG,
+	HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE,
+
+} httpd_err_code_t;
+
+#define STUB_HTTPD_MAX_HEADERS	16
+
+struct stub_httpd_header {
+
+	char const *name;
+	char const *value;
+
+};
+
+struct stub_httpd_response {
+
+	char status[32]; // `"200 OK"` unless the handler said otherwise.
+	char type[64];
+	stub_httpd_header headers[STUB_HTTPD_MAX_HEADERS];
+	int header_count;
+	char *body; // `malloc()`ed. Chunks get appended. `stub_httpd_reset()` frees it.
+	size_t body_len;
+	int chunks;
+	bool finished; // `httpd_resp_send()`, or the empty chunk that ends a chunked reply.
+
+};
+
+typedef struct httpd_req {
+
+	httpd_handle_t handle;
+	int method;
+	char const uri[512];
+	size_t content_len;
+	void *user_ctx;
+
+	// What the "client" sent. `query` without the `?`.
+	char const *query;
+	stub_httpd_header request_headers[STUB_HTTPD_MAX_HEADERS];
+	int request_header_count;
+
+	stub_httpd_response response;
+
+} httpd_req_t;
+
+typedef struct httpd_uri {
+
+	char const *uri;
+	httpd_method_t method;
+	esp_err_t (*handler)(httpd_req_t *request);
+	void *user_ctx;
+
+} httpd_uri_t;
+
+// Sets up `request` for `uri` (query string and all). Frees whatever an earlier response left behind, so `request` has to
+// start out zeroed: `httpd_req_t request = {};`.
+void stub_httpd_request(httpd_req_t *request, char const *uri);
+void stub_httpd_add_header(httpd_req_t *request, char const *name, char const *value);
+char const* stub_httpd_response_header(httpd_req_t const *request, char const *name); // `NULL` if not set.
+void stub_httpd_reset(httpd_req_t *request);
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *request, char *buffer, size_t size);
+size_t httpd_req_get_url_query_len(httpd_req_t *request);
+esp_err_t httpd_query_key_value(char const *query, char const *key, char *value, size_t size);
+size_t httpd_req_get_hdr_value_len(httpd_req_t *request, char const *field);
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *request, char const *field, char *value, size_t size);
+int httpd_req_to_sockfd(httpd_req_t *request);
+
+esp_err_t httpd_resp_set_status(httpd_req_t *request, char const *status);
+esp_err_t httpd_resp_set_type(httpd_req_t *request, char const *type);
+esp_err_t httpd_resp_set_hdr(httpd_req_t *request, char const *field, char const *value);
+esp_err_t httpd_resp_send(httpd_req_t *request, char const *buffer, ssize_t length);
+esp_err_t httpd_resp_send_chunk(httpd_req_t *request, char const *buffer, ssize_t length);
+esp_err_t httpd_resp_send_err(httpd_req_t *request, httpd_err_code_t error, char const *message);
+esp_err_t httpd_resp_send_404(httpd_req_t *request);
+esp_err_t httpd_resp_send_500(httpd_req_t *request);
+
+#define HTTPD_RESP_USE_STRLEN	-1
@@ -0,0 +1,9 @@
+#pragma once
+
+// What this project builds against.
+#define ESP_IDF_VERSION_MAJOR	5
+#define ESP_IDF_VERSION_MINOR	1
+#define ESP_IDF_VERSION_PATCH	1
+
+#define ESP_IDF_VERSION_VAL(major, minor, patch) (((major) << 16) | ((minor) << 8) | (patch))
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(ESP_IDF_VERSION_MAJOR, ESP_IDF_VERSION_MINOR, ESP_IDF_VERSION_PATCH)
@@ -0,0 +1,18 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Debug and verbose logs go nowhere. The rest goes to `stderr`, same format as on the device, minus colours.
+void stub_log(char level, char const *tag, char const *format, ...) __attribute__((format(printf, 3, 4)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#define ESP_LOGE(tag, format, ...) stub_log('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) stub_log('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) stub_log('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do { if (0) stub_log('D', tag, format, ##__VA_ARGS__); } while (0)
+#define ESP_LOGV(tag, format, ...) do { if (0) stub_log('V', tag, format, ##__VA_ARGS__); } while (0)
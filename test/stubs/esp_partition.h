@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+
+	ESP_PARTITION_TYPE_APP = 0x00,
+	ESP_PARTITION_TYPE_DATA = 0x01,
+
+} esp_partition_type_t;
+
+typedef enum {
+
+	ESP_PARTITION_SUBTYPE_ANY = 0xFF,
+
+} esp_partition_subtype_t;
+
+typedef enum {
+
+	ESP_PARTITION_MMAP_DATA,
+	ESP_PARTITION_MMAP_INST,
+
+} esp_partition_mmap_memory_t;
+
+typedef uint32_t esp_partition_mmap_handle_t;
+
+typedef struct {
+
+	esp_partition_type_t type;
+	esp_partition_subtype_t subtype;
+	uint32_t address;
+	uint32_t size;
+	uint32_t erase_size;
+	char label[17];
+	bool encrypted;
+
+} esp_partition_t;
+
+// One partition of "flash", in RAM, that behaves like NOR flash: erasing sets whole 4 KiB sectors to `0xFF`, and writing can
+// only ever clear bits. `esp_partition_mmap()` hands out the RAM itself, so writes show up in the map right away.
+esp_partition_t const* stub_partition_create(char const *label, uint32_t size);
+
+// Power cut: after this many more writes and erases, every one fails, until it's set back to `-1` (the default).
+// An erase or write that fails this way doesn't happen at all.
+extern int g_stub_flash_operations_left;
+
+esp_partition_t const* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, char const *label);
+esp_err_t esp_partition_read(esp_partition_t const *partition, size_t offset, void *dst, size_t size);
+esp_err_t esp_partition_write(esp_partition_t const *partition, size_t offset, void const *src, size_t size);
+esp_err_t esp_partition_erase_range(esp_partition_t const *partition, size_t offset, size_t size);
+esp_err_t esp_partition_mmap(esp_partition_t const *partition, size_t offset, size_t size, esp_partition_mmap_memory_t memory,
+	void const **out_ptr, esp_partition_mmap_handle_t *out_handle);
+void esp_partition_munmap(esp_partition_mmap_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,11 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int esp_clk_cpu_freq(void);
+
+#ifdef __cplusplus
+}
+#endif
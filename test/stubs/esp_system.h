@@ -0,0 +1,5 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_attr.h"
+#include "esp_idf_version.h"
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The host's monotonic clock, so timings in tests are real. Starts near `0`, like after a boot.
+int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
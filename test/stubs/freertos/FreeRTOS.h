@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sdkconfig.h"
+
+// Just enough FreeRTOS for modules to build and run on one host thread: tasks never start (tests call whatever the task
+// would've), and nothing ever blocks. Taking a semaphore that isn't there returns `pdFALSE` right away, and doing that
+// with `portMAX_DELAY` aborts, since on the device it would've waited for another task that doesn't exist here.
+typedef uint32_t TickType_t;
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+
+#define pdFALSE			((BaseType_t) 0)
+#define pdTRUE			((BaseType_t) 1)
+#define pdFAIL			pdFALSE
+#define pdPASS			pdTRUE
+#define portMAX_DELAY	((TickType_t) 0xFFFFFFFF)
+#define portTICK_PERIOD_MS	(1000 / CONFIG_FREERTOS_HZ)
+#define pdMS_TO_TICKS(ms)	((TickType_t) (((uint64_t) (ms) * CONFIG_FREERTOS_HZ) / 1000))
+#define pdTICKS_TO_MS(ticks)	((uint32_t) (((uint64_t) (ticks) * 1000) / CONFIG_FREERTOS_HZ))
+
+typedef struct {
+
+	int unused;
+
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED	{ 0 }
+#define portENTER_CRITICAL(mux)			((void) (mux))
+#define portEXIT_CRITICAL(mux)			((void) (mux))
+#define taskENTER_CRITICAL(mux)			((void) (mux))
+#define taskEXIT_CRITICAL(mux)			((void) (mux))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+TickType_t xTaskGetTickCount(void);
+
+#ifdef __cplusplus
+}
+#endif
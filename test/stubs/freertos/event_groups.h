@@ -0,0 +1,6 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef uint32_t EventBits_t;
+typedef struct stub_event_group *EventGroupHandle_t;
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+// A real FIFO, copies and all. Like `xSemaphoreTake()`, receiving from an empty queue returns `pdFALSE` right away (the
+// tick count moves as if it'd waited), and sending to a full one too.
+typedef struct stub_queue *QueueHandle_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, void const *item, TickType_t timeout);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *out_item, TickType_t timeout);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+void vQueueDelete(QueueHandle_t queue);
+
+#ifdef __cplusplus
+}
+#endif
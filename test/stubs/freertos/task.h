@@ -0,0 +1,44 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct stub_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *parameter);
+
+#define tskNO_AFFINITY	0x7FFFFFFF
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hands back a handle, but never runs `function`.
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, char const *name, uint32_t stack, void *parameter, UBaseType_t priority, TaskHandle_t *out_handle, BaseType_t core);
+BaseType_t xTaskCreate(TaskFunction_t function, char const *name, uint32_t stack, void *parameter, UBaseType_t priority, TaskHandle_t *out_handle);
+void vTaskDelete(TaskHandle_t task);
+
+// Moves the clock `xTaskGetTickCount()` reads. `esp_timer_get_time()` is real time, and doesn't care.
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t increment);
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+typedef enum {
+
+	eNoAction,
+	eSetBits,
+	eIncrement,
+	eSetValueWithOverwrite,
+	eSetValueWithoutOverwrite,
+
+} eNotifyAction;
+
+// Notifications go nowhere: the task they're for never runs.
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *out_value, TickType_t timeout);
+BaseType_t xPortGetCoreID(void);
+
+#ifdef __cplusplus
+}
+#endif
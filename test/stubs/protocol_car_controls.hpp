@@ -0,0 +1,7 @@
+#pragma once
+
+// The real one's shared with the Arduino sketch, and lives in that project. Nothing on the host drives pins, so any
+// numbers do, as long as they're not the microSD slot's (`2`, `14` and `15`). `app_recorder` refuses to start otherwise.
+#define PIN_CAR_ESP_CAM_STEER	12
+#define PIN_CAR_ESP_CAM_1		13
+#define PIN_CAR_ESP_CAM_2		16
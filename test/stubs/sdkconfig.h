@@ -0,0 +1,7 @@
+#pragma once
+
+// The bits of `sdkconfig` that code under test reads. Same values as the real one, for the AI-Thinker board.
+#define CONFIG_FREERTOS_HZ 1000
+#define CONFIG_LWIP_TCP_MSS 1440
+#define CONFIG_LWIP_TCP_SND_BUF_DEFAULT 5744
+#define CONFIG_ESP_WIFI_DYNAMIC_TX_BUFFER_NUM 32
@@ -0,0 +1,685 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <map>
+#include <string>
+
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_cpu.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <esp_partition.h>
+#include <esp_http_server.h>
+#include <esp_private/esp_clk.h>
+#include <driver/uart.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <Arduino.h>
+#include <SD_MMC.h>
+
+bool g_stub_psram = false;
+
+static std::map<void*, size_t> s_internal; // Pointer to size, for everything that came from "internal RAM".
+static size_t s_internal_in_use = 0;
+static TickType_t s_ticks = 0;
+
+struct stub_task {
+
+	char name[16];
+
+};
+
+struct stub_semaphore {
+
+	UBaseType_t count;
+	UBaseType_t max;
+
+};
+
+struct stub_queue {
+
+	UBaseType_t length;
+	UBaseType_t item_size;
+	UBaseType_t count;
+	UBaseType_t head;
+	uint8_t items[];
+
+};
+
+// `esp_log`:
+extern "C" void stub_log(char const p_level, char const *p_tag, char const *p_format, ...) {
+	char const *file = strrchr(p_tag, '/'); // Tags are mostly `__FILE__`s.
+	fprintf(stderr, "%c (%lld) %s: ", p_level, (long long) (esp_timer_get_time() / 1000), file == NULL ? p_tag : file + 1);
+
+	va_list args;
+	va_start(args, p_format);
+	vfprintf(stderr, p_format, args);
+	va_end(args);
+
+	fputc('\n', stderr);
+}
+
+extern "C" char const* esp_err_to_name(esp_err_t const p_code) {
+	switch (p_code) {
+		case ESP_OK: return "ESP_OK";
+		case ESP_FAIL: return "ESP_FAIL";
+		case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+		case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+		case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+		case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+		case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+		case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+		case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+		case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+		case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+		default: return "UNKNOWN ERROR";
+	}
+}
+
+// Clocks:
+extern "C" int64_t esp_timer_get_time() {
+	static int64_t start = 0;
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	int64_t const us = now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+	if (start == 0) {
+		start = us - 1;
+	}
+
+	return us - start;
+}
+
+extern "C" uint32_t esp_cpu_get_cycle_count() {
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t) (now.tv_sec * 1000000000ULL + now.tv_nsec);
+}
+
+extern "C" int esp_clk_cpu_freq() {
+	return 1000 * 1000 * 1000;
+}
+
+// Heap:
+extern "C" size_t stub_internal_in_use() {
+	return s_internal_in_use;
+}
+
+extern "C" void* heap_caps_malloc(size_t const p_size, uint32_t const p_caps) {
+	if ((p_caps & MALLOC_CAP_SPIRAM) && !g_stub_psram) {
+		return NULL;
+	}
+
+	void *pointer = malloc(p_size);
+	if (pointer != NULL && !(p_caps & MALLOC_CAP_SPIRAM)) {
+		s_internal[pointer] = p_size;
+		s_internal_in_use += p_size;
+	}
+
+	return pointer;
+}
+
+extern "C" void* heap_caps_calloc(size_t const p_n, size_t const p_size, uint32_t const p_caps) {
+	void *pointer = heap_caps_malloc(p_n * p_size, p_caps);
+	if (pointer != NULL) {
+		memset(pointer, 0, p_n * p_size);
+	}
+
+	return pointer;
+}
+
+extern "C" void heap_caps_free(void *p_pointer) {
+	auto const internal = s_internal.find(p_pointer);
+	if (internal != s_internal.end()) {
+		s_internal_in_use -= internal->second;
+		s_internal.erase(internal);
+	}
+
+	free(p_pointer);
+}
+
+extern "C" void* heap_caps_realloc(void *p_pointer, size_t const p_size, uint32_t const p_caps) {
+	if (p_pointer == NULL) {
+		return heap_caps_malloc(p_size, p_caps);
+	}
+
+	if ((p_caps & MALLOC_CAP_SPIRAM) && !g_stub_psram) {
+		return NULL;
+	}
+
+	size_t old_size = 0;
+	auto const internal = s_internal.find(p_pointer);
+	if (internal != s_internal.end()) {
+		old_size = internal->second;
+		s_internal_in_use -= old_size;
+		s_internal.erase(internal);
+	}
+
+	void *pointer = realloc(p_pointer, p_size);
+	if (pointer == NULL) { // Still the old block.
+		if (old_size > 0) {
+			s_internal[p_pointer] = old_size;
+			s_internal_in_use += old_size;
+		}
+
+		return NULL;
+	}
+
+	if (!(p_caps & MALLOC_CAP_SPIRAM)) {
+		s_internal[pointer] = p_size;
+		s_internal_in_use += p_size;
+	}
+
+	return pointer;
+}
+
+extern "C" size_t heap_caps_get_free_size(uint32_t const p_caps) {
+	return (p_caps & MALLOC_CAP_SPIRAM) && !g_stub_psram ? 0 : 4 * 1024 * 1024;
+}
+
+extern "C" size_t heap_caps_get_largest_free_block(uint32_t const p_caps) {
+	return heap_caps_get_free_size(p_caps);
+}
+
+// FreeRTOS:
+extern "C" TickType_t xTaskGetTickCount() {
+	return s_ticks;
+}
+
+extern "C" BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, char const *p_name, uint32_t, void*, UBaseType_t, TaskHandle_t *p_out_handle, BaseType_t) {
+	stub_task *task = (stub_task*) calloc(1, sizeof(stub_task));
+	snprintf(task->name, sizeof(task->name), "%s", p_name);
+
+	if (p_out_handle != NULL) {
+		*p_out_handle = task;
+	}
+
+	return pdPASS;
+}
+
+extern "C" BaseType_t xTaskCreate(TaskFunction_t p_function, char const *p_name, uint32_t p_stack, void *p_parameter, UBaseType_t p_priority, TaskHandle_t *p_out_handle) {
+	return xTaskCreatePinnedToCore(p_function, p_name, p_stack, p_parameter, p_priority, p_out_handle, tskNO_AFFINITY);
+}
+
+extern "C" void vTaskDelete(TaskHandle_t) {
+}
+
+extern "C" void vTaskDelay(TickType_t const p_ticks) {
+	s_ticks += p_ticks;
+}
+
+extern "C" void vTaskDelayUntil(TickType_t *p_previous_wake, TickType_t const p_increment) {
+	*p_previous_wake += p_increment;
+	s_ticks = *p_previous_wake > s_ticks ? *p_previous_wake : s_ticks;
+}
+
+extern "C" TaskHandle_t xTaskGetCurrentTaskHandle() {
+	static stub_task main_task = { "main" };
+	return &main_task;
+}
+
+extern "C" uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) {
+	return 0;
+}
+
+extern "C" BaseType_t xTaskNotifyGive(TaskHandle_t) {
+	return pdPASS;
+}
+
+extern "C" BaseType_t xTaskNotify(TaskHandle_t, uint32_t, eNotifyAction) {
+	return pdPASS;
+}
+
+extern "C" BaseType_t xTaskNotifyWait(uint32_t, uint32_t, uint32_t *p_out_value, TickType_t const p_timeout) {
+	if (p_timeout == portMAX_DELAY) {
+		fprintf(stderr, "`xTaskNotifyWait()` would wait forever. Nobody else is here to notify!\n");
+		abort();
+	}
+
+	s_ticks += p_timeout;
+	*p_out_value = 0;
+	return pdFALSE;
+}
+
+extern "C" BaseType_t xPortGetCoreID() {
+	return 0;
+}
+
+extern "C" SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t const p_max, UBaseType_t const p_initial) {
+	stub_semaphore *semaphore = (stub_semaphore*) malloc(sizeof(stub_semaphore));
+	semaphore->count = p_initial;
+	semaphore->max = p_max;
+	return semaphore;
+}
+
+extern "C" SemaphoreHandle_t xSemaphoreCreateMutex() {
+	return xSemaphoreCreateCounting(1, 1);
+}
+
+extern "C" SemaphoreHandle_t xSemaphoreCreateBinary() {
+	return xSemaphoreCreateCounting(1, 0);
+}
+
+extern "C" BaseType_t xSemaphoreTake(SemaphoreHandle_t p_semaphore, TickType_t const p_timeout) {
+	if (p_semaphore->count > 0) {
+		p_semaphore->count--;
+		return pdTRUE;
+	}
+
+	if (p_timeout == portMAX_DELAY) {
+		fprintf(stderr, "`xSemaphoreTake()` would wait forever. Nobody else is here to give it back!\n");
+		abort();
+	}
+
+	s_ticks += p_timeout; // As if it waited the whole time.
+	return pdFALSE;
+}
+
+extern "C" BaseType_t xSemaphoreGive(SemaphoreHandle_t p_semaphore) {
+	if (p_semaphore->count >= p_semaphore->max) {
+		return pdFALSE;
+	}
+
+	p_semaphore->count++;
+	return pdTRUE;
+}
+
+extern "C" void vSemaphoreDelete(SemaphoreHandle_t p_semaphore) {
+	free(p_semaphore);
+}
+
+extern "C" QueueHandle_t xQueueCreate(UBaseType_t const p_length, UBaseType_t const p_item_size) {
+	stub_queue *queue = (stub_queue*) calloc(1, sizeof(stub_queue) + p_length * p_item_size);
+	queue->length = p_length;
+	queue->item_size = p_item_size;
+	return queue;
+}
+
+extern "C" BaseType_t xQueueSend(QueueHandle_t p_queue, void const *p_item, TickType_t const p_timeout) {
+	if (p_queue->count == p_queue->length) {
+		s_ticks += p_timeout == portMAX_DELAY ? 0 : p_timeout;
+		return pdFALSE;
+	}
+
+	UBaseType_t const at = (p_queue->head + p_queue->count++) % p_queue->length;
+	memcpy(p_queue->items + at * p_queue->item_size, p_item, p_queue->item_size);
+	return pdTRUE;
+}
+
+extern "C" BaseType_t xQueueReceive(QueueHandle_t p_queue, void *p_out_item, TickType_t const p_timeout) {
+	if (p_queue->count == 0) {
+		if (p_timeout == portMAX_DELAY) {
+			fprintf(stderr, "`xQueueReceive()` would wait forever. Nobody else is here to send anything!\n");
+			abort();
+		}
+
+		s_ticks += p_timeout;
+		return pdFALSE;
+	}
+
+	memcpy(p_out_item, p_queue->items + p_queue->head * p_queue->item_size, p_queue->item_size);
+	p_queue->head = (p_queue->head + 1) % p_queue->length;
+	p_queue->count--;
+	return pdTRUE;
+}
+
+extern "C" UBaseType_t uxQueueMessagesWaiting(QueueHandle_t p_queue) {
+	return p_queue->count;
+}
+
+extern "C" UBaseType_t uxQueueSpacesAvailable(QueueHandle_t p_queue) {
+	return p_queue->length - p_queue->count;
+}
+
+extern "C" void vQueueDelete(QueueHandle_t p_queue) {
+	free(p_queue);
+}
+
+// `esp_partition`:
+#define STUB_FLASH_SECTOR_SIZE	4096
+
+int g_stub_flash_operations_left = -1;
+static esp_partition_t s_partition = {};
+static uint8_t *s_flash = NULL;
+
+static bool stub_flash_operation() {
+	if (g_stub_flash_operations_left == 0) {
+		return false;
+	}
+
+	if (g_stub_flash_operations_left > 0) {
+		g_stub_flash_operations_left--;
+	}
+
+	return true;
+}
+
+extern "C" esp_partition_t const* stub_partition_create(char const *p_label, uint32_t const p_size) {
+	free(s_flash);
+	s_flash = (uint8_t*) malloc(p_size);
+	memset(s_flash, 0xFF, p_size);
+
+	s_partition = {};
+	s_partition.type = ESP_PARTITION_TYPE_DATA;
+	s_partition.size = p_size;
+	s_partition.erase_size = STUB_FLASH_SECTOR_SIZE;
+	snprintf(s_partition.label, sizeof(s_partition.label), "%s", p_label);
+	return &s_partition;
+}
+
+extern "C" esp_partition_t const* esp_partition_find_first(esp_partition_type_t, esp_partition_subtype_t, char const *p_label) {
+	return s_flash != NULL && strcmp(p_label, s_partition.label) == 0 ? &s_partition : NULL;
+}
+
+extern "C" esp_err_t esp_partition_read(esp_partition_t const *p_partition, size_t const p_offset, void *p_dst, size_t const p_size) {
+	if (p_offset + p_size > p_partition->size) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	memcpy(p_dst, s_flash + p_offset, p_size);
+	return ESP_OK;
+}
+
+extern "C" esp_err_t esp_partition_write(esp_partition_t const *p_partition, size_t const p_offset, void const *p_src,
+	size_t const p_size) {
+	if (p_offset + p_size > p_partition->size) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	if (!stub_flash_operation()) {
+		return ESP_FAIL;
+	}
+
+	for (size_t i = 0; i < p_size; i++) {
+		s_flash[p_offset + i] &= ((uint8_t const*) p_src)[i];
+	}
+
+	return ESP_OK;
+}
+
+extern "C" esp_err_t esp_partition_erase_range(esp_partition_t const *p_partition, size_t const p_offset, size_t const p_size) {
+	if (p_offset % STUB_FLASH_SECTOR_SIZE != 0 || p_size % STUB_FLASH_SECTOR_SIZE != 0 || p_offset + p_size > p_partition->size) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	if (!stub_flash_operation()) {
+		return ESP_FAIL;
+	}
+
+	memset(s_flash + p_offset, 0xFF, p_size);
+	return ESP_OK;
+}
+
+extern "C" esp_err_t esp_partition_mmap(esp_partition_t const *p_partition, size_t const p_offset, size_t const p_size,
+	esp_partition_mmap_memory_t, void const **p_out_ptr, esp_partition_mmap_handle_t *p_out_handle) {
+	if (p_offset + p_size > p_partition->size) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	*p_out_ptr = s_flash + p_offset;
+	*p_out_handle = 1;
+	return ESP_OK;
+}
+
+extern "C" void esp_partition_munmap(esp_partition_mmap_handle_t) {
+}
+
+// Arduino:
+bool psramFound() {
+	return g_stub_psram;
+}
+
+unsigned long millis() {
+	return (unsigned long) (esp_timer_get_time() / 1000);
+}
+
+void pinMode(uint8_t, uint8_t) {
+}
+
+int g_stub_pins[STUB_PIN_COUNT] = {};
+
+void digitalWrite(uint8_t p_pin, uint8_t p_value) {
+	g_stub_pins[p_pin % STUB_PIN_COUNT] = p_value;
+}
+
+void analogWrite(uint8_t p_pin, int p_value) {
+	g_stub_pins[p_pin % STUB_PIN_COUNT] = p_value;
+}
+
+// `SD_MMC`:
+bool g_stub_sd_card = true;
+uint64_t g_stub_sd_total_bytes = 8ULL << 30;
+SDMMCFS SD_MMC;
+static std::string s_sd_mount_point;
+
+bool SDMMCFS::begin(char const *p_mount_point, bool, bool, int, uint8_t) {
+	if (!g_stub_sd_card) {
+		return false;
+	}
+
+	s_sd_mount_point = p_mount_point;
+	mkdir(p_mount_point, 0755);
+	return true;
+}
+
+uint64_t SDMMCFS::totalBytes() {
+	return g_stub_sd_total_bytes;
+}
+
+static uint64_t stub_sd_used_bytes(std::string const &p_path) {
+	DIR *directory = opendir(p_path.c_str());
+	uint64_t used = 0;
+
+	for (dirent *entry; directory != NULL && (entry = readdir(directory)) != NULL;) {
+		std::string const path = p_path + "/" + entry->d_name;
+		struct stat info;
+
+		if (entry->d_name[0] == '.' || stat(path.c_str(), &info) != 0) {
+			continue;
+		}
+
+		used += S_ISDIR(info.st_mode) ? stub_sd_used_bytes(path) : (uint64_t) info.st_size;
+	}
+
+	if (directory != NULL) {
+		closedir(directory);
+	}
+
+	return used;
+}
+
+uint64_t SDMMCFS::usedBytes() {
+	return stub_sd_used_bytes(s_sd_mount_point);
+}
+
+// `driver/uart.h`:
+extern "C" int uart_read_bytes(uart_port_t, void*, uint32_t, TickType_t) {
+	return 0;
+}
+
+extern "C" int uart_write_bytes(uart_port_t, void const*, size_t const p_length) {
+	return (int) p_length;
+}
+
+// `esp_http_server`:
+void stub_httpd_reset(httpd_req_t *p_request) {
+	for (int i = 0; i < p_request->response.header_count; i++) {
+		free((char*) p_request->response.headers[i].name);
+		free((char*) p_request->response.headers[i].value);
+	}
+
+	free(p_request->response.body);
+	memset(&p_request->response, 0, sizeof(p_request->response));
+	strcpy(p_request->response.status, "200 OK");
+}
+
+void stub_httpd_request(httpd_req_t *p_request, char const *p_uri) {
+	stub_httpd_reset(p_request);
+	memset((void*) p_request, 0, sizeof(*p_request));
+	p_request->method = HTTP_GET;
+	snprintf((char*) p_request->uri, sizeof(p_request->uri), "%s", p_uri);
+
+	char const *query = strchr(p_request->uri, '?');
+	p_request->query = query == NULL ? NULL : query + 1;
+	stub_httpd_reset(p_request);
+}
+
+void stub_httpd_add_header(httpd_req_t *p_request, char const *p_name, char const *p_value) {
+	if (p_request->request_header_count < STUB_HTTPD_MAX_HEADERS) {
+		p_request->request_headers[p_request->request_header_count++] = { p_name, p_value };
+	}
+}
+
+char const* stub_httpd_response_header(httpd_req_t const *p_request, char const *p_name) {
+	for (int i = 0; i < p_request->response.header_count; i++) {
+		if (strcasecmp(p_request->response.headers[i].name, p_name) == 0) {
+			return p_request->response.headers[i].value;
+		}
+	}
+
+	return NULL;
+}
+
+static char const* stub_httpd_request_header(httpd_req_t *p_request, char const *p_name) {
+	for (int i = 0; i < p_request->request_header_count; i++) {
+		if (strcasecmp(p_request->request_headers[i].name, p_name) == 0) {
+			return p_request->request_headers[i].value;
+		}
+	}
+
+	return NULL;
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t *p_request) {
+	return p_request->query == NULL ? 0 : strlen(p_request->query);
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *p_request, char *p_buffer, size_t const p_size) {
+	if (p_request->query == NULL) {
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	snprintf(p_buffer, p_size, "%s", p_request->query);
+	return strlen(p_request->query) >= p_size ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
+
+// Same rules as the real one: exact key match, value up to the next `&`, truncated (with an error) if it doesn't fit.
+esp_err_t httpd_query_key_value(char const *p_query, char const *p_key, char *p_value, size_t const p_size) {
+	size_t const key_len = strlen(p_key);
+	char const *at = p_query;
+
+	while (at != NULL && *at != '\0') {
+		char const *end = strchr(at, '&');
+		char const *equals = strchr(at, '=');
+		size_t const len = end == NULL ? strlen(at) : (size_t) (end - at);
+
+		if (equals != NULL && (end == NULL || equals < end) && (size_t) (equals - at) == key_len && strncmp(at, p_key, key_len) == 0) {
+			size_t const value_len = len - key_len - 1;
+			size_t const copied = value_len < p_size - 1 ? value_len : p_size - 1;
+			memcpy(p_value, equals + 1, copied);
+			p_value[copied] = '\0';
+			return copied < value_len ? ESP_ERR_INVALID_SIZE : ESP_OK;
+		}
+
+		at = end == NULL ? NULL : end + 1;
+	}
+
+	return ESP_ERR_NOT_FOUND;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *p_request, char const *p_field) {
+	char const *value = stub_httpd_request_header(p_request, p_field);
+	return value == NULL ? 0 : strlen(value);
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *p_request, char const *p_field, char *p_value, size_t const p_size) {
+	char const *value = stub_httpd_request_header(p_request, p_field);
+	if (value == NULL) {
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	snprintf(p_value, p_size, "%s", value);
+	return strlen(value) >= p_size ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
+
+int httpd_req_to_sockfd(httpd_req_t*) {
+	return 54; // Like the first socket `httpd` hands out on the device.
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *p_request, char const *p_status) {
+	snprintf(p_request->response.status, sizeof(p_request->response.status), "%s", p_status);
+	return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *p_request, char const *p_type) {
+	snprintf(p_request->response.type, sizeof(p_request->response.type), "%s", p_type);
+	return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *p_request, char const *p_field, char const *p_value) {
+	stub_httpd_response &response = p_request->response;
+	if (response.header_count >= STUB_HTTPD_MAX_HEADERS) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	// Copied, unlike the real one: that sends them before the handler returns, but tests look at them afterwards.
+	response.headers[response.header_count++] = { strdup(p_field), strdup(p_value) };
+	return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *p_request, char const *p_buffer, ssize_t p_length) {
+	stub_httpd_response &response = p_request->response;
+	if (p_length == HTTPD_RESP_USE_STRLEN) {
+		p_length = p_buffer == NULL ? 0 : strlen(p_buffer);
+	}
+
+	if (p_buffer == NULL || p_length == 0) {
+		response.finished = true;
+		return ESP_OK;
+	}
+
+	response.body = (char*) realloc(response.body, response.body_len + p_length + 1);
+	memcpy(response.body + response.body_len, p_buffer, p_length);
+	response.body_len += p_length;
+	response.body[response.body_len] = '\0';
+	response.chunks++;
+	return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *p_request, char const *p_buffer, ssize_t const p_length) {
+	esp_err_t const err = httpd_resp_send_chunk(p_request, p_buffer, p_length);
+	p_request->response.finished = true;
+	return err;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *p_request, httpd_err_code_t const p_error, char const *p_message) {
+	char const *status = "500 Internal Server Error";
+	switch (p_error) {
+		case HTTPD_400_BAD_REQUEST: status = "400 Bad Request"; break;
+		case HTTPD_404_NOT_FOUND: status = "404 Not Found"; break;
+		case HTTPD_408_REQ_TIMEOUT: status = "408 Request Timeout"; break;
+		default: break;
+	}
+
+	httpd_resp_set_status(p_request, status);
+	httpd_resp_set_type(p_request, "text/html");
+	return httpd_resp_send(p_request, p_message == NULL ? status : p_message, HTTPD_RESP_USE_STRLEN);
+}
+
+esp_err_t httpd_resp_send_404(httpd_req_t *p_request) {
+	return httpd_resp_send_err(p_request, HTTPD_404_NOT_FOUND, NULL);
+}
+
+esp_err_t httpd_resp_send_500(httpd_req_t *p_request) {
+	return httpd_resp_send_err(p_request, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// `esp32-camera`'s software `tjpgd`, with its `LONG`s at 32 bits like on the ESP32. It types them as `long`, which is 64 bits
+// here, and that doubles its quantization tables - `esp_jpg_decode()`'s `3100` byte pool then runs out ("Insufficient memory
+// pool") on every picture.
+#define long int
+#include_next <tjpgd.h>
+#undef long
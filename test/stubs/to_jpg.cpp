@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_camera.h>
+#include <img_converters.h>
+
+#include "jpge.h"
+
+// `esp32-camera`'s `fmt2jpg()`, for the host. Its `to_jpg.cpp` can't build here: its streams return `size_t` where
+// `jpge::output_stream` says `uint`, and those are only the same type on 32-bit targets. Same encoder, same settings
+// (`H2V2`, quality clamped to `1..100`), same 128 KiB output buffer. RGB565, RGB888 and grayscale in.
+static char const *TAG = __FILE__;
+
+class memory_stream : public jpge::output_stream {
+
+	uint8_t *m_buffer;
+	size_t m_capacity;
+	size_t m_len = 0;
+
+public:
+
+	memory_stream(uint8_t *p_buffer, size_t p_capacity) : m_buffer(p_buffer), m_capacity(p_capacity) {
+	}
+
+	virtual bool put_buf(void const *p_data, int p_len) {
+		if (m_len + p_len > m_capacity) {
+			return false;
+		}
+
+		memcpy(m_buffer + m_len, p_data, p_len);
+		m_len += p_len;
+		return true;
+	}
+
+	virtual jpge::uint get_size() const {
+		return m_len;
+	}
+
+};
+
+static void convert_line(uint8_t const *p_src, pixformat_t p_format, uint8_t *p_dst, int p_width, int p_line) {
+	if (p_format == PIXFORMAT_GRAYSCALE) {
+		memcpy(p_dst, p_src + p_line * p_width, p_width);
+	} else if (p_format == PIXFORMAT_RGB888) { // BGR, really.
+		uint8_t const *src = p_src + p_line * p_width * 3;
+		for (int i = 0; i < p_width * 3; i += 3) {
+			*p_dst++ = src[i + 2];
+			*p_dst++ = src[i + 1];
+			*p_dst++ = src[i];
+		}
+	} else { // RGB565, big-endian.
+		uint8_t const *src = p_src + p_line * p_width * 2;
+		for (int i = 0; i < p_width * 2; i += 2) {
+			*p_dst++ = src[i] & 0xF8;
+			*p_dst++ = (src[i] & 0x07) << 5 | (src[i + 1] & 0xE0) >> 3;
+			*p_dst++ = (src[i + 1] & 0x1F) << 3;
+		}
+	}
+}
+
+bool fmt2jpg(uint8_t *p_src, size_t, uint16_t p_width, uint16_t p_height, pixformat_t p_format, uint8_t p_quality, uint8_t **p_out, size_t *p_out_len) {
+	if (p_format != PIXFORMAT_GRAYSCALE && p_format != PIXFORMAT_RGB888 && p_format != PIXFORMAT_RGB565) {
+		ESP_LOGE(TAG, "Format `%d` isn't supported on the host.", p_format);
+		return false;
+	}
+
+	int const channels = p_format == PIXFORMAT_GRAYSCALE ? 1 : 3;
+	jpge::params params;
+	params.m_subsampling = channels == 1 ? jpge::Y_ONLY : jpge::H2V2;
+	params.m_quality = p_quality == 0 ? 1 : (p_quality > 100 ? 100 : p_quality);
+
+	size_t const capacity = 128 * 1024;
+	uint8_t *buffer = (uint8_t*) malloc(capacity);
+	uint8_t *line = (uint8_t*) malloc(p_width * channels);
+	memory_stream stream(buffer, capacity);
+	jpge::jpeg_encoder encoder;
+
+	bool ok = buffer != NULL && line != NULL && encoder.init(&stream, p_width, p_height, channels, params);
+	for (int y = 0; ok && y < p_height; y++) {
+		convert_line(p_src, p_format, line, p_width, y);
+		ok = encoder.process_scanline(line);
+	}
+
+	ok = ok && encoder.process_scanline(NULL);
+	encoder.deinit();
+	free(line);
+
+	if (!ok) {
+		ESP_LOGE(TAG, "JPEG encoding failed.");
+		free(buffer);
+		return false;
+	}
+
+	*p_out = buffer;
+	*p_out_len = stream.get_size();
+	return true;
+}
+
+bool frame2jpg(camera_fb_t *p_fb, uint8_t p_quality, uint8_t **p_out, size_t *p_out_len) {
+	return fmt2jpg(p_fb->buf, p_fb->len, p_fb->width, p_fb->height, p_fb->format, p_quality, p_out, p_out_len);
+}
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_camera.h>
+#include <img_converters.h>
+
+#include "app_recorder.hpp"
+
+#include "test.h"
+
+uint8_t* test_read_file(char const *p_path, size_t *p_out_len) {
+	FILE *file = fopen(p_path, "rb");
+	if (file == NULL) {
+		return NULL;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long const len = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	uint8_t *data = (uint8_t*) malloc(len > 0 ? len : 1);
+	if (data != NULL && fread(data, 1, len, file) != (size_t) len) {
+		free(data);
+		data = NULL;
+	}
+
+	fclose(file);
+	*p_out_len = len;
+	return data;
+}
+
+bool test_name_8_3(char const *p_path) {
+	for (char const *part = p_path; *part != '\0';) {
+		size_t const len = strcspn(part, "/");
+		char const *dot = (char const*) memchr(part, '.', len);
+		size_t const base = dot == NULL ? len : dot - part;
+		size_t const extension = dot == NULL ? 0 : len - base - 1;
+
+		if (len > 0 && (base == 0 || base > 8 || extension > 3 || (dot != NULL && memchr(dot + 1, '.', extension) != NULL))) {
+			return false;
+		}
+
+		for (size_t i = 0; i < len; i++) {
+			if (strchr("\"*+,:;<=>?[\\]|", part[i]) != NULL || part[i] < ' ') {
+				return false;
+			}
+		}
+
+		part += len + (part[len] == '/');
+	}
+
+	return true;
+}
+
+bool test_jpeg_size(uint8_t const *p_jpeg, size_t const p_len, uint16_t *p_width, uint16_t *p_height) {
+	size_t i = 2;
+
+	while (i + 9 < p_len) {
+		if (p_jpeg[i] != 0xFF) {
+			return false;
+		}
+
+		uint8_t const marker = p_jpeg[i + 1];
+		size_t const len = (p_jpeg[i + 2] << 8) | p_jpeg[i + 3];
+
+		if (marker == 0xC0) {
+			*p_height = (p_jpeg[i + 5] << 8) | p_jpeg[i + 6];
+			*p_width = (p_jpeg[i + 7] << 8) | p_jpeg[i + 8];
+			return true;
+		}
+
+		i += 2 + len;
+	}
+
+	return false;
+}
+
+bool test_pictures(test_picture *p_out, size_t *p_count) {
+	static char const *names[] = { "test_inside.jpeg", "test_outside.jpeg", "testimg.jpeg" };
+	size_t count = 0;
+
+	for (char const *name : names) {
+		char path[512];
+		snprintf(path, sizeof(path), "%s/%s", TEST_PICTURES_DIR, name);
+
+		test_picture &picture = p_out[count];
+		picture.name = name;
+		picture.jpeg = test_read_file(path, &picture.len);
+
+		if (picture.jpeg == NULL || !test_jpeg_size(picture.jpeg, picture.len, &picture.width, &picture.height)) {
+			fprintf(stderr, "Couldn't read `%s`!\n", path);
+			return false;
+		}
+
+		count++;
+	}
+
+	*p_count = count;
+	return true;
+}
+
+uint8_t* test_jpeg_encode(uint16_t const *p_rgb565, int const p_width, int const p_height, int const p_quality, size_t *p_out_len) {
+	// `fmt2jpg()` wants RGB565 big-endian, the way the sensor sends it:
+	size_t const pixels = (size_t) p_width * p_height;
+	uint8_t *swapped = (uint8_t*) malloc(pixels * 2);
+
+	for (size_t i = 0; i < pixels; i++) {
+		swapped[i * 2] = p_rgb565[i] >> 8;
+		swapped[i * 2 + 1] = p_rgb565[i] & 0xFF;
+	}
+
+	uint8_t *jpeg = NULL;
+	bool const ok = fmt2jpg(swapped, pixels * 2, p_width, p_height, PIXFORMAT_RGB565, p_quality, &jpeg, p_out_len);
+	free(swapped);
+	return ok ? jpeg : NULL;
+}
+
+size_t test_frames_load(char const *p_path, test_frame *p_out, size_t const p_capacity) {
+	size_t len = 0;
+	uint8_t *data = test_read_file(p_path, &len);
+	if (data == NULL || len < 4) {
+		free(data);
+		return 0;
+	}
+
+	size_t count = 0;
+
+	if (data[0] == 0xFF && data[1] == 0xD8) {
+		test_frame &frame = p_out[count];
+		frame.file = data;
+		frame.jpeg = data;
+		frame.len = len;
+		frame.timestamp_us = 0;
+		count += test_jpeg_size(frame.jpeg, frame.len, &frame.width, &frame.height) ? 1 : 0;
+	} else {
+		// Segments get trimmed at the last frame that was synced, so a frame running off the end means the card got pulled.
+		size_t offset = 0;
+		while (count < p_capacity && offset + sizeof(recorder_frame_header) <= len) {
+			recorder_frame_header header;
+			memcpy(&header, data + offset, sizeof(header));
+			offset += sizeof(header);
+
+			if (header.magic != RECORDER_FRAME_MAGIC || offset + header.length > len) {
+				break;
+			}
+
+			test_frame &frame = p_out[count];
+			frame.file = data;
+			frame.jpeg = data + offset;
+			frame.len = header.length;
+			frame.timestamp_us = header.timestamp_us;
+			offset += header.length;
+
+			if (test_jpeg_size(frame.jpeg, frame.len, &frame.width, &frame.height)) {
+				count++;
+			}
+		}
+	}
+
+	if (count == 0) {
+		free(data);
+	}
+
+	return count;
+}
+
+void test_frames_free(test_frame *p_frames, size_t const p_count) {
+	if (p_count > 0) {
+		free(p_frames[0].file);
+	}
+}
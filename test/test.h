@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Every test is its own executable, and `ctest` only looks at the exit code. `CHECK()`s keep going after failing, so one
+// run shows everything that's off. End `main()` with `return TEST_RESULT();`.
+inline int g_test_failures = 0;
+
+#define CHECK(x) do { \
+		if (!(x)) { \
+			fprintf(stderr, "%s:%d: `CHECK(%s)` failed!\n", __FILE__, __LINE__, #x); \
+			g_test_failures++; \
+		} \
+	} while (false)
+
+#define CHECK_EQ(a, b) do { \
+		long long const check_a = (long long) (a); \
+		long long const check_b = (long long) (b); \
+		if (check_a != check_b) { \
+			fprintf(stderr, "%s:%d: `CHECK_EQ(%s, %s)` failed: `%lld` vs. `%lld`!\n", __FILE__, __LINE__, #a, #b, check_a, check_b); \
+			g_test_failures++; \
+		} \
+	} while (false)
+
+#define TEST_RESULT() (g_test_failures == 0 ? 0 : (fprintf(stderr, "`%d` checks failed.\n", g_test_failures), 1))
+
+// Whole file into a `malloc()`ed buffer. `NULL` if it couldn't be read.
+uint8_t* test_read_file(char const *path, size_t *out_len);
+
+// Whether every part of `path` is a valid 8.3 name: what FatFs takes without long file names, like `sdkconfig` builds it.
+bool test_name_8_3(char const *path);
+
+// For `test_pictures()`. `TEST_PICTURES_DIR` comes from `CMakeLists.txt`: `esp32-camera`'s own test pictures.
+struct test_picture {
+
+	char const *name;
+	uint8_t *jpeg;
+	size_t len;
+	uint16_t width;
+	uint16_t height;
+
+};
+
+// `QVGA`, `480x320` and `227x149`. `false` if they're not there (no `managed_components`?).
+bool test_pictures(test_picture *out, size_t *count);
+
+// From the JPEG's `SOF0` marker. `false` if there's none.
+bool test_jpeg_size(uint8_t const *jpeg, size_t len, uint16_t *width, uint16_t *height);
+
+// RGB565 (native byte order, like `jpg2rgb565()` writes it) to a `malloc()`ed JPEG, with `esp32-camera`'s own encoder.
+uint8_t* test_jpeg_encode(uint16_t const *rgb565, int width, int height, int quality, size_t *out_len);
+
+inline uint16_t test_rgb565(int r, int g, int b) {
+	return (uint16_t) (((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+}
+
+struct test_frame {
+
+	uint8_t *file; // What was read, shared by every frame from the same file. `test_frames_free()` frees it.
+	uint8_t *jpeg; // Somewhere in `file`.
+	size_t len;
+	uint16_t width;
+	uint16_t height;
+	int64_t timestamp_us; // From the segment. `0` for lone JPEGs.
+
+};
+
+// Every frame in `path`: a lone JPEG, or a recorder segment (`<number>.mjp`, see `app_recorder.hpp`) pulled off the card or
+// through `/footage`. `0` if there were none, or the file couldn't be read. Frees what one call loaded.
+size_t test_frames_load(char const *path, test_frame *out, size_t capacity);
+void test_frames_free(test_frame *frames, size_t count);
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "app_assets.hpp"
+#include "camera_index.h"
+
+#include "test.h"
+
+// `If-None-Match` parsing, what `assets_init()` used to check at every boot. Then `/` through `assets_handler()`: a `200`
+// with the page and its ETag, a `304` for that ETag, and a `200` again for anything else.
+static void test_etag_matches() {
+	struct {
+		char const *if_none_match;
+		bool matches;
+	} const cases[] = {
+		{ "\"0123\"", true },
+		{ "W/\"0123\"", true },
+		{ "*", true },
+		{ "\"abcd\", \"0123\"", true },
+		{ "\"abcd\",W/\"0123\" , \"ef\"", true },
+		{ "\"abcd\",\"0123", false },
+		{ "\"012\"", false },
+		{ "\"01234\"", false },
+		{ "0123", false },
+		{ "\"a,b\", \"0123\"", true },
+		{ "", false },
+		{ " , ,", false },
+		{ "W/", false },
+	};
+
+	for (auto const &test : cases) {
+		bool const matches = assets_etag_matches(test.if_none_match, "\"0123\"");
+		if (matches != test.matches) {
+			fprintf(stderr, "`If-None-Match: %s`: ", test.if_none_match);
+		}
+
+		CHECK_EQ(matches, test.matches);
+	}
+}
+
+static void test_handler() {
+	httpd_req_t request = {};
+	assets_stats before, after;
+	assets_get(&before);
+
+	// First visit:
+	stub_httpd_request(&request, "/");
+	CHECK_EQ(assets_handler(&request), ESP_OK);
+	CHECK(strcmp(request.response.status, "200 OK") == 0);
+	CHECK(strcmp(request.response.type, "text/html") == 0);
+	CHECK_EQ(request.response.body_len, index_ov2640_html_gz_len);
+	CHECK(memcmp(request.response.body, index_ov2640_html_gz, index_ov2640_html_gz_len) == 0);
+
+	char const *encoding = stub_httpd_response_header(&request, "Content-Encoding");
+	char const *cache_control = stub_httpd_response_header(&request, "Cache-Control");
+	CHECK(encoding != NULL && strcmp(encoding, "gzip") == 0);
+	CHECK(cache_control != NULL && strcmp(cache_control, ASSETS_CACHE_CONTROL) == 0);
+
+	char etag[32] = "";
+	char const *sent = stub_httpd_response_header(&request, "ETag");
+	CHECK(sent != NULL && strlen(sent) == 18 && sent[0] == '"');
+	snprintf(etag, sizeof(etag), "%s", sent == NULL ? "" : sent);
+
+	// Coming back, with what it got. A query string doesn't make it another asset:
+	char weak[40];
+	snprintf(weak, sizeof(weak), "\"0\", W/%s", etag);
+
+	char const *const revalidations[] = { etag, weak };
+	for (char const *if_none_match : revalidations) {
+		stub_httpd_request(&request, "/?cache=1");
+		stub_httpd_add_header(&request, "If-None-Match", if_none_match);
+		CHECK_EQ(assets_handler(&request), ESP_OK);
+		CHECK(strcmp(request.response.status, "304 Not Modified") == 0);
+		CHECK_EQ(request.response.body_len, 0);
+
+		sent = stub_httpd_response_header(&request, "ETag");
+		CHECK(sent != NULL && strcmp(sent, etag) == 0); // A `304` still carries it.
+	}
+
+	// Some other build's page gets the new one:
+	stub_httpd_request(&request, "/");
+	stub_httpd_add_header(&request, "If-None-Match", "\"0000000000000000\"");
+	CHECK_EQ(assets_handler(&request), ESP_OK);
+	CHECK(strcmp(request.response.status, "200 OK") == 0);
+	CHECK_EQ(request.response.body_len, index_ov2640_html_gz_len);
+
+	// So does an `If-None-Match` too long to read, even one that'd match:
+	static char huge[ASSETS_IF_NONE_MATCH_MAX + 32];
+	memset(huge, ' ', sizeof(huge));
+	snprintf(huge + sizeof(huge) - 20, 20, "%s", etag);
+	stub_httpd_request(&request, "/");
+	stub_httpd_add_header(&request, "If-None-Match", huge);
+	CHECK_EQ(assets_handler(&request), ESP_OK);
+	CHECK(strcmp(request.response.status, "200 OK") == 0);
+
+	stub_httpd_request(&request, "/nope.js");
+	assets_handler(&request);
+	CHECK(strncmp(request.response.status, "404", 3) == 0);
+
+	assets_get(&after);
+	CHECK_EQ(after.sent - before.sent, 3);
+	CHECK_EQ(after.not_modified - before.not_modified, 2);
+	CHECK_EQ(after.bytes_saved - before.bytes_saved, 2 * index_ov2640_html_gz_len);
+
+	stub_httpd_reset(&request);
+}
+
+int main() {
+	test_etag_matches();
+	test_handler();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,240 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <Arduino.h>
+
+#include "app_drive.hpp"
+#include "app_link.hpp"
+#include "app_controls.hpp"
+#include "protocol_car_controls.hpp"
+
+#include "fakes/fakes.h"
+#include "test.h"
+
+// `app_drive`'s motion profile, the real one, with the limits from `app_drive.hpp`. Setpoint steps, and a joystick over a
+// lossy, jittery network, checked for steps, overshoot and limit violations. Then the drive task's tick, for how long a
+// setpoint takes to show up in `drive_get()`, which is what the link sends.
+#define TEST_STEP_TICKS		(3000 / DRIVE_PERIOD_MS)
+#define TEST_JOYSTICK_MS	10000
+#define TEST_JOYSTICK_TICKS	(TEST_JOYSTICK_MS / DRIVE_PERIOD_MS)
+#define TEST_PACKET_MS		50
+#define TEST_PACKETS		(TEST_JOYSTICK_MS / TEST_PACKET_MS)
+
+struct test_limits {
+
+	float speed;
+	float accel;
+	float jerk;
+
+};
+
+static test_limits const s_steer = { DRIVE_STEER_SPEED, DRIVE_STEER_ACCEL, DRIVE_STEER_JERK };
+static test_limits const s_throttle = { DRIVE_THROTTLE_SPEED, DRIVE_THROTTLE_ACCEL, DRIVE_THROTTLE_JERK };
+static float s_outputs[TEST_JOYSTICK_TICKS];
+static uint32_t s_seed = 1;
+
+// `0` to `1`.
+static double test_random() {
+	s_seed = s_seed * 1103515245 + 12345;
+	return (double) ((s_seed >> 8) & 0xFFFF) / 0xFFFF;
+}
+
+// Speed, acceleration and jerk, off finite differences, against the limits. The slack's for `float` rounding: the position
+// is a `float` around `±255`, and every difference divides what's left of that by `DRIVE_DT` once more.
+static void test_limits_hold(char const *p_name, float const *p_outputs, int const p_count, test_limits const &p_limits) {
+	double const dt = DRIVE_DT;
+	double const rounding = 4 * 255 * 6e-8; // `FLT_EPSILON / 2`, a few times over.
+	double peak_speed = 0, peak_accel = 0, peak_jerk = 0;
+	int worst_step = 0;
+
+	for (int i = 3; i < p_count; i++) {
+		double const x0 = p_outputs[i - 3], x1 = p_outputs[i - 2], x2 = p_outputs[i - 1], x3 = p_outputs[i];
+		double const speed = fabs(x3 - x2) / dt;
+		double const accel = fabs(x3 - 2 * x2 + x1) / (dt * dt);
+		double const jerk = fabs(x3 - 3 * x2 + 3 * x1 - x0) / (dt * dt * dt);
+		int const step = abs((int) lroundf(p_outputs[i]) - (int) lroundf(p_outputs[i - 1]));
+
+		peak_speed = speed > peak_speed ? speed : peak_speed;
+		peak_accel = accel > peak_accel ? accel : peak_accel;
+		peak_jerk = jerk > peak_jerk ? jerk : peak_jerk;
+		worst_step = step > worst_step ? step : worst_step;
+	}
+
+	CHECK(peak_speed <= p_limits.speed * 1.001 + 2 * rounding / dt);
+	CHECK(peak_accel <= p_limits.accel * 1.001 + 4 * rounding / (dt * dt));
+	CHECK(peak_jerk <= p_limits.jerk * 1.001 + 8 * rounding / (dt * dt * dt));
+	printf("  %-22s max step %3d/tick, speed %6.0f, accel %7.0f, jerk %8.0f\n", p_name, worst_step, peak_speed, peak_accel, peak_jerk);
+}
+
+static void test_step(test_limits const &p_limits, int const p_start, int const p_target, char const *p_name) {
+	static drive_axis axis;
+	drive_axis_init(&axis, p_limits.speed, p_limits.accel, p_limits.jerk, p_start);
+
+	int const direction = p_target >= p_start ? 1 : -1;
+	float overshoot = 0;
+	int first = -1;
+	int settle = -1;
+
+	for (int i = 0; i < TEST_STEP_TICKS; i++) {
+		s_outputs[i] = drive_axis_step(&axis, p_target);
+
+		float const over = (s_outputs[i] - p_target) * direction;
+		overshoot = over > overshoot ? over : overshoot;
+		long const rounded = lroundf(s_outputs[i]);
+		first = first < 0 && rounded != p_start ? i : first;
+		settle = rounded != p_target ? -1 : settle < 0 ? i : settle;
+	}
+
+	CHECK(overshoot <= 0.5F);
+	CHECK(settle >= 0);
+
+	test_limits_hold(p_name, s_outputs, TEST_STEP_TICKS, p_limits);
+	printf("  %-22s first movement after %d ms, settled after %d ms\n", "", (first + 1) * DRIVE_PERIOD_MS, (settle + 1) * DRIVE_PERIOD_MS);
+}
+
+// A thumb sweeping the stick back and forth, sent every `TEST_PACKET_MS`. A third of the packets get lost, and the rest are
+// up to `150` ms late. Late ones can overtake each other.
+static void test_joystick(test_limits const &p_limits, char const *p_name) {
+	static int arrival_ms[TEST_PACKETS];
+	static int value[TEST_PACKETS];
+	int count = 0;
+
+	for (int n = 0; n < TEST_PACKETS; n++) {
+		int const sent_ms = n * TEST_PACKET_MS;
+		if (test_random() < 1.0 / 3) {
+			continue;
+		}
+
+		long const wanted = lround(127 * sin(2 * M_PI * 0.4 * sent_ms / 1000) + (test_random() * 16 - 8));
+		value[count] = wanted < -127 ? -127 : wanted > 127 ? 127 : (int) wanted;
+		arrival_ms[count] = sent_ms + (int) (test_random() * 150);
+		count++;
+	}
+
+	static drive_axis axis;
+	drive_axis_init(&axis, p_limits.speed, p_limits.accel, p_limits.jerk, 0);
+	int target = 0;
+	int latest_ms = -1;
+
+	for (int tick = 0; tick < TEST_JOYSTICK_TICKS; tick++) {
+		int const now_ms = tick * DRIVE_PERIOD_MS;
+
+		// Whatever arrived by now. The latest arrival wins, like it would on `/controls`:
+		for (int i = 0; i < count; i++) {
+			if (arrival_ms[i] <= now_ms && arrival_ms[i] > latest_ms) {
+				latest_ms = arrival_ms[i];
+				target = value[i];
+			}
+		}
+
+		s_outputs[tick] = drive_axis_step(&axis, target);
+	}
+
+	test_limits_hold(p_name, s_outputs, TEST_JOYSTICK_TICKS, p_limits);
+}
+
+// Ticks until `drive_get()` shows `throttle`, or `-1`.
+static int test_ticks_to_throttle(int const p_throttle) {
+	for (int i = 0; i < TEST_STEP_TICKS; i++) {
+		drive_tick();
+
+		drive_output output;
+		drive_get(&output);
+		if (output.throttle == p_throttle) {
+			return i + 1;
+		}
+	}
+
+	return -1;
+}
+
+// The drive task's tick, through the same calls `/controls` and the link make.
+static void test_task() {
+	CHECK_EQ(drive_init(), ESP_OK);
+	g_carModeControls = true;
+
+	drive_output output;
+	drive_set_throttle(127);
+	drive_tick();
+	drive_get(&output);
+	CHECK_EQ(output.throttle_target, 127); // The setpoint's out on the very next tick, but not as a step.
+	CHECK(output.throttle >= 0 && output.throttle < 10);
+
+	uint32_t const settles = fake_metrics_count(METRICS_STAGE_DRIVE_SETTLE);
+	int const ticks = test_ticks_to_throttle(127);
+	CHECK(ticks > 0);
+	CHECK_EQ(fake_metrics_count(METRICS_STAGE_DRIVE_SETTLE), settles + 1);
+	printf("  throttle 0 -> 127 through `drive_tick()`: `%d` ms.\n", (ticks + 1) * DRIVE_PERIOD_MS);
+
+	// The same setpoint again (a duplicate packet) changes nothing:
+	drive_set_throttle(127);
+	drive_tick();
+	CHECK_EQ(fake_metrics_count(METRICS_STAGE_DRIVE_SETTLE), settles + 1);
+
+#if !LINK_ENABLED
+	CHECK(g_stub_pins[PIN_CAR_ESP_CAM_1] == HIGH && g_stub_pins[PIN_CAR_ESP_CAM_2] == LOW); // Forwards.
+#endif
+
+	// Stopping from full speed is worth a clip:
+	uint32_t const events = fake_events_count();
+	drive_set_throttle(0);
+	CHECK_EQ(fake_events_count(), events + 1);
+	CHECK_EQ(fake_events_last(), EVENTS_CAUSE_HARD_STOP);
+
+	// The gear pins are all or nothing, so they stop on the very next tick, while the profile's still at speed:
+	drive_tick();
+	drive_get(&output);
+	CHECK(output.throttle > DRIVE_GEAR_DEADBAND);
+#if !LINK_ENABLED
+	CHECK(g_stub_pins[PIN_CAR_ESP_CAM_1] == HIGH && g_stub_pins[PIN_CAR_ESP_CAM_2] == HIGH);
+#endif
+	CHECK(test_ticks_to_throttle(0) > 0);
+
+	// Straight into reverse, too:
+	drive_set_throttle(-127);
+	drive_tick();
+#if !LINK_ENABLED
+	CHECK(g_stub_pins[PIN_CAR_ESP_CAM_1] == LOW && g_stub_pins[PIN_CAR_ESP_CAM_2] == HIGH);
+#endif
+	drive_set_throttle(0);
+	CHECK(test_ticks_to_throttle(0) > 0);
+
+	// While avoiding obstacles, `app_vision` steers, through the same profile:
+	g_carModeControls = false;
+	fake_vision_steer(255);
+	drive_tick();
+	drive_get(&output);
+	CHECK_EQ(output.steer_target, 255);
+	CHECK(output.steer < 140);
+
+	for (int i = 0; i < TEST_STEP_TICKS; i++) {
+		drive_tick();
+	}
+
+	drive_get(&output);
+	CHECK_EQ(output.steer, 255);
+	g_carModeControls = true;
+}
+
+int main() {
+	printf("Tick `%d` ms. Steering `%.0f`, `%.0f`, `%.0f`, throttle `%.0f`, `%.0f`, `%.0f` (speed, accel, jerk).\n", DRIVE_PERIOD_MS,
+		s_steer.speed, s_steer.accel, s_steer.jerk, s_throttle.speed, s_throttle.accel, s_throttle.jerk);
+
+	printf("Steps:\n");
+	test_step(s_throttle, 0, 127, "throttle 0 -> 127");
+	test_step(s_throttle, 127, -127, "throttle 127 -> -127");
+	test_step(s_throttle, 0, 5, "throttle 0 -> 5");
+	test_step(s_steer, 127, 255, "steer 127 -> 255");
+	test_step(s_steer, 0, 255, "steer 0 -> 255");
+	test_step(s_steer, 127, 130, "steer 127 -> 130");
+
+	printf("Joystick, lossy and late:\n");
+	test_joystick(s_throttle, "throttle");
+	test_joystick(s_steer, "steer");
+
+	printf("Drive task:\n");
+	test_task();
+
+	return TEST_RESULT();
+}
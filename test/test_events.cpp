@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <esp_heap_caps.h>
+
+#include "app_events.hpp"
+#include "app_recorder.hpp"
+
+#include "test.h"
+
+// The event ring's allocator, what used to be `events_ring_self_test()` at every boot: random entries into a small ring,
+// with the odd one pinned, and a walk from the oldest after every step. Every entry has to still be there, in order, with
+// its bytes intact, and none of them overlapping the next. Then `events_init()` without PSRAM, which `app_memory` has no
+// internal RAM budgeted for: no ring at all, and frames offered to it go nowhere.
+#define TEST_RING_BYTES		4096
+#define TEST_ROUNDS			20000
+
+static uint32_t s_seed = 1;
+
+static uint32_t test_random() {
+	s_seed = s_seed * 1103515245 + 12345;
+	return s_seed >> 8;
+}
+
+static void test_ring() {
+	static uint8_t buffer[TEST_RING_BYTES];
+	events_ring ring = {};
+	ring.buffer = buffer;
+	ring.capacity = TEST_RING_BYTES;
+	ring.end = ring.capacity;
+
+	uint32_t next_sequence = 0;
+	int committed = 0;
+	int refused = 0;
+	int broken = 0;
+
+	for (int round = 0; round < TEST_ROUNDS && broken == 0; round++) {
+		uint32_t const length = test_random() % (TEST_RING_BYTES / 3);
+		uint32_t const size = (sizeof(events_entry) + length + EVENTS_ALIGN - 1) & ~(EVENTS_ALIGN - 1);
+		uint32_t const pinned = ring.count > 1 && test_random() % 4 == 0 ? events_ring_next(&ring, ring.tail) : UINT32_MAX;
+		int32_t const at = events_ring_reserve(&ring, size, pinned);
+
+		if (at >= 0) {
+			events_entry *entry = events_ring_entry(&ring, at);
+			entry->size = size;
+			entry->sequence = next_sequence++;
+			entry->frame.length = length;
+			memset(entry + 1, entry->sequence & 0xFF, length);
+			events_ring_commit(&ring, at);
+			committed++;
+		} else {
+			CHECK(pinned != UINT32_MAX); // Only a pin's allowed to make it give up.
+			refused++;
+		}
+
+		uint32_t walked = 0;
+		uint32_t at_walk = ring.tail;
+		bool walk_wrapped = false;
+
+		for (uint32_t i = 0; i < ring.count; i++) {
+			events_entry const *entry = events_ring_entry(&ring, at_walk);
+			uint8_t const *bytes = (uint8_t const*) (entry + 1);
+
+			broken += entry->sequence != next_sequence - ring.count + i || at_walk + entry->size > ring.capacity;
+			for (uint32_t b = 0; b < entry->frame.length && broken == 0; b++) {
+				broken += bytes[b] != (entry->sequence & 0xFF);
+			}
+
+			walked += entry->size;
+			at_walk = i + 1 < ring.count ? events_ring_next(&ring, at_walk) : at_walk + entry->size;
+			walk_wrapped = walk_wrapped || at_walk == 0;
+		}
+
+		// The walk has to end where the next entry goes (a head at `end` and one at `0` are the same place), and the newest
+		// entries, at the front, mustn't run into the oldest ones:
+		uint32_t const head = ring.head == ring.end ? 0 : ring.head;
+		at_walk = at_walk == ring.end ? 0 : at_walk;
+		broken += walked != ring.used || (ring.count > 0 && at_walk != head) || (walk_wrapped && ring.head > ring.tail);
+
+		if (broken != 0) {
+			fprintf(stderr, "Ring broken after round `%d`!\n", round);
+		}
+	}
+
+	CHECK_EQ(broken, 0);
+	CHECK(committed > TEST_ROUNDS / 2);
+	printf("ring: `%d` entries in, `%d` refused for a pin.\n", committed, refused);
+}
+
+static void test_no_psram() {
+	test_picture pictures[3];
+	size_t count = 0;
+	CHECK(test_pictures(pictures, &count));
+
+	char card[] = "/tmp/test_events.XXXXXX";
+	CHECK(mkdtemp(card) != NULL && chdir(card) == 0);
+
+	// No card, no clips:
+	CHECK_EQ(events_init(), ESP_ERR_INVALID_STATE);
+
+	// The recorder gets its PSRAM, so the card's there. Then the event ring doesn't:
+	g_stub_psram = true;
+	CHECK_EQ(recorder_init(), ESP_OK);
+	g_stub_psram = false;
+
+	size_t const internal_before = stub_internal_in_use();
+	CHECK_EQ(events_init(), ESP_ERR_NO_MEM);
+	CHECK_EQ(stub_internal_in_use(), internal_before);
+
+	events_stats stats;
+	events_get(&stats);
+	CHECK_EQ(stats.ring_bytes, 0);
+	uint32_t const evicted_before = stats.evicted; // `test_ring()` counts in there too.
+
+	for (size_t i = 0; i < count; i++) {
+		camera_fb_t fb = {};
+		fb.buf = pictures[i].jpeg;
+		fb.len = pictures[i].len;
+		fb.format = PIXFORMAT_JPEG;
+		events_offer(&fb);
+	}
+
+	events_get(&stats);
+	CHECK_EQ(stats.frames, 0);
+	CHECK_EQ(stats.ring_used, 0);
+	CHECK_EQ(stats.evicted, evicted_before);
+
+	httpd_req_t request = {};
+	stub_httpd_request(&request, "/events");
+	CHECK_EQ(events_handler(&request), ESP_OK);
+	CHECK(strstr(request.response.body, "\"ring_bytes\":0") != NULL);
+	stub_httpd_reset(&request);
+
+	char command[64];
+	snprintf(command, sizeof(command), "rm -r '%s'", card);
+	system(command);
+}
+
+// Clips go on the same card as segments, so 8.3 names only:
+static void test_clip_names() {
+	static uint32_t const numbers[] = { 1, 99999 }; // Five digits, at most.
+	char path[32];
+	for (uint32_t const clip : numbers) {
+		for (int index = 0; index < 2; index++) {
+			events_clip_path(path, sizeof(path), clip, index);
+			CHECK(test_name_8_3(path));
+		}
+	}
+}
+
+int main() {
+	test_clip_names();
+	test_ring();
+	test_no_psram();
+
+	return TEST_RESULT();
+}
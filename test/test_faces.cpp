@@ -0,0 +1,201 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_timer.h>
+#include <esp_partition.h>
+
+#include "app_faces.hpp"
+
+#include "test.h"
+
+// The face database, on "flash" that behaves like the real thing (see `stub_partition_create()`). Prints lookup time against
+// database size, from a handful of faces up to a partition much bigger than `fr`. Then checks that compacting survives a
+// power cut at any point.
+#define TEST_PARTITION_SIZE		(128 * 1024) // `fr`, in `partitions.csv`.
+#define TEST_BIG_PARTITION_SIZE	(1024 * 1024)
+#define TEST_SEARCHES			200
+#define TEST_FACES_MAX			2048
+
+static uint32_t s_seed = 1;
+static float s_faces[TEST_FACES_MAX][FACES_EMBEDDING_LENGTH];
+static int s_ids[TEST_FACES_MAX];
+
+static float test_random() {
+	s_seed = s_seed * 1103515245 + 12345;
+	return (float) ((s_seed >> 8) & 0xFFFF) / 0x8000 - 1;
+}
+
+static void test_embedding(float *p_out) {
+	for (int i = 0; i < FACES_EMBEDDING_LENGTH; i++) {
+		p_out[i] = test_random();
+	}
+}
+
+// The same face, another day: `p_face`, give or take a little.
+static void test_embedding_near(float const *p_face, float *p_out) {
+	for (int i = 0; i < FACES_EMBEDDING_LENGTH; i++) {
+		p_out[i] = p_face[i] + test_random() * 0.1F;
+	}
+}
+
+static bool test_boot(uint32_t const p_size) {
+	stub_partition_create("fr", p_size);
+	return faces_init() == ESP_OK;
+}
+
+// Fills the database up to `count` faces, or until it's full. Returns how many got in.
+static int test_enroll(int const p_from, int const p_count) {
+	int i = p_from;
+	for (; i < p_count; i++) {
+		test_embedding(s_faces[i]);
+		s_ids[i] = faces_enroll(s_faces[i], FACES_EMBEDDING_LENGTH, "test");
+
+		if (s_ids[i] < 0) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+// Average `faces_search()` time, in microseconds. Every search is for an enrolled face, and has to find it.
+static double test_benchmark(int const p_count) {
+	static float query[FACES_EMBEDDING_LENGTH];
+	int found = 0;
+	int64_t total_us = 0;
+
+	for (int i = 0; i < TEST_SEARCHES; i++) {
+		int const face = i % p_count;
+		test_embedding_near(s_faces[face], query);
+
+		int64_t const start = esp_timer_get_time();
+		faces_match const match = faces_search(query, FACES_EMBEDDING_LENGTH);
+		total_us += esp_timer_get_time() - start;
+
+		found += match.id == s_ids[face] && match.similarity >= FACES_MATCH_THRESHOLD;
+	}
+
+	CHECK_EQ(found, TEST_SEARCHES);
+	return (double) total_us / TEST_SEARCHES;
+}
+
+static void test_lookup(uint32_t const p_size, char const *p_name) {
+	CHECK(test_boot(p_size));
+
+	static int const sizes[] = { 1, 8, 32, 64, 128, 256, 512, 1024, 2048 };
+	int enrolled = 0;
+
+	for (int size : sizes) {
+		int const now = test_enroll(enrolled, size);
+		bool const full = now < size;
+		enrolled = now;
+
+		if (enrolled > 0) {
+			printf("%-8s %5d faces  %8.2f us per search\n", p_name, enrolled, test_benchmark(enrolled));
+		}
+
+		if (full) {
+			break;
+		}
+	}
+
+	CHECK_EQ(faces_count(), enrolled);
+
+	// Nobody that's not enrolled gets mistaken for someone who is:
+	static float stranger[FACES_EMBEDDING_LENGTH];
+	test_embedding(stranger);
+	CHECK(faces_search(stranger, FACES_EMBEDDING_LENGTH).similarity < FACES_MATCH_THRESHOLD);
+}
+
+static int test_find(int const p_face) {
+	static float query[FACES_EMBEDDING_LENGTH];
+	test_embedding_near(s_faces[p_face], query);
+	faces_match const match = faces_search(query, FACES_EMBEDDING_LENGTH);
+	return match.similarity >= FACES_MATCH_THRESHOLD ? match.id : -1;
+}
+
+// Full, with every other face deleted. The next enrollment has to compact. Cut the power `k` flash operations into that,
+// reboot, and every face that wasn't deleted still has to be there. Then again with `k + 1`, until it makes it through.
+static void test_compaction() {
+	CHECK(test_boot(TEST_PARTITION_SIZE));
+	int const capacity = test_enroll(0, TEST_FACES_MAX);
+	CHECK(capacity > 100);
+
+	int highest_id = 0;
+	for (int i = 0; i < capacity; i += 2) {
+		CHECK_EQ(faces_delete(s_ids[i]), ESP_OK);
+		highest_id = s_ids[i] > highest_id ? s_ids[i] : highest_id;
+	}
+
+	for (int i = 1; i < capacity; i += 2) {
+		highest_id = s_ids[i] > highest_id ? s_ids[i] : highest_id;
+	}
+
+	int const live = faces_count();
+	uint8_t *snapshot = (uint8_t*) malloc(TEST_PARTITION_SIZE);
+	esp_partition_t const *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "fr");
+	CHECK_EQ(esp_partition_read(partition, 0, snapshot, TEST_PARTITION_SIZE), ESP_OK);
+
+	test_embedding(s_faces[capacity]);
+	int cuts = 0;
+
+	for (int k = 0; k < 1000; k++) {
+		CHECK_EQ(esp_partition_erase_range(partition, 0, TEST_PARTITION_SIZE), ESP_OK);
+		CHECK_EQ(esp_partition_write(partition, 0, snapshot, TEST_PARTITION_SIZE), ESP_OK);
+		CHECK_EQ(faces_init(), ESP_OK);
+
+		g_stub_flash_operations_left = k;
+		int const id = faces_enroll(s_faces[capacity], FACES_EMBEDDING_LENGTH, "late");
+		bool const cut = g_stub_flash_operations_left == 0;
+		g_stub_flash_operations_left = -1;
+
+		// Power's back:
+		CHECK_EQ(faces_init(), ESP_OK);
+		CHECK_EQ(faces_count(), live + (id >= 0 ? 1 : 0));
+
+		int missing = 0;
+		for (int i = 1; i < capacity; i += 2) {
+			missing += test_find(i) != s_ids[i];
+		}
+		CHECK_EQ(missing, 0);
+
+		if (id >= 0) {
+			CHECK(id > highest_id); // Deleted IDs never come back, compaction or not.
+			CHECK_EQ(test_find(capacity), id);
+		}
+
+		if (!cut) {
+			CHECK(id >= 0);
+			break;
+		}
+
+		cuts++;
+	}
+
+	printf("compaction: `%d` faces kept through `%d` power cuts.\n", live, cuts);
+	CHECK(cuts > live); // Every record copied was a chance to cut the power.
+
+	// New faces go into the compacted half, and a reboot still finds them:
+	int const more = test_enroll(capacity + 1, capacity + 1 + 8);
+	CHECK_EQ(more, capacity + 1 + 8);
+	CHECK_EQ(faces_init(), ESP_OK);
+	CHECK_EQ(faces_count(), live + 1 + 8);
+
+	// Deleting goes there too:
+	CHECK_EQ(faces_delete(s_ids[1]), ESP_OK);
+	CHECK_EQ(faces_init(), ESP_OK);
+	CHECK_EQ(faces_count(), live + 8);
+	CHECK_EQ(test_find(1), -1);
+
+	free(snapshot);
+}
+
+int main() {
+	test_lookup(TEST_PARTITION_SIZE, "fr");
+	test_lookup(TEST_BIG_PARTITION_SIZE, "1 MiB");
+	test_compaction();
+
+	return TEST_RESULT();
+}
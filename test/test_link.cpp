@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "app_link.hpp"
+#include "protocol_android_controls.hpp"
+
+#include "test.h"
+
+// The Arduino link's framing, what used to be the boot-time loopback self-test. Bytes go straight from `link_frame()` into
+// `link_parse()`: the UART in between only ever adds losses and noise, and those are made up here instead.
+#define TEST_STREAM_MAX	1024
+
+static link_command const s_command = { 0xBEEF, 200, -42, 1, ANDROID_GEAR_FORWARDS };
+static link_telemetry const s_telemetry = { 0xBEEF, -1234, 7400, 0 };
+
+static uint8_t s_stream[TEST_STREAM_MAX];
+static int s_stream_len = 0;
+
+static void test_stream_frame(link_message const p_type, void const *p_payload, uint8_t const p_length) {
+	s_stream_len += link_frame(p_type, p_payload, p_length, s_stream + s_stream_len);
+}
+
+static void test_stream_bytes(uint8_t const *p_bytes, int const p_len) {
+	memcpy(s_stream + s_stream_len, p_bytes, p_len);
+	s_stream_len += p_len;
+}
+
+// Everything in `s_stream`, through a fresh parser. Counts good frames, and how many of those are `s_command`.
+static void test_parse_stream(int *p_frames, int *p_commands, int *p_crc_errors) {
+	link_parser parser = {};
+	*p_frames = *p_commands = *p_crc_errors = 0;
+
+	for (int i = 0; i < s_stream_len; i++) {
+		int const result = link_parse(&parser, s_stream[i]);
+
+		if (result > 0) {
+			(*p_frames)++;
+
+			link_command command;
+			if (parser.type == LINK_MESSAGE_COMMAND && parser.length == sizeof(command)) {
+				memcpy(&command, parser.payload, sizeof(command));
+				*p_commands += memcmp(&command, &s_command, sizeof(command)) == 0;
+			}
+		} else if (result < 0) {
+			(*p_crc_errors)++;
+		}
+	}
+}
+
+static void test_round_trip() {
+	uint8_t tx[LINK_FRAME_OVERHEAD + LINK_MAX_PAYLOAD];
+	int const len = link_frame(LINK_MESSAGE_COMMAND, &s_command, sizeof(s_command), tx);
+	CHECK_EQ(len, LINK_FRAME_OVERHEAD + sizeof(s_command));
+
+	// Done on the last byte, not a byte earlier:
+	link_parser parser = {};
+	for (int i = 0; i < len; i++) {
+		CHECK_EQ(link_parse(&parser, tx[i]), i == len - 1 ? 1 : 0);
+	}
+
+	CHECK_EQ(parser.type, LINK_MESSAGE_COMMAND);
+	CHECK_EQ(parser.length, sizeof(s_command));
+	CHECK(memcmp(parser.payload, &s_command, sizeof(s_command)) == 0);
+
+	// Telemetry, on the same parser:
+	int const telemetry_len = link_frame(LINK_MESSAGE_TELEMETRY, &s_telemetry, sizeof(s_telemetry), tx);
+	int result = 0;
+	for (int i = 0; i < telemetry_len; i++) {
+		result = link_parse(&parser, tx[i]);
+	}
+
+	CHECK_EQ(result, 1);
+	CHECK_EQ(parser.type, LINK_MESSAGE_TELEMETRY);
+	CHECK(memcmp(parser.payload, &s_telemetry, sizeof(s_telemetry)) == 0);
+
+	// No payload at all, and the most there can be:
+	uint8_t const biggest[LINK_MAX_PAYLOAD] = { LINK_SYNC_0, LINK_SYNC_1, LINK_SYNC_0 };
+	static int const lengths[] = { 0, LINK_MAX_PAYLOAD };
+	for (int length : lengths) {
+		int const n = link_frame(LINK_MESSAGE_COMMAND, biggest, length, tx);
+		for (int i = 0; i < n; i++) {
+			result = link_parse(&parser, tx[i]);
+		}
+
+		CHECK_EQ(result, 1);
+		CHECK_EQ(parser.length, length);
+	}
+}
+
+// Every bit past the sync bytes flipped, one at a time. A CRC-16 catches all of those, so none may come out as a frame.
+static void test_bit_flips() {
+	uint8_t tx[LINK_FRAME_OVERHEAD + sizeof(s_command)];
+	int const len = link_frame(LINK_MESSAGE_COMMAND, &s_command, sizeof(s_command), tx);
+	int accepted = 0;
+	int flips = 0;
+
+	for (int byte = 2; byte < len; byte++) {
+		for (int bit = 0; bit < 8; bit++) {
+			link_parser parser = {};
+			tx[byte] ^= 1 << bit;
+
+			for (int i = 0; i < len; i++) {
+				accepted += link_parse(&parser, tx[i]) > 0;
+			}
+
+			tx[byte] ^= 1 << bit;
+			flips++;
+		}
+	}
+
+	CHECK_EQ(accepted, 0);
+	printf("bit flips: `%d`, none accepted.\n", flips);
+}
+
+// Line noise before a frame, including sync bytes that lead nowhere, and too long a length. The frame still gets through.
+static void test_resync() {
+	uint8_t const noise[] = {
+		0x00, LINK_SYNC_0, 0x00, LINK_SYNC_0, LINK_SYNC_0, LINK_SYNC_1, LINK_MESSAGE_COMMAND, LINK_MAX_PAYLOAD + 1, 0xFF, LINK_SYNC_0,
+	};
+
+	s_stream_len = 0;
+	test_stream_bytes(noise, sizeof(noise));
+	test_stream_frame(LINK_MESSAGE_COMMAND, &s_command, sizeof(s_command));
+
+	int frames, commands, crc_errors;
+	test_parse_stream(&frames, &commands, &crc_errors);
+	CHECK_EQ(frames, 1);
+	CHECK_EQ(commands, 1);
+	CHECK_EQ(crc_errors, 0);
+}
+
+// One byte lost out of a run of frames, at every position of the first. That frame's gone. The parser can take the next
+// one's bytes for the rest of the lost one, and lose that too, but never more, and it never hands out a broken frame.
+#define TEST_RUN_FRAMES	4
+
+static void test_lost_byte() {
+	int const frame_len = LINK_FRAME_OVERHEAD + sizeof(s_command);
+	int worst = TEST_RUN_FRAMES;
+
+	for (int lost = 0; lost < frame_len; lost++) {
+		s_stream_len = 0;
+		for (int i = 0; i < TEST_RUN_FRAMES; i++) {
+			test_stream_frame(LINK_MESSAGE_COMMAND, &s_command, sizeof(s_command));
+		}
+
+		memmove(s_stream + lost, s_stream + lost + 1, --s_stream_len - lost);
+
+		int frames, commands, crc_errors;
+		test_parse_stream(&frames, &commands, &crc_errors);
+		CHECK_EQ(frames, commands);
+		CHECK(frames >= TEST_RUN_FRAMES - 2);
+		worst = frames < worst ? frames : worst;
+	}
+
+	printf("lost byte: `%d` of `%d` frames through, at worst.\n", worst, TEST_RUN_FRAMES);
+}
+
+int main() {
+	test_round_trip();
+	test_bit_flips();
+	test_resync();
+	test_lost_byte();
+
+	return TEST_RESULT();
+}
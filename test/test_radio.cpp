@@ -0,0 +1,195 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "app_radio_model.hpp"
+
+#include "test.h"
+
+// `app_radio`'s governor, replaying every link trace in `radio/`, as `tools/radio_record.py` writes them:
+// `seconds,rssi_dbm,goodput_kbps,predicted_kbps,interval_ms,framesize`. Only the RSSI and the goodput go in. The rest is what
+// the car's governor did at the time, and the biggest `framesize` in there stands in for the size that was picked.
+// Every trace has to step down before the picked size stops fitting, and not flap. Some traces also have checkpoints, below.
+#define TEST_SAMPLES_MAX	4096
+#define TEST_FRAME_BYTES	30000 // A VGA frame, about. Other sizes scale with their pixels.
+#define TEST_TRACE_HEADER	"seconds,rssi_dbm,goodput_kbps,predicted_kbps,interval_ms,framesize"
+
+struct test_sample {
+
+	int64_t at_us;
+	int8_t rssi;
+	uint32_t goodput_kbps;
+	framesize_t framesize;
+
+};
+
+enum test_expect : uint8_t {
+
+	TEST_EXPECT_WANTED, // Back at the picked size, frames not spaced out.
+	TEST_EXPECT_DOWN, // Smaller than picked.
+	TEST_EXPECT_FLOOR, // The smallest size, and frames spaced out.
+
+};
+
+struct test_checkpoint {
+
+	char const *trace;
+	float seconds; // Right after the sample at this time.
+	test_expect expect;
+
+};
+
+// `drive_away.csv`: driving away from the access point and back, the signal fine but the channel busy with someone else's
+// traffic, then a wobble at the edge of where VGA fits.
+static test_checkpoint const s_checkpoints[] = {
+
+	{ "drive_away.csv", 4.75F, TEST_EXPECT_WANTED },
+	{ "drive_away.csv", 13.25F, TEST_EXPECT_FLOOR }, // A dB per sample, down to `-88`.
+	{ "drive_away.csv", 15.25F, TEST_EXPECT_FLOOR },
+	{ "drive_away.csv", 27.25F, TEST_EXPECT_WANTED }, // Around the corner, and right back.
+	{ "drive_away.csv", 32.25F, TEST_EXPECT_DOWN }, // `1500` kbit/s measured.
+	{ "drive_away.csv", 52.25F, TEST_EXPECT_WANTED },
+	{ "drive_away.csv", 72.25F, TEST_EXPECT_WANTED }, // After the wobble.
+
+};
+
+static test_sample s_samples[TEST_SAMPLES_MAX];
+
+// Samples from while it wasn't associated (`rssi_dbm` `0`) are left out, like the governor's task leaves them out.
+static size_t test_trace_load(char const *p_path) {
+	FILE *file = fopen(p_path, "r");
+	CHECK(file != NULL);
+	if (file == NULL) {
+		return 0;
+	}
+
+	char line[128];
+	size_t count = 0;
+	bool header = true;
+
+	while (fgets(line, sizeof(line), file) != NULL && count < TEST_SAMPLES_MAX) {
+		if (header) {
+			CHECK(strncmp(line, TEST_TRACE_HEADER, strlen(TEST_TRACE_HEADER)) == 0);
+			header = false;
+			continue;
+		}
+
+		double seconds;
+		int rssi, framesize;
+		unsigned goodput_kbps, predicted_kbps, interval_ms;
+		if (sscanf(line, "%lf,%d,%u,%u,%u,%d", &seconds, &rssi, &goodput_kbps, &predicted_kbps, &interval_ms, &framesize) != 6) {
+			fprintf(stderr, "`%s`: can't read `%s`!\n", p_path, line);
+			CHECK(false);
+			continue;
+		}
+
+		if (rssi == 0) {
+			continue;
+		}
+
+		test_sample &sample = s_samples[count++];
+		sample.at_us = llround(seconds * 1000000);
+		sample.rssi = rssi;
+		sample.goodput_kbps = goodput_kbps;
+		sample.framesize = (framesize_t) framesize;
+	}
+
+	fclose(file);
+	return count;
+}
+
+static bool test_expect_met(test_expect const p_expect, radio_state const &p_state, uint8_t const p_wanted) {
+	switch (p_expect) {
+		case TEST_EXPECT_WANTED: return p_state.step == p_wanted && p_state.interval_ms == 0;
+		case TEST_EXPECT_DOWN: return p_state.step > p_wanted;
+		case TEST_EXPECT_FLOOR: return p_state.step == RADIO_LADDER_COUNT - 1 && p_state.interval_ms > 0;
+	}
+
+	return false;
+}
+
+static void test_trace(char const *p_name) {
+	char path[280];
+	snprintf(path, sizeof(path), "radio/%s", p_name);
+	size_t const count = test_trace_load(path);
+	CHECK(count > 0);
+	if (count == 0) {
+		return;
+	}
+
+	framesize_t wanted_size = s_samples[0].framesize;
+	for (size_t i = 1; i < count; i++) {
+		wanted_size = s_samples[i].framesize > wanted_size ? s_samples[i].framesize : wanted_size;
+	}
+
+	uint32_t pixels[RADIO_LADDER_COUNT];
+	uint8_t const wanted = radio_ladder(wanted_size, pixels);
+	uint32_t const wanted_kbps = (uint64_t) TEST_FRAME_BYTES * pixels[wanted] / (640 * 480) * 8 * RADIO_FPS_TARGET / 1000;
+	radio_state state = {};
+	state.step = wanted;
+	int first_down = 0;
+	int checkpoints = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		test_sample const &sample = s_samples[i];
+		uint8_t const step = state.step;
+
+		radio_predict(&state, sample.rssi, UINT32_MAX, sample.goodput_kbps, sample.at_us);
+		radio_decide(&state, pixels, wanted, (uint64_t) TEST_FRAME_BYTES * pixels[step] / (640 * 480), step, sample.at_us);
+
+		// The whole point: the first step down comes while the picked size still fits what the link does *right now*.
+		if (first_down == 0 && state.step > wanted) {
+			first_down = sample.rssi;
+			CHECK((uint64_t) radio_phy_kbps(sample.rssi) * RADIO_EFFICIENCY_PERCENT * RADIO_HEADROOM_PERCENT / 10000 >= wanted_kbps);
+		}
+
+		for (test_checkpoint const &checkpoint : s_checkpoints) {
+			if (strcmp(checkpoint.trace, p_name) != 0 || llround(checkpoint.seconds * 1000000) != sample.at_us) {
+				continue;
+			}
+
+			checkpoints++;
+			if (!test_expect_met(checkpoint.expect, state, wanted)) {
+				fprintf(stderr, "`%s` at `%.2f` s: step `%u`, `%lu` ms apart. ", p_name, checkpoint.seconds, (unsigned) state.step,
+					(unsigned long) state.interval_ms);
+				CHECK(false);
+			}
+		}
+	}
+
+	// Flapping: more size changes than `RADIO_HOLD_MS` allows for, on average.
+	uint32_t const changes = state.steps_down + state.steps_up;
+	int64_t const duration_us = s_samples[count - 1].at_us - s_samples[0].at_us;
+	CHECK(changes <= 1 + duration_us / (RADIO_HOLD_MS * 1000LL));
+
+	for (test_checkpoint const &checkpoint : s_checkpoints) {
+		checkpoints -= strcmp(checkpoint.trace, p_name) == 0;
+	}
+
+	CHECK_EQ(checkpoints, 0); // Every one of them is a sample in the trace.
+	printf("`%s`: `%zu` samples over `%.0f` s, `%lu` down, `%lu` up. First step down at `%d` dBm.\n", p_name, count,
+		duration_us / 1e6, (unsigned long) state.steps_down, (unsigned long) state.steps_up, first_down);
+}
+
+int main() {
+	DIR *directory = opendir("radio");
+	CHECK(directory != NULL);
+	int traces = 0;
+
+	for (struct dirent *entry; directory != NULL && (entry = readdir(directory)) != NULL;) {
+		size_t const len = strlen(entry->d_name);
+		if (len > 4 && strcmp(entry->d_name + len - 4, ".csv") == 0) {
+			test_trace(entry->d_name);
+			traces++;
+		}
+	}
+
+	if (directory != NULL) {
+		closedir(directory);
+	}
+
+	CHECK(traces > 0);
+	return TEST_RESULT();
+}
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <SD_MMC.h>
+#include <esp_heap_caps.h>
+
+#include "app_recorder.hpp"
+
+#include "test.h"
+
+// The recorder, writing segments onto a "card" that's a directory in `/tmp` (see `stubs/SD_MMC.h`). First with PSRAM, until
+// the power goes out mid-segment: a child process records, then just exits. Whatever it wrote after its last sync gets
+// scribbled over, and the next boot has to cut the segment back to what its index vouches for, and record on. Then a boot
+// without PSRAM, which `app_memory` has no internal RAM budgeted for: no recording, and the card doesn't even get mounted.
+#define TEST_FRAMES_MAX		256
+#define TEST_POWER_CUT_FRAMES	150 // Past two whole batches of index entries (`RECORDER_INDEX_BATCH`, `64`), and into a third.
+#define TEST_INDEX_BATCH		64
+
+static test_picture s_pictures[3];
+static size_t s_picture_count = 0;
+static test_frame s_frames[TEST_FRAMES_MAX];
+
+static camera_fb_t test_fb(int const p_frame) {
+	test_picture const &picture = s_pictures[p_frame % s_picture_count];
+	camera_fb_t fb = {};
+
+	fb.buf = picture.jpeg;
+	fb.len = picture.len;
+	fb.width = picture.width;
+	fb.height = picture.height;
+	fb.format = PIXFORMAT_JPEG;
+	fb.timestamp.tv_sec = p_frame / 10;
+	fb.timestamp.tv_usec = p_frame % 10 * 100000;
+	return fb;
+}
+
+static off_t test_file_size(char const *p_path) {
+	struct stat info;
+	return stat(p_path, &info) == 0 ? info.st_size : -1;
+}
+
+// Every frame of `segment`, against its index, and against the picture it came from. `p_pictures[i]` for the `i`th frame.
+// Returns how many frames there were.
+static int test_segment(uint32_t const p_segment, int const *p_pictures, int const p_expected) {
+	char data_path[32];
+	char index_path[32];
+	recorder_segment_path(data_path, sizeof(data_path), p_segment, false);
+	recorder_segment_path(index_path, sizeof(index_path), p_segment, true);
+
+	size_t index_len = 0;
+	recorder_index_entry *index = (recorder_index_entry*) test_read_file(index_path, &index_len);
+	int const entries = index_len / sizeof(recorder_index_entry);
+	size_t const count = test_frames_load(data_path, s_frames, TEST_FRAMES_MAX);
+
+	CHECK_EQ(index_len % sizeof(recorder_index_entry), 0);
+	CHECK_EQ(count, entries);
+	CHECK_EQ(entries, p_expected);
+
+	for (int i = 0; i < entries && i < (int) count; i++) {
+		test_picture const &picture = s_pictures[p_pictures[i]];
+		CHECK_EQ(s_frames[i].jpeg - s_frames[0].file, index[i].offset);
+		CHECK_EQ(s_frames[i].len, index[i].length);
+		CHECK_EQ(s_frames[i].timestamp_us, index[i].timestamp_us);
+		CHECK(s_frames[i].len == picture.len && memcmp(s_frames[i].jpeg, picture.jpeg, picture.len) == 0);
+	}
+
+	// Nothing after the last frame. Not even the rest of the preallocation:
+	if (entries > 0) {
+		CHECK_EQ(test_file_size(data_path), index[entries - 1].offset + index[entries - 1].length);
+	}
+
+	test_frames_free(s_frames, count);
+	free(index);
+	return entries;
+}
+
+// The child: records until it's killed, as far as the files can tell.
+static void test_record_then_cut() {
+	g_stub_psram = true;
+	CHECK_EQ(recorder_init(), ESP_OK);
+
+	recorder_stats stats;
+	recorder_get(&stats);
+	CHECK_EQ(stats.ring_bytes, RECORDER_RING_BYTES);
+
+	for (int i = 0; i < TEST_POWER_CUT_FRAMES; i++) {
+		camera_fb_t const fb = test_fb(i);
+		recorder_offer(&fb);
+		recorder_tick();
+	}
+
+	recorder_get(&stats);
+	CHECK_EQ(stats.frames, TEST_POWER_CUT_FRAMES);
+	CHECK_EQ(stats.dropped, 0);
+	CHECK_EQ(stats.segment, 1);
+
+	fflush(stdout);
+	_exit(TEST_RESULT()); // No `close()`, no trimming. The segment's still `RECORDER_SEGMENT_BYTES` long.
+}
+
+static void test_power_cut() {
+	pid_t const child = fork();
+	if (child == 0) {
+		test_record_then_cut();
+	}
+
+	int status = 0;
+	waitpid(child, &status, 0);
+	CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	char data_path[32];
+	char index_path[32];
+	recorder_segment_path(data_path, sizeof(data_path), 1, false);
+	recorder_segment_path(index_path, sizeof(index_path), 1, true);
+	CHECK_EQ(test_file_size(data_path), RECORDER_SEGMENT_BYTES);
+
+	// Only whole batches of index entries made it, and the data they point at. Everything past that's torn now:
+	off_t const entries = test_file_size(index_path) / sizeof(recorder_index_entry);
+	CHECK(entries >= TEST_INDEX_BATCH && entries <= TEST_POWER_CUT_FRAMES);
+
+	recorder_index_entry last;
+	int fd = open(index_path, O_RDONLY);
+	CHECK(pread(fd, &last, sizeof(last), (entries - 1) * sizeof(last)) == sizeof(last));
+	close(fd);
+
+	static uint8_t garbage[64 * 1024];
+	memset(garbage, 0x5A, sizeof(garbage));
+	fd = open(data_path, O_WRONLY);
+	CHECK(pwrite(fd, garbage, sizeof(garbage), last.offset + last.length) == sizeof(garbage));
+	close(fd);
+
+	// ...and half an index entry, written just as the power went:
+	fd = open(index_path, O_WRONLY | O_APPEND);
+	CHECK(write(fd, garbage, sizeof(recorder_index_entry) / 2) == sizeof(recorder_index_entry) / 2);
+	close(fd);
+
+	// The next boot:
+	CHECK_EQ(recorder_init(), ESP_OK);
+
+	static int pictures[TEST_FRAMES_MAX];
+	for (int i = 0; i < TEST_FRAMES_MAX; i++) {
+		pictures[i] = i % s_picture_count;
+	}
+
+	printf("power cut: `%d` of `%d` frames recovered.\n", test_segment(1, pictures, entries), TEST_POWER_CUT_FRAMES);
+}
+
+// Still recording, since `test_power_cut()`'s boot, into segment `2`.
+static void test_after_power_cut() {
+	recorder_stats stats;
+	recorder_get(&stats);
+	CHECK(stats.recording);
+
+	static int pictures[TEST_FRAMES_MAX];
+	for (int i = 0; i < 60; i++) {
+		camera_fb_t const fb = test_fb(i);
+		recorder_offer(&fb);
+		recorder_tick();
+		pictures[i] = i % s_picture_count;
+	}
+
+	recorder_get(&stats);
+	CHECK_EQ(stats.dropped, 0);
+
+	// Stop, through `/recorder`, then let the writer finish up:
+	httpd_req_t request = {};
+	stub_httpd_request(&request, "/recorder?record=0");
+	CHECK_EQ(recorder_handler(&request), ESP_OK);
+	CHECK(strstr(request.response.body, "\"ring_bytes\":1048576") != NULL);
+	stub_httpd_reset(&request);
+
+	for (int i = 0; i < 100 && stats.segment != 0; i++) {
+		recorder_tick();
+		recorder_get(&stats);
+	}
+
+	CHECK_EQ(stats.segment, 0);
+	CHECK_EQ(stats.ring_used, 0);
+	CHECK_EQ(test_segment(2, pictures, 60), 60);
+}
+
+static void test_no_psram() {
+	g_stub_psram = false;
+	size_t const internal_before = stub_internal_in_use();
+	CHECK_EQ(recorder_init(), ESP_ERR_NO_MEM);
+	CHECK_EQ(stub_internal_in_use(), internal_before);
+
+	recorder_stats stats;
+	recorder_get(&stats);
+	CHECK_EQ(stats.ring_bytes, 0);
+	CHECK(!stats.recording);
+
+	camera_fb_t const fb = test_fb(0);
+	recorder_offer(&fb);
+	recorder_get(&stats);
+	CHECK_EQ(stats.ring_used, 0);
+}
+
+int main() {
+	CHECK(test_pictures(s_pictures, &s_picture_count));
+
+	char card[] = "/tmp/test_recorder.XXXXXX";
+	CHECK(mkdtemp(card) != NULL && chdir(card) == 0);
+
+	// The card's FatFs only takes 8.3 names:
+	static uint32_t const numbers[] = { 1, 99999 }; // Five digits, at most.
+	char path[32];
+	for (uint32_t const segment : numbers) {
+		for (int index = 0; index < 2; index++) {
+			recorder_segment_path(path, sizeof(path), segment, index);
+			CHECK(test_name_8_3(path));
+		}
+	}
+
+	// No card, no recorder, and no ring kept for it:
+	g_stub_psram = true;
+	g_stub_sd_card = false;
+	CHECK_EQ(recorder_init(), ESP_ERR_NOT_FOUND);
+	g_stub_sd_card = true;
+
+	recorder_stats stats;
+	recorder_get(&stats);
+	CHECK_EQ(stats.ring_bytes, 0);
+
+	if (s_picture_count > 0) {
+		test_power_cut();
+		test_after_power_cut();
+		test_no_psram();
+	}
+
+	char command[64];
+	snprintf(command, sizeof(command), "rm -r '%s'", card);
+	system(command);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_heap_caps.h>
+
+#include "app_motion.hpp"
+#include "app_overlay.hpp"
+#include "app_decode.hpp"
+
+#include "test.h"
+#include "fakes/fakes.h"
+
+// What `/stream` does to frames before they go out. `test_stream [frames...]` replays frames (JPEGs, or recorder segments off
+// the card) through `motion_update()` and `motion_skip_frame()`, and prints what each got: compared or not, the motion map,
+// sent or skipped. Without any, it plays a sequence made right here: a parked car (sensor noise only), then something
+// walking past, then parked again. That's where the answers are known. Then it stamps the HUD (`?hud=1`) into `esp32-camera`'s
+// test pictures, checks what changed and what didn't, and times that against decoding, drawing and re-encoding instead.
+#define TEST_FRAMES_MAX		1024
+#define TEST_FRAME_US		(1000000 / 15) // The `driving` profile's frame-rate.
+#define TEST_KEEPALIVE_MS	1000 // `STREAM_SKIP_KEEPALIVE_MS`.
+#define TEST_IDLE_FRAMES	30
+#define TEST_MOTION_FRAMES	15
+#define TEST_BOX_SIZE		60
+#define TEST_BOX_STEP		16 // Pixels per frame.
+
+struct test_counts {
+
+	int sent;
+	int skipped;
+	int compared;
+
+};
+
+// One frame through `stream_serve()`'s skip logic. `true` if it went out.
+static bool test_offer(motion_skip *p_skip, uint8_t *p_jpeg, size_t const p_len, int const p_width, int const p_height,
+	int64_t const p_timestamp_us, test_counts *p_counts, char const *p_name, int const p_index) {
+	camera_fb_t fb = {};
+	fb.buf = p_jpeg;
+	fb.len = p_len;
+	fb.width = p_width;
+	fb.height = p_height;
+	fb.format = PIXFORMAT_JPEG;
+	fb.timestamp.tv_sec = p_timestamp_us / 1000000;
+	fb.timestamp.tv_usec = p_timestamp_us % 1000000;
+
+	motion_result motion = {};
+	bool const compared = motion_update(&fb, &motion);
+	bool const skipped = motion_skip_frame(p_skip, compared, &motion, p_len, p_timestamp_us);
+
+	if (!skipped) {
+		motion_skip_sent(p_skip, p_len, p_timestamp_us);
+	}
+
+	p_counts->sent += !skipped;
+	p_counts->skipped += skipped;
+	p_counts->compared += compared;
+
+	if (p_name != NULL) {
+		printf("%-24s %5d %4dx%-4d %6zu B  %s  blocks %2u  energy %4u  %s\n", p_name, p_index, p_width, p_height, p_len,
+			compared ? "compared" : "--------", motion.blocks, motion.energy, skipped ? "skipped" : "sent");
+	}
+
+	return !skipped;
+}
+
+static bool test_replay(char const *p_path) {
+	static test_frame frames[TEST_FRAMES_MAX];
+	size_t const count = test_frames_load(p_path, frames, TEST_FRAMES_MAX);
+
+	if (count == 0) {
+		fprintf(stderr, "No frames in `%s`!\n", p_path);
+		return false;
+	}
+
+	char const *name = strrchr(p_path, '/') == NULL ? p_path : strrchr(p_path, '/') + 1;
+	motion_skip skip = { .keepalive_ms = TEST_KEEPALIVE_MS };
+	test_counts counts = {};
+
+	for (size_t i = 0; i < count; i++) {
+		test_frame const &frame = frames[i];
+		int64_t const timestamp_us = frame.timestamp_us != 0 ? frame.timestamp_us : (int64_t) (i + 1) * TEST_FRAME_US;
+		test_offer(&skip, frame.jpeg, frame.len, frame.width, frame.height, timestamp_us, &counts, name, i);
+	}
+
+	printf("%s: `%d` sent, `%d` skipped, `%d` compared.\n", name, counts.sent, counts.skipped, counts.compared);
+	test_frames_free(frames, count);
+	return true;
+}
+
+// The background, plus a little sensor noise, plus maybe a dark box with its left edge at `box_x`.
+static uint8_t* test_sequence_frame(uint16_t const *p_background, int const p_width, int const p_height, int const p_box_x,
+	uint32_t *p_seed, size_t *p_len) {
+	static uint16_t rgb[480 * 320];
+
+	for (int y = 0; y < p_height; y++) {
+		for (int x = 0; x < p_width; x++) {
+			uint16_t const pixel = p_background[y * p_width + x];
+			bool const box = p_box_x >= 0 && x >= p_box_x && x < p_box_x + TEST_BOX_SIZE && y >= p_height / 3
+				&& y < p_height / 3 + TEST_BOX_SIZE;
+
+			*p_seed = *p_seed * 1103515245 + 12345;
+			int const noise = (int) ((*p_seed >> 16) % 5) - 2;
+			int const r = box ? 20 : ((pixel >> 8) & 0xF8) + noise;
+			int const g = box ? 20 : ((pixel >> 3) & 0xFC) + noise;
+			int const b = box ? 20 : ((pixel << 3) & 0xF8) + noise;
+			rgb[y * p_width + x] = test_rgb565(r < 0 ? 0 : r > 255 ? 255 : r, g < 0 ? 0 : g > 255 ? 255 : g,
+				b < 0 ? 0 : b > 255 ? 255 : b);
+		}
+	}
+
+	return test_jpeg_encode(rgb, p_width, p_height, 80, p_len);
+}
+
+// Parked, something walks past, parked again. `sent[i]` says whether frame `i` went out.
+static void test_sequence(test_picture const *p_picture, uint32_t const p_keepalive_ms, bool *p_sent, test_counts *p_counts,
+	bool const p_print) {
+	int const width = p_picture->width;
+	int const height = p_picture->height;
+	uint16_t *background = (uint16_t*) malloc(width * height * 2);
+	CHECK(decode_jpg2rgb565(p_picture->jpeg, p_picture->len, (uint8_t*) background, JPG_SCALE_NONE));
+
+	motion_skip skip = { .keepalive_ms = p_keepalive_ms };
+	uint32_t seed = 1;
+	static int64_t timestamp_us = 0; // Across calls, so `motion_update()` never sees the same frame twice.
+
+	for (int i = 0; i < TEST_IDLE_FRAMES + TEST_MOTION_FRAMES + TEST_IDLE_FRAMES; i++) {
+		bool const walking = i >= TEST_IDLE_FRAMES && i < TEST_IDLE_FRAMES + TEST_MOTION_FRAMES;
+		int const box_x = walking ? (i - TEST_IDLE_FRAMES) * TEST_BOX_STEP : -1;
+
+		size_t len = 0;
+		uint8_t *jpeg = test_sequence_frame(background, width, height, box_x, &seed, &len);
+		CHECK(jpeg != NULL);
+
+		timestamp_us += TEST_FRAME_US;
+		p_sent[i] = test_offer(&skip, jpeg, len, width, height, timestamp_us, p_counts,
+			p_print ? (walking ? "sequence: walking" : "sequence: parked") : NULL, i);
+		free(jpeg);
+	}
+
+	free(background);
+}
+
+static uint16_t* test_decode(uint8_t const *p_jpeg, size_t const p_len, int const p_width, int const p_height) {
+	uint16_t *rgb = (uint16_t*) malloc(p_width * p_height * 2);
+	CHECK(decode_jpg2rgb565(p_jpeg, p_len, (uint8_t*) rgb, JPG_SCALE_NONE));
+	return rgb;
+}
+
+static int test_luma(uint16_t const p_pixel) {
+	return (((p_pixel >> 8) & 0xF8) * 77 + ((p_pixel >> 3) & 0xFC) * 150 + ((p_pixel << 3) & 0xF8) * 29) >> 8;
+}
+
+// `/overlay`'s JSON has both timings. `-1` for a field that's not there.
+static long long test_json_field(char const *p_json, char const *p_field) {
+	char key[32];
+	snprintf(key, sizeof(key), "\"%s\":", p_field);
+	char const *value = strstr(p_json, key);
+	return value == NULL ? -1 : strtoll(value + strlen(key), NULL, 10);
+}
+
+static void test_overlay(test_picture const *p_picture) {
+	camera_fb_t fb = {};
+	fb.buf = p_picture->jpeg;
+	fb.len = p_picture->len;
+	fb.width = p_picture->width;
+	fb.height = p_picture->height;
+	fb.format = PIXFORMAT_JPEG;
+	fb.timestamp.tv_sec = 12;
+	fb.timestamp.tv_usec = 345000;
+
+	size_t const capacity = fb.len + fb.len / 4 + 1024; // What `stream_serve()` gives it.
+	uint8_t *out = (uint8_t*) malloc(capacity);
+	size_t const len = overlay_hud(&fb, out, capacity);
+	CHECK(len > 0);
+
+	if (len > 0) {
+		uint16_t *before = test_decode(fb.buf, fb.len, fb.width, fb.height);
+		uint16_t *after = test_decode(out, len, fb.width, fb.height);
+
+		// Black box in the corner, white text in it:
+		CHECK(test_luma(after[1 * fb.width + 1]) < 48);
+		int white = 0;
+		for (int y = 2; y < 9; y++) {
+			for (int x = 2; x < 60; x++) {
+				white += test_luma(after[y * fb.width + x]) > 200;
+			}
+		}
+		CHECK(white > 20);
+
+		// The HUD's `10` rows tall here, so nothing below the first MCU row (`16` at most) may have changed. At all:
+		CHECK(memcmp(before + 16 * fb.width, after + 16 * fb.width, (fb.height - 16) * fb.width * 2) == 0);
+
+		free(before);
+		free(after);
+	}
+
+	// The timing comparison, straight from `/overlay`:
+	httpd_req_t request = {};
+	stub_httpd_request(&request, "/overlay");
+	fake_camera_queue(&fb);
+	CHECK_EQ(overlay_handler(&request), ESP_OK);
+
+	char const *json = request.response.body == NULL ? "" : request.response.body;
+	long long const overlay_us = test_json_field(json, "overlay_us");
+	long long const roundtrip_us = test_json_field(json, "roundtrip_us");
+	printf("%-24s %4dx%-4d  overlay %6lld us (%5lld B)  decode, draw, encode %7lld us (%5lld B)\n", p_picture->name, fb.width,
+		fb.height, overlay_us, test_json_field(json, "overlay_bytes"), roundtrip_us, test_json_field(json, "roundtrip_bytes"));
+	CHECK(overlay_us > 0);
+	CHECK(roundtrip_us < 0 || overlay_us < roundtrip_us);
+
+	// `?image=1`: the stamped JPEG itself.
+	stub_httpd_request(&request, "/overlay?image=1");
+	fake_camera_queue(&fb);
+	CHECK_EQ(overlay_handler(&request), ESP_OK);
+	CHECK(strcmp(request.response.type, "image/jpeg") == 0);
+	CHECK_EQ(request.response.body_len, len);
+
+	stub_httpd_reset(&request);
+	free(out);
+}
+
+int main(int const p_argc, char const *p_argv[]) {
+	// No PSRAM, like the `sdkconfig`. Motion detection has to make do with a smaller decode, and the HUD with a smaller canvas:
+	g_stub_psram = false;
+	CHECK_EQ(decode_init(), ESP_OK);
+	CHECK_EQ(motion_init(), ESP_OK);
+	CHECK(stub_internal_in_use() <= 16 * 1024);
+
+	size_t const internal = stub_internal_in_use();
+	CHECK_EQ(overlay_init(), ESP_OK);
+	CHECK(stub_internal_in_use() - internal <= 8 * 1024);
+
+	if (p_argc > 1) {
+		for (int i = 1; i < p_argc; i++) {
+			CHECK(test_replay(p_argv[i]));
+		}
+
+		return TEST_RESULT();
+	}
+
+	// UXGA doesn't fit that decode. Turned away before decoding, so never compared, so never skipped:
+	uint8_t not_a_jpeg[] = { 0xFF, 0xD8, 0xFF, 0xD9 };
+	motion_skip uxga = { .keepalive_ms = TEST_KEEPALIVE_MS };
+	test_counts uxga_counts = {};
+	for (int i = 0; i < 3; i++) {
+		CHECK(test_offer(&uxga, not_a_jpeg, sizeof(not_a_jpeg), 1600, 1200, (i + 1) * TEST_FRAME_US, &uxga_counts, NULL, i));
+	}
+	CHECK_EQ(uxga_counts.compared, 0);
+
+	test_picture pictures[3];
+	size_t count = 0;
+	CHECK(test_pictures(pictures, &count));
+	CHECK(count > 0);
+
+	if (count > 0) {
+		int const frames = TEST_IDLE_FRAMES + TEST_MOTION_FRAMES + TEST_IDLE_FRAMES;
+		bool sent[frames];
+		test_counts counts = {};
+		test_sequence(&pictures[0], TEST_KEEPALIVE_MS, sent, &counts, true);
+		printf("sequence: `%d` sent, `%d` skipped, `%d` compared.\n", counts.sent, counts.skipped, counts.compared);
+
+		// The very first frame has nothing to be compared against. Everything after it does:
+		CHECK(sent[0]);
+		CHECK_EQ(counts.compared, frames - 1);
+
+		// Parked: only keep-alives go out. `2` seconds of frames, so `1` or `2` of them, plus that first frame:
+		int parked_sent = 0;
+		for (int i = 1; i < TEST_IDLE_FRAMES; i++) {
+			parked_sent += sent[i];
+		}
+		CHECK(parked_sent >= 1 && parked_sent <= 2);
+
+		// Something moves: every frame goes out, starting with the very first one. No added latency!
+		for (int i = TEST_IDLE_FRAMES; i < TEST_IDLE_FRAMES + TEST_MOTION_FRAMES; i++) {
+			CHECK(sent[i]);
+		}
+
+		// The first frame without the box differs from the last one with it. Past that, it's parked again:
+		CHECK(sent[TEST_IDLE_FRAMES + TEST_MOTION_FRAMES]);
+		int settled_sent = 0;
+		for (int i = TEST_IDLE_FRAMES + TEST_MOTION_FRAMES + 1; i < frames; i++) {
+			settled_sent += sent[i];
+		}
+		CHECK(settled_sent <= 2);
+		CHECK(counts.skipped >= 2 * TEST_IDLE_FRAMES - 8);
+
+		// `?skip=0`: everything goes out, motion or not.
+		test_counts unskipped = {};
+		test_sequence(&pictures[0], 0, sent, &unskipped, false);
+		CHECK_EQ(unskipped.sent, frames);
+		CHECK_EQ(unskipped.skipped, 0);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		test_overlay(&pictures[i]);
+		free(pictures[i].jpeg);
+	}
+
+	return TEST_RESULT();
+}
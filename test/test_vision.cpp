@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_heap_caps.h>
+
+#include "app_vision.hpp"
+#include "app_decode.hpp"
+
+#include "test.h"
+
+// `test_vision [frames...]` replays frames through `vision_analyze()` and prints what it made of each, and how long that took.
+// Frames are JPEGs, or recorder segments (`.mjp`) off the card. Without any, it replays `esp32-camera`'s test pictures, then
+// checks scenes drawn right here, where the answer's known.
+#define TEST_FRAMES_MAX		1024
+#define TEST_SCENE_WIDTH	320 // QVGA, like the `driving` profile.
+#define TEST_SCENE_HEIGHT	240
+#define TEST_SCENE_HORIZON	96 // Wall above, floor below.
+
+static void test_print(char const *p_name, int const p_index, int const p_width, int const p_height, bool const p_analyzed) {
+	vision_result result = {};
+	vision_get(&result);
+
+	if (!p_analyzed) {
+		printf("%-24s %5d %4dx%-4d   (not analyzed)\n", p_name, p_index, p_width, p_height);
+		return;
+	}
+
+	printf("%-24s %5d %4dx%-4d %6lu us  free %3u  steer %3u  sectors %3u %3u %3u\n", p_name, p_index, p_width, p_height,
+		(unsigned long) result.compute_us, result.free_space, result.steer,
+		result.sectors[VISION_SECTOR_LEFT], result.sectors[VISION_SECTOR_CENTER], result.sectors[VISION_SECTOR_RIGHT]);
+}
+
+static bool test_replay(char const *p_path) {
+	static test_frame frames[TEST_FRAMES_MAX];
+	size_t const count = test_frames_load(p_path, frames, TEST_FRAMES_MAX);
+
+	if (count == 0) {
+		fprintf(stderr, "No frames in `%s`!\n", p_path);
+		return false;
+	}
+
+	char const *name = strrchr(p_path, '/') == NULL ? p_path : strrchr(p_path, '/') + 1;
+	for (size_t i = 0; i < count; i++) {
+		test_frame const &frame = frames[i];
+		bool const analyzed = vision_analyze(frame.jpeg, frame.len, frame.width, frame.height);
+		test_print(name, i, frame.width, frame.height, analyzed);
+	}
+
+	test_frames_free(frames, count);
+	return true;
+}
+
+// Grey floor up to `TEST_SCENE_HORIZON`, white wall above it. A dark box, if any, stands on the floor between `x0` and `x1`.
+static bool test_scene(char const *p_name, int const p_x0, int const p_x1, vision_result *p_out) {
+	static uint16_t rgb[TEST_SCENE_WIDTH * TEST_SCENE_HEIGHT];
+
+	for (int y = 0; y < TEST_SCENE_HEIGHT; y++) {
+		for (int x = 0; x < TEST_SCENE_WIDTH; x++) {
+			bool const box = x >= p_x0 && x < p_x1 && y >= TEST_SCENE_HORIZON - 20 && y < TEST_SCENE_HEIGHT - 60;
+			int const grain = ((x * 7 + y * 13) % 5) - 2; // Floors aren't perfectly flat grey.
+			int const luma = box ? 30 : (y < TEST_SCENE_HORIZON ? 220 : 120 + grain);
+			rgb[y * TEST_SCENE_WIDTH + x] = test_rgb565(luma, luma, luma);
+		}
+	}
+
+	size_t len = 0;
+	uint8_t *jpeg = test_jpeg_encode(rgb, TEST_SCENE_WIDTH, TEST_SCENE_HEIGHT, 80, &len);
+	CHECK(jpeg != NULL);
+
+	bool const analyzed = jpeg != NULL && vision_analyze(jpeg, len, TEST_SCENE_WIDTH, TEST_SCENE_HEIGHT);
+	free(jpeg);
+
+	test_print(p_name, 0, TEST_SCENE_WIDTH, TEST_SCENE_HEIGHT, analyzed);
+	vision_get(p_out);
+	return analyzed;
+}
+
+int main(int const p_argc, char const *p_argv[]) {
+	// No PSRAM, like the `sdkconfig`. Everything has to come out of internal RAM, and not too much of it:
+	g_stub_psram = false;
+	CHECK_EQ(decode_init(), ESP_OK);
+	CHECK_EQ(vision_init(), ESP_OK);
+	CHECK(stub_internal_in_use() <= 48 * 1024);
+
+	if (p_argc > 1) {
+		for (int i = 1; i < p_argc; i++) {
+			CHECK(test_replay(p_argv[i]));
+		}
+
+		return TEST_RESULT();
+	}
+
+	test_picture pictures[3];
+	size_t count = 0;
+	CHECK(test_pictures(pictures, &count));
+
+	for (size_t i = 0; i < count; i++) {
+		vision_result before = {};
+		vision_get(&before);
+
+		// All three fit `VISION_MAX_WIDTH` at some scale, so all three get analyzed:
+		CHECK(vision_analyze(pictures[i].jpeg, pictures[i].len, pictures[i].width, pictures[i].height));
+		test_print(pictures[i].name, 0, pictures[i].width, pictures[i].height, true);
+
+		vision_result after = {};
+		vision_get(&after);
+		CHECK_EQ(after.sequence, before.sequence + 1);
+		CHECK(after.free_space <= 100);
+		free(pictures[i].jpeg);
+	}
+
+	// UXGA won't fit even at 1/8. Turned away before decoding, so the bytes don't matter:
+	uint8_t const not_a_jpeg[] = { 0xFF, 0xD8, 0xFF, 0xD9 };
+	CHECK(!vision_analyze(not_a_jpeg, sizeof(not_a_jpeg), 1600, 1200));
+
+	vision_result clear = {};
+	vision_result left = {};
+	vision_result right = {};
+	CHECK(test_scene("scene: clear", 0, 0, &clear));
+	CHECK(test_scene("scene: box on the left", 0, 100, &left));
+	CHECK(test_scene("scene: box on the right", 220, 320, &right));
+
+	// Nothing in the way: straight ahead, floor all the way to the wall.
+	CHECK(clear.steer >= 120 && clear.steer <= 134);
+	CHECK(clear.free_space >= 55);
+
+	// Something on one side: less free space there, and away from it.
+	CHECK(left.sectors[VISION_SECTOR_LEFT] + 10 < left.sectors[VISION_SECTOR_RIGHT]);
+	CHECK(left.steer > clear.steer + 10);
+	CHECK(right.sectors[VISION_SECTOR_RIGHT] + 10 < right.sectors[VISION_SECTOR_LEFT]);
+	CHECK(right.steer + 10 < clear.steer);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+# Times control requests against the car, first with nothing else going on, then with `/stream` open and being read, so
+# what a stream does to `/controls`' latency shows up. Also prints `httpd_internal_bytes` from `/metrics`, which is what
+# the HTTP servers cost in internal RAM: build once with `STREAM_SEPARATE_PORT` set to `1` and once without to compare.
+# Usage: `python3 tools/control_latency.py <car> [requests] [path]`. `path` defaults to `/status`, which changes nothing.
+# With `STREAM_SEPARATE_PORT`, `/stream` is a `404` on port `80`, so it gets read from port `81` instead.
+# Last, the same while "steering": bare `/controls` requests (a `500` without a query, nothing moves) count as someone driving,
+# so the stream paces itself (see `app_qos.hpp`). That one's told apart from the plain streaming run by `stream_throttle_ms`.
+
+import re
+import sys
+import threading
+import time
+import urllib.error
+import urllib.request
+
+
+def get(url):
+	try:
+		with urllib.request.urlopen(url, timeout=10) as response:
+			return response.read()
+	except urllib.error.HTTPError as error:  # Still a response, and just as timed.
+		return error.read()
+
+
+def metric(base, name, missing="?"):
+	found = re.search(rb"^" + name.encode() + rb" (\d+)", get(base + "/metrics"), re.MULTILINE)
+	return found.group(1).decode() if found else missing
+
+
+def percentile(samples, p):
+	ordered = sorted(samples)
+	return ordered[min(len(ordered) - 1, int(len(ordered) * p / 100))]
+
+
+def time_requests(url, count):
+	samples = []
+	for _ in range(count):
+		start = time.monotonic()
+		get(url)
+		samples.append((time.monotonic() - start) * 1000)
+		time.sleep(0.02)  # About a joystick's rate.
+	return samples
+
+
+def read_stream(url, stop, counters):
+	with urllib.request.urlopen(url, timeout=10) as stream:
+		while not stop.is_set():
+			chunk = stream.read(16384)
+			if not chunk:
+				break
+			counters["bytes"] += len(chunk)
+
+
+def report(name, samples):
+	print("%-16s p50 %6.1f ms   p95 %6.1f ms   p99 %6.1f ms   max %6.1f ms" % (
+		name, percentile(samples, 50), percentile(samples, 95), percentile(samples, 99), max(samples)))
+
+
+def main():
+	if len(sys.argv) < 2:
+		print("Usage: control_latency.py <car> [requests] [path]")
+		sys.exit(2)
+
+	host = sys.argv[1]
+	base = host if "://" in host else "http://" + host
+	count = int(sys.argv[2]) if len(sys.argv) > 2 else 200
+	path = sys.argv[3] if len(sys.argv) > 3 else "/status"
+
+	print("Servers' internal RAM: %s bytes." % metric(base, "httpd_internal_bytes"))
+
+	idle = time_requests(base + path, count)
+
+	# The single server first, then the old stream port:
+	stop = threading.Event()
+	counters = {"bytes": 0}
+	stream_url = base + "/stream"
+	try:
+		urllib.request.urlopen(stream_url, timeout=10).close()  # Just the headers.
+	except urllib.error.HTTPError as error:
+		if error.code != 404:
+			raise
+		stream_url = re.sub(r"(://[^/:]+)(:\d+)?", r"\1:81", base) + "/stream"
+
+	reader = threading.Thread(target=read_stream, args=(stream_url + "?skip=0", stop, counters), daemon=True)
+	reader.start()
+	time.sleep(1)  # Let it get going.
+
+	start = time.monotonic()
+	streaming = time_requests(base + path, count)
+	streaming_rate = counters["bytes"] / 1048576 / max(time.monotonic() - start, 1e-6)
+
+	throttled_before = int(metric(base, "stream_throttled_frames_total", "0"))
+	counters["bytes"] = 0
+	start = time.monotonic()
+	steering = time_requests(base + "/controls", count)
+	steering_rate = counters["bytes"] / 1048576 / max(time.monotonic() - start, 1e-6)
+	throttle = metric(base, "stream_throttle_ms")
+	throttled = int(metric(base, "stream_throttled_frames_total", "0")) - throttled_before
+	stop.set()
+
+	report("Idle:", idle)
+	report("Streaming:", streaming)
+	report("Steering:", steering)
+	print("Stream from `%s`: %.2f MiB/s, then %.2f MiB/s while steering." % (stream_url, streaming_rate, steering_rate))
+	print("While steering: %d frames throttled, %s ms between frames at the end." % (throttled, throttle))
+
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+# Pulls a recorded segment (or event clip) off the car through `/footage` (see `main/include/app_footage.hpp`) the way a
+# player would: the index first, then the frames in `Range:` requests. Checks every frame against the index, seeks to a few
+# timestamps, pokes at the edge cases of `Range:`, and prints the throughput. Samples `/metrics` meanwhile, so a stream
+# that slows down while footage goes out shows up. Exits with `1` if a check fails.
+# Usage: `python3 tools/footage_fetch.py <car> [segment | clip:<n>] [request MiB] [out.mjpg]`.
+
+import json
+import random
+import re
+import struct
+import sys
+import threading
+import time
+import urllib.error
+import urllib.request
+
+FRAME_MAGIC = 0x4D524652  # `RECORDER_FRAME_MAGIC`.
+FRAME_HEADER = struct.Struct("<IIq")  # `recorder_frame_header`.
+INDEX_ENTRY = struct.Struct("<IIq")  # `recorder_index_entry`.
+
+
+def get(url, headers=None):
+	request = urllib.request.Request(url, headers=headers or {})
+	try:
+		with urllib.request.urlopen(request, timeout=30) as response:
+			return response.status, dict(response.headers), response.read()
+	except urllib.error.HTTPError as error:
+		return error.code, dict(error.headers), error.read()
+
+
+def sample_stream_fps(base, samples, stop):
+	while not stop.is_set():
+		try:
+			_, _, body = get(base + "/metrics")
+			found = re.search(rb"^stream_fps ([\d.]+)", body, re.MULTILINE)
+			if found:
+				samples.append(float(found.group(1)))
+		except OSError:
+			pass
+		stop.wait(1)
+
+
+def main():
+	if len(sys.argv) < 2:
+		print(__doc__ or "Usage: footage_fetch.py <car> [segment | clip:<n>] [request MiB] [out.mjpg]")
+		sys.exit(2)
+
+	host = sys.argv[1]
+	base = host if "://" in host else "http://" + host
+	which = sys.argv[2] if len(sys.argv) > 2 else None
+	request_bytes = int(float(sys.argv[3]) * 1048576) if len(sys.argv) > 3 else 4 * 1048576
+	out = sys.argv[4] if len(sys.argv) > 4 else None
+	failures = []
+
+	listing = json.loads(get(base + "/footage")[2])
+	if which is None:
+		closed = [s for s in listing["segments"] if not s["recording"] and s["frames"] > 0]
+		if not closed:
+			print("No closed segments with frames on the card.")
+			sys.exit(1)
+		which = str(max(closed, key=lambda s: s["number"])["number"])
+
+	kind, number = ("clip", which[5:]) if which.startswith("clip:") else ("segment", which)
+	url = "%s/footage?%s=%s" % (base, kind, number)
+	print("%d segments, %d clips on the card. Fetching %s `%s`." % (len(listing["segments"]), len(listing["clips"]), kind, number))
+
+	status, _, raw_index = get(url + "&index=1")
+	if status != 200:
+		print("Index: HTTP `%d`." % status)
+		sys.exit(1)
+
+	index = [INDEX_ENTRY.unpack_from(raw_index, i) for i in range(0, len(raw_index) - INDEX_ENTRY.size + 1, INDEX_ENTRY.size)]
+	total = index[-1][0] + index[-1][1] if index else 0
+	print("Index: %d frames, %d bytes of footage." % (len(index), total))
+
+	# Everything, one `Range:` at a time, with the stream's frame rate sampled meanwhile:
+	samples = []
+	stop = threading.Event()
+	sampler = threading.Thread(target=sample_stream_fps, args=(base, samples, stop), daemon=True)
+	sampler.start()
+
+	data = bytearray()
+	start = time.monotonic()
+	while len(data) < total:
+		last = min(total, len(data) + request_bytes) - 1
+		status, headers, body = get(url, {"Range": "bytes=%d-%d" % (len(data), last)})
+		expected = "bytes %d-%d/%d" % (len(data), last, total)
+		if status != 206 or headers.get("Content-Range") != expected or len(body) != last - len(data) + 1:
+			failures.append("`Range: bytes=%d-%d` got HTTP `%d`, `%s`, %d bytes." % (
+				len(data), last, status, headers.get("Content-Range"), len(body)))
+			break
+		data += body
+	seconds = time.monotonic() - start
+
+	stop.set()
+	sampler.join()
+	print("Fetched %d bytes in %.2f s: %.2f MiB/s, in requests of up to %d KiB." % (
+		len(data), seconds, len(data) / 1048576 / max(seconds, 1e-6), request_bytes // 1024))
+	if samples:
+		print("Stream meanwhile: %.1f to %.1f fps." % (min(samples), max(samples)))
+
+	# Every frame where the index says, with a header that agrees, and a whole JPEG:
+	for i, (offset, length, timestamp) in enumerate(index):
+		if offset + length > len(data):
+			break
+		magic, header_length, header_timestamp = FRAME_HEADER.unpack_from(data, offset - FRAME_HEADER.size)
+		jpeg = data[offset:offset + length]
+		if magic != FRAME_MAGIC or header_length != length or header_timestamp != timestamp:
+			failures.append("Frame %d: header doesn't match the index." % i)
+		elif jpeg[:2] != b"\xff\xd8" or jpeg[-2:] != b"\xff\xd9":
+			failures.append("Frame %d: not a whole JPEG." % i)
+
+	# Seeks, to frame timestamps and to between them:
+	rng = random.Random(1)
+	for _ in range(min(8, len(index))):
+		i = rng.randrange(len(index))
+		at = index[i][2] + (rng.randrange(1, index[i + 1][2] - index[i][2]) if i + 1 < len(index) and index[i + 1][2] > index[i][2] + 1 else 0)
+		status, headers, body = get(url + "&at=%d" % at)
+		offset, length, _ = index[i]
+		if status != 200 or int(headers.get("X-Frame", -1)) != i or int(headers.get("X-Offset", -1)) != offset - FRAME_HEADER.size \
+			or bytes(body) != bytes(data[offset:offset + length]):
+			failures.append("Seek to `%d` didn't land on frame %d (got HTTP `%d`, frame `%s`)." % (at, i, status, headers.get("X-Frame")))
+
+	if index:
+		status, headers, _ = get(url + "&at=%d" % (index[0][2] - 1))
+		if status != 200 or headers.get("X-Frame") != "0":
+			failures.append("Seek before the first frame didn't land on it.")
+
+	# `Range:` edge cases:
+	status, headers, body = get(url, {"Range": "bytes=-100"})
+	if total >= 100 and (status != 206 or bytes(body) != bytes(data[-100:])):
+		failures.append("Suffix range: HTTP `%d`, %d bytes." % (status, len(body)))
+	status, headers, _ = get(url, {"Range": "bytes=%d-" % total})
+	if status != 416 or headers.get("Content-Range") != "bytes */%d" % total:
+		failures.append("Range past the end: HTTP `%d`, `%s`." % (status, headers.get("Content-Range")))
+
+	if out:
+		with open(out, "wb") as file:
+			file.write(data)
+
+	for failure in failures:
+		print("FAIL: " + failure)
+	print("%d frames checked, %d seeks." % (len(index), min(8, len(index)) + 1))
+	sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+	main()
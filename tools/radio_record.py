@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+# Records the Wi-Fi link as the car's governor (see `main/include/app_radio.hpp`) sees it: `/metrics` every `RADIO_SAMPLE_MS`,
+# one CSV line per sample, with what the governor did about it. Walk the car around with a stream open, then Ctrl+C. Save
+# the recording into `test/radio/`, and `test/test_radio.cpp` replays it through the governor from then on.
+# Usage: `python3 tools/radio_record.py <car> test/radio/<name>.csv`.
+
+import re
+import sys
+import time
+import urllib.request
+
+SAMPLE_S = 0.25  # `RADIO_SAMPLE_MS`.
+FIELDS = ("wifi_rssi_dbm", "wifi_goodput_kbps", "wifi_predicted_kbps", "stream_frame_interval_ms")
+
+
+def scrape(base):
+	with urllib.request.urlopen(base + "/metrics", timeout=5) as response:
+		text = response.read().decode()
+
+	values = {}
+	for name in FIELDS:
+		found = re.search(r"^" + name + r" (-?\d+)", text, re.MULTILINE)
+		values[name] = int(found.group(1)) if found else 0
+
+	found = re.search(r'^stream_framesize\{size="governed"\} (\d+)', text, re.MULTILINE)
+	values["framesize"] = int(found.group(1)) if found else 0
+	return values
+
+
+def main():
+	if len(sys.argv) < 2:
+		print("Usage: radio_record.py <car> [out.csv]")
+		sys.exit(2)
+
+	host = sys.argv[1]
+	base = host if "://" in host else "http://" + host
+	out = open(sys.argv[2], "w") if len(sys.argv) > 2 else sys.stdout
+
+	print("seconds,rssi_dbm,goodput_kbps,predicted_kbps,interval_ms,framesize", file=out, flush=True)
+	start = time.monotonic()
+	due = start
+
+	try:
+		while True:
+			values = scrape(base)
+			print("%.2f,%d,%d,%d,%d,%d" % (time.monotonic() - start, values["wifi_rssi_dbm"], values["wifi_goodput_kbps"],
+				values["wifi_predicted_kbps"], values["stream_frame_interval_ms"], values["framesize"]), file=out, flush=True)
+
+			due += SAMPLE_S
+			time.sleep(max(0.0, due - time.monotonic()))
+	except KeyboardInterrupt:
+		pass
+
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+# Prints the per-frame metadata `/stream` sends as part headers (see `_STREAM_PART` in `main/app_httpd.cpp`), plus how many
+# bytes that metadata costs next to the JPEGs themselves.
+# Usage: `python3 tools/stream_meta.py http://<car>/stream [frames]`, or a dump: `curl -s ... > stream.bin` first.
+
+import sys
+import urllib.request
+
+BOUNDARY = b"--123456789000000000000987654321"
+# What the part header was, before any metadata got added to it:
+BASELINE_HEADERS = ("content-type", "content-length", "x-timestamp")
+
+
+def parts(stream):
+	while True:
+		line = stream.readline()
+		if not line:
+			return
+		if line.strip() != BOUNDARY:
+			continue
+
+		headers = {}
+		size = 0
+		while True:
+			line = stream.readline()
+			if not line:
+				return
+			size += len(line)
+			if line in (b"\r\n", b"\n"):
+				break
+			name, _, value = line.decode("ascii", "replace").partition(":")
+			headers[name.strip().lower()] = (value.strip(), len(line))
+
+		length = int(headers.get("content-length", ("0", 0))[0])
+		jpeg = stream.read(length)
+		if len(jpeg) < length:
+			return
+		yield headers, size, jpeg
+
+
+def describe(headers):
+	fields = []
+	if "x-timestamp" in headers and "x-sent" in headers:
+		latency = float(headers["x-sent"][0]) - float(headers["x-timestamp"][0])
+		fields.append("latency %6.1f ms" % (latency * 1000))
+	if "x-motion" in headers:
+		energy, blocks, bitmap = headers["x-motion"][0].split(";")
+		fields.append("motion %4s permille, %2s blocks (0x%07x)" % (energy, blocks, int(bitmap, 16)))
+	if "x-controls" in headers:
+		steer, gear, mode = headers["x-controls"][0].split(";")
+		fields.append("steer %3s, gear `%s`, %s" % (steer, chr(int(gear)) if int(gear) > 0 else "-",
+			"manual" if mode == "1" else "auto"))
+	if "x-faces" in headers:
+		face_id, *boxes = headers["x-faces"][0].split(";")
+		fields.append("faces %s (ID %s)" % (" ".join("[%s]" % box for box in boxes), face_id))
+	return ", ".join(fields)
+
+
+def main(source, limit):
+	stream = urllib.request.urlopen(source) if "://" in source else open(source, "rb")
+	frames = header_bytes = metadata_bytes = jpeg_bytes = 0
+
+	try:
+		for headers, size, jpeg in parts(stream):
+			frames += 1
+			header_bytes += size
+			metadata_bytes += sum(length for name, (_, length) in headers.items() if name not in BASELINE_HEADERS)
+			jpeg_bytes += len(jpeg)
+			print("%5d  %6d B  %s" % (frames, len(jpeg), describe(headers)))
+			if limit and frames >= limit:
+				break
+	except KeyboardInterrupt:
+		pass
+
+	if frames:
+		print("%d frames: %.0f B of JPEG, %.0f B of part header (%.0f B metadata) per frame. Metadata overhead: %.2f%%." % (
+			frames, jpeg_bytes / frames, header_bytes / frames, metadata_bytes / frames,
+			100.0 * metadata_bytes / (jpeg_bytes + header_bytes)))
+
+
+if __name__ == "__main__":
+	if len(sys.argv) not in (2, 3):
+		sys.exit("Usage: %s <stream URL or dump> [frames]" % sys.argv[0])
+	main(sys.argv[1], int(sys.argv[2]) if len(sys.argv) == 3 else 0)
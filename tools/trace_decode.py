@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+# Renders a `/trace` dump (see `main/include/app_trace.hpp`) as a timeline.
+# Usage: `curl -s http://<car>/trace > trace.bin && python3 tools/trace_decode.py trace.bin`.
+
+import struct
+import sys
+
+TRACE_MAGIC = 0x31435254
+CHANNELS = ["camera", "stream", "control", "stream_2"]
+
+# Same order as `trace_event`. Append only!
+EVENTS = [
+	"none",
+	"camera_init_begin",
+	"camera_init_end",
+	"fb_get_begin",
+	"fb_get_end",
+	"stream_begin",
+	"stream_encode_end",
+	"stream_send_end",
+	"stream_end",
+	"control_begin",
+	"control_steer",
+	"control_gear",
+	"control_mode",
+	"control_end",
+	"stream_skip",
+	"control_throttle",
+]
+
+HEADER = struct.Struct("<IHHI%dI" % len(CHANNELS))
+RECORD = struct.Struct("<IHBBII")
+
+
+def describe(event, arg0, arg1):
+	if event == "fb_get_end":
+		return "%u B, %ux%u" % (arg0, arg1 >> 16, arg1 & 0xFFFF)
+	if event == "stream_skip":
+		return "%u B, energy %u" % (arg0, arg1)
+	if event == "control_throttle":
+		return "throttle %d" % (arg0 - (1 << 32) if arg0 & 0x80000000 else arg0)
+	if event == "control_gear":
+		return "gear `%s`" % chr(arg0)
+	if event in ("camera_init_end", "stream_send_end"):
+		return "err 0x%x" % arg0
+	return "%u, %u" % (arg0, arg1)
+
+
+def main(path):
+	with open(path, "rb") as file:
+		data = file.read()
+
+	magic, record_size, count, emit_cost_ns, *dropped = HEADER.unpack_from(data, 0)
+	if magic != TRACE_MAGIC or record_size != RECORD.size:
+		sys.exit("Not a trace dump (or a different version of one).")
+
+	print("%d records, `trace_emit()` costs ~%d ns." % (count, emit_cost_ns))
+	for channel, lost in zip(CHANNELS, dropped):
+		if lost:
+			print("Channel `%s` dropped %d records (ever)." % (channel, lost))
+
+	records = []
+	for i in range(count):
+		records.append(RECORD.unpack_from(data, HEADER.size + i * RECORD.size))
+
+	# Timestamps are the low 32 bits of a microsecond clock. Unwrap them, assuming no gap is over ~71 minutes:
+	unwrapped = []
+	epoch = 0
+	previous = None
+	for timestamp, event, channel, core, arg0, arg1 in records:
+		if previous is not None and timestamp < previous and previous - timestamp > 1 << 31:
+			epoch += 1 << 32
+		previous = timestamp
+		unwrapped.append((epoch + timestamp, event, channel, core, arg0, arg1))
+
+	# Channels get drained one after another, so sort to interleave them properly:
+	unwrapped.sort(key=lambda record: record[0])
+
+	start = unwrapped[0][0] if unwrapped else 0
+	last_by_channel = {}
+	for timestamp, event, channel, core, arg0, arg1 in unwrapped:
+		name = EVENTS[event] if event < len(EVENTS) else "event_%d" % event
+		channel_name = CHANNELS[channel] if channel < len(CHANNELS) else "channel_%d" % channel
+		delta = timestamp - last_by_channel.get(channel, timestamp)
+		last_by_channel[channel] = timestamp
+
+		# One column per channel, so each producer's events line up vertically:
+		indent = "    " * channel
+		print("%10.3f ms  core %d  %s%-8s %-18s +%7d us  %s" % (
+			(timestamp - start) / 1000, core, indent, channel_name, name, delta, describe(name, arg0, arg1)))
+
+
+if __name__ == "__main__":
+	if len(sys.argv) != 2:
+		sys.exit("Usage: %s <trace.bin>" % sys.argv[0])
+	main(sys.argv[1])